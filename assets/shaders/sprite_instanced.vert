@@ -0,0 +1,27 @@
+#version 430 core
+
+layout(location = 0)in vec2 v_corner;
+layout(location = 1)in vec2 i_position;
+layout(location = 2)in vec2 i_scale;
+layout(location = 3)in vec2 i_origin;
+layout(location = 4)in float i_rotation;
+layout(location = 5)in vec4 i_color;
+layout(location = 6)in vec4 i_texture_rect;
+
+out vec4 color;
+out vec2 tex_coord;
+
+uniform mat4 u_view;
+
+void main()
+ {
+    vec2 local_position = v_corner * i_scale - i_origin;
+    float c = cos(i_rotation);
+    float s = sin(i_rotation);
+    vec2 position = i_position + vec2(c * local_position.x - s * local_position.y,
+                                      s * local_position.x + c * local_position.y);
+
+    tex_coord = i_texture_rect.xy + (v_corner + 0.5) * i_texture_rect.zw;
+    gl_Position = u_view * vec4(position, 0.0, 1.0);
+    color = i_color;
+}
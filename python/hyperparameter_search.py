@@ -59,6 +59,7 @@ class HyperParameterSearch(tune.Trainable):
 
     def _setup(self, config):
         self._timesteps_total = 0
+        self._metric_cursor = 0
         with open(config["base_program"], 'r') as file:
             self.program = json.load(file)
         self.program["hyper_parameters"] = config
@@ -66,9 +67,19 @@ class HyperParameterSearch(tune.Trainable):
 
     def _train(self):
         start_time = time.time()
+        batch = self.trainer.step_batch_async()
         while time.time() - start_time < 300:
-            self.trainer.step_batch()
-        return {"elo": self.trainer.evaluate()}
+            batch.result()
+            batch = self.trainer.step_batch_async()
+        batch.result()
+        elo = self.trainer.evaluate_async().result()
+
+        # Report the latest value of each metric logged since the last call
+        metrics, self._metric_cursor, _ = self.trainer.metrics.poll(
+            self._metric_cursor)
+        result = {metric.name: metric.value for metric in metrics}
+        result["elo"] = elo
+        return result
 
     def _save(self, _):
         return {"path": self.trainer.save_model("")}
@@ -81,6 +92,7 @@ class HyperParameterSearch(tune.Trainable):
             if file.endswith(".meta"):
                 self.program["opponent_pool"].append(file)
         self.trainer = st.make_trainer(json.dumps(self.program, indent=0))
+        self._metric_cursor = 0
 
 
 def main():
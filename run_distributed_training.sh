@@ -0,0 +1,27 @@
+#!/bin/bash
+# Runs a learner and several rollout workers on this machine
+# Usage: ./run_distributed_training.sh <program.json> [workers] [envs per worker]
+
+set -e
+
+PROGRAM=$1
+WORKERS=${2:-4}
+ENVS=${3:-2}
+BUILD_DIR=${BUILD_DIR:-build}
+
+if [ -z "$PROGRAM" ]; then
+    echo "Usage: $0 <program.json> [workers] [envs per worker]"
+    exit 1
+fi
+
+function cleanup {
+    kill -INT $(jobs -p) 2>/dev/null || true
+    wait
+}
+trap cleanup EXIT
+
+"${BUILD_DIR}/learner" "$PROGRAM" &
+for i in $(seq 1 "$WORKERS"); do
+    "${BUILD_DIR}/rolloutworker" "$PROGRAM" --envs="$ENVS" --id="worker-$i" &
+done
+wait
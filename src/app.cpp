@@ -1,4 +1,5 @@
 #include <memory>
+#include <string>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -20,6 +21,7 @@
 #include "graphics/window.h"
 #include "misc/animator.h"
 #include "misc/io.h"
+#include "misc/profiler.h"
 #include "misc/resource_manager.h"
 #include "misc/screen_manager.h"
 #include "misc/utilities.h"
@@ -37,6 +39,33 @@ const int opengl_version_minor = 3;
 int last_resolution_x = resolution_x;
 int last_resolution_y = resolution_y;
 
+std::string profile_path = "profile.json";
+
+void write_profile()
+{
+    auto &profiler = get_profiler();
+    profiler.write_chrome_trace(profile_path);
+#ifdef BUILD_WITH_EASY_PROFILER
+    profiler.write_easy_profile(profile_path + ".prof");
+#endif
+    profiler.clear();
+}
+
+void toggle_profiling()
+{
+    auto &profiler = get_profiler();
+    if (profiler.is_enabled())
+    {
+        profiler.set_enabled(false);
+        write_profile();
+    }
+    else
+    {
+        spdlog::info("Profiling, press F9 again to stop and write {}", profile_path);
+        profiler.set_enabled(true);
+    }
+}
+
 void reset_imgui_style()
 {
     ImGuiStyle &style = ImGui::GetStyle();
@@ -195,6 +224,12 @@ void resize_window_callback(GLFWwindow *glfw_window, int x, int y)
 
 void key_callback(GLFWwindow *glfw_window, int key, int /*scancode*/, int actions, int /*mod*/)
 {
+    if (key == GLFW_KEY_F9 && actions == GLFW_PRESS)
+    {
+        toggle_profiling();
+        return;
+    }
+
     auto &io = static_cast<Window *>(glfwGetWindowUserPointer(glfw_window))->get_io();
     if (!ImGui::GetIO().WantCaptureKeyboard)
     {
@@ -265,6 +300,15 @@ int App::run(int argc, char *argv[])
         return run_tests(argc, argv, args);
     }
 
+    // Profile from startup with --profile=<path>, or toggle with F9
+    if (args({"--profile"}) >> profile_path)
+    {
+        get_profiler().set_enabled(true);
+    }
+#ifdef BUILD_WITH_EASY_PROFILER
+    EASY_MAIN_THREAD;
+#endif
+
     window.init();
     glfwSetErrorCallback(error_callback);
     renderer.init();
@@ -321,6 +365,8 @@ int App::run(int argc, char *argv[])
 
     while (!window.should_close())
     {
+        AI_PROFILE_SCOPE("Frame");
+
         /*
          *  Input
          */
@@ -374,6 +420,13 @@ int App::run(int argc, char *argv[])
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         window.swap_buffers();
+        get_profiler().end_frame();
+    }
+
+    if (get_profiler().is_enabled())
+    {
+        get_profiler().set_enabled(false);
+        write_profile();
     }
 
     // Allow screens to perform cleanup
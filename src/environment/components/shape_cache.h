@@ -0,0 +1,16 @@
+#pragma once
+
+#include "graphics/renderers/shape_tessellator.h"
+
+namespace ai
+{
+// The shape an entity was last drawn as, and its tessellation once it has
+// been drawn the same way twice in a row
+template <typename Shape>
+struct ShapeCache
+{
+    Shape shape{};
+    bool has_shape = false;
+    RetainedShape retained;
+};
+}
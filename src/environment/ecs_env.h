@@ -33,5 +33,9 @@ class EcsEnv : public IEcsEnv
     void set_body(std::size_t index, const nlohmann::json &body_def) override;
     void set_reward_config(const RewardConfig &reward_config) override;
     EcsStepInfo step(const std::vector<torch::Tensor> &actions, double step_length) override;
+
+    inline const std::array<entt::entity, 2> &get_bodies() const { return bodies; }
+    inline entt::registry &get_registry() { return registry; }
+    inline const entt::registry &get_registry() const { return registry; }
 };
 }
\ No newline at end of file
@@ -3,11 +3,14 @@
 #include "distortion_system.h"
 #include "environment/components/distortion_emitter.h"
 #include "graphics/renderers/renderer.h"
+#include "misc/profiler.h"
 
 namespace ai
 {
 void distortion_system(entt::registry &registry, Renderer &renderer)
 {
+    AI_PROFILE_SCOPE("distortion_system");
+
     registry.view<DistortionEmitter>().each([&](auto entity, auto &emitter) {
         if (emitter.explosive)
         {
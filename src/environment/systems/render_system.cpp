@@ -1,15 +1,22 @@
+#include <algorithm>
+
 #include <Box2D/Box2D.h>
 #include <doctest.h>
 #include <entt/entt.hpp>
+#include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "render_system.h"
 #include "environment/components/ecs_render_data.h"
 #include "environment/components/render_shape_container.h"
+#include "environment/components/shape_cache.h"
 #include "environment/systems/clean_up_system.h"
 #include "graphics/colors.h"
 #include "graphics/render_data.h"
 #include "graphics/renderers/renderer.h"
+#include "misc/profiler.h"
+#include "misc/transform.h"
 
 namespace ai
 {
@@ -38,54 +45,185 @@ void update_container_transforms(entt::registry &registry)
     });
 }
 
+// The part of the world an orthographic view shows
+struct ViewBounds
+{
+    glm::vec2 min;
+    glm::vec2 max;
+
+    // Whether anything within radius of position can be seen
+    bool is_visible(glm::vec2 position, float radius) const
+    {
+        return position.x + radius >= min.x && position.x - radius <= max.x &&
+               position.y + radius >= min.y && position.y - radius <= max.y;
+    }
+
+    bool is_visible(const Transform &transform, float radius) const
+    {
+        return is_visible(transform.get_position(), radius);
+    }
+};
+
+ViewBounds get_view_bounds(const glm::mat4 &view)
+{
+    const auto inverse_view = glm::inverse(view);
+    const glm::vec2 corner_1(inverse_view * glm::vec4(-1.f, -1.f, 0.f, 1.f));
+    const glm::vec2 corner_2(inverse_view * glm::vec4(1.f, 1.f, 0.f, 1.f));
+    return {glm::min(corner_1, corner_2), glm::max(corner_1, corner_2)};
+}
+
+bool same_shape(const Circle &a, const Circle &b)
+{
+    return a.radius == b.radius &&
+           a.fill_color == b.fill_color &&
+           a.stroke_color == b.stroke_color &&
+           a.stroke_width == b.stroke_width &&
+           a.transform == b.transform;
+}
+
+bool same_shape(const Rectangle &a, const Rectangle &b)
+{
+    return a.fill_color == b.fill_color &&
+           a.stroke_color == b.stroke_color &&
+           a.stroke_width == b.stroke_width &&
+           a.transform == b.transform;
+}
+
+bool same_shape(const SemiCircle &a, const SemiCircle &b)
+{
+    return a.radius == b.radius &&
+           a.fill_color == b.fill_color &&
+           a.stroke_color == b.stroke_color &&
+           a.stroke_width == b.stroke_width &&
+           a.transform == b.transform;
+}
+
+bool same_shape(const Trapezoid &a, const Trapezoid &b)
+{
+    return a.top_width == b.top_width &&
+           a.bottom_width == b.bottom_width &&
+           a.fill_color == b.fill_color &&
+           a.stroke_color == b.stroke_color &&
+           a.stroke_width == b.stroke_width &&
+           a.transform == b.transform;
+}
+
+// Shapes that are drawn the same way two frames in a row (walls, the hill,
+// the background) keep their tessellation and redraw it from then on, until
+// they change. Shapes that move every frame just get tessellated as normal.
+template <typename Shape>
+void draw_cached(entt::registry &registry,
+                 Renderer &renderer,
+                 entt::entity entity,
+                 const Shape &shape)
+{
+    auto &cache = registry.get_or_emplace<ShapeCache<Shape>>(entity);
+    if (!cache.has_shape || !same_shape(cache.shape, shape))
+    {
+        cache.shape = shape;
+        cache.has_shape = true;
+        cache.retained.vertices.clear();
+        renderer.draw(shape);
+        return;
+    }
+
+    if (!cache.retained.vertices.empty() && renderer.draw(cache.retained))
+    {
+        return;
+    }
+    renderer.draw(shape);
+    renderer.retain_last_shape(cache.retained);
+}
+
 void render_system(entt::registry &registry, Renderer &renderer)
 {
+    AI_PROFILE_SCOPE("render_system");
+
     clean_up_orphans(registry);
     update_container_transforms(registry);
     clean_up_system(registry);
 
-    registry.view<EcsCircle, Transform, Color>().each([&renderer](auto &circle,
-                                                                  auto &transform,
-                                                                  auto &color) {
-        renderer.draw(Circle{transform.get_scale().x * 0.5f,
-                             color.fill_color,
-                             color.stroke_color,
-                             circle.stroke_width,
-                             transform});
+    const auto bounds = get_view_bounds(renderer.get_view());
+
+    registry.view<EcsCircle, Transform, Color>().each([&](const auto entity,
+                                                          auto &circle,
+                                                          auto &transform,
+                                                          auto &color) {
+        const float radius = transform.get_scale().x * 0.5f;
+        if (bounds.is_visible(transform,
+                              radius + circle.stroke_width + glm::length(transform.get_origin())))
+        {
+            draw_cached(registry, renderer, entity, Circle{radius,
+                                                           color.fill_color,
+                                                           color.stroke_color,
+                                                           circle.stroke_width,
+                                                           transform});
+        }
     });
 
-    registry.view<EcsRectangle, Transform, Color>().each([&renderer](auto &rectangle,
-                                                                     auto &transform,
-                                                                     auto &color) {
-        renderer.draw(Rectangle{color.fill_color,
-                                color.stroke_color,
-                                rectangle.stroke_width,
-                                transform});
+    registry.view<EcsRectangle, Transform, Color>().each([&](const auto entity,
+                                                             auto &rectangle,
+                                                             auto &transform,
+                                                             auto &color) {
+        if (bounds.is_visible(transform,
+                              glm::length(transform.get_scale() * 0.5f) +
+                                  glm::length(transform.get_origin()) +
+                                  rectangle.stroke_width))
+        {
+            draw_cached(registry, renderer, entity, Rectangle{color.fill_color,
+                                                              color.stroke_color,
+                                                              rectangle.stroke_width,
+                                                              transform});
+        }
     });
 
-    registry.view<EcsSemiCircle, Transform, Color>().each([&renderer](auto &semi_circle,
-                                                                      auto &transform,
-                                                                      auto &color) {
-        renderer.draw(SemiCircle{transform.get_scale().x * 0.5f,
-                                 color.fill_color,
-                                 color.stroke_color,
-                                 semi_circle.stroke_width,
-                                 transform});
+    registry.view<EcsSemiCircle, Transform, Color>().each([&](const auto entity,
+                                                              auto &semi_circle,
+                                                              auto &transform,
+                                                              auto &color) {
+        const float radius = transform.get_scale().x * 0.5f;
+        if (bounds.is_visible(transform,
+                              radius + semi_circle.stroke_width +
+                                  glm::length(transform.get_origin())))
+        {
+            draw_cached(registry, renderer, entity, SemiCircle{radius,
+                                                               color.fill_color,
+                                                               color.stroke_color,
+                                                               semi_circle.stroke_width,
+                                                               transform});
+        }
     });
 
-    registry.view<EcsTrapezoid, Transform, Color>().each([&renderer](auto &trapezoid,
-                                                                     auto &transform,
-                                                                     auto &color) {
-        renderer.draw(Trapezoid{trapezoid.top_width,
-                                trapezoid.bottom_width,
-                                color.fill_color,
-                                color.stroke_color,
-                                trapezoid.stroke_width,
-                                transform});
+    registry.view<EcsTrapezoid, Transform, Color>().each([&](const auto entity,
+                                                             auto &trapezoid,
+                                                             auto &transform,
+                                                             auto &color) {
+        const auto scale = transform.get_scale();
+        const glm::vec2 half_size(std::max(trapezoid.top_width, trapezoid.bottom_width) *
+                                      scale.x * 0.5f,
+                                  scale.y * 0.5f);
+        if (bounds.is_visible(transform,
+                              glm::length(half_size) +
+                                  glm::length(transform.get_origin()) +
+                                  trapezoid.stroke_width))
+        {
+            draw_cached(registry, renderer, entity, Trapezoid{trapezoid.top_width,
+                                                              trapezoid.bottom_width,
+                                                              color.fill_color,
+                                                              color.stroke_color,
+                                                              trapezoid.stroke_width,
+                                                              transform});
+        }
     });
 
-    registry.view<Line>().each([&renderer](auto &line) {
-        renderer.draw(line);
+    registry.view<Line>().each([&](auto &line) {
+        const auto scale = line.transform.get_scale();
+        const auto offset = line.transform.get_position() - line.transform.get_origin();
+        if (bounds.is_visible(offset + (line.start + line.end) * 0.5f * scale,
+                              glm::length((line.end - line.start) * scale) * 0.5f + line.width))
+        {
+            renderer.draw(line);
+        }
     });
 
     registry.view<Sprite>().each([&renderer](auto &sprite) {
@@ -166,6 +304,25 @@ TEST_CASE("Render system")
         }
     }
 
+    SUBCASE("View bounds")
+    {
+        const auto bounds = get_view_bounds(glm::ortho(-10.f, 10.f, -5.f, 5.f));
+
+        DOCTEST_CHECK(bounds.min.x == doctest::Approx(-10.f));
+        DOCTEST_CHECK(bounds.min.y == doctest::Approx(-5.f));
+        DOCTEST_CHECK(bounds.max.x == doctest::Approx(10.f));
+        DOCTEST_CHECK(bounds.max.y == doctest::Approx(5.f));
+
+        SUBCASE("Shapes are only culled once they are entirely outside the view")
+        {
+            Transform transform;
+            transform.set_position({12.f, 0.f});
+
+            DOCTEST_CHECK(!bounds.is_visible(transform, 1.f));
+            DOCTEST_CHECK(bounds.is_visible(transform, 3.f));
+        }
+    }
+
     SUBCASE("update_container_transforms()")
     {
         const auto parent_entity = registry.create();
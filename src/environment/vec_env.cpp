@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <torch/torch.h>
+
+#include "environment/vec_env.h"
+#include "environment/ecs_env.h"
+#include "environment/serialization/serialize_body.h"
+#include "misc/thread_pool.h"
+
+namespace ai
+{
+namespace
+{
+// The same timing as training: one action every six frames
+const double frame_length = 1. / 60.;
+const int frames_per_action = 6;
+}
+
+VecEnv::VecEnv(std::size_t env_count,
+               const nlohmann::json &body_spec,
+               double game_length,
+               unsigned int thread_count,
+               const RewardConfig &reward_config)
+    : action_size(body_spec["num_actions"]),
+      dones(env_count, 0),
+      observation_size(body_spec["num_observations"]),
+      observations(env_count * 2 * static_cast<std::size_t>(observation_size), 0.f),
+      rewards(env_count * 2, 0.f),
+      thread_count(thread_count == 0 ? std::max(1u, std::thread::hardware_concurrency())
+                                     : thread_count),
+      victors(env_count, -1)
+{
+    if (env_count == 0)
+    {
+        throw std::invalid_argument("A VecEnv needs at least one environment");
+    }
+
+    this->thread_count = std::min(this->thread_count, static_cast<unsigned int>(env_count));
+    if (this->thread_count > 1)
+    {
+        thread_pool = std::make_unique<ThreadPool>(this->thread_count - 1);
+    }
+
+    for (std::size_t i = 0; i < env_count; ++i)
+    {
+        environments.push_back(std::make_unique<EcsEnv>(game_length));
+        auto &environment = *environments.back();
+        environment.set_audibility(false);
+        environment.set_reward_config(reward_config);
+        environment.set_body(0, body_spec);
+        environment.set_body(1, body_spec);
+    }
+}
+
+VecEnv::~VecEnv() {}
+
+void VecEnv::reset()
+{
+    run_parallel([this](std::size_t index) {
+        write_observations(index, environments[index]->reset().observations);
+        rewards[index * 2] = 0.f;
+        rewards[index * 2 + 1] = 0.f;
+        dones[index] = 0;
+        victors[index] = -1;
+    });
+}
+
+template <typename Function>
+void VecEnv::run_parallel(Function function)
+{
+    const auto env_count = environments.size();
+    const auto envs_per_thread = (env_count + thread_count - 1) / thread_count;
+    auto run_range = [&function](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i)
+        {
+            function(i);
+        }
+    };
+
+    // The calling thread takes the first share rather than waiting idle
+    std::vector<std::future<void>> futures;
+    for (std::size_t first = envs_per_thread; first < env_count; first += envs_per_thread)
+    {
+        futures.push_back(thread_pool->enqueue(run_range,
+                                               first,
+                                               std::min(first + envs_per_thread, env_count)));
+    }
+    run_range(0, std::min(envs_per_thread, env_count));
+    for (auto &future : futures)
+    {
+        future.get();
+    }
+}
+
+void VecEnv::step(const float *actions)
+{
+    torch::NoGradGuard no_grad;
+    run_parallel([this, actions](std::size_t index) {
+        auto &environment = *environments[index];
+        const auto agent_actions = const_cast<float *>(actions) +
+                                   index * 2 * static_cast<std::size_t>(action_size);
+        const auto step_info = environment.step(
+            {torch::from_blob(agent_actions, {1, action_size}),
+             torch::from_blob(agent_actions + action_size, {1, action_size})},
+            frame_length);
+        for (int i = 1; i < frames_per_action; ++i)
+        {
+            environment.forward(frame_length);
+        }
+
+        const auto step_rewards = step_info.reward.contiguous();
+        rewards[index * 2] = step_rewards.data_ptr<float>()[0];
+        rewards[index * 2 + 1] = step_rewards.data_ptr<float>()[1];
+        dones[index] = step_info.done[0].item().toBool();
+        victors[index] = step_info.victor;
+
+        if (dones[index])
+        {
+            write_observations(index, environment.reset().observations);
+        }
+        else
+        {
+            write_observations(index, step_info.observations);
+        }
+    });
+}
+
+void VecEnv::write_observations(std::size_t index,
+                                const std::vector<torch::Tensor> &env_observations)
+{
+    for (std::size_t body = 0; body < 2; ++body)
+    {
+        const auto observation = env_observations[body].contiguous();
+        if (observation.numel() != observation_size)
+        {
+            throw std::runtime_error(fmt::format("Expected {} observations, got {}",
+                                                 observation_size,
+                                                 observation.numel()));
+        }
+        std::memcpy(observations.data() +
+                        (index * 2 + body) * static_cast<std::size_t>(observation_size),
+                    observation.data_ptr<float>(),
+                    static_cast<std::size_t>(observation_size) * sizeof(float));
+    }
+}
+
+TEST_CASE("VecEnv")
+{
+    VecEnv vec_env(3, default_body(), 1, 2);
+    vec_env.reset();
+    const auto action_count = vec_env.get_env_count() * 2 *
+                              static_cast<std::size_t>(vec_env.get_action_size());
+
+    SUBCASE("Buffers stay in the same place between steps")
+    {
+        const auto *observations = vec_env.get_observations();
+        std::vector<float> actions(action_count, 1.f);
+        vec_env.step(actions.data());
+
+        DOCTEST_CHECK(vec_env.get_observations() == observations);
+    }
+
+    SUBCASE("Finished environments are reset")
+    {
+        std::vector<float> actions(action_count, 0.f);
+        int steps = 0;
+        while (!vec_env.get_dones()[0] && steps < 100)
+        {
+            vec_env.step(actions.data());
+            ++steps;
+        }
+
+        // A one second game at ten actions per second. EcsEnv::step() checks
+        // for the end of the game after the first frame of a step, the same
+        // as in every other rollout, so the game is over on the 11th step.
+        DOCTEST_CHECK(steps == 11);
+        DOCTEST_CHECK(vec_env.get_dones()[1]);
+        DOCTEST_CHECK(vec_env.get_dones()[2]);
+
+        vec_env.step(actions.data());
+
+        DOCTEST_CHECK(!vec_env.get_dones()[0]);
+    }
+
+    SUBCASE("Observations are written for every body")
+    {
+        const auto observation_count = vec_env.get_env_count() * 2 *
+                                       static_cast<std::size_t>(vec_env.get_observation_size());
+        const auto *observations = vec_env.get_observations();
+
+        DOCTEST_CHECK(std::all_of(observations, observations + observation_count,
+                                  [](float value) { return std::isfinite(value); }));
+        DOCTEST_CHECK(std::any_of(observations, observations + observation_count,
+                                  [](float value) { return value != 0.f; }));
+    }
+}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <torch/torch.h>
+
+#include "training/training_program.h"
+
+class ThreadPool;
+
+namespace ai
+{
+class EcsEnv;
+
+// A batch of EcsEnvs stepped together, for driving the game from outside
+// the Trainer (e.g. from Python).
+//
+// Both bodies in every environment are controlled by the caller. Actions are
+// read from, and observations, rewards and dones written to, flat row-major
+// buffers owned by the VecEnv that stay at the same address for its whole
+// life, so they can be shared with NumPy without copying. Each step()
+// overwrites them. Environments that finish are reset straight away, and
+// the observations returned for them are the first of the next game.
+class VecEnv
+{
+  private:
+    int action_size;
+    std::vector<std::uint8_t> dones;
+    std::vector<std::unique_ptr<EcsEnv>> environments;
+    int observation_size;
+    std::vector<float> observations;
+    std::vector<float> rewards;
+    std::unique_ptr<ThreadPool> thread_pool;
+    unsigned int thread_count;
+    std::vector<std::int32_t> victors;
+
+    template <typename Function>
+    void run_parallel(Function function);
+    void write_observations(std::size_t index, const std::vector<torch::Tensor> &observations);
+
+  public:
+    // thread_count of 0 uses one thread per core
+    VecEnv(std::size_t env_count,
+           const nlohmann::json &body_spec,
+           double game_length = 60,
+           unsigned int thread_count = 0,
+           const RewardConfig &reward_config = RewardConfig());
+    ~VecEnv();
+
+    void reset();
+    // actions holds env_count * 2 * action_size values, non-zero meaning
+    // the module is active
+    void step(const float *actions);
+
+    inline int get_action_size() const { return action_size; }
+    inline const std::uint8_t *get_dones() const { return dones.data(); }
+    inline std::size_t get_env_count() const { return environments.size(); }
+    inline int get_observation_size() const { return observation_size; }
+    inline const float *get_observations() const { return observations.data(); }
+    inline const float *get_rewards() const { return rewards.data(); }
+    // -1 for a draw, otherwise the index of the body that won, for
+    // environments that finished on the last step
+    inline const std::int32_t *get_victors() const { return victors.data(); }
+};
+}
@@ -0,0 +1,127 @@
+#include <vector>
+
+#include <doctest.h>
+
+#include "shelf_packer.h"
+
+namespace ai
+{
+ShelfPacker::ShelfPacker(int width, int height, int padding)
+    : height(height),
+      next_y(0),
+      padding(padding),
+      width(width) {}
+
+bool ShelfPacker::pack(int rect_width, int rect_height, int &x, int &y)
+{
+    // Padding on every side stops linear filtering bleeding between regions
+    const int padded_width = rect_width + padding * 2;
+    const int padded_height = rect_height + padding * 2;
+
+    Shelf *best_shelf = nullptr;
+    for (auto &shelf : shelves)
+    {
+        if (shelf.height >= padded_height &&
+            shelf.used_width + padded_width <= width &&
+            (best_shelf == nullptr || shelf.height < best_shelf->height))
+        {
+            best_shelf = &shelf;
+        }
+    }
+
+    if (best_shelf == nullptr)
+    {
+        if (next_y + padded_height > height || padded_width > width)
+        {
+            return false;
+        }
+        shelves.push_back({next_y, padded_height, 0});
+        next_y += padded_height;
+        best_shelf = &shelves.back();
+    }
+
+    x = best_shelf->used_width + padding;
+    y = best_shelf->y + padding;
+    best_shelf->used_width += padded_width;
+    return true;
+}
+
+void ShelfPacker::clear()
+{
+    shelves.clear();
+    next_y = 0;
+}
+
+TEST_CASE("ShelfPacker")
+{
+    ShelfPacker packer(100, 100, 1);
+    int x, y;
+
+    SUBCASE("Places rectangles side by side on a shelf")
+    {
+        DOCTEST_CHECK(packer.pack(20, 20, x, y));
+        DOCTEST_CHECK(x == 1);
+        DOCTEST_CHECK(y == 1);
+
+        DOCTEST_CHECK(packer.pack(10, 10, x, y));
+        DOCTEST_CHECK(x == 23);
+        DOCTEST_CHECK(y == 1);
+    }
+
+    SUBCASE("Opens a new shelf when the current one is full")
+    {
+        DOCTEST_CHECK(packer.pack(60, 20, x, y));
+        DOCTEST_CHECK(packer.pack(60, 20, x, y));
+        DOCTEST_CHECK(x == 1);
+        DOCTEST_CHECK(y == 23);
+    }
+
+    SUBCASE("Fails when the page is full")
+    {
+        DOCTEST_CHECK(packer.pack(98, 60, x, y));
+        DOCTEST_CHECK(!packer.pack(98, 60, x, y));
+        DOCTEST_CHECK(!packer.pack(120, 10, x, y));
+    }
+
+    SUBCASE("Packed rectangles never overlap")
+    {
+        struct Rect
+        {
+            int x, y, width, height;
+        };
+        std::vector<Rect> rects;
+        for (int i = 0; i < 40; ++i)
+        {
+            const int rect_width = 5 + (i * 7) % 13;
+            const int rect_height = 5 + (i * 5) % 11;
+            if (packer.pack(rect_width, rect_height, x, y))
+            {
+                rects.push_back({x, y, rect_width, rect_height});
+            }
+        }
+
+        bool overlap = false;
+        for (unsigned int i = 0; i < rects.size(); ++i)
+        {
+            DOCTEST_CHECK(rects[i].x + rects[i].width <= 100);
+            DOCTEST_CHECK(rects[i].y + rects[i].height <= 100);
+            for (unsigned int j = i + 1; j < rects.size(); ++j)
+            {
+                overlap |= rects[i].x < rects[j].x + rects[j].width &&
+                           rects[j].x < rects[i].x + rects[i].width &&
+                           rects[i].y < rects[j].y + rects[j].height &&
+                           rects[j].y < rects[i].y + rects[i].height;
+            }
+        }
+        DOCTEST_CHECK(!overlap);
+        DOCTEST_CHECK(rects.size() > 20);
+    }
+
+    SUBCASE("clear() frees the whole page")
+    {
+        DOCTEST_CHECK(packer.pack(98, 98, x, y));
+        packer.clear();
+        DOCTEST_CHECK(packer.pack(98, 98, x, y));
+    }
+}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+namespace ai
+{
+// Packs rectangles into a fixed size page in rows ("shelves"). Each
+// rectangle goes on the existing shelf that wastes the least height, or on
+// a new shelf if none fit.
+class ShelfPacker
+{
+  private:
+    struct Shelf
+    {
+        int y;
+        int height;
+        int used_width;
+    };
+
+    int height;
+    int next_y;
+    int padding;
+    std::vector<Shelf> shelves;
+    int width;
+
+  public:
+    ShelfPacker(int width, int height, int padding = 1);
+
+    // Returns false if the rectangle doesn't fit, leaving x and y untouched
+    bool pack(int rect_width, int rect_height, int &x, int &y);
+    void clear();
+};
+}
@@ -0,0 +1,137 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "graphics/backend/texture_atlas.h"
+#include "graphics/backend/shelf_packer.h"
+#include "graphics/backend/texture.h"
+#include "third_party/stb_image.h"
+
+namespace ai
+{
+TextureAtlas::TextureAtlas(int page_size)
+    : page_size(page_size) {}
+
+const AtlasRegion *TextureAtlas::add_image(const std::string &id, const std::string &filepath)
+{
+    if (regions.find(id) != regions.end())
+    {
+        return &regions.at(id);
+    }
+
+    stbi_set_flip_vertically_on_load(1);
+    int width, height, bpp;
+    auto *buffer = stbi_load(filepath.c_str(), &width, &height, &bpp, 4);
+    if (buffer == nullptr)
+    {
+        spdlog::error("Couldn't load {} into texture atlas", filepath);
+        return nullptr;
+    }
+
+    const auto *region = add_pixels(id, width, height, buffer);
+    stbi_image_free(buffer);
+    return region;
+}
+
+const AtlasRegion *TextureAtlas::add_pixels(const std::string &id,
+                                            int width,
+                                            int height,
+                                            const unsigned char *rgba_pixels)
+{
+    int x, y;
+    const auto *region = allocate(id, width, height, x, y);
+    if (region == nullptr)
+    {
+        return nullptr;
+    }
+
+    region->page->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba_pixels);
+    region->page->unbind();
+    return region;
+}
+
+const AtlasRegion *TextureAtlas::add_from_read_buffer(const std::string &id, int width, int height)
+{
+    int x, y;
+    const auto *region = allocate(id, width, height, x, y);
+    if (region == nullptr)
+    {
+        return nullptr;
+    }
+
+    region->page->bind();
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, x, y, 0, 0, width, height);
+    region->page->unbind();
+    return region;
+}
+
+void TextureAtlas::add_region(const std::string &id, const AtlasRegion &region)
+{
+    regions.emplace(id, region);
+}
+
+const AtlasRegion *TextureAtlas::allocate(const std::string &id,
+                                          int width,
+                                          int height,
+                                          int &x,
+                                          int &y)
+{
+    if (regions.find(id) != regions.end())
+    {
+        spdlog::warn("Texture {} is already in the atlas", id);
+        return nullptr;
+    }
+
+    // Images too big for a page are left to stand alone
+    if (width > page_size || height > page_size)
+    {
+        return nullptr;
+    }
+
+    unsigned int page = 0;
+    while (page < packers.size() && !packers[page].pack(width, height, x, y))
+    {
+        ++page;
+    }
+    if (page == packers.size())
+    {
+        packers.emplace_back(page_size, page_size);
+        // Start pages transparent so the padding around regions is too
+        std::vector<unsigned char> blank_page(page_size * page_size * 4, 0);
+        pages.push_back(std::make_unique<Texture>(page_size,
+                                                  page_size,
+                                                  blank_page.data(),
+                                                  GL_RGBA));
+        if (!packers.back().pack(width, height, x, y))
+        {
+            return nullptr;
+        }
+    }
+
+    const float size = static_cast<float>(page_size);
+    const auto inserted = regions.emplace(id, AtlasRegion{pages[page].get(),
+                                                          {x / size,
+                                                           y / size,
+                                                           width / size,
+                                                           height / size}});
+    return &inserted.first->second;
+}
+
+void TextureAtlas::clear()
+{
+    packers.clear();
+    pages.clear();
+    regions.clear();
+}
+
+const AtlasRegion *TextureAtlas::get(const std::string &id) const
+{
+    const auto region = regions.find(id);
+    return region == regions.end() ? nullptr : &region->second;
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/backend/shelf_packer.h"
+#include "graphics/backend/texture.h"
+
+namespace ai
+{
+struct AtlasRegion
+{
+    const Texture *page;
+    // Offset (xy) and size (zw) of the region in UV space
+    glm::vec4 texture_rect;
+
+    inline glm::vec2 get_uv_min() const { return {texture_rect.x, texture_rect.y}; }
+    inline glm::vec2 get_uv_max() const
+    {
+        return {texture_rect.x + texture_rect.z, texture_rect.y + texture_rect.w};
+    }
+};
+
+// Packs many small images into a few large textures, so sprites using
+// different images can still be drawn in one batch
+class TextureAtlas
+{
+  private:
+    std::vector<ShelfPacker> packers;
+    int page_size;
+    std::vector<std::unique_ptr<Texture>> pages;
+    std::unordered_map<std::string, AtlasRegion> regions;
+
+    const AtlasRegion *allocate(const std::string &id, int width, int height, int &x, int &y);
+
+  public:
+    TextureAtlas(int page_size = 2048);
+
+    const AtlasRegion *add_image(const std::string &id, const std::string &filepath);
+    const AtlasRegion *add_pixels(const std::string &id,
+                                  int width,
+                                  int height,
+                                  const unsigned char *rgba_pixels);
+    const AtlasRegion *add_from_read_buffer(const std::string &id, int width, int height);
+    // Makes a region of another atlas available under this atlas' ids
+    void add_region(const std::string &id, const AtlasRegion &region);
+    void clear();
+    const AtlasRegion *get(const std::string &id) const;
+
+    inline std::size_t get_page_count() const { return pages.size(); }
+};
+}
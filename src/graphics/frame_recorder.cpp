@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "graphics/frame_recorder.h"
+#include "graphics/backend/frame_buffer.h"
+
+namespace ai
+{
+namespace
+{
+std::FILE *open_pipe(const std::string &command)
+{
+#ifdef _WIN32
+    return _popen(command.c_str(), "wb");
+#else
+    return popen(command.c_str(), "w");
+#endif
+}
+
+int close_pipe(std::FILE *pipe)
+{
+#ifdef _WIN32
+    return _pclose(pipe);
+#else
+    return pclose(pipe);
+#endif
+}
+}
+
+FileFrameSink::FileFrameSink(const std::string &path)
+    : file(std::fopen(path.c_str(), "wb"))
+{
+    if (file == nullptr)
+    {
+        throw std::runtime_error(fmt::format("Unable to open {} for writing", path));
+    }
+}
+
+FileFrameSink::~FileFrameSink()
+{
+    std::fclose(file);
+}
+
+void FileFrameSink::write(const unsigned char *pixels, std::size_t size)
+{
+    if (std::fwrite(pixels, 1, size, file) != size)
+    {
+        throw std::runtime_error("Unable to write frame");
+    }
+}
+
+PipeFrameSink::PipeFrameSink(const std::string &command)
+    : pipe(open_pipe(command))
+{
+    if (pipe == nullptr)
+    {
+        throw std::runtime_error(fmt::format("Unable to start encoder: {}", command));
+    }
+}
+
+PipeFrameSink::~PipeFrameSink()
+{
+    const auto status = close_pipe(pipe);
+    if (status != 0)
+    {
+        spdlog::warn("Encoder exited with status {}", status);
+    }
+}
+
+void PipeFrameSink::write(const unsigned char *pixels, std::size_t size)
+{
+    if (std::fwrite(pixels, 1, size, pipe) != size)
+    {
+        throw std::runtime_error("Encoder stopped accepting frames");
+    }
+}
+
+void flip_rows(const unsigned char *source, int width, int height, unsigned char *destination)
+{
+    const auto row_size = static_cast<std::size_t>(width) * 4;
+    for (int row = 0; row < height; ++row)
+    {
+        std::memcpy(destination + static_cast<std::size_t>(height - 1 - row) * row_size,
+                    source + static_cast<std::size_t>(row) * row_size,
+                    row_size);
+    }
+}
+
+FrameRecorder::FrameRecorder(int width, int height, IFrameSink &sink, unsigned int buffer_count)
+    : fences(buffer_count, nullptr),
+      frame(static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 4),
+      frames_written(0),
+      height(height),
+      next_buffer(0),
+      pending_frames(0),
+      pixel_buffers(buffer_count),
+      sink(sink),
+      width(width)
+{
+    glGenBuffers(static_cast<GLsizei>(buffer_count), pixel_buffers.data());
+    for (const auto pixel_buffer : pixel_buffers)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER,
+                     static_cast<GLsizeiptr>(frame.size()),
+                     nullptr,
+                     GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    for (auto fence : fences)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+        }
+    }
+    glDeleteBuffers(static_cast<GLsizei>(pixel_buffers.size()), pixel_buffers.data());
+}
+
+void FrameRecorder::flush()
+{
+    while (pending_frames > 0)
+    {
+        write_oldest();
+    }
+}
+
+void FrameRecorder::record(const FrameBuffer &frame_buffer)
+{
+    if (pending_frames == pixel_buffers.size())
+    {
+        write_oldest();
+    }
+
+    frame_buffer.bind_read();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers[next_buffer]);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[next_buffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    next_buffer = (next_buffer + 1) % pixel_buffers.size();
+    ++pending_frames;
+}
+
+void FrameRecorder::write_oldest()
+{
+    const auto buffer = (next_buffer + pixel_buffers.size() - pending_frames) %
+                        pixel_buffers.size();
+
+    // Usually already signalled, unless the ring is too short to cover the
+    // GPU's latency
+    auto &fence = fences[buffer];
+    GLenum wait_result;
+    do
+    {
+        wait_result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while (wait_result == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(fence);
+    fence = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers[buffer]);
+    const auto pixels = static_cast<const unsigned char *>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                         0,
+                         static_cast<GLsizeiptr>(frame.size()),
+                         GL_MAP_READ_BIT));
+    if (pixels == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        throw std::runtime_error("Unable to map pixel buffer");
+    }
+    flip_rows(pixels, width, height, frame.data());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    --pending_frames;
+    sink.write(frame.data(), frame.size());
+    ++frames_written;
+}
+
+TEST_CASE("flip_rows()")
+{
+    // 1x3 image, one pixel per row
+    const std::vector<unsigned char> source{1, 1, 1, 1,
+                                            2, 2, 2, 2,
+                                            3, 3, 3, 3};
+    std::vector<unsigned char> destination(source.size());
+
+    flip_rows(source.data(), 1, 3, destination.data());
+
+    DOCTEST_CHECK(destination == std::vector<unsigned char>{3, 3, 3, 3,
+                                                            2, 2, 2, 2,
+                                                            1, 1, 1, 1});
+}
+}
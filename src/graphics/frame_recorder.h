@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace ai
+{
+class FrameBuffer;
+
+// Somewhere to put finished frames, as tightly packed, top-down RGBA rows
+class IFrameSink
+{
+  public:
+    virtual ~IFrameSink() = 0;
+
+    virtual void write(const unsigned char *pixels, std::size_t size) = 0;
+};
+
+inline IFrameSink::~IFrameSink() {}
+
+// Writes frames back to back into a raw video file
+class FileFrameSink : public IFrameSink
+{
+  private:
+    std::FILE *file;
+
+  public:
+    explicit FileFrameSink(const std::string &path);
+    FileFrameSink(const FileFrameSink &) = delete;
+    ~FileFrameSink();
+
+    void write(const unsigned char *pixels, std::size_t size) override;
+};
+
+// Pipes frames into the standard input of an encoder process, e.g. ffmpeg
+// reading rawvideo from "-"
+class PipeFrameSink : public IFrameSink
+{
+  private:
+    std::FILE *pipe;
+
+  public:
+    explicit PipeFrameSink(const std::string &command);
+    PipeFrameSink(const PipeFrameSink &) = delete;
+    ~PipeFrameSink();
+
+    void write(const unsigned char *pixels, std::size_t size) override;
+};
+
+// GL frames are stored bottom-up, video frames top-down
+void flip_rows(const unsigned char *source, int width, int height, unsigned char *destination);
+
+// Reads rendered frames back from the GPU without stalling on them.
+//
+// Each frame is copied into one of a ring of pixel buffers and fenced; it is
+// only mapped once the ring comes back around to it, by which point the GPU
+// has usually long finished with it. Frames reach the sink in order.
+class FrameRecorder
+{
+  private:
+    std::vector<GLsync> fences;
+    std::vector<unsigned char> frame;
+    std::size_t frames_written;
+    int height;
+    std::size_t next_buffer;
+    std::size_t pending_frames;
+    std::vector<unsigned int> pixel_buffers;
+    IFrameSink &sink;
+    int width;
+
+    void write_oldest();
+
+  public:
+    FrameRecorder(int width, int height, IFrameSink &sink, unsigned int buffer_count = 3);
+    FrameRecorder(const FrameRecorder &) = delete;
+    ~FrameRecorder();
+
+    // Drains frames that are still in flight
+    void flush();
+    void record(const FrameBuffer &frame_buffer);
+
+    inline std::size_t get_frames_written() const { return frames_written; }
+};
+}
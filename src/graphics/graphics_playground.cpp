@@ -27,6 +27,7 @@
 #include "misc/io.h"
 #include "misc/module_factory.h"
 #include "misc/module_texture_store.h"
+#include "misc/profiler.h"
 #include "misc/random.h"
 #include "misc/resource_manager.h"
 #include "misc/screen_manager.h"
@@ -188,6 +189,7 @@ int main(int /*argc*/, const char * /*argv*/[])
 #ifdef BUILD_WITH_EASY_PROFILER
     EASY_MAIN_THREAD;
     profiler::startListen();
+    get_profiler().set_enabled(true);
 #endif
 
     // Create window
@@ -205,7 +207,7 @@ int main(int /*argc*/, const char * /*argv*/[])
     ParticleRenderer particle_renderer(100000, resource_manager);
     BatchedSpriteRenderer sprite_renderer(resource_manager);
     TextRenderer text_renderer(resource_manager);
-    VectorRenderer vector_renderer;
+    VectorRenderer vector_renderer(resource_manager);
     Renderer renderer(resolution_x,
                       resolution_y,
                       resource_manager,
@@ -226,7 +228,7 @@ int main(int /*argc*/, const char * /*argv*/[])
     ParticleRenderer module_particle_renderer(100000, resource_manager);
     BatchedSpriteRenderer module_sprite_renderer(resource_manager);
     TextRenderer module_text_renderer(resource_manager);
-    VectorRenderer module_vector_renderer;
+    VectorRenderer module_vector_renderer(resource_manager);
     Renderer module_renderer(resolution_x,
                              resolution_y,
                              resource_manager,
@@ -301,9 +303,8 @@ int main(int /*argc*/, const char * /*argv*/[])
     // Main loop
     while (!window.should_close())
     {
-#ifdef BUILD_WITH_EASY_PROFILER
-        EASY_BLOCK("Frame");
-#endif
+        AI_PROFILE_SCOPE("Frame");
+
         // Time
         double new_time = glfwGetTime();
         double delta_time = new_time - time;
@@ -329,6 +330,7 @@ int main(int /*argc*/, const char * /*argv*/[])
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         window.swap_buffers();
+        get_profiler().end_frame();
     }
 
     ImGui_ImplOpenGL3_Shutdown();
@@ -0,0 +1,152 @@
+#include <cstring>
+#include <stdexcept>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "graphics/headless_context.h"
+
+namespace ai
+{
+namespace
+{
+EGLDisplay get_display()
+{
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (client_extensions != nullptr &&
+        std::strstr(client_extensions, "EGL_MESA_platform_surfaceless") != nullptr)
+    {
+        const auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display != nullptr)
+        {
+            const auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                                      EGL_DEFAULT_DISPLAY,
+                                                      nullptr);
+            if (display != EGL_NO_DISPLAY)
+            {
+                return display;
+            }
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+}
+
+HeadlessContext::HeadlessContext()
+    : context(EGL_NO_CONTEXT),
+      display(EGL_NO_DISPLAY),
+      surface(EGL_NO_SURFACE) {}
+
+HeadlessContext::~HeadlessContext()
+{
+    if (display == EGL_NO_DISPLAY)
+    {
+        return;
+    }
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE)
+    {
+        eglDestroySurface(display, surface);
+    }
+    if (context != EGL_NO_CONTEXT)
+    {
+        eglDestroyContext(display, context);
+    }
+    eglTerminate(display);
+}
+
+void HeadlessContext::init(int opengl_major_version, int opengl_minor_version)
+{
+    spdlog::debug("Creating headless context with target OpenGL version {}.{}",
+                  opengl_major_version,
+                  opengl_minor_version);
+
+    display = get_display();
+    EGLint egl_major_version, egl_minor_version;
+    if (display == EGL_NO_DISPLAY ||
+        !eglInitialize(display, &egl_major_version, &egl_minor_version))
+    {
+        spdlog::error("Unable to initialize EGL");
+        display = EGL_NO_DISPLAY;
+        throw std::runtime_error("Unable to initialize EGL");
+    }
+    spdlog::debug("EGL version: {}.{} ({})",
+                  egl_major_version,
+                  egl_minor_version,
+                  eglQueryString(display, EGL_VENDOR));
+
+    const EGLint config_attributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                        EGL_RED_SIZE, 8,
+                                        EGL_GREEN_SIZE, 8,
+                                        EGL_BLUE_SIZE, 8,
+                                        EGL_ALPHA_SIZE, 8,
+                                        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                        EGL_NONE};
+    EGLConfig config;
+    EGLint config_count;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) ||
+        config_count == 0)
+    {
+        spdlog::error("No suitable EGL config");
+        throw std::runtime_error("No suitable EGL config");
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        spdlog::error("Unable to bind the OpenGL API");
+        throw std::runtime_error("Unable to bind the OpenGL API");
+    }
+
+    const EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, opengl_major_version,
+                                         EGL_CONTEXT_MINOR_VERSION, opengl_minor_version,
+                                         EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                         EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                         EGL_NONE};
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT)
+    {
+        spdlog::error("Unable to create OpenGL context");
+        throw std::runtime_error("Unable to create OpenGL context");
+    }
+
+    // Nothing is ever drawn to the default frame buffer, so only make a
+    // surface if the driver insists on one
+    const char *display_extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (display_extensions == nullptr ||
+        std::strstr(display_extensions, "EGL_KHR_surfaceless_context") == nullptr)
+    {
+        const EGLint surface_attributes[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, surface_attributes);
+        if (surface == EGL_NO_SURFACE)
+        {
+            spdlog::error("Unable to create pbuffer surface");
+            throw std::runtime_error("Unable to create pbuffer surface");
+        }
+    }
+
+    if (!eglMakeCurrent(display, surface, surface, context))
+    {
+        spdlog::error("Unable to make OpenGL context current");
+        throw std::runtime_error("Unable to make OpenGL context current");
+    }
+
+    if (gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)) == 0)
+    {
+        spdlog::error("Unable to initialize GLAD");
+        throw std::runtime_error("Unable to initialize GLAD");
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_MULTISAMPLE);
+
+    spdlog::debug("Actual OpenGL version: {} ({})",
+                  reinterpret_cast<const char *>(glGetString(GL_VERSION)),
+                  reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+}
+}
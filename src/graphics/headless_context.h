@@ -0,0 +1,26 @@
+#pragma once
+
+namespace ai
+{
+// An OpenGL context with no window, for rendering on machines without a
+// display server.
+//
+// Uses a surfaceless EGL display where the driver offers one (Mesa's
+// llvmpipe does, so this also works on CPU only machines), and falls back to
+// the default EGL display with a tiny pbuffer otherwise. Everything is drawn
+// into the renderer's own frame buffers, so the surface is never used.
+class HeadlessContext
+{
+  private:
+    void *context;
+    void *display;
+    void *surface;
+
+  public:
+    HeadlessContext();
+    HeadlessContext(const HeadlessContext &) = delete;
+    ~HeadlessContext();
+
+    void init(int opengl_major_version, int opengl_minor_version);
+};
+}
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AI_PARTICLE_SPAWNER_SSE2
+#endif
+
+#include <doctest.h>
+#include <glm/glm.hpp>
+
+#include "particle_spawner.h"
+#include "graphics/render_data.h"
+
+namespace ai
+{
+namespace
+{
+constexpr std::size_t block_size = 4;
+constexpr float two_pi = 6.28318530717958647f;
+constexpr float uniform_scale = 1.f / 16777216.f;
+
+// pi / 2 split so that the first two parts multiply exactly with small
+// quadrant numbers, for accurate range reduction
+constexpr float two_over_pi = 0.636619772367581343f;
+constexpr float half_pi_1 = 1.5703125f;
+constexpr float half_pi_2 = 4.837512969970703125e-4f;
+constexpr float half_pi_3 = 7.54978995489188216e-8f;
+
+// Minimax polynomials for sin and cos on [-pi / 4, pi / 4]
+constexpr float sin_1 = -1.6666654611e-1f;
+constexpr float sin_2 = 8.3321608736e-3f;
+constexpr float sin_3 = -1.9515295891e-4f;
+constexpr float cos_1 = 4.166664568298827e-2f;
+constexpr float cos_2 = -1.388731625493765e-3f;
+constexpr float cos_3 = 2.443315711809948e-5f;
+
+constexpr std::uint32_t hash_multiplier_1 = 0x7feb352d;
+constexpr std::uint32_t hash_multiplier_2 = 0x846ca68b;
+
+std::uint32_t hash(std::uint32_t x)
+{
+    x ^= x >> 16;
+    x *= hash_multiplier_1;
+    x ^= x >> 15;
+    x *= hash_multiplier_2;
+    x ^= x >> 16;
+    return x;
+}
+
+// Uniform float in [0, 1) for one of a particle's two random streams
+float random_uniform(std::uint32_t key, std::uint32_t particle, std::uint32_t stream)
+{
+    return static_cast<float>(hash(((particle << 1) + stream) ^ key) >> 8) * uniform_scale;
+}
+
+void sincos(float angle, float &sine, float &cosine)
+{
+    const float quadrant = std::nearbyint(angle * two_over_pi);
+    const float x = ((angle - quadrant * half_pi_1) - quadrant * half_pi_2) -
+                    quadrant * half_pi_3;
+    const float x2 = x * x;
+    const float sin_x = x + (x * x2) * (sin_1 + x2 * (sin_2 + x2 * sin_3));
+    const float cos_x = (1.f - 0.5f * x2) + (x2 * x2) * (cos_1 + x2 * (cos_2 + x2 * cos_3));
+
+    const int quadrant_int = static_cast<int>(quadrant);
+    const float sin_value = (quadrant_int & 1) ? cos_x : sin_x;
+    const float cos_value = (quadrant_int & 1) ? sin_x : cos_x;
+    sine = (quadrant_int & 2) ? -sin_value : sin_value;
+    cosine = ((quadrant_int + 1) & 2) ? -cos_value : cos_value;
+}
+
+#ifdef AI_PARTICLE_SPAWNER_SSE2
+// SSE2 has no 32 bit multiply, so multiply the even and odd lanes as 64 bit
+// values and keep the low halves
+__m128i multiply(__m128i a, __m128i b)
+{
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+__m128i hash(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = multiply(x, _mm_set1_epi32(static_cast<int>(hash_multiplier_1)));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = multiply(x, _mm_set1_epi32(static_cast<int>(hash_multiplier_2)));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    return x;
+}
+#endif
+
+// random_uniform() for block_size consecutive particles
+void random_block(std::uint32_t key,
+                  std::uint32_t first_particle,
+                  std::uint32_t stream,
+                  float *values)
+{
+#ifdef AI_PARTICLE_SPAWNER_SSE2
+    const __m128i particles = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(first_particle)),
+                                            _mm_setr_epi32(0, 1, 2, 3));
+    const __m128i inputs = _mm_xor_si128(
+        _mm_add_epi32(_mm_slli_epi32(particles, 1), _mm_set1_epi32(static_cast<int>(stream))),
+        _mm_set1_epi32(static_cast<int>(key)));
+    const __m128 uniform = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(hash(inputs), 8)),
+                                      _mm_set1_ps(uniform_scale));
+    _mm_storeu_ps(values, uniform);
+#else
+    for (std::uint32_t i = 0; i < block_size; ++i)
+    {
+        values[i] = random_uniform(key, first_particle + i, stream);
+    }
+#endif
+}
+
+// sincos() for block_size angles, giving the same bits as the scalar version
+void sincos_block(const float *angles, float *sines, float *cosines)
+{
+#ifdef AI_PARTICLE_SPAWNER_SSE2
+    const __m128 angle = _mm_loadu_ps(angles);
+    const __m128i quadrant_int = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(two_over_pi)));
+    const __m128 quadrant = _mm_cvtepi32_ps(quadrant_int);
+    const __m128 x = _mm_sub_ps(
+        _mm_sub_ps(_mm_sub_ps(angle, _mm_mul_ps(quadrant, _mm_set1_ps(half_pi_1))),
+                   _mm_mul_ps(quadrant, _mm_set1_ps(half_pi_2))),
+        _mm_mul_ps(quadrant, _mm_set1_ps(half_pi_3)));
+    const __m128 x2 = _mm_mul_ps(x, x);
+
+    const __m128 sin_polynomial = _mm_add_ps(
+        _mm_set1_ps(sin_1),
+        _mm_mul_ps(x2, _mm_add_ps(_mm_set1_ps(sin_2), _mm_mul_ps(x2, _mm_set1_ps(sin_3)))));
+    const __m128 sin_x = _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(x, x2), sin_polynomial));
+    const __m128 cos_polynomial = _mm_add_ps(
+        _mm_set1_ps(cos_1),
+        _mm_mul_ps(x2, _mm_add_ps(_mm_set1_ps(cos_2), _mm_mul_ps(x2, _mm_set1_ps(cos_3)))));
+    const __m128 cos_x = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(0.5f), x2)),
+                                    _mm_mul_ps(_mm_mul_ps(x2, x2), cos_polynomial));
+
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128 swap = _mm_castsi128_ps(
+        _mm_cmpeq_epi32(_mm_and_si128(quadrant_int, one), one));
+    const __m128 sin_value = _mm_or_ps(_mm_and_ps(swap, cos_x), _mm_andnot_ps(swap, sin_x));
+    const __m128 cos_value = _mm_or_ps(_mm_and_ps(swap, sin_x), _mm_andnot_ps(swap, cos_x));
+    // Bit 1 of the quadrant, moved up to the sign bit
+    const __m128 sin_sign = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_and_si128(quadrant_int, two), 30));
+    const __m128 cos_sign = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant_int, one), two), 30));
+    _mm_storeu_ps(sines, _mm_xor_ps(sin_value, sin_sign));
+    _mm_storeu_ps(cosines, _mm_xor_ps(cos_value, cos_sign));
+#else
+    for (std::size_t i = 0; i < block_size; ++i)
+    {
+        sincos(angles[i], sines[i], cosines[i]);
+    }
+#endif
+}
+
+Particle make_particle(glm::vec2 position,
+                       glm::vec2 velocity,
+                       std::size_t index,
+                       const ParticleSettings &settings)
+{
+    return {position,
+            velocity,
+            -static_cast<float>(index) * settings.stagger,
+            settings.lifetime,
+            settings.size,
+            settings.start_color,
+            settings.end_color};
+}
+}
+
+ParticleSpawner::ParticleSpawner(std::uint32_t seed)
+    : counter(0), key(hash(seed)) {}
+
+void ParticleSpawner::set_seed(std::uint32_t seed)
+{
+    counter = 0;
+    key = hash(seed);
+}
+
+void ParticleSpawner::spawn_burst(Particle *particles,
+                                  std::size_t count,
+                                  glm::vec2 position,
+                                  float max_speed,
+                                  const ParticleSettings &settings)
+{
+    alignas(16) std::array<float, block_size> radii;
+    alignas(16) std::array<float, block_size> angles;
+    alignas(16) std::array<float, block_size> sines;
+    alignas(16) std::array<float, block_size> cosines;
+    for (std::size_t start = 0; start < count; start += block_size)
+    {
+        const auto first_particle = counter + static_cast<std::uint32_t>(start);
+        random_block(key, first_particle, 0, radii.data());
+        random_block(key, first_particle, 1, angles.data());
+        for (auto &angle : angles)
+        {
+            angle *= two_pi;
+        }
+        sincos_block(angles.data(), sines.data(), cosines.data());
+
+        // Square root of the radius keeps the speeds uniform over the disk
+        const auto end = std::min(count - start, block_size);
+        for (std::size_t i = 0; i < end; ++i)
+        {
+            const float speed = std::sqrt(radii[i]) * max_speed;
+            particles[start + i] = make_particle(position,
+                                                 {cosines[i] * speed, sines[i] * speed},
+                                                 start + i,
+                                                 settings);
+        }
+    }
+    counter += static_cast<std::uint32_t>(count);
+}
+
+void ParticleSpawner::spawn_line(Particle *particles,
+                                 std::size_t count,
+                                 glm::vec2 position,
+                                 float direction,
+                                 float spread,
+                                 float speed,
+                                 const ParticleSettings &settings)
+{
+    const glm::vec2 along{std::cos(direction), std::sin(direction)};
+    const glm::vec2 across{-along.y, along.x};
+    alignas(16) std::array<float, block_size> offsets;
+    for (std::size_t start = 0; start < count; start += block_size)
+    {
+        random_block(key, counter + static_cast<std::uint32_t>(start), 0, offsets.data());
+
+        const auto end = std::min(count - start, block_size);
+        for (std::size_t i = 0; i < end; ++i)
+        {
+            const float offset = (offsets[i] - 0.5f) * spread;
+            particles[start + i] = make_particle(position + along * offset,
+                                                 (across + along * offset) * speed,
+                                                 start + i,
+                                                 settings);
+        }
+    }
+    counter += static_cast<std::uint32_t>(count);
+}
+
+void ParticleSpawner::spawn_fan(Particle *particles,
+                                std::size_t count,
+                                glm::vec2 position,
+                                float direction,
+                                float spread,
+                                float speed,
+                                const ParticleSettings &settings)
+{
+    const glm::vec2 across{-std::sin(direction), std::cos(direction)};
+    alignas(16) std::array<float, block_size> offsets;
+    alignas(16) std::array<float, block_size> angles;
+    alignas(16) std::array<float, block_size> sines;
+    alignas(16) std::array<float, block_size> cosines;
+    for (std::size_t start = 0; start < count; start += block_size)
+    {
+        random_block(key, counter + static_cast<std::uint32_t>(start), 0, offsets.data());
+        for (std::size_t i = 0; i < block_size; ++i)
+        {
+            offsets[i] = (offsets[i] - 0.5f) * spread;
+            angles[i] = direction + offsets[i];
+        }
+        sincos_block(angles.data(), sines.data(), cosines.data());
+
+        const auto end = std::min(count - start, block_size);
+        for (std::size_t i = 0; i < end; ++i)
+        {
+            particles[start + i] = make_particle(position + across * offsets[i],
+                                                 glm::vec2{cosines[i], sines[i]} * speed,
+                                                 start + i,
+                                                 settings);
+        }
+    }
+    counter += static_cast<std::uint32_t>(count);
+}
+
+TEST_CASE("ParticleSpawner")
+{
+    ParticleSpawner spawner(42);
+    ParticleSettings settings;
+    settings.stagger = 0.01f;
+
+    SUBCASE("Block sines and cosines match the scalar version exactly")
+    {
+        bool all_equal = true;
+        float max_error = 0;
+        for (int i = 0; i < 1000; i += block_size)
+        {
+            std::array<float, block_size> angles;
+            for (std::size_t j = 0; j < block_size; ++j)
+            {
+                angles[j] = static_cast<float>(i + static_cast<int>(j)) * 0.0137f - 7.f;
+            }
+            std::array<float, block_size> sines, cosines;
+            sincos_block(angles.data(), sines.data(), cosines.data());
+            for (std::size_t j = 0; j < block_size; ++j)
+            {
+                float sine, cosine;
+                sincos(angles[j], sine, cosine);
+                all_equal &= std::memcmp(&sine, &sines[j], sizeof(float)) == 0 &&
+                             std::memcmp(&cosine, &cosines[j], sizeof(float)) == 0;
+                max_error = std::max(max_error, std::abs(sine - std::sin(angles[j])));
+                max_error = std::max(max_error, std::abs(cosine - std::cos(angles[j])));
+            }
+        }
+
+        DOCTEST_CHECK(all_equal);
+        DOCTEST_CHECK(max_error < 1e-6f);
+    }
+
+    SUBCASE("Block random numbers match the scalar version")
+    {
+        std::array<float, block_size> values;
+        random_block(1234, 5, 1, values.data());
+
+        for (std::uint32_t i = 0; i < block_size; ++i)
+        {
+            DOCTEST_CHECK(values[i] == random_uniform(1234, 5 + i, 1));
+            DOCTEST_CHECK(values[i] >= 0.f);
+            DOCTEST_CHECK(values[i] < 1.f);
+        }
+    }
+
+    SUBCASE("Splitting a batch doesn't change the particles")
+    {
+        std::vector<Particle> whole(11);
+        spawner.spawn_burst(whole.data(), whole.size(), {1.f, 2.f}, 4.f, settings);
+
+        ParticleSpawner split_spawner(42);
+        std::vector<Particle> split(11);
+        split_spawner.spawn_burst(split.data(), 3, {1.f, 2.f}, 4.f, settings);
+        split_spawner.spawn_burst(split.data() + 3, 1, {1.f, 2.f}, 4.f, settings);
+        split_spawner.spawn_burst(split.data() + 4, 7, {1.f, 2.f}, 4.f, settings);
+
+        for (std::size_t i = 0; i < whole.size(); ++i)
+        {
+            DOCTEST_CHECK(whole[i].velocity == split[i].velocity);
+        }
+    }
+
+    SUBCASE("Different seeds give different particles")
+    {
+        ParticleSpawner other_spawner(43);
+        std::array<Particle, 4> particles;
+        std::array<Particle, 4> other_particles;
+        spawner.spawn_fan(particles.data(), 4, {0.f, 0.f}, 0.f, 1.f, 10.f, settings);
+        other_spawner.spawn_fan(other_particles.data(), 4, {0.f, 0.f}, 0.f, 1.f, 10.f, settings);
+
+        DOCTEST_CHECK(!(particles[0].velocity == other_particles[0].velocity));
+    }
+
+    SUBCASE("Burst speeds stay under the maximum")
+    {
+        std::vector<Particle> particles(100);
+        spawner.spawn_burst(particles.data(), particles.size(), {5.f, 5.f}, 4.f, settings);
+
+        for (std::size_t i = 0; i < particles.size(); ++i)
+        {
+            DOCTEST_CHECK(glm::length(particles[i].velocity) <= 4.0001f);
+            DOCTEST_CHECK(particles[i].start_position == glm::vec2(5.f, 5.f));
+            DOCTEST_CHECK(particles[i].start_time_offset == doctest::Approx(-0.01f * i));
+        }
+    }
+
+    SUBCASE("Fan particles stay within the spread")
+    {
+        std::vector<Particle> particles(50);
+        spawner.spawn_fan(particles.data(), particles.size(), {0.f, 0.f}, 0.f, 1.f, 10.f, settings);
+
+        for (const auto &particle : particles)
+        {
+            DOCTEST_CHECK(particle.start_position.x == doctest::Approx(0.f));
+            DOCTEST_CHECK(std::abs(particle.start_position.y) <= 0.5f);
+            DOCTEST_CHECK(particle.velocity.x > 0.f);
+            DOCTEST_CHECK(glm::length(particle.velocity) == doctest::Approx(10.f));
+        }
+    }
+}
+}
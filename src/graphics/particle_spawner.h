@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/colors.h"
+
+namespace ai
+{
+struct Particle;
+
+struct ParticleSettings
+{
+    float lifetime = 0.75f;
+    float size = 0.03f;
+    glm::vec4 start_color = cl_white;
+    glm::vec4 end_color = cl_white;
+    // Each particle starts this much later than the one before it
+    float stagger = 0.f;
+};
+
+// Fills batches of particles with randomised positions and velocities.
+//
+// Random numbers come from hashing a running particle counter with the
+// seed, so there's no generator state to share between threads and a given
+// seed always produces the same particles, whether they are spawned in one
+// batch or many. Random numbers and sines/cosines are computed four
+// particles at a time.
+class ParticleSpawner
+{
+  private:
+    std::uint32_t counter;
+    std::uint32_t key;
+
+  public:
+    explicit ParticleSpawner(std::uint32_t seed = 0);
+
+    // Particles thrown out from position in random directions, at up to
+    // max_speed
+    void spawn_burst(Particle *particles,
+                     std::size_t count,
+                     glm::vec2 position,
+                     float max_speed,
+                     const ParticleSettings &settings);
+    // Particles spread along a spread wide line through position, pointing
+    // along direction, moving sideways at speed and drifting outwards
+    void spawn_line(Particle *particles,
+                    std::size_t count,
+                    glm::vec2 position,
+                    float direction,
+                    float spread,
+                    float speed,
+                    const ParticleSettings &settings);
+    // Particles spread across a spread wide line through position, each
+    // moving at speed along direction turned by its offset from the centre
+    void spawn_fan(Particle *particles,
+                   std::size_t count,
+                   glm::vec2 position,
+                   float direction,
+                   float spread,
+                   float speed,
+                   const ParticleSettings &settings);
+    void set_seed(std::uint32_t seed);
+};
+}
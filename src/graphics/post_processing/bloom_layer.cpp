@@ -2,6 +2,7 @@
 
 #include "bloom_layer.h"
 #include "graphics/backend/shader.h"
+#include "misc/profiler.h"
 #include "misc/resource_manager.h"
 
 namespace ai
@@ -22,6 +23,8 @@ BloomLayer::BloomLayer(ResourceManager &resource_manager, int width, int height)
 
 FrameBuffer &BloomLayer::render(Texture &input_texture)
 {
+    AI_PROFILE_GPU_SCOPE("BloomLayer::render");
+
     glDisable(GL_BLEND);
 
     // Apply highpass filter
@@ -8,6 +8,7 @@
 #include "graphics/backend/vertex_buffer.h"
 #include "graphics/backend/vertex_buffer_layout.h"
 #include "graphics/post_processing/post_proc_layer.h"
+#include "misc/profiler.h"
 #include "misc/resource_manager.h"
 #include "misc/spring_mesh.h"
 
@@ -21,7 +22,8 @@ DistortionLayer::DistortionLayer(ResourceManager &resource_manager,
       mesh_width(static_cast<int>(std::round(width * 0.1))),
       mesh_height(static_cast<int>(std::round(height * 0.1))),
       scaling_factor(scaling_factor),
-      spring_mesh(mesh_width, mesh_height) {}
+      spring_mesh(mesh_width, mesh_height, 0.06f, 0.98f, 0.28f, 0.05f, 0),
+      pixels(mesh_width * mesh_height * 2) {}
 
 void DistortionLayer::apply_explosive_force(glm::vec2 position, float size, float strength)
 {
@@ -35,6 +37,8 @@ void DistortionLayer::apply_implosive_force(glm::vec2 position, float size, floa
 
 FrameBuffer &DistortionLayer::render(Texture &input_texture)
 {
+    AI_PROFILE_GPU_SCOPE("DistortionLayer::render");
+
     update_texture();
     shader->set_uniform_1i("u_distortion", 1);
     texture->bind(1);
@@ -49,13 +53,7 @@ void DistortionLayer::update_mesh()
 
 void DistortionLayer::update_texture()
 {
-    std::vector<float> pixels(mesh_width * mesh_height * 2);
-    auto &offsets = spring_mesh.get_offsets();
-    for (unsigned int i = 0; i < offsets.size(); ++i)
-    {
-        pixels[i * 2] = offsets[i].x * scaling_factor;
-        pixels[i * 2 + 1] = offsets[i].y * scaling_factor;
-    }
+    spring_mesh.get_offsets(scaling_factor, pixels.data());
 
     texture = std::make_unique<Texture>(mesh_width, mesh_height, pixels.data());
 }
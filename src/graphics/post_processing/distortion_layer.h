@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include <glm/glm.hpp>
 
 #include "graphics/backend/element_buffer.h"
@@ -19,6 +22,7 @@ class DistortionLayer : public PostProcLayer
     int mesh_width, mesh_height;
     float scaling_factor;
     SpringMesh spring_mesh;
+    std::vector<float> pixels;
     std::unique_ptr<Texture> texture;
 
   public:
@@ -8,6 +8,7 @@
 #include "graphics/render_data.h"
 #include "graphics/renderers/renderer.h"
 #include "graphics/post_processing/post_proc_layer.h"
+#include "misc/profiler.h"
 
 namespace ai
 {
@@ -48,6 +49,8 @@ PostProcLayer::PostProcLayer(const Shader &shader, int width, int height)
 
 FrameBuffer &PostProcLayer::render(Texture &input_texture)
 {
+    AI_PROFILE_GPU_SCOPE("PostProcLayer::render");
+
     glDisable(GL_BLEND);
     frame_buffer.bind();
 
@@ -1,108 +1,218 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <memory>
 
+#include <doctest.h>
 #include <easy/profiler.h>
-#include <fmt/ostream.h>
-#include <glm/mat4x4.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <spdlog/spdlog.h>
 
 #include "batched_sprite_renderer.h"
 #include "graphics/backend/vertex_array.h"
-#include "graphics/backend/vertex_buffer_layout.h"
 #include "graphics/backend/shader.h"
-#include "graphics/backend/element_buffer.h"
 #include "graphics/backend/texture.h"
 #include "graphics/render_data.h"
 #include "misc/resource_manager.h"
+#include "misc/transform.h"
 
 namespace ai
 {
-BatchedSpriteRenderer::BatchedSpriteRenderer(ResourceManager &resource_manager)
-    : resource_manager(resource_manager),
-      max_sprites(100000),
-      transformed_vertices(max_sprites * 4) {}
+namespace
+{
+// Triangle strip order
+const std::array<glm::vec2, 4> quad_corners{glm::vec2(-0.5f, -0.5f),
+                                            glm::vec2(0.5f, -0.5f),
+                                            glm::vec2(-0.5f, 0.5f),
+                                            glm::vec2(0.5f, 0.5f)};
 
-void BatchedSpriteRenderer::draw(const std::string &texture,
-                                 const std::vector<glm::mat4> &transforms,
-                                 const std::vector<glm::vec4> &colors,
-                                 const glm::mat4 &view)
+const GLuint64 fence_timeout = 1000000000;
+}
+
+std::array<SpriteVertex, 4> expand_sprite_instance(const SpriteInstance &instance)
 {
-    vertex_array->bind();
+    const float cos_rotation = std::cos(instance.rotation);
+    const float sin_rotation = std::sin(instance.rotation);
 
-    auto shader = resource_manager.shader_store.get("batched_texture");
-    shader->bind();
+    std::array<SpriteVertex, 4> vertices;
+    for (unsigned int i = 0; i < quad_corners.size(); ++i)
+    {
+        const glm::vec2 local_position = quad_corners[i] * instance.scale - instance.origin;
+        const glm::vec2 position = instance.position +
+                                   glm::vec2(cos_rotation * local_position.x -
+                                                 sin_rotation * local_position.y,
+                                             sin_rotation * local_position.x +
+                                                 cos_rotation * local_position.y);
+        const glm::vec2 texture_coord = glm::vec2(instance.texture_rect.x, instance.texture_rect.y) +
+                                        (quad_corners[i] + 0.5f) *
+                                            glm::vec2(instance.texture_rect.z,
+                                                      instance.texture_rect.w);
+        vertices[i] = {position, texture_coord, instance.color};
+    }
+    return vertices;
+}
 
-    for (unsigned int i = 0; i < transforms.size(); ++i)
+BatchedSpriteRenderer::BatchedSpriteRenderer(ResourceManager &resource_manager)
+    : current_region(0),
+      fences{},
+      max_sprites(16384),
+      resource_manager(resource_manager),
+      write_offset(0) {}
+
+BatchedSpriteRenderer::~BatchedSpriteRenderer()
+{
+    for (auto &fence : fences)
     {
-        const auto &transform = transforms[i];
-
-        glm::vec4 transformed_position = transform * glm::vec4(-0.5, 0.5, 1.0, 1.0);
-        transformed_vertices[i * 4] = {glm::vec2(transformed_position.x,
-                                                 transformed_position.y),
-                                       glm::vec2(0.0, 1.0),
-                                       colors[i]};
-
-        transformed_position = transform * glm::vec4(-0.5, -0.5, 1.0, 1.0);
-        transformed_vertices[i * 4 + 1] = {glm::vec2(transformed_position.x,
-                                                     transformed_position.y),
-                                           glm::vec2(0.0, 0.0),
-                                           colors[i]};
-
-        transformed_position = transform * glm::vec4(0.5, -0.5, 1.0, 1.0);
-        transformed_vertices[i * 4 + 2] = {glm::vec2(transformed_position.x,
-                                                     transformed_position.y),
-                                           glm::vec2(1.0, 0.0),
-                                           colors[i]};
-
-        transformed_position = transform * glm::vec4(0.5, 0.5, 1.0, 1.0);
-        transformed_vertices[i * 4 + 3] = {glm::vec2(transformed_position.x,
-                                                     transformed_position.y),
-                                           glm::vec2(1.0, 1.0),
-                                           colors[i]};
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+        }
     }
+}
 
-    vertex_buffer->add_data(transformed_vertices.data(),
-                            sizeof(SpriteVertex) * (transforms.size() * 4),
-                            GL_DYNAMIC_DRAW);
+void BatchedSpriteRenderer::draw(const Texture &texture,
+                                 const SpriteInstance *instances,
+                                 std::size_t count,
+                                 const glm::mat4 &view)
+{
+    vertex_array->bind();
 
+    auto shader = resource_manager.shader_store.get("sprite_instanced");
+    shader->bind();
     shader->set_uniform_mat4f("u_view", view);
     shader->set_uniform_1i("u_texture", 0);
 
-    resource_manager.texture_store.get(texture)->bind();
+    texture.bind();
 
-    glDrawElements(GL_TRIANGLES, transforms.size() * 6, GL_UNSIGNED_INT, 0);
+    instance_buffer->bind();
+    while (count > 0)
+    {
+        const int batch_size = std::min(static_cast<int>(count), max_sprites);
+        const int offset = reserve(batch_size);
+
+        // The fences guarantee the GPU is done with this part of the ring,
+        // so there's no need for the driver to synchronise
+        void *mapped_buffer = glMapBufferRange(GL_ARRAY_BUFFER,
+                                               offset * sizeof(SpriteInstance),
+                                               batch_size * sizeof(SpriteInstance),
+                                               GL_MAP_WRITE_BIT |
+                                                   GL_MAP_INVALIDATE_RANGE_BIT |
+                                                   GL_MAP_UNSYNCHRONIZED_BIT);
+        std::memcpy(mapped_buffer, instances, batch_size * sizeof(SpriteInstance));
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, batch_size, offset);
+
+        instances += batch_size;
+        count -= batch_size;
+    }
 }
 
 void BatchedSpriteRenderer::init()
 {
-    resource_manager.load_shader("batched_texture",
-                                 "shaders/texture_batched.vert",
+    resource_manager.load_shader("sprite_instanced",
+                                 "shaders/sprite_instanced.vert",
                                  "shaders/texture.frag");
     vertex_array = std::make_unique<VertexArray>();
 
-    SpriteVertex sprite_vertices[4]{
-        {glm::vec2(-0.5, 0.5), glm::vec2(0.0, 1.0), glm::vec4(1.0, 1.0, 1.0, 1.0)},
-        {glm::vec2(-0.5, -0.5), glm::vec2(0.0, 0.0), glm::vec4(1.0, 1.0, 1.0, 1.0)},
-        {glm::vec2(0.5, -0.5), glm::vec2(1.0, 0.0), glm::vec4(1.0, 1.0, 1.0, 1.0)},
-        {glm::vec2(0.5, 0.5), glm::vec2(1.0, 1.0), glm::vec4(1.0, 1.0, 1.0, 1.0)}};
-    vertex_buffer = std::make_unique<VertexBuffer>(&sprite_vertices[0], 4 * sizeof(SpriteVertex));
+    quad_buffer = std::make_unique<VertexBuffer>(quad_corners.data(),
+                                                 sizeof(quad_corners));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+    glVertexAttribDivisor(0, 0);
+
+    instance_buffer = std::make_unique<VertexBuffer>(nullptr,
+                                                     ring_regions * max_sprites *
+                                                         sizeof(SpriteInstance),
+                                                     GL_STREAM_DRAW);
+    const std::array<std::pair<int, std::size_t>, 6> instance_attributes{
+        std::make_pair(2, offsetof(SpriteInstance, position)),
+        std::make_pair(2, offsetof(SpriteInstance, scale)),
+        std::make_pair(2, offsetof(SpriteInstance, origin)),
+        std::make_pair(1, offsetof(SpriteInstance, rotation)),
+        std::make_pair(4, offsetof(SpriteInstance, color)),
+        std::make_pair(4, offsetof(SpriteInstance, texture_rect))};
+    for (unsigned int i = 0; i < instance_attributes.size(); ++i)
+    {
+        glEnableVertexAttribArray(i + 1);
+        glVertexAttribPointer(i + 1,
+                              instance_attributes[i].first,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              sizeof(SpriteInstance),
+                              reinterpret_cast<void *>(instance_attributes[i].second));
+        glVertexAttribDivisor(i + 1, 1);
+    }
+}
+
+int BatchedSpriteRenderer::reserve(int count)
+{
+    // Batches never straddle two regions of the ring, so one fence per region
+    // is enough to know when the GPU has finished reading it
+    if (write_offset % max_sprites + count > max_sprites)
+    {
+        write_offset = ((write_offset / max_sprites + 1) % ring_regions) * max_sprites;
+    }
 
-    std::vector<unsigned int> sprite_indices;
-    for (int i = 0; i < max_sprites; ++i)
+    const int region = write_offset / max_sprites;
+    if (region != current_region)
     {
-        unsigned int sprite_number = i * 4;
-        sprite_indices.push_back(0 + sprite_number);
-        sprite_indices.push_back(1 + sprite_number);
-        sprite_indices.push_back(2 + sprite_number);
-        sprite_indices.push_back(2 + sprite_number);
-        sprite_indices.push_back(3 + sprite_number);
-        sprite_indices.push_back(0 + sprite_number);
+        fences[current_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        if (fences[region] != nullptr)
+        {
+            const auto result = glClientWaitSync(fences[region],
+                                                 GL_SYNC_FLUSH_COMMANDS_BIT,
+                                                 fence_timeout);
+            if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+            {
+                spdlog::warn("Timed out waiting for sprite buffer region {}", region);
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = nullptr;
+        }
+        current_region = region;
     }
-    element_buffer = std::make_unique<ElementBuffer>(sprite_indices.data(), max_sprites * 6);
 
-    VertexBufferLayout layout;
-    layout.push<float>(2);
-    layout.push<float>(2);
-    layout.push<float>(4);
-    vertex_array->add_buffer(*vertex_buffer, layout);
+    const int offset = write_offset;
+    write_offset = (write_offset + count) % (ring_regions * max_sprites);
+    return offset;
+}
+
+TEST_CASE("expand_sprite_instance()")
+{
+    SpriteInstance instance{{1.f, 2.f}, {3.f, 4.f}, {0.5f, 0.25f}, 0.7f, {1.f, 0.5f, 0.25f, 1.f}};
+
+    SUBCASE("Matches the sprite's transform matrix")
+    {
+        Transform transform;
+        transform.set_position(instance.position);
+        transform.set_scale(instance.scale);
+        transform.set_origin(instance.origin);
+        transform.set_rotation(instance.rotation);
+
+        const auto vertices = expand_sprite_instance(instance);
+
+        for (unsigned int i = 0; i < vertices.size(); ++i)
+        {
+            const glm::vec4 expected = transform.get() * glm::vec4(quad_corners[i], 0.f, 1.f);
+            DOCTEST_CHECK(vertices[i].position.x == doctest::Approx(expected.x));
+            DOCTEST_CHECK(vertices[i].position.y == doctest::Approx(expected.y));
+            DOCTEST_CHECK(vertices[i].color == instance.color);
+        }
+    }
+
+    SUBCASE("Maps corners onto the texture rect")
+    {
+        instance.texture_rect = {0.5f, 0.25f, 0.25f, 0.5f};
+
+        const auto vertices = expand_sprite_instance(instance);
+
+        DOCTEST_CHECK(vertices[0].texture_coord == glm::vec2(0.5f, 0.25f));
+        DOCTEST_CHECK(vertices[3].texture_coord == glm::vec2(0.75f, 0.75f));
+    }
+}
 }
-}
\ No newline at end of file
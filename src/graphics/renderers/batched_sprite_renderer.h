@@ -1,37 +1,65 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <glad/glad.h>
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 
 #include "graphics/renderers/sprite_renderer.h"
-#include "graphics/backend/element_buffer.h"
 #include "graphics/backend/vertex_array.h"
 #include "graphics/backend/vertex_buffer.h"
 
 namespace ai
 {
 class ResourceManager;
+class Texture;
+
+// Everything the vertex shader needs to place one sprite. Corners are
+// expanded on the GPU, matching Transform::get() applied to a unit quad.
+struct SpriteInstance
+{
+    glm::vec2 position;
+    glm::vec2 scale;
+    glm::vec2 origin;
+    float rotation;
+    glm::vec4 color;
+    // Offset (xy) and size (zw) of the sprite's region in its texture
+    glm::vec4 texture_rect = {0.f, 0.f, 1.f, 1.f};
+};
+
+// CPU reference for the corner expansion done in sprite_instanced.vert
+std::array<SpriteVertex, 4> expand_sprite_instance(const SpriteInstance &instance);
 
 class BatchedSpriteRenderer
 {
   private:
-    std::unique_ptr<VertexArray> vertex_array;
-    std::unique_ptr<VertexBuffer> vertex_buffer;
-    std::unique_ptr<ElementBuffer> element_buffer;
-    ResourceManager &resource_manager;
+    static const int ring_regions = 3;
+
+    int current_region;
+    std::array<GLsync, ring_regions> fences;
+    std::unique_ptr<VertexBuffer> instance_buffer;
     int max_sprites;
-    std::vector<SpriteVertex> transformed_vertices;
+    std::unique_ptr<VertexBuffer> quad_buffer;
+    ResourceManager &resource_manager;
+    std::unique_ptr<VertexArray> vertex_array;
+    int write_offset;
+
+    int reserve(int count);
 
   public:
     BatchedSpriteRenderer(ResourceManager &resource_manager);
+    ~BatchedSpriteRenderer();
 
-    void draw(const std::string &texture,
-              const std::vector<glm::mat4> &transforms,
-              const std::vector<glm::vec4> &colors,
+    void draw(const Texture &texture,
+              const SpriteInstance *instances,
+              std::size_t count,
               const glm::mat4 &view);
     void init();
 };
-}
\ No newline at end of file
+}
@@ -1,6 +1,13 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <memory>
+#include <utility>
 
+#include <doctest.h>
 #include <glad/glad.h>
+#include <spdlog/spdlog.h>
 
 #include "graphics/renderers/particle_renderer.h"
 #include "graphics/backend/vertex_array.h"
@@ -11,28 +18,94 @@
 
 namespace ai
 {
+namespace
+{
+const GLuint64 fence_timeout = 1000000000;
+}
+
+void pack_particles(const Particle *particles,
+                    std::size_t count,
+                    float time,
+                    ParticleVertex *vertices)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto &particle = particles[i];
+        vertices[i] = {particle.start_position,
+                       particle.velocity,
+                       time + particle.start_time_offset,
+                       particle.lifetime,
+                       particle.size,
+                       particle.start_color,
+                       particle.end_color};
+    }
+}
+
 ParticleRenderer::ParticleRenderer(int max_particles, ResourceManager &resource_manager)
-    : resource_manager(resource_manager),
+    : draw_fence(nullptr),
+      resource_manager(resource_manager),
       max_particles(max_particles),
       particle_count(0),
       current_particle_index(0),
       vertex_array(nullptr) {}
 
-void ParticleRenderer::add_particles(std::vector<Particle> &particles, double time)
+ParticleRenderer::~ParticleRenderer()
+{
+    if (draw_fence != nullptr)
+    {
+        glDeleteSync(draw_fence);
+    }
+}
+
+void ParticleRenderer::add_particles(const Particle *particles, std::size_t count, double time)
 {
+    // Anything past max_particles would be overwritten in this same call
+    if (count > static_cast<std::size_t>(max_particles))
+    {
+        particles += count - max_particles;
+        count = max_particles;
+    }
+
+    // The last draw read every slot, expired or not, so it has to finish
+    // before any of them are overwritten
+    if (draw_fence != nullptr)
+    {
+        const auto result = glClientWaitSync(draw_fence,
+                                             GL_SYNC_FLUSH_COMMANDS_BIT,
+                                             fence_timeout);
+        if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+        {
+            spdlog::warn("Timed out waiting for particle buffer");
+        }
+        glDeleteSync(draw_fence);
+        draw_fence = nullptr;
+    }
+
     float mod_time = static_cast<float>(std::fmod(time, 10000));
-    for (const auto &particle : particles)
+    particle_vertex_buffer->bind();
+    while (count > 0)
     {
-        particle_positions[current_particle_index] = particle.start_position;
-        particle_velocities[current_particle_index] = particle.velocity;
-        particle_lives[current_particle_index] = particle.lifetime;
-        particle_sizes[current_particle_index] = particle.size;
-        particle_start_times[current_particle_index] = mod_time + particle.start_time_offset;
-        particle_start_colors[current_particle_index] = particle.start_color;
-        particle_end_colors[current_particle_index] = particle.end_color;
-        current_particle_index++;
-        current_particle_index %= max_particles;
-        particle_count = particle_count > current_particle_index ? particle_count : current_particle_index;
+        const int batch_size = std::min(static_cast<int>(count),
+                                        max_particles - current_particle_index);
+
+        // The fence guarantees the GPU is done with the buffer, so there's no
+        // need for the driver to synchronise
+        void *mapped_buffer = glMapBufferRange(GL_ARRAY_BUFFER,
+                                               current_particle_index * sizeof(ParticleVertex),
+                                               batch_size * sizeof(ParticleVertex),
+                                               GL_MAP_WRITE_BIT |
+                                                   GL_MAP_INVALIDATE_RANGE_BIT |
+                                                   GL_MAP_UNSYNCHRONIZED_BIT);
+        pack_particles(particles,
+                       batch_size,
+                       mod_time,
+                       static_cast<ParticleVertex *>(mapped_buffer));
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+
+        particles += batch_size;
+        count -= batch_size;
+        current_particle_index = (current_particle_index + batch_size) % max_particles;
+        particle_count = std::min(particle_count + batch_size, max_particles);
     }
 }
 
@@ -44,30 +117,25 @@ void ParticleRenderer::clear_particles()
 
 void ParticleRenderer::draw(double time, glm::mat4 view)
 {
-    float mod_time = static_cast<float>(std::fmod(time, 10000));
-    position_vertex_buffer->clear();
-    position_vertex_buffer->add_sub_data(&particle_positions[0], 0, particle_count * sizeof(glm::vec2));
-    velocity_vertex_buffer->clear();
-    velocity_vertex_buffer->add_sub_data(&particle_velocities[0], 0, particle_count * sizeof(glm::vec2));
-    start_time_vertex_buffer->clear();
-    start_time_vertex_buffer->add_sub_data(&particle_start_times[0], 0, particle_count * sizeof(float));
-    life_vertex_buffer->clear();
-    life_vertex_buffer->add_sub_data(&particle_lives[0], 0, particle_count * sizeof(float));
-    size_vertex_buffer->clear();
-    size_vertex_buffer->add_sub_data(&particle_sizes[0], 0, particle_count * sizeof(float));
-    start_color_vertex_buffer->clear();
-    start_color_vertex_buffer->add_sub_data(&particle_start_colors[0], 0, particle_count * sizeof(glm::vec4));
-    end_color_vertex_buffer->clear();
-    end_color_vertex_buffer->add_sub_data(&particle_end_colors[0], 0, particle_count * sizeof(glm::vec4));
+    if (particle_count == 0)
+    {
+        return;
+    }
 
+    float mod_time = static_cast<float>(std::fmod(time, 10000));
     auto shader = resource_manager.shader_store.get("particle");
     shader->bind();
     shader->set_uniform_mat4f("u_mvp", view);
     shader->set_uniform_1f("u_time", mod_time);
 
-    // renderer.draw(particle_engine, shader);
     vertex_array->bind();
     glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, particle_count);
+
+    if (draw_fence != nullptr)
+    {
+        glDeleteSync(draw_fence);
+    }
+    draw_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
 void ParticleRenderer::init()
@@ -75,13 +143,6 @@ void ParticleRenderer::init()
     vertex_array = std::make_unique<VertexArray>();
 
     resource_manager.load_shader("particle", "shaders/particle.vert", "shaders/default.frag");
-    particle_positions.resize(max_particles);
-    particle_velocities.resize(max_particles);
-    particle_start_times.resize(max_particles);
-    particle_lives.resize(max_particles);
-    particle_sizes.resize(max_particles);
-    particle_start_colors.resize(max_particles);
-    particle_end_colors.resize(max_particles);
 
     float vertex_buffer_data[] = {
         -1, -1,
@@ -89,13 +150,9 @@ void ParticleRenderer::init()
         -1, 1,
         1, 1};
     quad_vertex_buffer = std::make_unique<VertexBuffer>(&vertex_buffer_data, sizeof(vertex_buffer_data));
-    position_vertex_buffer = std::make_unique<VertexBuffer>(nullptr, max_particles * sizeof(glm::vec2), GL_STREAM_DRAW);
-    velocity_vertex_buffer = std::make_unique<VertexBuffer>(nullptr, max_particles * sizeof(glm::vec2), GL_STREAM_DRAW);
-    start_time_vertex_buffer = std::make_unique<VertexBuffer>(nullptr, max_particles * sizeof(float), GL_STREAM_DRAW);
-    life_vertex_buffer = std::make_unique<VertexBuffer>(nullptr, max_particles * sizeof(float), GL_STREAM_DRAW);
-    size_vertex_buffer = std::make_unique<VertexBuffer>(nullptr, max_particles * sizeof(float), GL_STREAM_DRAW);
-    start_color_vertex_buffer = std::make_unique<VertexBuffer>(nullptr, max_particles * sizeof(glm::vec4), GL_STREAM_DRAW);
-    end_color_vertex_buffer = std::make_unique<VertexBuffer>(nullptr, max_particles * sizeof(glm::vec4), GL_STREAM_DRAW);
+    particle_vertex_buffer = std::make_unique<VertexBuffer>(nullptr,
+                                                            max_particles * sizeof(ParticleVertex),
+                                                            GL_STREAM_DRAW);
 
     // Set attribute pointer for quad
     vertex_array->bind();
@@ -104,46 +161,52 @@ void ParticleRenderer::init()
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
     glVertexAttribDivisor(0, 0);
 
-    // Set attribute pointer for start positions
-    position_vertex_buffer->bind();
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
-    glVertexAttribDivisor(1, 1);
-
-    // Set attribute pointer for velocities
-    velocity_vertex_buffer->bind();
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
-    glVertexAttribDivisor(2, 1);
-
-    // Set attribute pointer for start times
-    start_time_vertex_buffer->bind();
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 0, (void *)0);
-    glVertexAttribDivisor(3, 1);
-
-    // Set attribute pointer for lives
-    life_vertex_buffer->bind();
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, 0, (void *)0);
-    glVertexAttribDivisor(4, 1);
-
-    // Set attribute pointer for sizes
-    size_vertex_buffer->bind();
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, 0, (void *)0);
-    glVertexAttribDivisor(5, 1);
-
-    // Set attribute pointer for start colors
-    start_color_vertex_buffer->bind();
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 0, (void *)0);
-    glVertexAttribDivisor(6, 1);
-
-    // Set attribute pointer for end colors
-    end_color_vertex_buffer->bind();
-    glEnableVertexAttribArray(7);
-    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, 0, (void *)0);
-    glVertexAttribDivisor(7, 1);
+    // Per particle attributes, in the order particle.vert declares them
+    particle_vertex_buffer->bind();
+    const std::array<std::pair<int, std::size_t>, 7> particle_attributes{
+        std::make_pair(2, offsetof(ParticleVertex, position)),
+        std::make_pair(2, offsetof(ParticleVertex, velocity)),
+        std::make_pair(1, offsetof(ParticleVertex, start_time)),
+        std::make_pair(1, offsetof(ParticleVertex, lifetime)),
+        std::make_pair(1, offsetof(ParticleVertex, size)),
+        std::make_pair(4, offsetof(ParticleVertex, start_color)),
+        std::make_pair(4, offsetof(ParticleVertex, end_color))};
+    for (unsigned int i = 0; i < particle_attributes.size(); ++i)
+    {
+        glEnableVertexAttribArray(i + 1);
+        glVertexAttribPointer(i + 1,
+                              particle_attributes[i].first,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              sizeof(ParticleVertex),
+                              reinterpret_cast<void *>(particle_attributes[i].second));
+        glVertexAttribDivisor(i + 1, 1);
+    }
+}
+
+TEST_CASE("pack_particles()")
+{
+    const std::array<Particle, 2> particles{
+        Particle{{1.f, 2.f}, {3.f, 4.f}, -0.5f, 0.8f, 0.05f, {1.f, 0.f, 0.f, 1.f}, {0.f, 0.f, 1.f, 0.f}},
+        Particle{{5.f, 6.f}, {7.f, 8.f}, 0.f, 1.f, 0.1f}};
+    std::array<ParticleVertex, 2> vertices;
+
+    pack_particles(particles.data(), particles.size(), 10.f, vertices.data());
+
+    SUBCASE("Start times are offset from the given time")
+    {
+        DOCTEST_CHECK(vertices[0].start_time == doctest::Approx(9.5f));
+        DOCTEST_CHECK(vertices[1].start_time == doctest::Approx(10.f));
+    }
+
+    SUBCASE("Other fields are copied across")
+    {
+        DOCTEST_CHECK(vertices[0].position == glm::vec2(1.f, 2.f));
+        DOCTEST_CHECK(vertices[0].velocity == glm::vec2(3.f, 4.f));
+        DOCTEST_CHECK(vertices[0].lifetime == doctest::Approx(0.8f));
+        DOCTEST_CHECK(vertices[0].size == doctest::Approx(0.05f));
+        DOCTEST_CHECK(vertices[0].end_color == glm::vec4(0.f, 0.f, 1.f, 0.f));
+        DOCTEST_CHECK(vertices[1].start_color == cl_white);
+    }
+}
 }
-}
\ No newline at end of file
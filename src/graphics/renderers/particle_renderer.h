@@ -1,8 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
-#include <vector>
 
+#include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "graphics/backend/vertex_array.h"
@@ -16,36 +17,47 @@ struct Particle;
 
 static auto MaxParticles = [] {};
 
+// A particle as stored on the GPU, with its start time made absolute
+struct ParticleVertex
+{
+    glm::vec2 position;
+    glm::vec2 velocity;
+    float start_time;
+    float lifetime;
+    float size;
+    glm::vec4 start_color;
+    glm::vec4 end_color;
+};
+
+void pack_particles(const Particle *particles,
+                    std::size_t count,
+                    float time,
+                    ParticleVertex *vertices);
+
+// Particles live in one interleaved ring buffer of max_particles slots.
+// New particles are written over the oldest ones, straight into the mapped
+// buffer, so a frame only uploads the particles spawned during it. Every
+// draw reads the whole ring, so a fence after each draw is waited on before
+// the ring is written to again.
 class ParticleRenderer
 {
   private:
+    GLsync draw_fence;
     ResourceManager &resource_manager;
     int max_particles;
     int particle_count;
     int current_particle_index;
     std::unique_ptr<VertexArray> vertex_array;
     std::unique_ptr<VertexBuffer> quad_vertex_buffer;
-    std::unique_ptr<VertexBuffer> position_vertex_buffer;
-    std::unique_ptr<VertexBuffer> velocity_vertex_buffer;
-    std::unique_ptr<VertexBuffer> start_time_vertex_buffer;
-    std::unique_ptr<VertexBuffer> life_vertex_buffer;
-    std::unique_ptr<VertexBuffer> size_vertex_buffer;
-    std::unique_ptr<VertexBuffer> start_color_vertex_buffer;
-    std::unique_ptr<VertexBuffer> end_color_vertex_buffer;
-    std::vector<glm::vec2> particle_positions;
-    std::vector<glm::vec2> particle_velocities;
-    std::vector<float> particle_start_times;
-    std::vector<float> particle_lives;
-    std::vector<float> particle_sizes;
-    std::vector<glm::vec4> particle_start_colors;
-    std::vector<glm::vec4> particle_end_colors;
+    std::unique_ptr<VertexBuffer> particle_vertex_buffer;
 
   public:
     BOOST_DI_INJECT(ParticleRenderer, (named = MaxParticles) int max_particles, ResourceManager &resource_manager);
+    ~ParticleRenderer();
 
-    void add_particles(std::vector<Particle> &particles, double time);
+    void add_particles(const Particle *particles, std::size_t count, double time);
     void clear_particles();
     void draw(double time, glm::mat4 view);
     void init();
 };
-}
\ No newline at end of file
+}
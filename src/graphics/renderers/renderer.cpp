@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <iterator>
 #include <memory>
 
 #include <glad/glad.h>
@@ -16,38 +18,16 @@
 #include "graphics/backend/element_buffer.h"
 #include "graphics/backend/shader.h"
 #include "graphics/backend/frame_buffer.h"
+#include "graphics/backend/texture_atlas.h"
 #include "graphics/post_processing/distortion_layer.h"
 #include "graphics/render_data.h"
 #include "graphics/post_processing/post_proc_layer.h"
 #include "graphics/render_data.h"
+#include "misc/profiler.h"
+#include "misc/resource_manager.h"
 
 namespace ai
 {
-struct GetDepthVisitor
-{
-    template <class T>
-    int operator()(const T &shape)
-    {
-        return shape.transform.get_z();
-    }
-};
-
-class DrawVisitor
-{
-  private:
-    VectorRenderer &vector_renderer;
-
-  public:
-    DrawVisitor(VectorRenderer &vector_renderer)
-        : vector_renderer(vector_renderer) {}
-
-    template <class T>
-    void operator()(const T &shape)
-    {
-        return vector_renderer.draw(shape);
-    }
-};
-
 Renderer::Renderer(int width, int height,
                    ResourceManager &resource_manager,
                    BatchedSpriteRenderer &sprite_renderer,
@@ -93,7 +73,7 @@ void Renderer::resize(int width, int height)
 
 void Renderer::draw(const Line &line)
 {
-    draw_list.push_back(line);
+    vector_renderer.draw(line);
 }
 
 void Renderer::draw(const std::vector<Particle> &particles)
@@ -101,14 +81,35 @@ void Renderer::draw(const std::vector<Particle> &particles)
     this->particles.insert(this->particles.end(), particles.begin(), particles.end());
 }
 
+Particle *Renderer::allocate_particles(std::size_t count)
+{
+    const auto start = particles.size();
+    particles.resize(start + count);
+    return particles.data() + start;
+}
+
 void Renderer::draw(const Sprite &sprite)
 {
-    auto texture_iter = std::find(textures.begin(), textures.end(), sprite.texture);
+    // Sprites on the same atlas page share a batch
+    const Texture *texture;
+    glm::vec4 texture_rect(0.f, 0.f, 1.f, 1.f);
+    const auto *region = resource_manager.texture_atlas.get(sprite.texture);
+    if (region != nullptr)
+    {
+        texture = region->page;
+        texture_rect = region->texture_rect;
+    }
+    else
+    {
+        texture = resource_manager.texture_store.get(sprite.texture);
+    }
+
+    auto texture_iter = std::find(textures.begin(), textures.end(), texture);
     unsigned int texture_index;
     if (texture_iter == textures.end())
     {
         unsigned int texture_count = textures.size();
-        textures.push_back(sprite.texture);
+        textures.push_back(texture);
         texture_index = texture_count;
     }
     else
@@ -116,34 +117,49 @@ void Renderer::draw(const Sprite &sprite)
         texture_index = std::distance(textures.begin(), texture_iter);
     }
 
+    const auto &transform = sprite.transform;
     sprites.push_back(PackedSprite{texture_index,
-                                   sprite.color,
-                                   sprite.transform.get()});
+                                   SpriteInstance{transform.get_position(),
+                                                  transform.get_scale(),
+                                                  transform.get_origin(),
+                                                  transform.get_rotation(),
+                                                  sprite.color,
+                                                  texture_rect}});
 }
 
 void Renderer::draw(const Text &text)
 {
-    texts.push_back(text);
+    text_renderer.draw(text);
 }
 
 void Renderer::draw(const Circle &circle)
 {
-    draw_list.push_back(circle);
+    vector_renderer.draw(circle);
 }
 
 void Renderer::draw(const Rectangle &rectangle)
 {
-    draw_list.push_back(rectangle);
+    vector_renderer.draw(rectangle);
 }
 
 void Renderer::draw(const SemiCircle &semicircle)
 {
-    draw_list.push_back(semicircle);
+    vector_renderer.draw(semicircle);
 }
 
 void Renderer::draw(const Trapezoid &trapezoid)
 {
-    draw_list.push_back(trapezoid);
+    vector_renderer.draw(trapezoid);
+}
+
+bool Renderer::draw(const RetainedShape &shape)
+{
+    return vector_renderer.draw(shape);
+}
+
+void Renderer::retain_last_shape(RetainedShape &shape) const
+{
+    vector_renderer.retain_last(shape);
 }
 
 void Renderer::clear(const glm::vec4 &color)
@@ -177,6 +193,8 @@ void Renderer::render(double time)
 
 const FrameBuffer *Renderer::render_to_buffer(double time)
 {
+    AI_PROFILE_GPU_SCOPE("Renderer::render_to_buffer");
+
     texture_frame_buffer->bind_draw();
     clear_scissor();
     glViewport(0, 0, width, height);
@@ -184,58 +202,29 @@ const FrameBuffer *Renderer::render_to_buffer(double time)
 
     if (distortion_layer != nullptr)
     {
+        AI_PROFILE_SCOPE("DistortionLayer::update_mesh");
         distortion_layer->update_mesh();
     }
 
-    std::sort(draw_list.begin(), draw_list.end(),
-              [](const ShapeVariant &lhs, const ShapeVariant &rhs) {
-                  return std::visit(GetDepthVisitor{}, lhs) < std::visit(GetDepthVisitor{}, rhs);
-              });
-    DrawVisitor draw_visitor(vector_renderer);
-    for (const auto &shape : draw_list)
+    // Shapes are depth sorted and drawn in one batch
     {
-        std::visit(draw_visitor, shape);
+        AI_PROFILE_GPU_SCOPE("Renderer: vector shapes");
+        vector_renderer.end_frame();
     }
-    vector_renderer.end_frame();
-    draw_list.clear();
-
-    std::sort(sprites.begin(), sprites.end(),
-              [](PackedSprite &a, PackedSprite &b) { return a.texture < b.texture; });
 
-    unsigned int texture_index = 0;
-    std::vector<glm::vec4> colors;
-    std::vector<glm::mat4> transforms;
-    for (const auto &sprite : sprites)
-    {
-        if (sprite.texture != texture_index)
-        {
-            if (transforms.size() > 0)
-            {
-                sprite_renderer.draw(textures[texture_index], transforms, colors, view);
-                colors.clear();
-                transforms.clear();
-            }
-            texture_index = sprite.texture;
-        }
+    render_sprites();
 
-        colors.push_back(sprite.color);
-        transforms.push_back(sprite.transform);
-    }
-    if (transforms.size() > 0)
     {
-        sprite_renderer.draw(textures[texture_index], transforms, colors, view);
+        AI_PROFILE_GPU_SCOPE("Renderer: particles");
+        particle_renderer.add_particles(particles.data(), particles.size(), time);
+        particle_renderer.draw(time, view);
+        particles.clear();
     }
-    sprites.clear();
-
-    particle_renderer.add_particles(particles, time);
-    particle_renderer.draw(time, view);
-    particles.clear();
 
-    for (const auto &text : texts)
     {
-        text_renderer.draw(text, view);
+        AI_PROFILE_GPU_SCOPE("Renderer: text");
+        text_renderer.flush(view);
     }
-    texts.clear();
 
     clear_scissor();
     for (const auto &post_proc_layer : post_proc_layers)
@@ -259,6 +248,32 @@ const FrameBuffer *Renderer::render_to_buffer(double time)
     return read_buffer;
 }
 
+void Renderer::render_sprites()
+{
+    AI_PROFILE_GPU_SCOPE("Renderer: sprites");
+
+    std::sort(sprites.begin(), sprites.end(),
+              [](PackedSprite &a, PackedSprite &b) { return a.texture < b.texture; });
+
+    sprite_instances.clear();
+    std::transform(sprites.begin(), sprites.end(),
+                   std::back_inserter(sprite_instances),
+                   [](const PackedSprite &sprite) { return sprite.instance; });
+    std::size_t run_start = 0;
+    for (std::size_t i = 1; i <= sprites.size(); ++i)
+    {
+        if (i == sprites.size() || sprites[i].texture != sprites[run_start].texture)
+        {
+            sprite_renderer.draw(*textures[sprites[run_start].texture],
+                                 sprite_instances.data() + run_start,
+                                 i - run_start,
+                                 view);
+            run_start = i;
+        }
+    }
+    sprites.clear();
+}
+
 void Renderer::push_post_proc_layer(PostProcLayer &post_proc_layer)
 {
     post_proc_layers.push_back(&post_proc_layer);
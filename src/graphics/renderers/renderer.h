@@ -1,13 +1,15 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
-#include <variant>
 #include <vector>
 
 #include <glm/glm.hpp>
 
 #include "graphics/backend/frame_buffer.h"
+#include "graphics/renderers/batched_sprite_renderer.h"
 #include "graphics/colors.h"
+#include "graphics/particle_spawner.h"
 #include "graphics/render_data.h"
 #include "third_party/di.hpp"
 
@@ -19,9 +21,10 @@ class ResourceManager;
 class VertexArray;
 class ElementBuffer;
 class Shader;
+class Texture;
+struct RetainedShape;
 struct Sprite;
 struct Text;
-class BatchedSpriteRenderer;
 class ParticleRenderer;
 class TextRenderer;
 class VectorRenderer;
@@ -29,16 +32,13 @@ class VectorRenderer;
 static auto ResolutionX = [] {};
 static auto ResolutionY = [] {};
 
-using ShapeVariant = std::variant<Circle, Rectangle, SemiCircle, Trapezoid, Line>;
-
 class Renderer
 {
   private:
     struct PackedSprite
     {
         unsigned int texture;
-        glm::vec4 color;
-        glm::mat4 transform;
+        SpriteInstance instance;
     };
 
     bool initialized;
@@ -49,12 +49,12 @@ class Renderer
     std::vector<PostProcLayer *> post_proc_layers;
     std::unique_ptr<FrameBuffer> texture_frame_buffer;
 
-    std::vector<std::string> textures;
+    std::vector<const Texture *> textures;
 
-    std::vector<ShapeVariant> draw_list;
+    ParticleSpawner particle_spawner;
     std::vector<Particle> particles;
+    std::vector<SpriteInstance> sprite_instances;
     std::vector<PackedSprite> sprites;
-    std::vector<Text> texts;
 
     ResourceManager &resource_manager;
 
@@ -65,6 +65,8 @@ class Renderer
 
     DistortionLayer *distortion_layer;
 
+    void render_sprites();
+
   public:
     BOOST_DI_INJECT(Renderer,
                     (named = ResolutionX) int width,
@@ -82,12 +84,20 @@ class Renderer
 
     void draw(const Line &line);
     void draw(const std::vector<Particle> &particles);
+    // Space for count particles in this frame's batch, valid until the next
+    // call to allocate_particles() or draw()
+    Particle *allocate_particles(std::size_t count);
     void draw(const Sprite &sprite);
     void draw(const Text &text);
     void draw(const Circle &circle);
     void draw(const Rectangle &rectangle);
     void draw(const SemiCircle &semicircle);
     void draw(const Trapezoid &trapezoid);
+    // Draws a shape kept from an earlier frame with retain_last_shape(),
+    // unless the view has zoomed since, in which case nothing is drawn and
+    // false is returned
+    bool draw(const RetainedShape &shape);
+    void retain_last_shape(RetainedShape &shape) const;
 
     void clear(const glm::vec4 &color = cl_background);
 
@@ -105,6 +115,7 @@ class Renderer
     void render(double time);
     const FrameBuffer *render_to_buffer(double time);
 
+    inline ParticleSpawner &get_particle_spawner() { return particle_spawner; }
     inline const glm::mat4 &get_view() const { return view; }
     void set_view(const glm::mat4 &view);
 
@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <doctest.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "shape_tessellator.h"
+#include "graphics/render_data.h"
+#include "misc/transform.h"
+
+namespace ai
+{
+namespace
+{
+const std::size_t no_range = static_cast<std::size_t>(-1);
+
+const std::array<glm::vec2, 4> unit_square{glm::vec2(-0.5f, -0.5f),
+                                            glm::vec2(0.5f, -0.5f),
+                                            glm::vec2(0.5f, 0.5f),
+                                            glm::vec2(-0.5f, 0.5f)};
+
+// Flip the sign bit so that negative z values sort before positive ones
+inline std::uint32_t depth_key(int z)
+{
+    return static_cast<std::uint32_t>(z) ^ 0x80000000u;
+}
+
+inline glm::vec4 transparent(glm::vec4 color)
+{
+    color.a = 0.f;
+    return color;
+}
+
+inline glm::vec2 outward_normal(glm::vec2 edge)
+{
+    const float length = glm::length(edge);
+    return length > 0.f ? glm::vec2(edge.y, -edge.x) / length : glm::vec2(0.f, 0.f);
+}
+}
+
+ShapeTessellator::ShapeTessellator(int circle_segments)
+    : fringe_width(0.f),
+      last_range(no_range)
+{
+    for (int i = 0; i < circle_segments; ++i)
+    {
+        const float angle = glm::two_pi<float>() * i / circle_segments;
+        unit_circle.push_back({std::cos(angle), std::sin(angle)});
+    }
+    const int semicircle_segments = std::max(circle_segments / 2, 1);
+    for (int i = 0; i <= semicircle_segments; ++i)
+    {
+        const float angle = glm::pi<float>() * i / semicircle_segments;
+        unit_semicircle.push_back({std::cos(angle), std::sin(angle)});
+    }
+}
+
+void ShapeTessellator::add(const Circle &circle)
+{
+    transform_outline(unit_circle.data(),
+                      unit_circle.size(),
+                      circle.transform,
+                      {circle.radius, circle.radius},
+                      false);
+    add_outline(circle.transform.get_z(),
+                circle.fill_color,
+                circle.stroke_color,
+                circle.stroke_width);
+}
+
+void ShapeTessellator::add(const Line &line)
+{
+    const auto scale = line.transform.get_scale();
+    const auto offset = line.transform.get_position() - line.transform.get_origin();
+    const glm::vec2 start = offset + line.start * scale;
+    const glm::vec2 end = offset + line.end * scale;
+    const float length = glm::length(end - start);
+    if (length == 0.f)
+    {
+        last_range = no_range;
+        return;
+    }
+
+    const glm::vec2 direction = (end - start) / length;
+    const glm::vec2 normal = glm::vec2(-direction.y, direction.x) * line.width * 0.5f;
+    outline.assign({start - normal, end - normal, end + normal, start + normal});
+    add_outline(line.transform.get_z(), line.color, line.color, 0.f);
+}
+
+void ShapeTessellator::add(const Rectangle &rectangle)
+{
+    transform_outline(unit_square.data(),
+                      unit_square.size(),
+                      rectangle.transform,
+                      rectangle.transform.get_scale(),
+                      true);
+    add_outline(rectangle.transform.get_z(),
+                rectangle.fill_color,
+                rectangle.stroke_color,
+                rectangle.stroke_width);
+}
+
+void ShapeTessellator::add(const SemiCircle &semicircle)
+{
+    transform_outline(unit_semicircle.data(),
+                      unit_semicircle.size(),
+                      semicircle.transform,
+                      {semicircle.radius, semicircle.radius},
+                      true);
+    add_outline(semicircle.transform.get_z(),
+                semicircle.fill_color,
+                semicircle.stroke_color,
+                semicircle.stroke_width);
+}
+
+void ShapeTessellator::add(const Trapezoid &trapezoid)
+{
+    const std::array<glm::vec2, 4> points{glm::vec2(-trapezoid.bottom_width * 0.5f, -0.5f),
+                                          glm::vec2(trapezoid.bottom_width * 0.5f, -0.5f),
+                                          glm::vec2(trapezoid.top_width * 0.5f, 0.5f),
+                                          glm::vec2(-trapezoid.top_width * 0.5f, 0.5f)};
+    transform_outline(points.data(),
+                      points.size(),
+                      trapezoid.transform,
+                      trapezoid.transform.get_scale(),
+                      true);
+    add_outline(trapezoid.transform.get_z(),
+                trapezoid.fill_color,
+                trapezoid.stroke_color,
+                trapezoid.stroke_width);
+}
+
+void ShapeTessellator::add(const RetainedShape &shape)
+{
+    last_range = no_range;
+    if (shape.vertices.empty())
+    {
+        return;
+    }
+
+    last_range = ranges.size();
+    ranges.push_back({depth_key(shape.z),
+                      static_cast<std::uint32_t>(scratch_vertices.size()),
+                      static_cast<std::uint32_t>(shape.vertices.size())});
+    scratch_vertices.insert(scratch_vertices.end(), shape.vertices.begin(), shape.vertices.end());
+}
+
+void ShapeTessellator::add_outline(int z,
+                                   const glm::vec4 &fill_color,
+                                   const glm::vec4 &stroke_color,
+                                   float stroke_width)
+{
+    last_range = no_range;
+    if (outline.size() < 3)
+    {
+        return;
+    }
+
+    // Miters are calculated assuming counter-clockwise winding, which
+    // mirrored transforms reverse
+    float area = 0.f;
+    for (unsigned int i = 0; i < outline.size(); ++i)
+    {
+        const auto &a = outline[i];
+        const auto &b = outline[(i + 1) % outline.size()];
+        area += a.x * b.y - b.x * a.y;
+    }
+    if (area < 0.f)
+    {
+        std::reverse(outline.begin(), outline.end());
+    }
+    calculate_miters();
+
+    const auto start = static_cast<std::uint32_t>(scratch_vertices.size());
+
+    if (fill_color.a != 0.f)
+    {
+        // All of the shapes are convex, so a fan is enough
+        for (unsigned int i = 1; i + 1 < outline.size(); ++i)
+        {
+            add_triangle(outline[0], outline[i], outline[i + 1], fill_color);
+        }
+        if (fringe_width > 0.f)
+        {
+            add_ring(0.f, fill_color, fringe_width, transparent(fill_color));
+        }
+    }
+
+    if (stroke_width != 0.f)
+    {
+        const float half_width = stroke_width * 0.5f;
+        add_ring(-half_width, stroke_color, half_width, stroke_color);
+        if (fringe_width > 0.f)
+        {
+            add_ring(half_width, stroke_color, half_width + fringe_width, transparent(stroke_color));
+            add_ring(-half_width - fringe_width, transparent(stroke_color), -half_width, stroke_color);
+        }
+    }
+
+    const auto count = static_cast<std::uint32_t>(scratch_vertices.size()) - start;
+    if (count > 0)
+    {
+        last_range = ranges.size();
+        ranges.push_back({depth_key(z), start, count});
+    }
+}
+
+void ShapeTessellator::add_ring(float inner_offset,
+                                const glm::vec4 &inner_color,
+                                float outer_offset,
+                                const glm::vec4 &outer_color)
+{
+    for (unsigned int i = 0; i < outline.size(); ++i)
+    {
+        const unsigned int next = (i + 1) % outline.size();
+        const glm::vec2 inner_a = outline[i] + miters[i] * inner_offset;
+        const glm::vec2 inner_b = outline[next] + miters[next] * inner_offset;
+        const glm::vec2 outer_a = outline[i] + miters[i] * outer_offset;
+        const glm::vec2 outer_b = outline[next] + miters[next] * outer_offset;
+
+        scratch_vertices.push_back({inner_a, inner_color});
+        scratch_vertices.push_back({inner_b, inner_color});
+        scratch_vertices.push_back({outer_b, outer_color});
+        scratch_vertices.push_back({outer_b, outer_color});
+        scratch_vertices.push_back({outer_a, outer_color});
+        scratch_vertices.push_back({inner_a, inner_color});
+    }
+}
+
+void ShapeTessellator::add_triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, const glm::vec4 &color)
+{
+    scratch_vertices.push_back({a, color});
+    scratch_vertices.push_back({b, color});
+    scratch_vertices.push_back({c, color});
+}
+
+const std::vector<ShapeVertex> &ShapeTessellator::build()
+{
+    // LSD radix sort on the depth keys, one byte per pass. Passes where every
+    // shape falls in the same bucket are skipped, which is almost all of them
+    // since z values are small.
+    const std::size_t shape_count = ranges.size();
+    sorted_ranges.resize(shape_count);
+    auto *source = &ranges;
+    auto *destination = &sorted_ranges;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        std::array<std::uint32_t, 256> offsets{};
+        for (const auto &range : *source)
+        {
+            ++offsets[(range.key >> shift) & 0xff];
+        }
+        if (std::find(offsets.begin(), offsets.end(), shape_count) != offsets.end())
+        {
+            continue;
+        }
+
+        std::uint32_t total = 0;
+        for (auto &offset : offsets)
+        {
+            const auto count = offset;
+            offset = total;
+            total += count;
+        }
+        for (const auto &range : *source)
+        {
+            (*destination)[offsets[(range.key >> shift) & 0xff]++] = range;
+        }
+        std::swap(source, destination);
+    }
+
+    vertices.clear();
+    vertices.reserve(scratch_vertices.size());
+    for (const auto &range : *source)
+    {
+        vertices.insert(vertices.end(),
+                        scratch_vertices.begin() + range.start,
+                        scratch_vertices.begin() + range.start + range.count);
+    }
+
+    return vertices;
+}
+
+void ShapeTessellator::calculate_miters()
+{
+    const unsigned int count = outline.size();
+    miters.resize(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const auto &previous = outline[(i + count - 1) % count];
+        const auto &next = outline[(i + 1) % count];
+        const glm::vec2 previous_normal = outward_normal(outline[i] - previous);
+        const glm::vec2 next_normal = outward_normal(next - outline[i]);
+
+        // Scale the averaged normal so offsetting by it moves both adjacent
+        // edges by one unit, capping the length at very sharp corners
+        const float cos_angle = glm::dot(previous_normal, next_normal);
+        miters[i] = (previous_normal + next_normal) / std::max(1.f + cos_angle, 0.125f);
+    }
+}
+
+void ShapeTessellator::clear()
+{
+    last_range = no_range;
+    ranges.clear();
+    scratch_vertices.clear();
+}
+
+void ShapeTessellator::retain_last(RetainedShape &shape) const
+{
+    shape.fringe_width = fringe_width;
+    if (last_range == no_range)
+    {
+        shape.vertices.clear();
+        return;
+    }
+
+    const auto &range = ranges[last_range];
+    shape.vertices.assign(scratch_vertices.begin() + range.start,
+                          scratch_vertices.begin() + range.start + range.count);
+    shape.z = static_cast<int>(range.key ^ 0x80000000u);
+}
+
+void ShapeTessellator::transform_outline(const glm::vec2 *points,
+                                         std::size_t count,
+                                         const Transform &transform,
+                                         glm::vec2 scale,
+                                         bool rotate)
+{
+    const auto position = transform.get_position();
+    const auto origin = transform.get_origin();
+    const float rotation = rotate ? transform.get_rotation() : 0.f;
+    const float cos_rotation = std::cos(rotation);
+    const float sin_rotation = std::sin(rotation);
+
+    outline.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const glm::vec2 local = points[i] * scale - origin;
+        outline[i] = position + glm::vec2(cos_rotation * local.x - sin_rotation * local.y,
+                                          sin_rotation * local.x + cos_rotation * local.y);
+    }
+}
+
+TEST_CASE("ShapeTessellator")
+{
+    ShapeTessellator tessellator(16);
+
+    SUBCASE("Fills circles with a triangle fan")
+    {
+        Circle circle{1.f};
+        circle.fill_color = cl_white;
+        tessellator.add(circle);
+
+        DOCTEST_CHECK(tessellator.build().size() == 3 * (16 - 2));
+    }
+
+    SUBCASE("Strokes outlines with two triangles per edge")
+    {
+        Rectangle rectangle;
+        rectangle.fill_color = glm::vec4(0, 0, 0, 0);
+        rectangle.stroke_width = 0.1f;
+        tessellator.add(rectangle);
+
+        DOCTEST_CHECK(tessellator.build().size() == 4 * 6);
+    }
+
+    SUBCASE("Adds fringes when anti-aliasing")
+    {
+        Rectangle rectangle;
+        tessellator.set_fringe_width(0.01f);
+        tessellator.add(rectangle);
+
+        DOCTEST_CHECK(tessellator.build().size() == 2 * 3 + 4 * 6);
+    }
+
+    SUBCASE("Applies transforms")
+    {
+        Rectangle rectangle;
+        rectangle.transform.set_position({1.f, 1.f});
+        rectangle.transform.set_rotation(glm::half_pi<float>());
+        rectangle.transform.set_scale({2.f, 1.f});
+        tessellator.add(rectangle);
+
+        const auto &vertices = tessellator.build();
+        glm::vec2 min(1000.f), max(-1000.f);
+        for (const auto &vertex : vertices)
+        {
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+
+        DOCTEST_CHECK(min.x == doctest::Approx(0.5f));
+        DOCTEST_CHECK(max.x == doctest::Approx(1.5f));
+        DOCTEST_CHECK(min.y == doctest::Approx(0.f));
+        DOCTEST_CHECK(max.y == doctest::Approx(2.f));
+    }
+
+    SUBCASE("Orders shapes by depth, keeping insertion order for ties")
+    {
+        const glm::vec4 red(1, 0, 0, 1), green(0, 1, 0, 1), blue(0, 0, 1, 1);
+        Rectangle first;
+        first.fill_color = red;
+        first.transform.set_z(2);
+        Circle second{1.f};
+        second.fill_color = blue;
+        second.transform.set_z(-1);
+        Rectangle third;
+        third.fill_color = green;
+        third.transform.set_z(2);
+        tessellator.add(first);
+        tessellator.add(second);
+        tessellator.add(third);
+
+        const auto &vertices = tessellator.build();
+
+        DOCTEST_CHECK(vertices.front().color == blue);
+        DOCTEST_CHECK(vertices[3 * (16 - 2)].color == red);
+        DOCTEST_CHECK(vertices.back().color == green);
+    }
+
+    SUBCASE("Skips degenerate lines")
+    {
+        Line line;
+        tessellator.add(line);
+
+        DOCTEST_CHECK(tessellator.get_shape_count() == 0);
+        DOCTEST_CHECK(tessellator.build().empty());
+    }
+
+    SUBCASE("Retained shapes draw the same as the shapes they were taken from")
+    {
+        Circle circle{1.f};
+        circle.transform.set_position({2.f, -1.f});
+        circle.transform.set_z(-3);
+        circle.stroke_width = 0.1f;
+        tessellator.set_fringe_width(0.01f);
+        tessellator.add(circle);
+        RetainedShape retained;
+        tessellator.retain_last(retained);
+        const auto original = tessellator.build();
+        tessellator.clear();
+
+        tessellator.add(Rectangle());
+        tessellator.add(retained);
+        const auto &vertices = tessellator.build();
+
+        DOCTEST_CHECK(retained.z == -3);
+        DOCTEST_CHECK(retained.fringe_width == doctest::Approx(0.01f));
+        DOCTEST_REQUIRE(vertices.size() > original.size());
+        DOCTEST_CHECK(vertices.front().position == original.front().position);
+        DOCTEST_CHECK(vertices[original.size() - 1].position == original.back().position);
+    }
+
+    SUBCASE("Nothing is retained from shapes with nothing to draw")
+    {
+        RetainedShape retained;
+        retained.vertices.resize(3);
+        tessellator.add(Rectangle());
+        tessellator.add(Line());
+        tessellator.retain_last(retained);
+
+        DOCTEST_CHECK(retained.vertices.empty());
+    }
+
+    SUBCASE("clear() removes all shapes")
+    {
+        tessellator.add(Rectangle());
+        tessellator.clear();
+
+        DOCTEST_CHECK(tessellator.build().empty());
+    }
+}
+}
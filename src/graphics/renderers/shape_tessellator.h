@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/render_data.h"
+
+namespace ai
+{
+struct ShapeVertex
+{
+    glm::vec2 position;
+    glm::vec4 color;
+};
+
+// A shape's tessellation, kept so that a shape that hasn't changed can be
+// drawn again in later frames without tessellating it again
+struct RetainedShape
+{
+    std::vector<ShapeVertex> vertices;
+    int z = 0;
+    // Fringes are sized in pixels, so a retained shape is stale once the view
+    // zooms
+    float fringe_width = -1.f;
+};
+
+// Turns a frame's vector shapes into a single triangle list on the CPU.
+//
+// Shapes are tessellated as they are added, into a scratch buffer, and
+// build() gathers them back-to-front using a radix sort on their z values.
+// Shapes with equal z keep the order they were added in. Edges get a
+// transparent fringe of fringe_width world units for cheap anti-aliasing.
+class ShapeTessellator
+{
+  private:
+    struct ShapeRange
+    {
+        std::uint32_t key;
+        std::uint32_t start;
+        std::uint32_t count;
+    };
+
+    float fringe_width;
+    std::size_t last_range;
+    std::vector<glm::vec2> miters;
+    std::vector<glm::vec2> outline;
+    std::vector<ShapeRange> ranges;
+    std::vector<ShapeVertex> scratch_vertices;
+    std::vector<ShapeRange> sorted_ranges;
+    std::vector<glm::vec2> unit_circle;
+    std::vector<glm::vec2> unit_semicircle;
+    std::vector<ShapeVertex> vertices;
+
+    void add_outline(int z,
+                     const glm::vec4 &fill_color,
+                     const glm::vec4 &stroke_color,
+                     float stroke_width);
+    void add_ring(float inner_offset,
+                  const glm::vec4 &inner_color,
+                  float outer_offset,
+                  const glm::vec4 &outer_color);
+    void add_triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, const glm::vec4 &color);
+    void calculate_miters();
+    void transform_outline(const glm::vec2 *points,
+                           std::size_t count,
+                           const Transform &transform,
+                           glm::vec2 scale,
+                           bool rotate);
+
+  public:
+    ShapeTessellator(int circle_segments = 32);
+
+    void add(const Circle &circle);
+    void add(const Line &line);
+    void add(const Rectangle &rectangle);
+    void add(const SemiCircle &semicircle);
+    void add(const Trapezoid &trapezoid);
+    void add(const RetainedShape &shape);
+    const std::vector<ShapeVertex> &build();
+    void clear();
+    // Copies out the tessellation of the shape added last, leaving shape
+    // empty if that shape had nothing to draw
+    void retain_last(RetainedShape &shape) const;
+
+    inline std::size_t get_shape_count() const { return ranges.size(); }
+    inline float get_fringe_width() const { return fringe_width; }
+    inline void set_fringe_width(float fringe_width) { this->fringe_width = fringe_width; }
+};
+}
@@ -1,5 +1,10 @@
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include <doctest.h>
+#include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "graphics/renderers/text_renderer.h"
@@ -14,112 +19,173 @@
 
 namespace ai
 {
-struct GlyphInfo
+namespace
 {
-    glm::vec2 positions[4];
-    glm::vec2 uvs[4];
+const int atlas_size = 1024;
+const unsigned int first_character = 32;
+}
+
+std::vector<GlyphQuad> layout_glyph_run(const std::vector<stbtt_packedchar> &char_info,
+                                        const std::string &text)
+{
+    std::vector<GlyphQuad> quads;
+    quads.reserve(text.size());
+
     float offset_x = 0;
     float offset_y = 0;
-};
+    for (const auto character : text)
+    {
+        const auto index = static_cast<unsigned char>(character) - first_character;
+        if (index >= char_info.size())
+        {
+            continue;
+        }
+
+        stbtt_aligned_quad quad;
+        stbtt_GetPackedQuad(char_info.data(),
+                            atlas_size,
+                            atlas_size,
+                            index,
+                            &offset_x,
+                            &offset_y,
+                            &quad,
+                            1);
+
+        // Text is laid out y down, but drawn y up
+        quads.push_back({{glm::vec2{quad.x0, -quad.y1},
+                          glm::vec2{quad.x0, -quad.y0},
+                          glm::vec2{quad.x1, -quad.y0},
+                          glm::vec2{quad.x1, -quad.y1}},
+                         {glm::vec2{quad.s0, quad.t1},
+                          glm::vec2{quad.s0, quad.t0},
+                          glm::vec2{quad.s1, quad.t0},
+                          glm::vec2{quad.s1, quad.t1}}});
+    }
+
+    return quads;
+}
+
+GlyphRunCache::GlyphRunCache(unsigned int max_unused_frames)
+    : frame(0), max_unused_frames(max_unused_frames) {}
+
+void GlyphRunCache::end_frame()
+{
+    ++frame;
+    if (frame % max_unused_frames != 0)
+    {
+        return;
+    }
+
+    for (auto iter = runs.begin(); iter != runs.end();)
+    {
+        if (frame - iter->second.last_used_frame >= max_unused_frames)
+        {
+            iter = runs.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
 
-GlyphInfo get_glyph_info(const stbtt_packedchar *char_info,
-                         unsigned int character,
-                         float offset_x,
-                         float offset_y)
+const std::vector<GlyphQuad> &GlyphRunCache::get(const std::string &font_id,
+                                                 const std::vector<stbtt_packedchar> &char_info,
+                                                 const std::string &text)
 {
-    stbtt_aligned_quad quad;
-
-    stbtt_GetPackedQuad(char_info, 1024, 1024, character - 32, &offset_x, &offset_y, &quad, 1);
-    auto x_min = quad.x0;
-    auto x_max = quad.x1;
-    auto y_min = -quad.y1;
-    auto y_max = -quad.y0;
-
-    GlyphInfo info;
-    info.offset_x = offset_x;
-    info.offset_y = offset_y;
-    info.positions[0] = {x_min, y_min};
-    info.positions[1] = {x_min, y_max};
-    info.positions[2] = {x_max, y_max};
-    info.positions[3] = {x_max, y_min};
-    info.uvs[0] = {quad.s0, quad.t1};
-    info.uvs[1] = {quad.s0, quad.t0};
-    info.uvs[2] = {quad.s1, quad.t0};
-    info.uvs[3] = {quad.s1, quad.t1};
-
-    return info;
+    key.assign(font_id);
+    key.push_back('\0');
+    key.append(text);
+
+    auto iter = runs.find(key);
+    if (iter == runs.end())
+    {
+        iter = runs.emplace(key, Entry{layout_glyph_run(char_info, text), frame}).first;
+    }
+    iter->second.last_used_frame = frame;
+    return iter->second.quads;
 }
 
 TextRenderer::TextRenderer(ResourceManager &resource_manager)
     : resource_manager(resource_manager) {}
 
-void TextRenderer::draw(const Text &text, const glm::mat4 &view)
-{
-    auto font = resource_manager.font_store.get(text.font);
-
-    vertex_array->bind();
+TextRenderer::~TextRenderer() {}
 
-    auto text_length = text.text.length();
-    std::vector<float> vertices;
-    vertices.reserve(text_length * 32);
-    std::vector<glm::vec2> positions;
-    positions.reserve(text_length * 4);
-    std::vector<glm::vec2> tex_coords;
-    tex_coords.reserve(text_length * 4);
-    std::vector<unsigned int> indices;
-    indices.reserve(text_length * 6);
+void TextRenderer::draw(const Text &text)
+{
+    const auto *font = resource_manager.font_store.get(text.font);
+    const auto &quads = glyph_runs.get(text.font, font->get_char_info(), text.text);
 
-    unsigned int last_index = 0;
-    float offset_x = 0;
-    float offset_y = 0;
+    auto batch = std::find_if(batches.begin(), batches.end(),
+                              [&](const FontBatch &batch) { return batch.font == font; });
+    if (batch == batches.end())
+    {
+        batches.push_back({font, {}});
+        batch = batches.end() - 1;
+    }
 
-    for (auto character : text.text)
+    // Glyphs are moved into world space here so every text in the batch can
+    // share a single draw call
+    const auto transform = text.transform.get();
+    auto &vertices = batch->vertices;
+    for (const auto &quad : quads)
     {
-        const auto glyph_info = get_glyph_info(font->get_char_info().data(), character, offset_x, offset_y);
-        offset_x = glyph_info.offset_x;
-        offset_y = glyph_info.offset_y;
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            const glm::vec4 position = transform * glm::vec4(quad.positions[i], 0.f, 1.f);
+            vertices.push_back({{position.x, position.y}, quad.uvs[i], text.color});
+        }
+    }
+}
 
-        positions.emplace_back(glyph_info.positions[0]);
-        positions.emplace_back(glyph_info.positions[1]);
-        positions.emplace_back(glyph_info.positions[2]);
-        positions.emplace_back(glyph_info.positions[3]);
-        tex_coords.emplace_back(glyph_info.uvs[0]);
-        tex_coords.emplace_back(glyph_info.uvs[1]);
-        tex_coords.emplace_back(glyph_info.uvs[2]);
-        tex_coords.emplace_back(glyph_info.uvs[3]);
-        indices.push_back(last_index);
-        indices.push_back(last_index + 1);
-        indices.push_back(last_index + 2);
-        indices.push_back(last_index);
-        indices.push_back(last_index + 2);
-        indices.push_back(last_index + 3);
+void TextRenderer::flush(const glm::mat4 &view)
+{
+    glyph_runs.end_frame();
 
-        last_index += 4;
+    std::size_t vertex_count = 0;
+    for (const auto &batch : batches)
+    {
+        vertex_count += batch.vertices.size();
     }
-
-    for (unsigned int i = 0; i < positions.size(); ++i)
+    if (vertex_count == 0)
     {
-        vertices.push_back(positions[i].x);
-        vertices.push_back(positions[i].y);
-        vertices.push_back(tex_coords[i].x);
-        vertices.push_back(tex_coords[i].y);
-        vertices.push_back(1);
-        vertices.push_back(1);
-        vertices.push_back(1);
-        vertices.push_back(1);
+        return;
     }
 
-    vertex_buffer->add_data(vertices.data(), sizeof(float) * vertices.size());
-    element_buffer->set_data(indices.data(), indices.size());
+    vertex_array->bind();
+    reserve_indices(vertex_count / 4);
+
+    vertex_buffer->add_data(nullptr, vertex_count * sizeof(TextVertex), GL_STREAM_DRAW);
+    std::size_t offset = 0;
+    for (const auto &batch : batches)
+    {
+        vertex_buffer->add_sub_data(batch.vertices.data(),
+                                    offset * sizeof(TextVertex),
+                                    batch.vertices.size() * sizeof(TextVertex));
+        offset += batch.vertices.size();
+    }
 
     auto shader = resource_manager.shader_store.get("font");
-    auto mvp = view * text.transform.get();
-    shader->set_uniform_mat4f("u_mvp", mvp);
-    shader->set_uniform_1i("u_texture", 0);
     shader->bind();
-    font->bind();
+    shader->set_uniform_mat4f("u_mvp", view);
+    shader->set_uniform_1i("u_texture", 0);
 
-    glDrawElements(GL_TRIANGLES, element_buffer->get_count(), GL_UNSIGNED_INT, 0);
+    // Quad indices are the same for every quad, so each batch just draws its
+    // own range of them
+    offset = 0;
+    for (auto &batch : batches)
+    {
+        if (!batch.vertices.empty())
+        {
+            batch.font->bind();
+            glDrawElements(GL_TRIANGLES,
+                           static_cast<GLsizei>(batch.vertices.size() / 4 * 6),
+                           GL_UNSIGNED_INT,
+                           reinterpret_cast<void *>(offset / 4 * 6 * sizeof(unsigned int)));
+            offset += batch.vertices.size();
+        }
+        batch.vertices.clear();
+    }
 }
 
 void TextRenderer::init()
@@ -136,4 +202,75 @@ void TextRenderer::init()
 
     resource_manager.load_shader("line", "shaders/line.vert", "shaders/default.frag");
 }
-}
\ No newline at end of file
+
+void TextRenderer::reserve_indices(std::size_t quad_count)
+{
+    const auto current_quads = element_buffer->get_count() / 6;
+    if (quad_count <= current_quads)
+    {
+        return;
+    }
+
+    const auto new_quads = std::max<std::size_t>(quad_count, current_quads * 2);
+    std::vector<unsigned int> indices;
+    indices.reserve(new_quads * 6);
+    for (unsigned int i = 0; i < new_quads * 4; i += 4)
+    {
+        indices.insert(indices.end(), {i, i + 1, i + 2, i, i + 2, i + 3});
+    }
+    element_buffer->set_data(indices.data(), indices.size());
+}
+
+TEST_CASE("GlyphRunCache")
+{
+    // Two characters, ' ' and '!', the second 10 pixels wide
+    std::vector<stbtt_packedchar> char_info(2);
+    char_info[0] = {0, 0, 0, 0, 0.f, 0.f, 5.f, 0.f, 0.f};
+    char_info[1] = {0, 0, 10, 20, 0.f, -20.f, 10.f, 10.f, 0.f};
+    GlyphRunCache cache(10);
+
+    SUBCASE("Characters are laid out left to right")
+    {
+        const auto quads = layout_glyph_run(char_info, " !!");
+
+        DOCTEST_CHECK(quads.size() == 3);
+        DOCTEST_CHECK(quads[1].positions[0].x == doctest::Approx(5.f));
+        DOCTEST_CHECK(quads[2].positions[0].x == doctest::Approx(15.f));
+        DOCTEST_CHECK(quads[2].positions[1].y == doctest::Approx(20.f));
+    }
+
+    SUBCASE("Characters the font doesn't have are skipped")
+    {
+        DOCTEST_CHECK(layout_glyph_run(char_info, "!\n~").size() == 1);
+    }
+
+    SUBCASE("The same string in the same font is only laid out once")
+    {
+        const auto &first = cache.get("font", char_info, "!!");
+        const auto &second = cache.get("font", char_info, "!!");
+
+        DOCTEST_CHECK(&first == &second);
+        DOCTEST_CHECK(cache.size() == 1);
+
+        cache.get("other_font", char_info, "!!");
+
+        DOCTEST_CHECK(cache.size() == 2);
+    }
+
+    SUBCASE("Unused runs are dropped")
+    {
+        cache.get("font", char_info, "!");
+        for (int i = 0; i < 5; ++i)
+        {
+            cache.end_frame();
+        }
+        cache.get("font", char_info, " ");
+        for (int i = 0; i < 5; ++i)
+        {
+            cache.end_frame();
+        }
+
+        DOCTEST_CHECK(cache.size() == 1);
+    }
+}
+}
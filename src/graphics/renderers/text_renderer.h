@@ -1,29 +1,96 @@
 #pragma once
 
+#include <array>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "third_party/stb_truetype.h"
 
 namespace ai
 {
 class VertexArray;
 class VertexBuffer;
 class ElementBuffer;
+class Font;
 class ResourceManager;
 struct Text;
 
+struct GlyphQuad
+{
+    std::array<glm::vec2, 4> positions;
+    std::array<glm::vec2, 4> uvs;
+};
+
+struct TextVertex
+{
+    glm::vec2 position;
+    glm::vec2 tex_coord;
+    glm::vec4 color;
+};
+
+// Lays text out in its own space, for a font packed from character 32 on
+std::vector<GlyphQuad> layout_glyph_run(const std::vector<stbtt_packedchar> &char_info,
+                                        const std::string &text);
+
+// Laid out glyph runs keyed by font and string, so text that doesn't change
+// isn't laid out again every frame. Runs that go unused for
+// max_unused_frames frames are dropped.
+class GlyphRunCache
+{
+  private:
+    struct Entry
+    {
+        std::vector<GlyphQuad> quads;
+        unsigned int last_used_frame;
+    };
+
+    unsigned int frame;
+    std::string key;
+    unsigned int max_unused_frames;
+    std::unordered_map<std::string, Entry> runs;
+
+  public:
+    GlyphRunCache(unsigned int max_unused_frames = 120);
+
+    void end_frame();
+    const std::vector<GlyphQuad> &get(const std::string &font_id,
+                                      const std::vector<stbtt_packedchar> &char_info,
+                                      const std::string &text);
+
+    inline std::size_t size() const { return runs.size(); }
+};
+
+// Collects a frame's text and draws it with one draw call per font
 class TextRenderer
 {
   private:
-    std::unique_ptr<VertexArray> vertex_array;
-    std::unique_ptr<VertexBuffer> vertex_buffer;
+    struct FontBatch
+    {
+        const Font *font;
+        std::vector<TextVertex> vertices;
+    };
+
+    std::vector<FontBatch> batches;
     std::unique_ptr<ElementBuffer> element_buffer;
+    GlyphRunCache glyph_runs;
     ResourceManager &resource_manager;
+    std::unique_ptr<VertexArray> vertex_array;
+    std::unique_ptr<VertexBuffer> vertex_buffer;
+
+    void reserve_indices(std::size_t quad_count);
 
   public:
     TextRenderer(ResourceManager &resource_manager);
+    ~TextRenderer();
 
-    void draw(const Text &text, const glm::mat4 &view);
+    void draw(const Text &text);
+    void flush(const glm::mat4 &view);
     void init();
 };
-}
\ No newline at end of file
+}
@@ -1,217 +1,113 @@
+#include <memory>
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
-#include <glm/gtc/constants.hpp>
-#include <nanovg.h>
-#define NANOVG_GL3_IMPLEMENTATION
-#include <nanovg_gl.h>
 
 #include "vector_renderer.h"
+#include "graphics/backend/shader.h"
+#include "graphics/backend/vertex_array.h"
+#include "graphics/backend/vertex_buffer.h"
+#include "graphics/backend/vertex_buffer_layout.h"
+#include "graphics/renderers/shape_tessellator.h"
 #include "graphics/render_data.h"
-
-NVGcolor glm_to_nvg(const glm::vec4 color)
-{
-    return nvgRGBAf(color.r, color.g, color.b, color.a);
-}
+#include "misc/resource_manager.h"
 
 namespace ai
 {
-VectorRenderer::VectorRenderer()
-    : vg(nullptr) {}
-
-VectorRenderer::~VectorRenderer()
-{
-    if (vg)
-    {
-        nvgDeleteGL3(vg);
-    }
-}
+VectorRenderer::VectorRenderer(ResourceManager &resource_manager)
+    : resource_manager(resource_manager),
+      resolution(1.f, 1.f),
+      view(1.f) {}
 
 void VectorRenderer::begin_frame(glm::vec2 resolution)
 {
     this->resolution = resolution;
-    nvgBeginFrame(vg, resolution.x, resolution.y, 1.f);
-    nvgLineJoin(vg, NVG_BEVEL);
+    update_fringe_width();
 }
 
 void VectorRenderer::draw(const Circle &circle)
 {
-    nvgSave(vg);
-
-    const auto position = circle.transform.get_position();
-    nvgTranslate(vg, position.x, position.y);
-
-    const auto origin = circle.transform.get_origin();
-    nvgTranslate(vg, -origin.x, -origin.y);
-
-    nvgBeginPath(vg);
-
-    nvgCircle(vg, 0, 0, circle.radius);
-
-    if (circle.fill_color.a != 0.f)
-    {
-        nvgFillColor(vg, glm_to_nvg(circle.fill_color));
-        nvgFill(vg);
-    }
-
-    if (circle.stroke_width != 0.f)
-    {
-        nvgStrokeWidth(vg, circle.stroke_width);
-        nvgStrokeColor(vg, glm_to_nvg(circle.stroke_color));
-        nvgStroke(vg);
-    }
-
-    nvgRestore(vg);
+    tessellator.add(circle);
 }
 
 void VectorRenderer::draw(const Line &line)
 {
-    nvgSave(vg);
-
-    const auto position = line.transform.get_position();
-    nvgTranslate(vg, position.x, position.y);
-
-    const auto origin = line.transform.get_origin();
-    nvgTranslate(vg, -origin.x, -origin.y);
-
-    const auto scale = line.transform.get_scale();
-
-    nvgBeginPath(vg);
-    nvgMoveTo(vg, line.start.x * scale.x, line.start.y * scale.y);
-    nvgLineTo(vg, line.end.x * scale.x, line.end.y * scale.y);
-
-    nvgStrokeWidth(vg, line.width);
-    nvgStrokeColor(vg, glm_to_nvg(line.color));
-    nvgStroke(vg);
-
-    nvgRestore(vg);
+    tessellator.add(line);
 }
 
 void VectorRenderer::draw(const Rectangle &rectangle)
 {
-    nvgSave(vg);
-
-    const auto position = rectangle.transform.get_position();
-    nvgTranslate(vg, position.x, position.y);
-
-    const auto rotation = rectangle.transform.get_rotation();
-    nvgRotate(vg, rotation);
-
-    const auto origin = rectangle.transform.get_origin();
-    nvgTranslate(vg, -origin.x, -origin.y);
-
-    nvgBeginPath(vg);
-
-    const auto size = rectangle.transform.get_scale();
-    nvgRect(vg, -size.x * 0.5f, -size.y * 0.5f, size.x, size.y);
-
-    if (rectangle.fill_color.a != 0.f)
-    {
-        nvgFillColor(vg, glm_to_nvg(rectangle.fill_color));
-        nvgFill(vg);
-    }
-
-    if (rectangle.stroke_width != 0.f)
-    {
-        nvgStrokeWidth(vg, rectangle.stroke_width);
-        nvgStrokeColor(vg, glm_to_nvg(rectangle.stroke_color));
-        nvgStroke(vg);
-    }
-
-    nvgRestore(vg);
+    tessellator.add(rectangle);
 }
 
 void VectorRenderer::draw(const SemiCircle &semicircle)
 {
-    nvgSave(vg);
-
-    const auto position = semicircle.transform.get_position();
-    nvgTranslate(vg, position.x, position.y);
-
-    const auto rotation = semicircle.transform.get_rotation();
-    nvgRotate(vg, rotation);
-
-    const auto origin = semicircle.transform.get_origin();
-    nvgTranslate(vg, -origin.x, -origin.y);
-
-    nvgBeginPath(vg);
+    tessellator.add(semicircle);
+}
 
-    nvgArc(vg, 0, 0, semicircle.radius, glm::pi<float>(), 0, NVG_CCW);
-    nvgClosePath(vg);
+void VectorRenderer::draw(const Trapezoid &trapezoid)
+{
+    tessellator.add(trapezoid);
+}
 
-    if (semicircle.fill_color.a != 0.f)
+bool VectorRenderer::draw(const RetainedShape &shape)
+{
+    if (shape.fringe_width != tessellator.get_fringe_width())
     {
-        nvgFillColor(vg, glm_to_nvg(semicircle.fill_color));
-        nvgFill(vg);
+        return false;
     }
+    tessellator.add(shape);
+    return true;
+}
 
-    if (semicircle.stroke_width != 0.f)
+void VectorRenderer::end_frame()
+{
+    const auto &vertices = tessellator.build();
+    if (!vertices.empty())
     {
-        nvgStrokeWidth(vg, semicircle.stroke_width);
-        nvgStrokeColor(vg, glm_to_nvg(semicircle.stroke_color));
-        nvgStroke(vg);
+        vertex_array->bind();
+        vertex_buffer->add_data(vertices.data(),
+                                sizeof(ShapeVertex) * vertices.size(),
+                                GL_DYNAMIC_DRAW);
+
+        auto shader = resource_manager.shader_store.get("vector");
+        shader->bind();
+        shader->set_uniform_mat4f("u_mvp", view);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDrawArrays(GL_TRIANGLES, 0, vertices.size());
     }
-
-    nvgRestore(vg);
+    tessellator.clear();
 }
 
-void VectorRenderer::draw(const Trapezoid &trapezoid)
+void VectorRenderer::init()
 {
-    nvgSave(vg);
-
-    const auto position = trapezoid.transform.get_position();
-    nvgTranslate(vg, position.x, position.y);
-
-    const auto rotation = trapezoid.transform.get_rotation();
-    nvgRotate(vg, rotation);
-
-    const auto origin = trapezoid.transform.get_origin();
-    nvgTranslate(vg, -origin.x, -origin.y);
-
-    nvgBeginPath(vg);
-
-    const auto size = trapezoid.transform.get_scale();
-    nvgMoveTo(vg, -trapezoid.top_width * 0.5f * size.x, size.y * 0.5f);
-    nvgLineTo(vg, trapezoid.top_width * 0.5f * size.x, size.y * 0.5f);
-    nvgLineTo(vg, trapezoid.bottom_width * 0.5f * size.x, -size.y * 0.5f);
-    nvgLineTo(vg, -trapezoid.bottom_width * 0.5f * size.x, -size.y * 0.5f);
-    nvgClosePath(vg);
-
-    if (trapezoid.fill_color.a != 0.f)
-    {
-        nvgFillColor(vg, glm_to_nvg(trapezoid.fill_color));
-        nvgFill(vg);
-    }
+    resource_manager.load_shader("vector", "shaders/default.vert", "shaders/default.frag");
 
-    if (trapezoid.stroke_width != 0.f)
-    {
-        nvgStrokeWidth(vg, trapezoid.stroke_width);
-        nvgStrokeColor(vg, glm_to_nvg(trapezoid.stroke_color));
-        nvgStroke(vg);
-    }
+    vertex_array = std::make_unique<VertexArray>();
+    vertex_buffer = std::make_unique<VertexBuffer>(nullptr, 0, GL_DYNAMIC_DRAW);
 
-    nvgRestore(vg);
+    VertexBufferLayout layout;
+    layout.push<float>(2);
+    layout.push<float>(4);
+    vertex_array->add_buffer(*vertex_buffer, layout);
 }
 
-void VectorRenderer::end_frame()
+void VectorRenderer::retain_last(RetainedShape &shape) const
 {
-    nvgEndFrame(vg);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_SCISSOR_TEST);
+    tessellator.retain_last(shape);
 }
 
-void VectorRenderer::init()
+void VectorRenderer::set_view(const glm::mat4 &view)
 {
-    vg = nvgCreateGL3(NVG_ANTIALIAS | NVG_STENCIL_STROKES | NVG_DEBUG);
+    this->view = view;
+    update_fringe_width();
 }
 
-void VectorRenderer::set_view(const glm::mat4 &view)
+void VectorRenderer::update_fringe_width()
 {
-    nvgResetTransform(vg);
-    nvgTransform(vg, 1, 0, 0, -1, 0, resolution.y);
-    nvgScale(vg, view[0][0], view[1][1]);
-    nvgScale(vg, resolution.x * 0.5f, resolution.y * 0.5f);
-    nvgTranslate(vg, 1.f / view[0][0], 1.f / view[1][1]);
-    nvgTranslate(vg, view[3][0] / view[0][0], view[3][1] / view[1][1]);
+    // One pixel, in world units
+    tessellator.set_fringe_width(2.f / (view[0][0] * resolution.x));
 }
 }
@@ -1,23 +1,35 @@
 #pragma once
 
+#include <memory>
+
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 
+#include "graphics/backend/vertex_array.h"
+#include "graphics/backend/vertex_buffer.h"
+#include "graphics/renderers/shape_tessellator.h"
 #include "graphics/render_data.h"
 
-class NVGcontext;
-
 namespace ai
 {
+class ResourceManager;
+
+// Draws all of a frame's vector shapes in a single draw call, tessellating
+// them on the CPU with a ShapeTessellator
 class VectorRenderer
 {
   private:
-    NVGcontext *vg;
+    ResourceManager &resource_manager;
     glm::vec2 resolution;
+    ShapeTessellator tessellator;
+    std::unique_ptr<VertexArray> vertex_array;
+    std::unique_ptr<VertexBuffer> vertex_buffer;
+    glm::mat4 view;
+
+    void update_fringe_width();
 
   public:
-    VectorRenderer();
-    ~VectorRenderer();
+    VectorRenderer(ResourceManager &resource_manager);
 
     void begin_frame(glm::vec2 resolution);
     void draw(const Circle &circle);
@@ -25,8 +37,10 @@ class VectorRenderer
     void draw(const Rectangle &rectangle);
     void draw(const SemiCircle &semicircle);
     void draw(const Trapezoid &trapezoid);
+    bool draw(const RetainedShape &shape);
     void end_frame();
     void init();
+    void retain_last(RetainedShape &shape) const;
     void set_view(const glm::mat4 &view);
 };
-}
\ No newline at end of file
+}
@@ -38,6 +38,7 @@ GridTestScreen::GridTestScreen(
       screen_manager(screen_manager),
       projection(glm::ortho(0.f, 1920.f, 0.f, 1080.f)),
       spring_mesh(width, height),
+      vertices(spring_mesh.get_vertex_count()),
       sprite_renderer(resource_manager)
 {
     this->resource_manager = &resource_manager;
@@ -64,10 +65,8 @@ void GridTestScreen::update(double delta_time)
 void GridTestScreen::draw(Renderer &renderer, bool /*lightweight*/)
 {
     renderer.set_view(projection);
-    std::vector<glm::mat4> transforms;
-    transforms.reserve(width * height);
 
-    auto vertices = spring_mesh.get_vertices(1920, 1080);
+    spring_mesh.get_vertices(1920, 1080, vertices.data());
 
     for (const auto &vertex : vertices)
     {
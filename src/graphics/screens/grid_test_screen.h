@@ -28,6 +28,7 @@ class GridTestScreen : public IScreen
     glm::mat4 projection;
 
     SpringMesh spring_mesh;
+    std::vector<glm::vec2> vertices;
 
     BatchedSpriteRenderer sprite_renderer;
 
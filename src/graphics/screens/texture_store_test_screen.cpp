@@ -32,8 +32,8 @@ TextureStoreTestScreen::TextureStoreTestScreen(ModuleTextureStore &module_textur
       projection(glm::ortho(-19.2f, 19.2f, -10.8f, 10.8f)),
       module_texture_store(module_texture_store)
 {
-    auto &texture = module_texture_store.get("base_module");
-    resource_manager.texture_store.add_raw("base_tex", &texture);
+    const auto &region = module_texture_store.get("base_module");
+    resource_manager.texture_atlas.add_region("base_tex", region);
 }
 
 void TextureStoreTestScreen::update(double delta_time)
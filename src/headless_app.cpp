@@ -9,6 +9,8 @@
 #include <spdlog/spdlog.h>
 
 #include "headless_app.h"
+#include "misc/metrics.h"
+#include "misc/metrics_exporter.h"
 #include "training/trainer.h"
 
 namespace ai
@@ -43,6 +45,9 @@ int HeadlessApp::run(int argc, char *argv[])
     TrainingProgram program(json);
     auto trainer = trainer_factory.make(program);
 
+    MetricsExporter metrics_exporter(get_metrics());
+    start_metrics_exporter(metrics_exporter, args);
+
     auto last_evaluation_time = std::chrono::high_resolution_clock::now();
     while (!stop)
     {
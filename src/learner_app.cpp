@@ -0,0 +1,116 @@
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <signal.h>
+#include <stdlib.h>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "learner_app.h"
+#include "misc/metrics.h"
+#include "misc/metrics_exporter.h"
+#include "third_party/zmq.hpp"
+#include "training/distributed/learner.h"
+#include "training/trainer.h"
+
+namespace
+{
+volatile sig_atomic_t stop;
+
+void inthand(int /*signum*/)
+{
+    stop = 1;
+}
+}
+
+namespace ai
+{
+LearnerApp::LearnerApp(TrainerFactory &trainer_factory)
+    : trainer_factory(trainer_factory)
+{
+    // Logging
+    spdlog::set_level(spdlog::level::debug);
+    spdlog::set_pattern("%^[%T %7l] %v%$");
+
+    signal(SIGINT, inthand);
+}
+
+int LearnerApp::run(int argc, char *argv[])
+{
+    argh::parser args(argv);
+    if (args[{"-t", "--test"}])
+    {
+        return run_tests(argc, argv, args);
+    }
+
+    int rollout_port;
+    args({"--rollout-port"}, 7300) >> rollout_port;
+    int policy_port;
+    args({"--policy-port"}, 7301) >> policy_port;
+    unsigned long long max_policy_lag;
+    args({"--max-lag"}, 4) >> max_policy_lag;
+
+    std::ifstream file(args[1]);
+    auto json = nlohmann::json::parse(file);
+    TrainingProgram program(json);
+    auto trainer = trainer_factory.make_learner(program);
+
+    MetricsExporter metrics_exporter(get_metrics());
+    start_metrics_exporter(metrics_exporter, args);
+
+    zmq::context_t zmq_context;
+    auto rollout_socket = std::make_unique<zmq::socket_t>(zmq_context, zmq::socket_type::pull);
+    rollout_socket->setsockopt(ZMQ_LINGER, 0);
+    rollout_socket->bind(fmt::format("tcp://*:{}", rollout_port));
+    auto policy_socket = std::make_unique<zmq::socket_t>(zmq_context, zmq::socket_type::pub);
+    policy_socket->setsockopt(ZMQ_LINGER, 0);
+    policy_socket->bind(fmt::format("tcp://*:{}", policy_port));
+
+    spdlog::info("Waiting for rollouts on port {}, publishing policies on port {}",
+                 rollout_port,
+                 policy_port);
+    Learner learner(*trainer, std::move(rollout_socket), std::move(policy_socket), max_policy_lag);
+
+    auto last_evaluation_time = std::chrono::steady_clock::now();
+    while (!stop)
+    {
+        const auto metrics = learner.update(std::chrono::milliseconds(100));
+        for (const auto &metric : metrics)
+        {
+            if (metric.name.find("Policy Lag") != std::string::npos ||
+                metric.name == "Dropped Rollouts")
+            {
+                spdlog::info("{}: {}", metric.name, metric.value);
+            }
+        }
+        if (!metrics.empty() &&
+            std::chrono::steady_clock::now() - last_evaluation_time > std::chrono::minutes(1))
+        {
+            trainer->evaluate();
+            last_evaluation_time = std::chrono::steady_clock::now();
+        }
+    }
+    trainer->save_model();
+
+    return 0;
+}
+
+int LearnerApp::run_tests(int argc, char *argv[], const argh::parser &args)
+{
+    if (!args["--with-logs"])
+    {
+        spdlog::set_level(spdlog::level::off);
+    }
+    doctest::Context context;
+
+    context.setOption("order-by", "name");
+
+    context.applyCommandLine(argc, argv);
+
+    return context.run();
+}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <argh.h>
+
+namespace ai
+{
+class TrainerFactory;
+
+class LearnerApp
+{
+  private:
+    TrainerFactory &trainer_factory;
+
+    int run_tests(int argc, char *argv[], const argh::parser &args);
+
+  public:
+    LearnerApp(TrainerFactory &trainer_factory);
+
+    int run(int argc, char *argv[]);
+};
+}
@@ -0,0 +1,22 @@
+#include <chrono>
+#include <string>
+
+#include "loadgen_app.h"
+#include "misc/random.h"
+#include "third_party/di.hpp"
+#include "training/checkpointer.h"
+#include "training/saver.h"
+
+using namespace ai;
+
+namespace di = boost::di;
+
+int main(int argc, char *argv[])
+{
+    const auto injector = di::make_injector(
+        di::bind<int>.named(RandomSeed).to(static_cast<int>(std::chrono::high_resolution_clock::now().time_since_epoch().count())),
+        di::bind<ISaver>.to<Saver>(),
+        di::bind<std::string>.named(CheckpointDirectory).to("checkpoints"));
+    auto app = injector.create<LoadgenApp>();
+    return app.run(argc, argv);
+}
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <stdlib.h>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "loadgen_app.h"
+#include "environment/serialization/serialize_body.h"
+#include "misc/random.h"
+#include "networking/client_communicator.h"
+#include "networking/simulated_client.h"
+#include "third_party/zmq.hpp"
+#include "training/agents/iagent.h"
+#include "training/agents/nn_agent.h"
+#include "training/agents/random_agent.h"
+#include "training/checkpointer.h"
+
+namespace
+{
+volatile sig_atomic_t stop;
+
+void inthand(int /*signum*/)
+{
+    stop = 1;
+}
+
+double now()
+{
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(time).count();
+}
+}
+
+namespace ai
+{
+struct MatchReport
+{
+    int match;
+    std::vector<ClientStats> clients;
+};
+
+static void log_report(const MatchReport &report)
+{
+    std::vector<double> round_trip_times;
+    std::vector<int> tick_lags;
+    std::size_t bytes_received = 0;
+    std::size_t bytes_sent = 0;
+    double duration = 0;
+    int ticks = 0;
+    for (const auto &stats : report.clients)
+    {
+        round_trip_times.insert(round_trip_times.end(),
+                                stats.round_trip_times.begin(),
+                                stats.round_trip_times.end());
+        tick_lags.insert(tick_lags.end(), stats.tick_lags.begin(), stats.tick_lags.end());
+        bytes_received += stats.bytes_received;
+        bytes_sent += stats.bytes_sent;
+        duration = std::max(duration, stats.finish_time - stats.start_time);
+        ticks = std::max(ticks, stats.last_tick);
+    }
+
+    const double mean_round_trip_time =
+        round_trip_times.empty()
+            ? 0
+            : std::accumulate(round_trip_times.begin(), round_trip_times.end(), 0.) /
+                  static_cast<double>(round_trip_times.size());
+    const double mean_tick_lag =
+        tick_lags.empty()
+            ? 0
+            : std::accumulate(tick_lags.begin(), tick_lags.end(), 0.) /
+                  static_cast<double>(tick_lags.size());
+    const int max_tick_lag = tick_lags.empty()
+                                 ? 0
+                                 : *std::max_element(tick_lags.begin(), tick_lags.end());
+    const double seconds = std::max(duration, 1e-9);
+
+    spdlog::info("Match {}: {} ticks in {:.1f}s - RTT mean/p50/p99: {:.1f}/{:.1f}/{:.1f}ms - "
+                 "Tick lag mean/max: {:.2f}/{} - Down: {:.1f}KB/s - Up: {:.1f}KB/s",
+                 report.match,
+                 ticks,
+                 duration,
+                 mean_round_trip_time * 1000,
+                 percentile(round_trip_times, 0.5) * 1000,
+                 percentile(round_trip_times, 0.99) * 1000,
+                 mean_tick_lag,
+                 max_tick_lag,
+                 static_cast<double>(bytes_received) / seconds / 1024,
+                 static_cast<double>(bytes_sent) / seconds / 1024);
+}
+
+LoadgenApp::LoadgenApp(Checkpointer &checkpointer, Random &rng)
+    : checkpointer(checkpointer),
+      rng(rng)
+{
+    // Logging
+    spdlog::set_level(spdlog::level::info);
+    spdlog::set_pattern("%^[%T %7l] %v%$");
+
+    signal(SIGINT, inthand);
+}
+
+int LoadgenApp::run(int argc, char *argv[])
+{
+    argh::parser args(argv);
+    if (args[{"-t", "--test"}])
+    {
+        return run_tests(argc, argv, args);
+    }
+
+    std::string address;
+    args({"-a", "--address"}, "tcp://localhost") >> address;
+    int base_port;
+    args({"-p", "--port"}, 7654) >> base_port;
+    int matches;
+    args({"-m", "--matches"}, 1) >> matches;
+    int thread_count;
+    args({"-j", "--threads"}, std::max(1u, std::thread::hardware_concurrency())) >> thread_count;
+    thread_count = std::max(1, std::min(thread_count, matches));
+    double timeout;
+    args({"--timeout"}, 600.) >> timeout;
+    std::string checkpoint_path;
+    args({"-c", "--checkpoint"}, "") >> checkpoint_path;
+
+    // Frozen agent shared by every simulated client, or random agents if no checkpoint is given
+    std::unique_ptr<IAgent> prototype_agent;
+    if (!checkpoint_path.empty())
+    {
+        auto checkpoint = checkpointer.load(checkpoint_path);
+        prototype_agent = std::make_unique<NNAgent>(checkpoint.policy,
+                                                    checkpoint.data.body_spec,
+                                                    "Loadgen");
+    }
+
+    spdlog::info("Driving {} matches ({} clients) on {}:{}-{} with {} threads",
+                 matches,
+                 matches * 2,
+                 address,
+                 base_port,
+                 base_port + matches - 1,
+                 thread_count);
+
+    zmq::context_t zmq_context;
+    std::mutex reports_mutex;
+    std::vector<MatchReport> reports;
+
+    std::vector<int> seeds;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        seeds.push_back(rng.next_int(0, 1000000));
+    }
+
+    auto worker = [&](int worker_index) {
+        Random worker_rng(seeds[worker_index]);
+        std::vector<int> worker_matches;
+        std::vector<std::unique_ptr<SimulatedClient>> clients;
+        const double start_time = now();
+
+        for (int match = worker_index; match < matches; match += thread_count)
+        {
+            worker_matches.push_back(match);
+            for (int player = 0; player < 2; ++player)
+            {
+                auto socket = std::make_unique<zmq::socket_t>(zmq_context,
+                                                              zmq::socket_type::dealer);
+                socket->setsockopt(ZMQ_LINGER, 0);
+                const auto id = fmt::format("loadgen-{}-{}", match, player);
+                socket->setsockopt(ZMQ_IDENTITY, id.c_str(), id.size());
+                socket->connect(fmt::format("{}:{}", address, base_port + match));
+
+                std::unique_ptr<IAgent> agent;
+                if (prototype_agent != nullptr)
+                {
+                    agent = prototype_agent->clone();
+                }
+                else
+                {
+                    agent = std::make_unique<RandomAgent>(default_body(),
+                                                          worker_rng,
+                                                          "Loadgen");
+                }
+
+                clients.push_back(std::make_unique<SimulatedClient>(
+                    std::move(agent),
+                    std::make_unique<ClientCommunicator>(std::move(socket))));
+                clients.back()->connect(now());
+            }
+        }
+
+        while (!stop)
+        {
+            bool all_finished = true;
+            bool received = false;
+            for (auto &client : clients)
+            {
+                received |= client->update(now());
+                all_finished &= client->is_finished();
+            }
+            if (all_finished)
+            {
+                break;
+            }
+            if (now() - start_time > timeout)
+            {
+                spdlog::warn("Worker {} timed out", worker_index);
+                break;
+            }
+            if (!received)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        }
+
+        std::lock_guard lock_guard(reports_mutex);
+        for (unsigned int i = 0; i < worker_matches.size(); ++i)
+        {
+            reports.push_back({worker_matches[i],
+                               {clients[i * 2]->get_stats(), clients[i * 2 + 1]->get_stats()}});
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        threads.emplace_back(worker, i);
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::sort(reports.begin(), reports.end(), [](const auto &a, const auto &b) {
+        return a.match < b.match;
+    });
+    for (const auto &report : reports)
+    {
+        log_report(report);
+    }
+
+    return 0;
+}
+
+int LoadgenApp::run_tests(int argc, char *argv[], const argh::parser &args)
+{
+    if (!args["--with-logs"])
+    {
+        spdlog::set_level(spdlog::level::off);
+    }
+    doctest::Context context;
+
+    context.setOption("order-by", "name");
+
+    context.applyCommandLine(argc, argv);
+
+    return context.run();
+}
+}
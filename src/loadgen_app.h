@@ -0,0 +1,23 @@
+#pragma once
+
+#include <argh.h>
+
+namespace ai
+{
+class Checkpointer;
+class Random;
+
+class LoadgenApp
+{
+  private:
+    Checkpointer &checkpointer;
+    Random &rng;
+
+    int run_tests(int argc, char *argv[], const argh::parser &args);
+
+  public:
+    LoadgenApp(Checkpointer &checkpointer, Random &rng);
+
+    int run(int argc, char *argv[]);
+};
+}
@@ -0,0 +1,206 @@
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <doctest.h>
+#include <fmt/format.h>
+
+#include "misc/mapped_file.h"
+
+namespace fs = std::filesystem;
+
+namespace ai
+{
+#ifdef _WIN32
+MappedFile::MappedFile(const fs::path &path)
+    : data(nullptr),
+      file_handle(INVALID_HANDLE_VALUE),
+      mapping_handle(nullptr),
+      size(0)
+{
+    file_handle = CreateFileW(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error(fmt::format("Couldn't open {}", path.string()));
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    size = static_cast<std::size_t>(file_size.QuadPart);
+    if (size == 0)
+    {
+        return;
+    }
+
+    mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *view = mapping_handle == nullptr
+                           ? nullptr
+                           : MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        close();
+        throw std::runtime_error(fmt::format("Couldn't map {}", path.string()));
+    }
+    data = static_cast<const std::byte *>(view);
+}
+
+void MappedFile::close()
+{
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle != nullptr)
+    {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file_handle);
+    }
+    data = nullptr;
+    mapping_handle = nullptr;
+    file_handle = INVALID_HANDLE_VALUE;
+    size = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data(std::exchange(other.data, nullptr)),
+      file_handle(std::exchange(other.file_handle, INVALID_HANDLE_VALUE)),
+      mapping_handle(std::exchange(other.mapping_handle, nullptr)),
+      size(std::exchange(other.size, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        data = std::exchange(other.data, nullptr);
+        file_handle = std::exchange(other.file_handle, INVALID_HANDLE_VALUE);
+        mapping_handle = std::exchange(other.mapping_handle, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+#else
+MappedFile::MappedFile(const fs::path &path)
+    : data(nullptr),
+      file_descriptor(-1),
+      size(0)
+{
+    file_descriptor = open(path.c_str(), O_RDONLY);
+    if (file_descriptor == -1)
+    {
+        throw std::runtime_error(fmt::format("Couldn't open {}", path.string()));
+    }
+    struct stat file_stats;
+    if (fstat(file_descriptor, &file_stats) == -1)
+    {
+        close();
+        throw std::runtime_error(fmt::format("Couldn't read the size of {}", path.string()));
+    }
+    size = static_cast<std::size_t>(file_stats.st_size);
+    if (size == 0)
+    {
+        return;
+    }
+
+    void *view = mmap(nullptr, size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+    if (view == MAP_FAILED)
+    {
+        close();
+        throw std::runtime_error(fmt::format("Couldn't map {}", path.string()));
+    }
+    data = static_cast<const std::byte *>(view);
+}
+
+void MappedFile::close()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<std::byte *>(data), size);
+    }
+    if (file_descriptor != -1)
+    {
+        ::close(file_descriptor);
+    }
+    data = nullptr;
+    file_descriptor = -1;
+    size = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data(std::exchange(other.data, nullptr)),
+      file_descriptor(std::exchange(other.file_descriptor, -1)),
+      size(std::exchange(other.size, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        data = std::exchange(other.data, nullptr);
+        file_descriptor = std::exchange(other.file_descriptor, -1);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+TEST_CASE("MappedFile")
+{
+    const auto path = fs::temp_directory_path() / "mapped_file_test.bin";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "Some bytes";
+    }
+
+    SUBCASE("Maps the whole file")
+    {
+        MappedFile mapped_file(path);
+
+        DOCTEST_REQUIRE(mapped_file.get_size() == 10);
+        DOCTEST_CHECK(std::string(reinterpret_cast<const char *>(mapped_file.get_data()), 10) ==
+                      "Some bytes");
+    }
+
+    SUBCASE("Moving hands the mapping over")
+    {
+        MappedFile mapped_file(path);
+        const auto *data = mapped_file.get_data();
+        MappedFile moved_file(std::move(mapped_file));
+
+        DOCTEST_CHECK(moved_file.get_data() == data);
+        DOCTEST_CHECK(mapped_file.get_data() == nullptr);
+        DOCTEST_CHECK(mapped_file.get_size() == 0);
+    }
+
+    SUBCASE("Missing files throw")
+    {
+        DOCTEST_CHECK_THROWS_AS(MappedFile(path.string() + ".missing"), std::runtime_error);
+    }
+
+    fs::remove(path);
+}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace ai
+{
+// A whole file mapped read-only into memory. Pages are only read from disk
+// when touched, and are shared between every process mapping the same file.
+class MappedFile
+{
+  private:
+    const std::byte *data;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#else
+    int file_descriptor;
+#endif
+    std::size_t size;
+
+    void close();
+
+  public:
+    // Throws std::runtime_error if the file can't be opened or mapped
+    explicit MappedFile(const std::filesystem::path &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    inline const std::byte *get_data() const { return data; }
+    inline std::size_t get_size() const { return size; }
+};
+}
@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <doctest.h>
+#include <fmt/format.h>
+
+#include "misc/metrics.h"
+
+namespace ai
+{
+namespace
+{
+bool is_valid_name(const std::string &name)
+{
+    const auto is_start = [](char character) {
+        return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') ||
+               character == '_' || character == ':';
+    };
+    return !name.empty() && is_start(name[0]) &&
+           std::all_of(name.begin() + 1, name.end(), [&](char character) {
+               return is_start(character) || (character >= '0' && character <= '9');
+           });
+}
+
+std::string escape_help(const std::string &help)
+{
+    std::string escaped;
+    for (const auto character : help)
+    {
+        if (character == '\\')
+        {
+            escaped += "\\\\";
+        }
+        else if (character == '\n')
+        {
+            escaped += "\\n";
+        }
+        else
+        {
+            escaped += character;
+        }
+    }
+    return escaped;
+}
+
+int get_magnitude(std::uint64_t value)
+{
+    int magnitude = 0;
+    while (value >>= 1)
+    {
+        ++magnitude;
+    }
+    return magnitude;
+}
+}
+
+void Gauge::add(double amount)
+{
+    auto current = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(current, current + amount, std::memory_order_relaxed))
+    {
+    }
+}
+
+Histogram::Histogram(double scale) : count(0), scale(scale), sum(0)
+{
+    for (auto &bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::size_t Histogram::get_bucket(std::uint64_t value)
+{
+    const std::uint64_t sub_bucket_count = 1 << sub_bucket_bits;
+    if (value < sub_bucket_count)
+    {
+        return value;
+    }
+    const auto magnitude = get_magnitude(value);
+    if (magnitude > max_magnitude)
+    {
+        return bucket_count - 1;
+    }
+    const auto shift = magnitude - sub_bucket_bits;
+    const auto sub_bucket = (value >> shift) & (sub_bucket_count - 1);
+    return ((shift + 1) << sub_bucket_bits) + sub_bucket;
+}
+
+std::uint64_t Histogram::get_bucket_limit(std::size_t bucket)
+{
+    const std::uint64_t sub_bucket_count = 1 << sub_bucket_bits;
+    if (bucket < sub_bucket_count)
+    {
+        return bucket;
+    }
+    const auto shift = static_cast<int>(bucket >> sub_bucket_bits) - 1;
+    const auto sub_bucket = bucket & (sub_bucket_count - 1);
+    return ((sub_bucket_count + sub_bucket + 1) << shift) - 1;
+}
+
+double Histogram::get_quantile(double quantile) const
+{
+    const auto total = get_count();
+    if (total == 0)
+    {
+        return 0;
+    }
+    const auto target = static_cast<std::uint64_t>(
+        std::ceil(std::clamp(quantile, 0., 1.) * static_cast<double>(total)));
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < bucket_count; ++bucket)
+    {
+        seen += get_bucket_count(bucket);
+        if (seen >= std::max<std::uint64_t>(target, 1))
+        {
+            return static_cast<double>(get_bucket_limit(bucket)) * scale;
+        }
+    }
+    return static_cast<double>(get_bucket_limit(bucket_count - 1)) * scale;
+}
+
+void Histogram::record(std::uint64_t value)
+{
+    buckets[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+ScopedTimer::ScopedTimer(Histogram &histogram)
+    : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+ScopedTimer::~ScopedTimer()
+{
+    const auto duration = std::chrono::steady_clock::now() - start;
+    histogram.record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+}
+
+MetricsRegistry::Metric &MetricsRegistry::get_metric(const std::string &name,
+                                                     const std::string &help)
+{
+    if (!is_valid_name(name))
+    {
+        throw std::invalid_argument(fmt::format("Invalid metric name: {}", name));
+    }
+    auto &metric = metrics[name];
+    if (metric.help.empty())
+    {
+        metric.help = help;
+    }
+    return metric;
+}
+
+Counter &MetricsRegistry::counter(const std::string &name, const std::string &help)
+{
+    std::lock_guard lock(mutex);
+    auto &metric = get_metric(name, help);
+    if (metric.gauge != nullptr || metric.histogram != nullptr)
+    {
+        throw std::invalid_argument(fmt::format("{} isn't a counter", name));
+    }
+    if (metric.counter == nullptr)
+    {
+        metric.counter = std::make_unique<Counter>();
+    }
+    return *metric.counter;
+}
+
+Gauge &MetricsRegistry::gauge(const std::string &name, const std::string &help)
+{
+    std::lock_guard lock(mutex);
+    auto &metric = get_metric(name, help);
+    if (metric.counter != nullptr || metric.histogram != nullptr)
+    {
+        throw std::invalid_argument(fmt::format("{} isn't a gauge", name));
+    }
+    if (metric.gauge == nullptr)
+    {
+        metric.gauge = std::make_unique<Gauge>();
+    }
+    return *metric.gauge;
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name,
+                                      const std::string &help,
+                                      double scale)
+{
+    std::lock_guard lock(mutex);
+    auto &metric = get_metric(name, help);
+    if (metric.counter != nullptr || metric.gauge != nullptr)
+    {
+        throw std::invalid_argument(fmt::format("{} isn't a histogram", name));
+    }
+    if (metric.histogram == nullptr)
+    {
+        metric.histogram = std::make_unique<Histogram>(scale);
+    }
+    return *metric.histogram;
+}
+
+std::string MetricsRegistry::to_prometheus() const
+{
+    std::string text;
+    std::lock_guard lock(mutex);
+    for (const auto &[name, metric] : metrics)
+    {
+        if (!metric.help.empty())
+        {
+            text += fmt::format("# HELP {} {}\n", name, escape_help(metric.help));
+        }
+        if (metric.counter != nullptr)
+        {
+            text += fmt::format("# TYPE {} counter\n{} {}\n", name, name, metric.counter->get());
+        }
+        else if (metric.gauge != nullptr)
+        {
+            text += fmt::format("# TYPE {} gauge\n{} {}\n", name, name, metric.gauge->get());
+        }
+        else if (metric.histogram != nullptr)
+        {
+            // One bucket per power of two keeps scrapes small, the finer
+            // buckets are only for quantiles
+            const auto &histogram = *metric.histogram;
+            text += fmt::format("# TYPE {} histogram\n", name);
+            std::uint64_t cumulative = 0;
+            const std::size_t step = 1 << Histogram::sub_bucket_bits;
+            for (std::size_t bucket = 0; bucket < Histogram::bucket_count; ++bucket)
+            {
+                cumulative += histogram.get_bucket_count(bucket);
+                if (bucket % step == step - 1 && bucket != Histogram::bucket_count - 1)
+                {
+                    const auto limit = static_cast<double>(Histogram::get_bucket_limit(bucket));
+                    text += fmt::format("{}_bucket{{le=\"{:g}\"}} {}\n",
+                                        name,
+                                        limit * histogram.get_scale(),
+                                        cumulative);
+                }
+            }
+            text += fmt::format("{}_bucket{{le=\"+Inf\"}} {}\n", name, cumulative);
+            text += fmt::format("{}_sum {}\n", name, histogram.get_sum());
+            text += fmt::format("{}_count {}\n", name, cumulative);
+        }
+    }
+    return text;
+}
+
+MetricsRegistry &get_metrics()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+TEST_CASE("MetricsRegistry")
+{
+    MetricsRegistry registry;
+
+    SUBCASE("Looking a name up again returns the same metric")
+    {
+        auto &counter = registry.counter("steps_total");
+        counter.increment(3);
+
+        DOCTEST_CHECK(&registry.counter("steps_total") == &counter);
+        DOCTEST_CHECK(registry.counter("steps_total").get() == 3);
+    }
+
+    SUBCASE("Names are checked")
+    {
+        DOCTEST_CHECK_THROWS(registry.counter("2fast"));
+        DOCTEST_CHECK_THROWS(registry.gauge("has space"));
+
+        registry.counter("taken");
+
+        DOCTEST_CHECK_THROWS(registry.gauge("taken"));
+    }
+
+    SUBCASE("Updates from many threads all count")
+    {
+        auto &counter = registry.counter("count");
+        auto &gauge = registry.gauge("gauge");
+        auto &histogram = registry.histogram("histogram");
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&] {
+                for (int j = 0; j < 1000; ++j)
+                {
+                    counter.increment();
+                    gauge.add(0.5);
+                    histogram.record(static_cast<std::uint64_t>(j));
+                }
+            });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+
+        DOCTEST_CHECK(counter.get() == 4000);
+        DOCTEST_CHECK(gauge.get() == doctest::Approx(2000.));
+        DOCTEST_CHECK(histogram.get_count() == 4000);
+    }
+
+    SUBCASE("Histogram buckets are within an eighth of their values")
+    {
+        for (const std::uint64_t value :
+             {0ull, 7ull, 8ull, 9ull, 100ull, 12345ull, 1ull << 39, (1ull << 41) - 1})
+        {
+            const auto bucket = Histogram::get_bucket(value);
+            const auto limit = Histogram::get_bucket_limit(bucket);
+
+            DOCTEST_CHECK(limit >= value);
+            DOCTEST_CHECK(static_cast<double>(limit) <= static_cast<double>(value) * 1.125 + 1);
+            DOCTEST_CHECK(bucket < Histogram::bucket_count);
+            if (bucket > 0)
+            {
+                DOCTEST_CHECK(Histogram::get_bucket_limit(bucket - 1) < value);
+            }
+        }
+    }
+
+    SUBCASE("Huge values go in the last bucket")
+    {
+        DOCTEST_CHECK(Histogram::get_bucket(1ull << 41) == Histogram::bucket_count - 1);
+        DOCTEST_CHECK(Histogram::get_bucket(~0ull) == Histogram::bucket_count - 1);
+    }
+
+    SUBCASE("Histogram quantiles")
+    {
+        Histogram histogram;
+        for (std::uint64_t value = 1; value <= 100; ++value)
+        {
+            histogram.record(value);
+        }
+
+        DOCTEST_CHECK(histogram.get_quantile(0.5) == doctest::Approx(50.).epsilon(0.125));
+        DOCTEST_CHECK(histogram.get_quantile(0.99) == doctest::Approx(99.).epsilon(0.125));
+        DOCTEST_CHECK(histogram.get_sum() == doctest::Approx(5050.));
+    }
+
+    SUBCASE("Exports the Prometheus text format")
+    {
+        registry.counter("requests_total", "Requests served").increment(2);
+        registry.gauge("temperature").set(1.5);
+        registry.histogram("latency_seconds").record(3);
+        const auto text = registry.to_prometheus();
+
+        DOCTEST_CHECK(text.find("# HELP requests_total Requests served\n") != std::string::npos);
+        DOCTEST_CHECK(text.find("# TYPE requests_total counter\nrequests_total 2\n") !=
+                      std::string::npos);
+        DOCTEST_CHECK(text.find("temperature 1.5\n") != std::string::npos);
+        DOCTEST_CHECK(text.find("latency_seconds_bucket{le=\"+Inf\"} 1\n") != std::string::npos);
+        DOCTEST_CHECK(text.find("latency_seconds_count 1\n") != std::string::npos);
+    }
+}
+}
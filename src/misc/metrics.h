@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ai
+{
+// A count that only goes up
+class Counter
+{
+  private:
+    std::atomic<std::uint64_t> value;
+
+  public:
+    Counter() : value(0) {}
+
+    inline void increment(std::uint64_t amount = 1)
+    {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+    inline std::uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// A value that can go up and down
+class Gauge
+{
+  private:
+    std::atomic<double> value;
+
+  public:
+    Gauge() : value(0) {}
+
+    void add(double amount);
+    inline double get() const { return value.load(std::memory_order_relaxed); }
+    inline void set(double value) { this->value.store(value, std::memory_order_relaxed); }
+};
+
+// Counts of non-negative integer values in log-linear buckets, in the style
+// of an HDR histogram: eight buckets per power of two, so any value is off
+// by at most 12.5% once bucketed. Values of 2^41 and up go in the last
+// bucket.
+class Histogram
+{
+  public:
+    static constexpr int sub_bucket_bits = 3;
+    static constexpr int max_magnitude = 40;
+    static constexpr std::size_t bucket_count =
+        (max_magnitude - sub_bucket_bits + 2) << sub_bucket_bits;
+
+  private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets;
+    std::atomic<std::uint64_t> count;
+    double scale;
+    std::atomic<std::uint64_t> sum;
+
+  public:
+    // Exported values are the recorded ones multiplied by scale
+    explicit Histogram(double scale = 1);
+
+    static std::size_t get_bucket(std::uint64_t value);
+    // The largest value that goes in bucket
+    static std::uint64_t get_bucket_limit(std::size_t bucket);
+
+    inline std::uint64_t get_bucket_count(std::size_t bucket) const
+    {
+        return buckets[bucket].load(std::memory_order_relaxed);
+    }
+    inline std::uint64_t get_count() const { return count.load(std::memory_order_relaxed); }
+    // An upper bound on the quantile'th value recorded, in exported units
+    double get_quantile(double quantile) const;
+    inline double get_scale() const { return scale; }
+    // In exported units
+    inline double get_sum() const
+    {
+        return static_cast<double>(sum.load(std::memory_order_relaxed)) * scale;
+    }
+    void record(std::uint64_t value);
+};
+
+// Records how long it lived, in microseconds
+class ScopedTimer
+{
+  private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    explicit ScopedTimer(Histogram &histogram);
+    ScopedTimer(const ScopedTimer &) = delete;
+    ~ScopedTimer();
+};
+
+// Named counters, gauges and histograms, exported in the Prometheus text
+// format.
+//
+// Adding a metric takes a lock, but updating one doesn't, so hot code looks
+// its metrics up once and keeps the references, which stay valid for the
+// registry's lifetime. Looking up an existing name returns the same metric.
+class MetricsRegistry
+{
+  private:
+    struct Metric
+    {
+        std::string help;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    std::map<std::string, Metric> metrics;
+    mutable std::mutex mutex;
+
+    Metric &get_metric(const std::string &name, const std::string &help);
+
+  public:
+    MetricsRegistry() {}
+    MetricsRegistry(const MetricsRegistry &) = delete;
+
+    // Names must be valid Prometheus metric names, and each name can only
+    // be one kind of metric
+    Counter &counter(const std::string &name, const std::string &help = "");
+    Gauge &gauge(const std::string &name, const std::string &help = "");
+    // Durations should be recorded in microseconds with the default scale,
+    // which exports them in seconds
+    Histogram &histogram(const std::string &name,
+                         const std::string &help = "",
+                         double scale = 1e-6);
+    std::string to_prometheus() const;
+};
+
+// The registry the AI_METRICS_* macros record into
+MetricsRegistry &get_metrics();
+}
+
+#define AI_METRICS_CONCAT_IMPL(a, b) a##b
+#define AI_METRICS_CONCAT(a, b) AI_METRICS_CONCAT_IMPL(a, b)
+
+// Times the rest of the enclosing scope into a histogram of the global
+// registry, looked up once per call site
+#define AI_METRICS_TIMER(name, help)                                                               \
+    static ::ai::Histogram &AI_METRICS_CONCAT(metrics_histogram_, __LINE__) =                      \
+        ::ai::get_metrics().histogram(name, help);                                                 \
+    const ::ai::ScopedTimer AI_METRICS_CONCAT(metrics_timer_, __LINE__)(                           \
+        AI_METRICS_CONCAT(metrics_histogram_, __LINE__))
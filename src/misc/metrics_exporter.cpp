@@ -0,0 +1,180 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include <argh.h>
+#include <doctest.h>
+#include <spdlog/spdlog.h>
+
+#include "misc/metrics_exporter.h"
+#include "misc/metrics.h"
+#include "third_party/httplib.h"
+
+namespace fs = std::filesystem;
+
+namespace ai
+{
+MetricsExporter::MetricsExporter(const MetricsRegistry &registry)
+    : registry(registry), server_finished(false), stopping(false) {}
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+void MetricsExporter::serve(int port, const std::string &host)
+{
+    if (server != nullptr)
+    {
+        throw std::logic_error("Metrics are already being served");
+    }
+    server = std::make_unique<httplib::Server>();
+    server->Get("/metrics", [this](const httplib::Request &, httplib::Response &response) {
+        response.set_content(registry.to_prometheus(), "text/plain; version=0.0.4");
+    });
+    server_finished = false;
+    server_thread = std::thread([this, host, port] {
+        if (!server->listen(host.c_str(), port))
+        {
+            spdlog::error("Couldn't serve metrics on {}:{}", host, port);
+        }
+        server_finished = true;
+    });
+    spdlog::info("Serving metrics at http://{}:{}/metrics", host, port);
+}
+
+void MetricsExporter::stop()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    if (writer_thread.joinable())
+    {
+        writer_thread.join();
+    }
+    if (server != nullptr)
+    {
+        // Stopping the server before it's listening does nothing, so wait
+        // until it either listens or fails to
+        while (!server->is_running() && !server_finished)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        server->stop();
+        server_thread.join();
+        server.reset();
+    }
+}
+
+void MetricsExporter::write(const std::string &path) const
+{
+    const auto temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::trunc);
+        file << registry.to_prometheus();
+        if (!file)
+        {
+            throw std::runtime_error("Couldn't write metrics to " + temporary_path);
+        }
+    }
+    // Unlike std::rename(), this replaces the old file on Windows too
+    std::error_code error;
+    fs::rename(temporary_path, path, error);
+    if (error)
+    {
+        throw std::runtime_error("Couldn't move metrics to " + path + ": " + error.message());
+    }
+}
+
+void MetricsExporter::write_every(const std::string &path, std::chrono::milliseconds interval)
+{
+    if (writer_thread.joinable())
+    {
+        throw std::logic_error("Metrics are already being written");
+    }
+    writer_thread = std::thread([this, path, interval] {
+        std::unique_lock lock(mutex);
+        bool last_write = false;
+        while (!last_write)
+        {
+            last_write = condition.wait_for(lock, interval, [this] { return stopping; });
+            try
+            {
+                write(path);
+            }
+            catch (const std::runtime_error &error)
+            {
+                spdlog::error("{}", error.what());
+            }
+        }
+    });
+}
+
+void start_metrics_exporter(MetricsExporter &exporter, argh::parser &args)
+{
+    int port;
+    args({"--metrics-port"}, 0) >> port;
+    if (port > 0)
+    {
+        exporter.serve(port);
+    }
+    std::string path;
+    args({"--metrics-file"}, "") >> path;
+    if (!path.empty())
+    {
+        exporter.write_every(path, std::chrono::seconds(10));
+    }
+}
+
+TEST_CASE("MetricsExporter")
+{
+    MetricsRegistry registry;
+    registry.counter("exported_total").increment(5);
+    MetricsExporter exporter(registry);
+    const auto path = (fs::temp_directory_path() / "metrics_exporter_test.prom").string();
+
+    SUBCASE("Writes the registry to a file")
+    {
+        exporter.write(path);
+
+        std::ifstream file(path);
+        const std::string text((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+        DOCTEST_CHECK(text == registry.to_prometheus());
+        std::remove(path.c_str());
+    }
+
+    SUBCASE("Replaces the file when written again")
+    {
+        exporter.write(path);
+        registry.counter("exported_total").increment();
+        exporter.write(path);
+
+        std::ifstream file(path);
+        const std::string text((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+        DOCTEST_CHECK(text.find("exported_total 6") != std::string::npos);
+        std::remove(path.c_str());
+    }
+
+    SUBCASE("Writes a final copy when stopped")
+    {
+        exporter.write_every(path, std::chrono::hours(1));
+        registry.counter("exported_total").increment();
+        exporter.stop();
+
+        std::ifstream file(path);
+        const std::string text((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+        DOCTEST_CHECK(text.find("exported_total 6") != std::string::npos);
+        std::remove(path.c_str());
+    }
+}
+}
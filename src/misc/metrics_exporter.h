@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace argh
+{
+class parser;
+}
+
+namespace httplib
+{
+class Server;
+}
+
+namespace ai
+{
+class MetricsRegistry;
+
+// Publishes a registry's metrics while a long job runs, either served at
+// /metrics for Prometheus to scrape, or written to a file for a textfile
+// collector, or both.
+class MetricsExporter
+{
+  private:
+    std::condition_variable condition;
+    std::mutex mutex;
+    const MetricsRegistry &registry;
+    std::unique_ptr<httplib::Server> server;
+    std::atomic<bool> server_finished;
+    std::thread server_thread;
+    bool stopping;
+    std::thread writer_thread;
+
+  public:
+    explicit MetricsExporter(const MetricsRegistry &registry);
+    MetricsExporter(const MetricsExporter &) = delete;
+    ~MetricsExporter();
+
+    // Serves /metrics in the background. Only listens on localhost by
+    // default, as there's no authentication.
+    void serve(int port, const std::string &host = "127.0.0.1");
+    void stop();
+    // Writes to a temporary file first and renames it, so readers never see
+    // half a file
+    void write(const std::string &path) const;
+    // Writes the file every interval in the background, and once more when
+    // stopped
+    void write_every(const std::string &path, std::chrono::milliseconds interval);
+};
+
+// Starts exporting as asked for on the command line: --metrics-port to serve
+// /metrics on localhost, and --metrics-file to write a file every 10 seconds
+void start_metrics_exporter(MetricsExporter &exporter, argh::parser &args);
+}
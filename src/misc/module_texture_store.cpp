@@ -1,4 +1,4 @@
-#include <unordered_map>
+#include <stdexcept>
 
 #include <doctest.h>
 #include <glad/glad.h>
@@ -10,7 +10,7 @@
 #include "environment/systems/physics_system.h"
 #include "environment/systems/render_system.h"
 #include "environment/utils/body_factories.h"
-#include "graphics/backend/texture.h"
+#include "graphics/backend/texture_atlas.h"
 #include "graphics/renderers/renderer.h"
 #include "misc/module_factory.h"
 #include "training/modules/imodule.h"
@@ -27,17 +27,17 @@ ModuleTextureStore::ModuleTextureStore(Renderer &&renderer)
     init_physics(registry);
 }
 
-Texture &ModuleTextureStore::get(const std::string &module)
+const AtlasRegion &ModuleTextureStore::get(const std::string &module)
 {
     if (!renderer.is_initialized())
     {
         renderer.init();
     }
 
-    const auto found_texture = cache.find(module);
-    if (found_texture != cache.end())
+    const auto *found_region = atlas.get(module);
+    if (found_region != nullptr)
     {
-        return found_texture->second;
+        return *found_region;
     }
 
     spdlog::debug("Creating module texture for {}", module);
@@ -54,13 +54,17 @@ Texture &ModuleTextureStore::get(const std::string &module)
 
     const auto *frame_buffer = renderer.render_to_buffer(0);
 
-    cache.insert(std::make_pair(module, Texture(image_size, image_size, nullptr, GL_RGBA)));
-    cache.find(module)->second.bind();
+    // Module thumbnails share atlas pages, so a window full of them only
+    // binds a few textures
     frame_buffer->bind_read();
-    glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 0, 0, image_size, image_size, 0);
+    const auto *region = atlas.add_from_read_buffer(module, image_size, image_size);
 
     registry.clear();
 
-    return cache.find(module)->second;
+    if (region == nullptr)
+    {
+        throw std::runtime_error("Couldn't add module texture to atlas: " + module);
+    }
+    return *region;
 }
 }
\ No newline at end of file
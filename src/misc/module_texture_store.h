@@ -1,23 +1,21 @@
 #pragma once
 
-#include <unordered_map>
-
 #include <entt/entity/registry.hpp>
 
-#include "graphics/backend/texture.h"
+#include "graphics/backend/texture_atlas.h"
 #include "graphics/renderers/renderer.h"
 
 namespace ai
 {
 class ModuleTextureStore
 {
-    std::unordered_map<std::string, Texture> cache;
+    TextureAtlas atlas;
     entt::registry registry;
     Renderer renderer;
 
   public:
     ModuleTextureStore(Renderer &&renderer);
 
-    Texture &get(const std::string &module);
+    const AtlasRegion &get(const std::string &module);
 };
 }
\ No newline at end of file
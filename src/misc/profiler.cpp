@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest.h>
+#include <easy/profiler.h>
+#include <fmt/format.h>
+#include <glad/glad.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "misc/profiler.h"
+
+namespace ai
+{
+namespace
+{
+// GPU scopes get their own row in the trace
+const std::uint32_t gpu_thread = 1000;
+
+std::uint32_t get_thread_index()
+{
+    static std::atomic<std::uint32_t> next_thread_index{0};
+    thread_local const std::uint32_t thread_index = next_thread_index++;
+    return thread_index;
+}
+}
+
+Profiler::Profiler(std::size_t max_events)
+    : enabled(false),
+      dropped_events(0),
+      epoch(std::chrono::steady_clock::now()),
+      gpu_clock_offset(0),
+      gpu_clock_synced(false),
+      max_events(max_events) {}
+
+void Profiler::add_event(const ProfileEvent &event)
+{
+    std::lock_guard lock_guard(mutex);
+    if (events.size() >= max_events)
+    {
+        ++dropped_events;
+        return;
+    }
+    events.push_back(event);
+}
+
+void Profiler::begin_gpu(const char *name)
+{
+    if (!gpu_clock_synced)
+    {
+        // Timestamps are in the GPU's clock, so line it up with ours once
+        GLint64 gpu_time;
+        glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+        gpu_clock_offset = now() - static_cast<double>(gpu_time) / 1000.;
+        gpu_clock_synced = true;
+    }
+
+    GpuScope scope{name, get_query(), get_query()};
+    glQueryCounter(scope.begin_query, GL_TIMESTAMP);
+    open_gpu_scopes.push_back(scope);
+}
+
+void Profiler::clear()
+{
+    std::lock_guard lock_guard(mutex);
+    events.clear();
+    dropped_events = 0;
+}
+
+void Profiler::end_frame()
+{
+    // Queries from before profiling was switched off still get collected
+    for (auto iter = closed_gpu_scopes.begin(); iter != closed_gpu_scopes.end();)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(iter->end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            ++iter;
+            continue;
+        }
+
+        GLuint64 begin_time, end_time;
+        glGetQueryObjectui64v(iter->begin_query, GL_QUERY_RESULT, &begin_time);
+        glGetQueryObjectui64v(iter->end_query, GL_QUERY_RESULT, &end_time);
+        const double start = static_cast<double>(begin_time) / 1000. + gpu_clock_offset;
+        add_event({iter->name,
+                   start,
+                   static_cast<double>(end_time - begin_time) / 1000.,
+                   gpu_thread,
+                   true});
+        free_queries.push_back(iter->begin_query);
+        free_queries.push_back(iter->end_query);
+        iter = closed_gpu_scopes.erase(iter);
+    }
+}
+
+void Profiler::end_gpu()
+{
+    auto scope = open_gpu_scopes.back();
+    open_gpu_scopes.pop_back();
+    glQueryCounter(scope.end_query, GL_TIMESTAMP);
+    closed_gpu_scopes.push_back(scope);
+}
+
+std::vector<ProfileEvent> Profiler::get_events() const
+{
+    std::lock_guard lock_guard(mutex);
+    return events;
+}
+
+std::size_t Profiler::get_dropped_events() const
+{
+    std::lock_guard lock_guard(mutex);
+    return dropped_events;
+}
+
+unsigned int Profiler::get_query()
+{
+    if (free_queries.empty())
+    {
+        free_queries.resize(32);
+        glGenQueries(static_cast<GLsizei>(free_queries.size()), free_queries.data());
+    }
+    const auto query = free_queries.back();
+    free_queries.pop_back();
+    return query;
+}
+
+double Profiler::now() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch)
+        .count();
+}
+
+void Profiler::record(const char *name, double start, double end)
+{
+    add_event({name, start, end - start, get_thread_index(), false});
+}
+
+void Profiler::set_enabled(bool enabled)
+{
+    this->enabled = enabled;
+#ifdef BUILD_WITH_EASY_PROFILER
+    if (enabled)
+    {
+        EASY_PROFILER_ENABLE;
+    }
+    else
+    {
+        EASY_PROFILER_DISABLE;
+    }
+#endif
+}
+
+nlohmann::json Profiler::to_chrome_trace() const
+{
+    auto trace_events = nlohmann::json::array();
+    std::vector<std::uint32_t> threads;
+    for (const auto &event : get_events())
+    {
+        trace_events.push_back({{"name", event.name},
+                                {"cat", event.gpu ? "gpu" : "cpu"},
+                                {"ph", "X"},
+                                {"ts", event.start},
+                                {"dur", event.duration},
+                                {"pid", 0},
+                                {"tid", event.thread}});
+        if (std::find(threads.begin(), threads.end(), event.thread) == threads.end())
+        {
+            threads.push_back(event.thread);
+        }
+    }
+
+    for (const auto thread : threads)
+    {
+        trace_events.push_back({{"name", "thread_name"},
+                                {"ph", "M"},
+                                {"pid", 0},
+                                {"tid", thread},
+                                {"args", {{"name", thread == gpu_thread
+                                                       ? std::string("GPU")
+                                                       : fmt::format("Thread {}", thread)}}}});
+    }
+
+    return {{"traceEvents", trace_events}, {"displayTimeUnit", "ms"}};
+}
+
+void Profiler::write_chrome_trace(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error(fmt::format("Unable to open {} for writing", path));
+    }
+    file << to_chrome_trace();
+
+    const auto dropped = get_dropped_events();
+    if (dropped > 0)
+    {
+        spdlog::warn("{} profiling events didn't fit in the buffer and were dropped", dropped);
+    }
+    spdlog::info("Wrote profile to {}", path);
+}
+
+bool Profiler::write_easy_profile(const std::string &path) const
+{
+#ifdef BUILD_WITH_EASY_PROFILER
+    return profiler::dumpBlocksToFile(path.c_str()) > 0;
+#else
+    spdlog::warn("Not built with easy_profiler, not writing {}", path);
+    return false;
+#endif
+}
+
+Profiler &get_profiler()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+ProfileScope::ProfileScope(Profiler &profiler, const char *name)
+    : name(name),
+      profiler(profiler.is_enabled() ? &profiler : nullptr),
+      start(this->profiler != nullptr ? profiler.now() : 0) {}
+
+ProfileScope::~ProfileScope()
+{
+    if (profiler != nullptr)
+    {
+        profiler->record(name, start, profiler->now());
+    }
+}
+
+GpuProfileScope::GpuProfileScope(Profiler &profiler, const char *name)
+    : profiler(profiler.is_enabled() ? &profiler : nullptr)
+{
+    if (this->profiler != nullptr)
+    {
+        this->profiler->begin_gpu(name);
+    }
+}
+
+GpuProfileScope::~GpuProfileScope()
+{
+    if (profiler != nullptr)
+    {
+        profiler->end_gpu();
+    }
+}
+
+TEST_CASE("Profiler")
+{
+    Profiler profiler(2);
+
+    SUBCASE("Scopes aren't recorded while disabled")
+    {
+        {
+            ProfileScope scope(profiler, "Scope");
+        }
+
+        DOCTEST_CHECK(profiler.get_events().empty());
+    }
+
+    SUBCASE("Scopes are recorded while enabled")
+    {
+        profiler.set_enabled(true);
+        {
+            ProfileScope outer(profiler, "Outer");
+            ProfileScope inner(profiler, "Inner");
+        }
+
+        const auto events = profiler.get_events();
+        DOCTEST_REQUIRE(events.size() == 2);
+        DOCTEST_CHECK(std::string(events[0].name) == "Inner");
+        DOCTEST_CHECK(std::string(events[1].name) == "Outer");
+        DOCTEST_CHECK(events[1].start <= events[0].start);
+        DOCTEST_CHECK(events[1].duration >= events[0].duration);
+    }
+
+    SUBCASE("Events past the limit are dropped")
+    {
+        profiler.set_enabled(true);
+        for (int i = 0; i < 3; ++i)
+        {
+            ProfileScope scope(profiler, "Scope");
+        }
+
+        DOCTEST_CHECK(profiler.get_events().size() == 2);
+        DOCTEST_CHECK(profiler.get_dropped_events() == 1);
+    }
+
+    SUBCASE("Chrome traces have a complete event per scope")
+    {
+        profiler.record("Scope", 10, 15);
+
+        const auto trace = profiler.to_chrome_trace();
+        const auto &event = trace["traceEvents"][0];
+
+        DOCTEST_CHECK(event["name"] == "Scope");
+        DOCTEST_CHECK(event["ph"] == "X");
+        DOCTEST_CHECK(event["ts"] == 10.);
+        DOCTEST_CHECK(event["dur"] == 5.);
+        DOCTEST_CHECK(trace["traceEvents"][1]["ph"] == "M");
+    }
+}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <easy/profiler.h>
+#include <nlohmann/json_fwd.hpp>
+
+namespace ai
+{
+struct ProfileEvent
+{
+    const char *name;
+    // Microseconds since the profiler was created
+    double start;
+    double duration;
+    std::uint32_t thread;
+    bool gpu;
+};
+
+// Collects CPU scopes and GPU timer queries while enabled, for exporting as a
+// Chrome trace (chrome://tracing, Perfetto) or an easy_profiler capture.
+//
+// Scope names must be string literals, they are stored as pointers. GPU
+// scopes may only be used on the thread that owns the GL context, and their
+// results are collected by end_frame() once the GPU has caught up, without
+// waiting on it.
+class Profiler
+{
+  private:
+    struct GpuScope
+    {
+        const char *name;
+        unsigned int begin_query;
+        unsigned int end_query;
+    };
+
+    std::atomic<bool> enabled;
+    std::vector<GpuScope> closed_gpu_scopes;
+    std::size_t dropped_events;
+    const std::chrono::steady_clock::time_point epoch;
+    std::vector<ProfileEvent> events;
+    std::vector<unsigned int> free_queries;
+    double gpu_clock_offset;
+    bool gpu_clock_synced;
+    std::size_t max_events;
+    mutable std::mutex mutex;
+    std::vector<GpuScope> open_gpu_scopes;
+
+    void add_event(const ProfileEvent &event);
+    unsigned int get_query();
+
+  public:
+    explicit Profiler(std::size_t max_events = 1 << 20);
+    Profiler(const Profiler &) = delete;
+
+    void begin_gpu(const char *name);
+    void clear();
+    void end_frame();
+    void end_gpu();
+    double now() const;
+    void record(const char *name, double start, double end);
+    nlohmann::json to_chrome_trace() const;
+    void write_chrome_trace(const std::string &path) const;
+    bool write_easy_profile(const std::string &path) const;
+
+    std::vector<ProfileEvent> get_events() const;
+    std::size_t get_dropped_events() const;
+    inline bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+    void set_enabled(bool enabled);
+};
+
+// The profiler the AI_PROFILE_* macros record into
+Profiler &get_profiler();
+
+class ProfileScope
+{
+  private:
+    const char *name;
+    Profiler *profiler;
+    double start;
+
+  public:
+    ProfileScope(Profiler &profiler, const char *name);
+    ProfileScope(const ProfileScope &) = delete;
+    ~ProfileScope();
+};
+
+class GpuProfileScope
+{
+  private:
+    Profiler *profiler;
+
+  public:
+    GpuProfileScope(Profiler &profiler, const char *name);
+    GpuProfileScope(const GpuProfileScope &) = delete;
+    ~GpuProfileScope();
+};
+}
+
+#define AI_PROFILE_CONCAT_IMPL(a, b) a##b
+#define AI_PROFILE_CONCAT(a, b) AI_PROFILE_CONCAT_IMPL(a, b)
+
+// Times the rest of the enclosing scope on the CPU
+#define AI_PROFILE_SCOPE(name) \
+    EASY_BLOCK(name);          \
+    const ::ai::ProfileScope AI_PROFILE_CONCAT(profile_scope_, __LINE__)(::ai::get_profiler(), name)
+
+// Times the rest of the enclosing scope on both the CPU and the GPU
+#define AI_PROFILE_GPU_SCOPE(name) \
+    AI_PROFILE_SCOPE(name);        \
+    const ::ai::GpuProfileScope AI_PROFILE_CONCAT(gpu_profile_scope_, __LINE__)(::ai::get_profiler(), name)
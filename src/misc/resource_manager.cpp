@@ -61,7 +61,14 @@ void ResourceManager::load_shader(const std::string &id,
 void ResourceManager::load_texture(const std::string &id, const std::string &path)
 {
     const std::string full_path = base_path + path;
-    if (texture_store.check_exists(id))
+    if (texture_atlas.get(id) != nullptr || texture_store.check_exists(id))
+    {
+        return;
+    }
+
+    // Sprites are drawn from the atlas whenever their image is in it, so
+    // images only get a texture of their own if they don't fit
+    if (texture_atlas.add_image(id, full_path) != nullptr)
     {
         return;
     }
@@ -77,5 +84,6 @@ void ResourceManager::unload_all()
     font_store.unload();
     shader_store.unload();
     texture_store.unload();
+    texture_atlas.clear();
 }
 }
\ No newline at end of file
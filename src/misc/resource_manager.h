@@ -5,6 +5,7 @@
 #include "audio/audio_source.h"
 #include "graphics/backend/shader.h"
 #include "graphics/backend/texture.h"
+#include "graphics/backend/texture_atlas.h"
 #include "graphics/font.h"
 #include "misc/asset_store.h"
 #include "third_party/di.hpp"
@@ -34,7 +35,9 @@ class ResourceManager
     AssetStore<AudioSource> audio_source_store;
     AssetStore<Font> font_store;
     AssetStore<Shader> shader_store;
+    // Textures that didn't fit in texture_atlas
     AssetStore<Texture> texture_store;
+    TextureAtlas texture_atlas;
 
   private:
     std::string base_path;
@@ -1,21 +1,180 @@
-#include <cstring>
-#include <iostream>
-#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AI_SPRING_MESH_SSE2
+#endif
 
 #include <doctest.h>
 #include <glm/glm.hpp>
-#include <glm/gtx/norm.hpp>
 
 #include "spring_mesh.h"
+#include "misc/thread_pool.h"
 
 namespace ai
 {
+namespace
+{
+constexpr float spring_length = 0.9f;
+// Rows whose offsets and velocities all fall below this are snapped to rest
+constexpr float rest_threshold = 1e-4f;
+constexpr unsigned int min_rows_per_band = 32;
+constexpr unsigned int scratch_arrays = 6;
+
+// Force along each spring between vertices a[i] and b[i], where b sits at
+// (rest_x, rest_y) from a when both are at rest. a receives -force and b
+// receives +force.
+void calculate_spring_forces(const float *a_x, const float *a_y,
+                             const float *a_velocity_x, const float *a_velocity_y,
+                             const float *b_x, const float *b_y,
+                             const float *b_velocity_x, const float *b_velocity_y,
+                             float rest_x, float rest_y,
+                             float stiffness, float damping,
+                             float *forces_x, float *forces_y,
+                             unsigned int count)
+{
+    unsigned int i = 0;
+#ifdef AI_SPRING_MESH_SSE2
+    const __m128 rest_x_4 = _mm_set1_ps(rest_x);
+    const __m128 rest_y_4 = _mm_set1_ps(rest_y);
+    const __m128 spring_length_4 = _mm_set1_ps(spring_length);
+    const __m128 one_4 = _mm_set1_ps(1.f);
+    const __m128 stiffness_4 = _mm_set1_ps(stiffness);
+    const __m128 damping_4 = _mm_set1_ps(damping);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 vector_x = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(a_x + i),
+                                                      _mm_loadu_ps(b_x + i)),
+                                           rest_x_4);
+        const __m128 vector_y = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(a_y + i),
+                                                      _mm_loadu_ps(b_y + i)),
+                                           rest_y_4);
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vector_x, vector_x),
+                                                     _mm_mul_ps(vector_y, vector_y)));
+        // Slack springs exert no force at all, damping included
+        const __m128 stretched = _mm_cmpgt_ps(length, spring_length_4);
+        const __m128 stretch = _mm_mul_ps(stiffness_4,
+                                          _mm_sub_ps(one_4, _mm_div_ps(spring_length_4, length)));
+        const __m128 velocity_x = _mm_sub_ps(_mm_loadu_ps(b_velocity_x + i),
+                                             _mm_loadu_ps(a_velocity_x + i));
+        const __m128 velocity_y = _mm_sub_ps(_mm_loadu_ps(b_velocity_y + i),
+                                             _mm_loadu_ps(a_velocity_y + i));
+        const __m128 force_x = _mm_sub_ps(_mm_mul_ps(vector_x, stretch),
+                                          _mm_mul_ps(velocity_x, damping_4));
+        const __m128 force_y = _mm_sub_ps(_mm_mul_ps(vector_y, stretch),
+                                          _mm_mul_ps(velocity_y, damping_4));
+        _mm_storeu_ps(forces_x + i, _mm_and_ps(stretched, force_x));
+        _mm_storeu_ps(forces_y + i, _mm_and_ps(stretched, force_y));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const float vector_x = a_x[i] - b_x[i] - rest_x;
+        const float vector_y = a_y[i] - b_y[i] - rest_y;
+        const float length = std::sqrt(vector_x * vector_x + vector_y * vector_y);
+        if (!(length > spring_length))
+        {
+            forces_x[i] = 0;
+            forces_y[i] = 0;
+            continue;
+        }
+        const float stretch = stiffness * (1.f - spring_length / length);
+        forces_x[i] = vector_x * stretch - (b_velocity_x[i] - a_velocity_x[i]) * damping;
+        forces_y[i] = vector_y * stretch - (b_velocity_y[i] - a_velocity_y[i]) * damping;
+    }
+}
+
+// accelerations[i] = left[i] - right[i] + up[i] - down[i], returning the
+// largest absolute acceleration written
+float gather_forces(const float *left,
+                    const float *right,
+                    const float *up,
+                    const float *down,
+                    float *accelerations,
+                    unsigned int count)
+{
+    float max_acceleration = 0;
+    unsigned int i = 0;
+#ifdef AI_SPRING_MESH_SSE2
+    const __m128 sign_mask = _mm_set1_ps(-0.f);
+    __m128 max_4 = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 acceleration = _mm_add_ps(
+            _mm_sub_ps(_mm_loadu_ps(left + i), _mm_loadu_ps(right + i)),
+            _mm_sub_ps(_mm_loadu_ps(up + i), _mm_loadu_ps(down + i)));
+        _mm_storeu_ps(accelerations + i, acceleration);
+        max_4 = _mm_max_ps(max_4, _mm_andnot_ps(sign_mask, acceleration));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, max_4);
+    max_acceleration = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+    for (; i < count; ++i)
+    {
+        accelerations[i] = left[i] - right[i] + up[i] - down[i];
+        max_acceleration = std::max(max_acceleration, std::abs(accelerations[i]));
+    }
+    return max_acceleration;
+}
+
+// Applies one step of acceleration to a run of vertices and clears the
+// accelerations, returning the largest absolute offset or velocity
+float integrate_vertices(float *accelerations,
+                         float *offsets,
+                         float *velocities,
+                         float elasticity,
+                         float friction,
+                         unsigned int count)
+{
+    float max_motion = 0;
+    unsigned int i = 0;
+#ifdef AI_SPRING_MESH_SSE2
+    const __m128 sign_mask = _mm_set1_ps(-0.f);
+    const __m128 elasticity_4 = _mm_set1_ps(elasticity);
+    const __m128 friction_4 = _mm_set1_ps(friction);
+    __m128 max_4 = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 velocity = _mm_add_ps(_mm_loadu_ps(velocities + i),
+                                           _mm_loadu_ps(accelerations + i));
+        __m128 offset = _mm_loadu_ps(offsets + i);
+        offset = _mm_add_ps(offset, _mm_sub_ps(velocity, _mm_mul_ps(offset, elasticity_4)));
+        const __m128 damped_velocity = _mm_mul_ps(velocity, friction_4);
+        _mm_storeu_ps(offsets + i, offset);
+        _mm_storeu_ps(velocities + i, damped_velocity);
+        _mm_storeu_ps(accelerations + i, _mm_setzero_ps());
+        max_4 = _mm_max_ps(max_4, _mm_andnot_ps(sign_mask, offset));
+        max_4 = _mm_max_ps(max_4, _mm_andnot_ps(sign_mask, damped_velocity));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, max_4);
+    max_motion = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+    for (; i < count; ++i)
+    {
+        const float velocity = velocities[i] + accelerations[i];
+        offsets[i] += velocity - offsets[i] * elasticity;
+        velocities[i] = velocity * friction;
+        accelerations[i] = 0;
+        max_motion = std::max(max_motion, std::max(std::abs(offsets[i]),
+                                                   std::abs(velocities[i])));
+    }
+    return max_motion;
+}
+}
+
 SpringMesh::SpringMesh(unsigned int width,
                        unsigned int height,
                        float damping,
                        float friction,
                        float stiffness,
-                       float elasticity)
+                       float elasticity,
+                       unsigned int thread_count)
     : width(width),
       height(height),
       no_vertices(width * height),
@@ -23,167 +182,244 @@ SpringMesh::SpringMesh(unsigned int width,
       friction(friction),
       stiffness(stiffness),
       elasticity(elasticity),
-      accelerations(no_vertices, {0, 0, 0}),
-      offsets(no_vertices, {0, 0, 0}),
-      velocities(no_vertices, {0, 0, 0}) {}
+      accelerations_x(no_vertices, 0),
+      accelerations_y(no_vertices, 0),
+      offsets_x(no_vertices, 0),
+      offsets_y(no_vertices, 0),
+      velocities_x(no_vertices, 0),
+      velocities_y(no_vertices, 0),
+      moving_rows(height, 0),
+      pending_rows(height, 0)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    band_count = std::max(1u, std::min(thread_count, height / min_rows_per_band));
+    scratch.resize(band_count * scratch_arrays * width);
+    if (band_count > 1)
+    {
+        thread_pool = std::make_unique<ThreadPool>(band_count - 1);
+    }
+}
 
-void SpringMesh::apply_explosive_force(glm::vec2 position, float size, float strength)
+SpringMesh::~SpringMesh() {}
+
+void SpringMesh::apply_force(glm::vec2 position, float size, float strength)
 {
     unsigned int index = 0;
     for (unsigned int row = 0; row < height; ++row)
     {
         for (unsigned int column = 0; column < width; ++column)
         {
-            glm::vec3 vertex_position = glm::vec3{column, row, 0} + offsets[index];
-            float distance = glm::length2(vertex_position - glm::vec3{position.x, position.y, 0});
+            const glm::vec2 vertex_position{static_cast<float>(column) + offsets_x[index],
+                                            static_cast<float>(row) + offsets_y[index]};
+            const glm::vec2 vector = vertex_position - position;
+            const float distance = glm::dot(vector, vector);
             if (distance < size * size)
             {
-                accelerations[index] += strength *
-                                        (vertex_position - glm::vec3(position, 0)) /
-                                        (distance + 1);
+                const glm::vec2 acceleration = strength * vector / (distance + 1);
+                accelerations_x[index] += acceleration.x;
+                accelerations_y[index] += acceleration.y;
+                pending_rows[row] = 1;
             }
             index++;
         }
     }
 }
 
+void SpringMesh::apply_explosive_force(glm::vec2 position, float size, float strength)
+{
+    apply_force(position, size, strength);
+}
+
 void SpringMesh::apply_implosive_force(glm::vec2 position, float size, float strength)
 {
-    unsigned int index = 0;
-    for (unsigned int row = 0; row < height; ++row)
+    apply_force(position, size, -strength);
+}
+
+void SpringMesh::apply_spring_forces(unsigned int band,
+                                     unsigned int first_row,
+                                     unsigned int last_row)
+{
+    float *horizontal_x = scratch.data() + band * scratch_arrays * width;
+    float *horizontal_y = horizontal_x + width;
+    float *up_x = horizontal_y + width;
+    float *up_y = up_x + width;
+    float *down_x = up_y + width;
+    float *down_y = down_x + width;
+
+    // Edge rows are pinned in place, so only interior rows need forces
+    first_row = std::max(first_row, 1u);
+    last_row = std::min(last_row, height - 1);
+    unsigned int previous_row = height;
+    for (unsigned int row = first_row; row < last_row; ++row)
     {
-        for (unsigned int column = 0; column < width; ++column)
+        if (!moving_rows[row - 1] && !moving_rows[row] && !moving_rows[row + 1])
         {
-            glm::vec3 vertex_position = glm::vec3{column, row, 0} + offsets[index];
-            float distance = glm::length2(vertex_position - glm::vec3{position.x, position.y, 0});
-            if (distance < size * size)
-            {
-                accelerations[index] += strength *
-                                        (glm::vec3(position, 0) - vertex_position) /
-                                        (distance + 1);
-            }
-            index++;
+            continue;
+        }
+
+        const unsigned int above = (row - 1) * width;
+        const unsigned int start = row * width;
+        const unsigned int below = (row + 1) * width;
+
+        // The springs above this row are the ones below the last row solved
+        if (previous_row == row - 1)
+        {
+            std::swap(up_x, down_x);
+            std::swap(up_y, down_y);
         }
+        else
+        {
+            calculate_spring_forces(&offsets_x[above], &offsets_y[above],
+                                    &velocities_x[above], &velocities_y[above],
+                                    &offsets_x[start], &offsets_y[start],
+                                    &velocities_x[start], &velocities_y[start],
+                                    0, 1, stiffness, damping, up_x, up_y, width);
+        }
+        calculate_spring_forces(&offsets_x[start], &offsets_y[start],
+                                &velocities_x[start], &velocities_y[start],
+                                &offsets_x[below], &offsets_y[below],
+                                &velocities_x[below], &velocities_y[below],
+                                0, 1, stiffness, damping, down_x, down_y, width);
+        calculate_spring_forces(&offsets_x[start], &offsets_y[start],
+                                &velocities_x[start], &velocities_y[start],
+                                &offsets_x[start + 1], &offsets_y[start + 1],
+                                &velocities_x[start + 1], &velocities_y[start + 1],
+                                1, 0, stiffness, damping, horizontal_x, horizontal_y, width - 1);
+        previous_row = row;
+
+        // Edge columns are pinned too
+        const float max_x = gather_forces(horizontal_x, horizontal_x + 1,
+                                          up_x + 1, down_x + 1,
+                                          &accelerations_x[start + 1], width - 2);
+        const float max_y = gather_forces(horizontal_y, horizontal_y + 1,
+                                          up_y + 1, down_y + 1,
+                                          &accelerations_y[start + 1], width - 2);
+        pending_rows[row] = max_x > 0 || max_y > 0;
     }
 }
 
-void SpringMesh::apply_spring_forces(const glm::vec3 &position_1,
-                                     const glm::vec3 &position_2,
-                                     const glm::vec3 &velocity_1,
-                                     const glm::vec3 &velocity_2,
-                                     glm::vec3 &acceleration_1,
-                                     glm::vec3 &acceleration_2)
+void SpringMesh::get_offsets(float scale, float *offsets) const
 {
-    glm::vec3 vector = position_1 - position_2;
-
-    float vector_length = glm::length(vector);
-    if (vector_length <= 0.9f)
+    for (unsigned int i = 0; i < no_vertices; ++i)
     {
-        return;
+        offsets[i * 2] = offsets_x[i] * scale;
+        offsets[i * 2 + 1] = offsets_y[i] * scale;
     }
-
-    vector = (vector / vector_length) * (vector_length - 0.9f);
-    glm::vec3 velocity = velocity_2 - velocity_1;
-    glm::vec3 force = stiffness * vector - velocity * damping;
-
-    acceleration_1 += -force;
-    acceleration_2 += force;
 }
 
-std::vector<glm::vec2> SpringMesh::get_vertices(float scale_x, float scale_y)
+void SpringMesh::get_vertices(float scale_x, float scale_y, glm::vec2 *vertices) const
 {
-    std::vector<glm::vec2> vertices(no_vertices);
+    const float column_scale = scale_x / static_cast<float>(width - 1);
+    const float row_scale = scale_y / static_cast<float>(height - 1);
     unsigned int index = 0;
     for (unsigned int row = 0; row < height; ++row)
     {
         for (unsigned int column = 0; column < width; ++column)
         {
-            vertices[index] = {(static_cast<float>(column) + offsets[index].x) /
-                                   static_cast<float>(width - 1) *
-                                   scale_x,
-                               (static_cast<float>(row) + offsets[index].y) /
-                                   static_cast<float>(height - 1) *
-                                   scale_y};
+            vertices[index] = {(static_cast<float>(column) + offsets_x[index]) * column_scale,
+                               (static_cast<float>(row) + offsets_y[index]) * row_scale};
             index++;
         }
     }
+}
 
-    return vertices;
+unsigned int SpringMesh::get_moving_row_count() const
+{
+    return static_cast<unsigned int>(std::count(moving_rows.begin(), moving_rows.end(), 1));
 }
 
-void SpringMesh::update()
+void SpringMesh::integrate(unsigned int first_row, unsigned int last_row)
 {
-    // Update vertex positions
-    for (unsigned int i = 0; i < no_vertices; ++i)
+    for (unsigned int row = first_row; row < last_row; ++row)
     {
-        if (i < width ||
-            i > no_vertices - width ||
-            i % width == 0 ||
-            i % width == width - 1)
+        if (!moving_rows[row] && !pending_rows[row])
         {
-            accelerations[i] = {0, 0, 0};
+            continue;
         }
-        glm::vec3 velocity = velocities[i];
-        velocity += accelerations[i];
-        offsets[i] += velocity + (-offsets[i] * elasticity);
-        velocity *= friction;
-        velocities[i] = velocity;
-    }
-
-    // Reset accelerations to 0
-    ::memset(accelerations.data(), 0.f, accelerations.size() * sizeof(accelerations[0]));
+        pending_rows[row] = 0;
 
-    // Apply springs horizontally
-    unsigned int index_1 = 0;
-    for (unsigned int row = 0; row < height; ++row)
-    {
-        for (unsigned int column = 0; column < width - 1; ++column)
+        const unsigned int start = row * width;
+        if (row == 0 || row == height - 1)
         {
-            unsigned int index_2 = index_1 + 1;
-            apply_spring_forces(glm::vec3{column, row, 0} + offsets[index_1],
-                                glm::vec3{column + 1, row, 0} + offsets[index_2],
-                                velocities[index_1],
-                                velocities[index_2],
-                                accelerations[index_1],
-                                accelerations[index_2]);
-            index_1++;
+            std::fill_n(&accelerations_x[start], width, 0.f);
+            std::fill_n(&accelerations_y[start], width, 0.f);
+            continue;
         }
-    }
+        accelerations_x[start] = accelerations_x[start + width - 1] = 0;
+        accelerations_y[start] = accelerations_y[start + width - 1] = 0;
 
-    // Apply springs vertically
-    index_1 = 0;
-    for (unsigned int column = 0; column < width; ++column)
-    {
-        for (unsigned int row = 0; row < height - 1; ++row)
+        const float max_x = integrate_vertices(&accelerations_x[start],
+                                               &offsets_x[start],
+                                               &velocities_x[start],
+                                               elasticity,
+                                               friction,
+                                               width);
+        const float max_y = integrate_vertices(&accelerations_y[start],
+                                               &offsets_y[start],
+                                               &velocities_y[start],
+                                               elasticity,
+                                               friction,
+                                               width);
+        moving_rows[row] = max_x >= rest_threshold || max_y >= rest_threshold;
+        if (!moving_rows[row])
         {
-            unsigned int index_2 = index_1 + width;
-            apply_spring_forces(glm::vec3{column, row, 0} + offsets[index_1],
-                                glm::vec3{column, row + 1, 0} + offsets[index_2],
-                                velocities[index_1],
-                                velocities[index_2],
-                                accelerations[index_1],
-                                accelerations[index_2]);
-            index_1++;
+            std::fill_n(&offsets_x[start], width, 0.f);
+            std::fill_n(&offsets_y[start], width, 0.f);
+            std::fill_n(&velocities_x[start], width, 0.f);
+            std::fill_n(&velocities_y[start], width, 0.f);
         }
     }
 }
 
-TEST_CASE("SpringMesh")
+template <typename F>
+void SpringMesh::run_banded(F &&function)
 {
-    SpringMesh spring_mesh(3, 4);
-
-    SUBCASE("Number of vertices returned is equal to width * height")
+    const unsigned int rows_per_band = (height + band_count - 1) / band_count;
+    std::vector<std::future<void>> futures;
+    futures.reserve(band_count - 1);
+    for (unsigned int band = 1; band < band_count; ++band)
     {
-        auto vertices = spring_mesh.get_vertices(1, 1);
+        const unsigned int first_row = std::min(band * rows_per_band, height);
+        const unsigned int last_row = std::min(first_row + rows_per_band, height);
+        futures.push_back(thread_pool->enqueue(function, band, first_row, last_row));
+    }
+    function(0, 0, std::min(rows_per_band, height));
+    for (auto &future : futures)
+    {
+        future.get();
+    }
+}
 
-        DOCTEST_CHECK(vertices.size() == 12);
+void SpringMesh::update()
+{
+    if (std::none_of(moving_rows.begin(), moving_rows.end(), [](auto row) { return row; }) &&
+        std::none_of(pending_rows.begin(), pending_rows.end(), [](auto row) { return row; }))
+    {
+        return;
     }
 
+    // Each band only writes to its own rows, so the passes don't need any
+    // locking beyond waiting for every band between them
+    run_banded([this](unsigned int, unsigned int first_row, unsigned int last_row) {
+        integrate(first_row, last_row);
+    });
+    run_banded([this](unsigned int band, unsigned int first_row, unsigned int last_row) {
+        apply_spring_forces(band, first_row, last_row);
+    });
+}
+
+TEST_CASE("SpringMesh")
+{
+    SpringMesh spring_mesh(3, 4);
+
     SUBCASE("Number of offsets returned is equal to width * height")
     {
-        auto &offsets = spring_mesh.get_offsets();
-
-        DOCTEST_CHECK(offsets.size() == 12);
+        DOCTEST_CHECK(spring_mesh.get_vertex_count() == 12);
+        DOCTEST_CHECK(spring_mesh.get_offsets_x().size() == 12);
+        DOCTEST_CHECK(spring_mesh.get_offsets_y().size() == 12);
     }
 
     SUBCASE("Small radius explosive force moves correct vertex")
@@ -191,17 +427,55 @@ TEST_CASE("SpringMesh")
         spring_mesh.apply_explosive_force({0.9f, 1.f}, 0.5f, 100.f);
         spring_mesh.update();
 
-        auto &offsets = spring_mesh.get_offsets();
-
-        DOCTEST_CHECK(offsets[4].x > 1);
+        DOCTEST_CHECK(spring_mesh.get_offsets_x()[4] > 1);
     }
 
     SUBCASE("Vertices are scaled correctly")
     {
-        auto vertices = spring_mesh.get_vertices(5, 7);
+        std::vector<glm::vec2> vertices(spring_mesh.get_vertex_count());
+        spring_mesh.get_vertices(5, 7, vertices.data());
 
         DOCTEST_CHECK(vertices[0] == glm::vec2{0, 0});
         DOCTEST_CHECK(vertices[11] == glm::vec2(5, 7));
     }
+
+    SUBCASE("Mesh comes back to rest after a force")
+    {
+        SpringMesh large_mesh(40, 30);
+        large_mesh.apply_implosive_force({20, 15}, 4, 50);
+        large_mesh.update();
+
+        DOCTEST_CHECK(large_mesh.get_moving_row_count() > 0);
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            large_mesh.update();
+        }
+
+        DOCTEST_CHECK(large_mesh.get_moving_row_count() == 0);
+        DOCTEST_CHECK(large_mesh.get_offsets_x()[15 * 40 + 20] == 0);
+    }
+
+    SUBCASE("Solving in bands gives the same result as a single band")
+    {
+        SpringMesh single_band(50, 200, 0.06f, 0.98f, 0.28f, 0.05f, 1);
+        SpringMesh multi_band(50, 200, 0.06f, 0.98f, 0.28f, 0.05f, 4);
+        DOCTEST_CHECK(multi_band.get_band_count() == 4);
+
+        for (int i = 0; i < 50; ++i)
+        {
+            if (i % 10 == 0)
+            {
+                single_band.apply_explosive_force({25.f, 20.f + i * 3}, 10, 200);
+                multi_band.apply_explosive_force({25.f, 20.f + i * 3}, 10, 200);
+            }
+            single_band.update();
+            multi_band.update();
+        }
+
+        DOCTEST_CHECK(single_band.get_offsets_x() == multi_band.get_offsets_x());
+        DOCTEST_CHECK(single_band.get_offsets_y() == multi_band.get_offsets_y());
+        DOCTEST_CHECK(single_band.get_moving_row_count() > 0);
+    }
+}
 }
-}
\ No newline at end of file
@@ -1,13 +1,22 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include <glm/vec2.hpp>
-#include <glm/vec3.hpp>
+
+class ThreadPool;
 
 namespace ai
 {
 
+// A grid of damped springs, used for the distortion effect.
+//
+// Vertex state is stored as separate x and y arrays so the spring passes can
+// run four vertices at a time. Rows are split into bands that are solved in
+// parallel, and rows that have come to rest (along with their neighbours)
+// are skipped until a force wakes them up again.
 class SpringMesh
 {
   private:
@@ -20,16 +29,29 @@ class SpringMesh
     float stiffness;
     float elasticity;
 
-    std::vector<glm::vec3> accelerations;
-    std::vector<glm::vec3> offsets;
-    std::vector<glm::vec3> velocities;
+    std::vector<float> accelerations_x;
+    std::vector<float> accelerations_y;
+    std::vector<float> offsets_x;
+    std::vector<float> offsets_y;
+    std::vector<float> velocities_x;
+    std::vector<float> velocities_y;
+
+    // Per row: has a non-zero offset or velocity, and has a non-zero
+    // acceleration waiting to be integrated
+    std::vector<std::uint8_t> moving_rows;
+    std::vector<std::uint8_t> pending_rows;
+
+    unsigned int band_count;
+    // Spring forces for one row plus the vertical springs either side of it,
+    // one set per band
+    std::vector<float> scratch;
+    std::unique_ptr<ThreadPool> thread_pool;
 
-    void apply_spring_forces(const glm::vec3 &position_1,
-                             const glm::vec3 &position_2,
-                             const glm::vec3 &velocity_1,
-                             const glm::vec3 &velocity_2,
-                             glm::vec3 &acceleration_1,
-                             glm::vec3 &acceleration_2);
+    void apply_force(glm::vec2 position, float size, float strength);
+    void apply_spring_forces(unsigned int band, unsigned int first_row, unsigned int last_row);
+    void integrate(unsigned int first_row, unsigned int last_row);
+    template <typename F>
+    void run_banded(F &&function);
 
   public:
     SpringMesh(unsigned int width,
@@ -37,13 +59,22 @@ class SpringMesh
                float damping = 0.06f,
                float friction = 0.98f,
                float stiffness = 0.28f,
-               float elasticity = 0.05f);
+               float elasticity = 0.05f,
+               unsigned int thread_count = 1);
+    ~SpringMesh();
 
     void apply_explosive_force(glm::vec2 position, float size, float strength);
     void apply_implosive_force(glm::vec2 position, float size, float strength);
-    std::vector<glm::vec2> get_vertices(float scale_x, float scale_y);
+    // Writes interleaved x/y offsets, multiplied by scale, for no_vertices vertices
+    void get_offsets(float scale, float *offsets) const;
+    // Writes no_vertices vertex positions, scaled to fit scale_x by scale_y
+    void get_vertices(float scale_x, float scale_y, glm::vec2 *vertices) const;
+    unsigned int get_moving_row_count() const;
     void update();
 
-    inline const std::vector<glm::vec3> &get_offsets() const { return offsets; }
+    inline unsigned int get_band_count() const { return band_count; }
+    inline const std::vector<float> &get_offsets_x() const { return offsets_x; }
+    inline const std::vector<float> &get_offsets_y() const { return offsets_y; }
+    inline unsigned int get_vertex_count() const { return no_vertices; }
 };
-}
\ No newline at end of file
+}
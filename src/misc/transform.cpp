@@ -53,6 +53,15 @@ Transform::operator b2Transform()
     return b2Transform(b2Vec2{position.x, position.y}, b2Rot(rotation));
 }
 
+bool Transform::operator==(const Transform &other) const
+{
+    return position == other.position &&
+           rotation == other.rotation &&
+           scale == other.scale &&
+           origin == other.origin &&
+           z == other.z;
+}
+
 void Transform::set_origin(glm::vec2 origin)
 {
     transform_needs_update = true;
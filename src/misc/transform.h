@@ -25,6 +25,8 @@ class Transform
     Transform(const b2Transform &b2_transform);
 
     explicit operator b2Transform();
+    bool operator==(const Transform &other) const;
+    inline bool operator!=(const Transform &other) const { return !(*this == other); }
 
     glm::mat4 get() const;
     void move(glm::vec2 offset);
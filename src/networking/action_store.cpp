@@ -1,5 +1,6 @@
 #include <algorithm>
-#include <map>
+#include <cstdint>
+#include <stdexcept>
 #include <vector>
 
 #include <doctest.h>
@@ -8,67 +9,159 @@
 
 namespace ai
 {
-ActionStore::ActionStore(std::vector<int> actions_per_player)
-    : actions_per_player(actions_per_player)
-{
-    initialize_tick(0);
-}
+const int bits_per_word = 64;
 
-void ActionStore::initialize_tick(int tick)
+ActionStore::ActionStore(std::vector<int> actions_per_player, int capacity)
+    : actions_per_player(actions_per_player),
+      capacity(capacity),
+      dropped_actions(0),
+      first_actions_received(0),
+      late_actions(0),
+      latest_ticks(actions_per_player.size(), -1),
+      next_tick(0),
+      slot_received(capacity, 0),
+      slot_ticks(capacity, -1),
+      words_per_tick(0)
 {
-    action_received[tick] = std::vector<bool>(actions_per_player.size(), false);
+    if (capacity <= 0)
+    {
+        throw std::runtime_error("ActionStore capacity must be positive");
+    }
+    if (actions_per_player.size() > bits_per_word)
+    {
+        throw std::runtime_error("ActionStore supports at most 64 players");
+    }
 
     for (const auto &num_actions : actions_per_player)
     {
-        actions[tick].push_back(std::vector<int>(num_actions, 0));
+        player_word_offsets.push_back(words_per_tick);
+        words_per_tick += (num_actions + bits_per_word - 1) / bits_per_word;
     }
+
+    action_bits.resize(static_cast<std::size_t>(capacity * words_per_tick), 0);
+    latest_action_bits.resize(static_cast<std::size_t>(words_per_tick), 0);
 }
 
-void ActionStore::add_action(int tick, int player, const std::vector<int> &action)
+void ActionStore::pack_action(std::uint64_t *words,
+                              int player,
+                              const std::vector<int> &action) const
 {
-    // If tick hasn't been encountered yet, intialize it
-    if (actions.find(tick) == actions.end())
+    std::uint64_t *player_words = words + player_word_offsets[player];
+    const int num_actions = actions_per_player[player];
+    std::fill(player_words,
+              player_words + (num_actions + bits_per_word - 1) / bits_per_word,
+              0);
+    const int num_set = std::min(num_actions, static_cast<int>(action.size()));
+    for (int i = 0; i < num_set; ++i)
     {
-        initialize_tick(tick);
+        if (action[i] != 0)
+        {
+            player_words[i / bits_per_word] |= std::uint64_t{1} << (i % bits_per_word);
+        }
     }
+}
 
-    actions[tick][player] = action;
-    action_received[tick][player] = true;
+void ActionStore::unpack_action(const std::uint64_t *words,
+                                int player,
+                                std::vector<int> &action) const
+{
+    const std::uint64_t *player_words = words + player_word_offsets[player];
+    const int num_actions = actions_per_player[player];
+    action.resize(static_cast<std::size_t>(num_actions));
+    for (int i = 0; i < num_actions; ++i)
+    {
+        action[i] = static_cast<int>((player_words[i / bits_per_word] >> (i % bits_per_word)) & 1);
+    }
 }
 
-std::vector<std::vector<int>> ActionStore::get_actions(int tick)
+bool ActionStore::add_action(int tick, int player, const std::vector<int> &action)
 {
-    // If tick hasn't been encountered yet, intialize it
-    if (actions.find(tick) == actions.end())
+    // Player numbers come from the network, so they can't be trusted
+    if (player < 0 || player >= static_cast<int>(actions_per_player.size()))
+    {
+        ++dropped_actions;
+        return false;
+    }
+
+    // Actions for ticks that have already been simulated can't be applied
+    if (tick < next_tick)
     {
-        initialize_tick(tick);
+        ++late_actions;
+        return false;
     }
 
+    // Actions too far in the future would overwrite a slot that is still pending
+    if (tick >= next_tick + capacity)
+    {
+        ++dropped_actions;
+        return false;
+    }
+
+    const int slot = tick % capacity;
+    std::uint64_t *words = action_bits.data() + slot * words_per_tick;
+
+    // If this slot was last used for an older tick, recycle it
+    if (slot_ticks[slot] != tick)
+    {
+        slot_ticks[slot] = tick;
+        slot_received[slot] = 0;
+        std::fill(words, words + words_per_tick, 0);
+    }
+
+    pack_action(words, player, action);
+    slot_received[slot] |= std::uint64_t{1} << player;
+
+    if (tick >= latest_ticks[player])
+    {
+        latest_ticks[player] = tick;
+        pack_action(latest_action_bits.data(), player, action);
+    }
+
+    if (tick == 0)
+    {
+        first_actions_received |= std::uint64_t{1} << player;
+    }
+
+    return true;
+}
+
+std::vector<std::vector<int>> ActionStore::get_actions(int tick)
+{
+    const int slot = ((tick % capacity) + capacity) % capacity;
+    const bool slot_valid = slot_ticks[slot] == tick;
+    const std::uint64_t *words = action_bits.data() + slot * words_per_tick;
+
+    std::vector<std::vector<int>> actions(actions_per_player.size());
     for (unsigned int i = 0; i < actions_per_player.size(); ++i)
     {
-        // If we haven't received an action for this step, use the latest
-        // received action
-        if (!action_received[tick][i])
+        if (slot_valid && (slot_received[slot] >> i) & 1)
+        {
+            unpack_action(words, static_cast<int>(i), actions[i]);
+        }
+        else if (latest_ticks[i] >= 0)
+        {
+            // If we haven't received an action for this step, use the latest
+            // received action
+            unpack_action(latest_action_bits.data(), static_cast<int>(i), actions[i]);
+        }
+        else
         {
-            for (auto iter = actions.rbegin(); iter != actions.rend(); ++iter)
-            {
-                if (action_received[iter->first][i])
-                {
-                    actions[tick][i] = iter->second[i];
-                    break;
-                }
-            }
+            actions[i] = std::vector<int>(actions_per_player[i], 0);
         }
     }
 
-    return actions[tick];
+    next_tick = std::max(next_tick, tick + 1);
+
+    return actions;
 }
 
-bool ActionStore::received_first_actions()
+bool ActionStore::received_first_actions() const
 {
-    return std::all_of(action_received[0].begin(),
-                       action_received[0].end(),
-                       [](bool received) { return received; });
+    const auto num_players = actions_per_player.size();
+    const std::uint64_t all_players = num_players == bits_per_word
+                                          ? ~std::uint64_t{0}
+                                          : (std::uint64_t{1} << num_players) - 1;
+    return (first_actions_received & all_players) == all_players;
 }
 
 TEST_CASE("ActionStore")
@@ -125,5 +218,65 @@ TEST_CASE("ActionStore")
             DOCTEST_CHECK(action_store.received_first_actions());
         }
     }
+
+    SUBCASE("Rejects actions for ticks that have already been read")
+    {
+        action_store.get_actions(0);
+        action_store.get_actions(1);
+
+        DOCTEST_CHECK(!action_store.add_action(1, 0, {1, 1}));
+        DOCTEST_CHECK(action_store.get_late_actions() == 1);
+        DOCTEST_CHECK(action_store.add_action(2, 0, {1, 1}));
+    }
+
+    SUBCASE("Drops actions too far in the future")
+    {
+        const int capacity = action_store.get_capacity();
+
+        DOCTEST_CHECK(action_store.add_action(capacity - 1, 0, {1, 1}));
+        DOCTEST_CHECK(!action_store.add_action(capacity, 0, {1, 1}));
+        DOCTEST_CHECK(action_store.get_dropped_actions() == 1);
+    }
+
+    SUBCASE("Drops actions for players that don't exist")
+    {
+        DOCTEST_CHECK(!action_store.add_action(0, -1, {1, 1}));
+        DOCTEST_CHECK(!action_store.add_action(0, 2, {1, 1}));
+        DOCTEST_CHECK(!action_store.add_action(0, 64, {1, 1}));
+        DOCTEST_CHECK(action_store.get_dropped_actions() == 3);
+        DOCTEST_CHECK(!action_store.received_first_actions());
+    }
+
+    SUBCASE("Reuses slots once the window has moved past them")
+    {
+        ActionStore small_store({2}, 4);
+        small_store.add_action(0, 0, {1, 0});
+        for (int i = 0; i < 4; ++i)
+        {
+            small_store.get_actions(i);
+        }
+        small_store.add_action(5, 0, {0, 1});
+
+        // Slot 0 still holds tick 0's action, which must not leak into tick 4
+        auto actions = small_store.get_actions(4);
+
+        DOCTEST_CHECK(actions[0] == std::vector<int>{0, 1});
+    }
+
+    SUBCASE("Packs actions wider than a single word")
+    {
+        std::vector<int> wide_action(70, 0);
+        wide_action[0] = 1;
+        wide_action[65] = 1;
+        wide_action[69] = 1;
+        ActionStore wide_store({70, 1});
+        wide_store.add_action(0, 0, wide_action);
+        wide_store.add_action(0, 1, {1});
+
+        auto actions = wide_store.get_actions(0);
+
+        DOCTEST_CHECK(actions[0] == wide_action);
+        DOCTEST_CHECK(actions[1] == std::vector<int>{1});
+    }
+}
 }
-}
\ No newline at end of file
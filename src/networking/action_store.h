@@ -1,6 +1,6 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
 #include <vector>
 
 namespace ai
@@ -8,17 +8,32 @@ namespace ai
 class ActionStore
 {
   private:
-    std::map<int, std::vector<std::vector<int>>> actions;
+    std::vector<std::uint64_t> action_bits;
     std::vector<int> actions_per_player;
-    std::map<int, std::vector<bool>> action_received;
+    int capacity;
+    int dropped_actions;
+    std::uint64_t first_actions_received;
+    int late_actions;
+    std::vector<std::uint64_t> latest_action_bits;
+    std::vector<int> latest_ticks;
+    int next_tick;
+    std::vector<int> player_word_offsets;
+    std::vector<std::uint64_t> slot_received;
+    std::vector<int> slot_ticks;
+    int words_per_tick;
 
-    void initialize_tick(int tick);
+    void pack_action(std::uint64_t *words, int player, const std::vector<int> &action) const;
+    void unpack_action(const std::uint64_t *words, int player, std::vector<int> &action) const;
 
   public:
-    ActionStore(std::vector<int> actions_per_player);
+    ActionStore(std::vector<int> actions_per_player, int capacity = 64);
 
-    void add_action(int tick, int player, const std::vector<int> &action);
+    bool add_action(int tick, int player, const std::vector<int> &action);
     std::vector<std::vector<int>> get_actions(int tick);
-    bool received_first_actions();
+    bool received_first_actions() const;
+
+    inline int get_capacity() const { return capacity; }
+    inline int get_dropped_actions() const { return dropped_actions; }
+    inline int get_late_actions() const { return late_actions; }
 };
-}
\ No newline at end of file
+}
@@ -0,0 +1,500 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <doctest.h>
+#include <spdlog/spdlog.h>
+
+#include "binary_codec.h"
+#include "misc/transform.h"
+#include "networking/messages.h"
+#include "networking/msgpack_codec.h"
+#include "training/events/effect_triggered.h"
+#include "training/events/entity_destroyed.h"
+
+namespace ai
+{
+namespace
+{
+const std::size_t header_size = 3;
+const std::size_t transform_size = 3 * sizeof(float);
+
+// Event table: every concrete event gets its own tag, so effect events don't
+// need a second type field
+enum class EventTag : std::uint8_t
+{
+    EntityDestroyed = 0,
+    BodyHit = 1,
+    BulletExplosion = 2,
+    ThrusterParticles = 3
+};
+
+class BinaryWriter
+{
+  private:
+    std::string &buffer;
+
+  public:
+    BinaryWriter(std::string &buffer) : buffer(buffer) {}
+
+    template <typename T>
+    void write_int(T value)
+    {
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+        {
+            buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    void write_f32(float value)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        write_int(bits);
+    }
+
+    void write_f64(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        write_int(bits);
+    }
+
+    void write_transform(const Transform &transform)
+    {
+        const auto position = transform.get_position();
+        write_f32(position.x);
+        write_f32(position.y);
+        write_f32(transform.get_rotation());
+    }
+
+    void write_count(std::size_t count)
+    {
+        if (count > UINT16_MAX)
+        {
+            throw std::runtime_error("Too many elements for binary message");
+        }
+        write_int(static_cast<std::uint16_t>(count));
+    }
+};
+
+class BinaryReader
+{
+  private:
+    const std::string &buffer;
+    std::size_t position;
+
+  public:
+    BinaryReader(const std::string &buffer) : buffer(buffer), position(header_size) {}
+
+    template <typename T>
+    T read_int()
+    {
+        if (position + sizeof(T) > buffer.size())
+        {
+            throw std::runtime_error("Binary message is truncated");
+        }
+        T value = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+        {
+            value |= static_cast<T>(static_cast<std::uint8_t>(buffer[position + i])) << (8 * i);
+        }
+        position += sizeof(T);
+        return value;
+    }
+
+    float read_f32()
+    {
+        const auto bits = read_int<std::uint32_t>();
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    double read_f64()
+    {
+        const auto bits = read_int<std::uint64_t>();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    Transform read_transform()
+    {
+        const float x = read_f32();
+        const float y = read_f32();
+        const float rotation = read_f32();
+        return Transform(x, y, rotation);
+    }
+
+    std::vector<float> read_floats()
+    {
+        std::vector<float> values(read_int<std::uint16_t>());
+        for (auto &value : values)
+        {
+            value = read_f32();
+        }
+        return values;
+    }
+};
+
+void write_header(std::string &buffer, MessageType type)
+{
+    buffer.push_back(static_cast<char>(BinaryCodec::magic));
+    buffer.push_back(static_cast<char>(BinaryCodec::schema_version));
+    buffer.push_back(static_cast<char>(type));
+}
+
+void check_header(const std::string &message, MessageType expected_type)
+{
+    if (!BinaryCodec::is_binary(message))
+    {
+        throw std::runtime_error("Not a binary message");
+    }
+    if (static_cast<std::uint8_t>(message[1]) != BinaryCodec::schema_version)
+    {
+        throw std::runtime_error("Unsupported binary message schema version: " +
+                                 std::to_string(static_cast<std::uint8_t>(message[1])));
+    }
+    if (BinaryCodec::get_message_type(message) != expected_type)
+    {
+        throw std::runtime_error("Unexpected binary message type");
+    }
+}
+}
+
+std::string BinaryCodec::encode(const ActionMessage &message)
+{
+    std::string buffer;
+    const auto num_actions = message.actions.size();
+    buffer.reserve(header_size + 6 + (num_actions + 7) / 8);
+
+    write_header(buffer, MessageType::Action);
+    BinaryWriter writer(buffer);
+    writer.write_int(static_cast<std::uint32_t>(message.tick));
+    writer.write_count(num_actions);
+
+    std::uint8_t byte = 0;
+    for (std::size_t i = 0; i < num_actions; ++i)
+    {
+        if (message.actions[i] != 0)
+        {
+            byte |= 1 << (i % 8);
+        }
+        if (i % 8 == 7 || i == num_actions - 1)
+        {
+            writer.write_int(byte);
+            byte = 0;
+        }
+    }
+
+    return buffer;
+}
+
+std::string BinaryCodec::encode(const StateMessage &message)
+{
+    std::string buffer;
+    buffer.reserve(header_size + 5 + 10 +
+                   message.agent_transforms.size() * transform_size +
+                   (message.hps.size() + message.scores.size()) * sizeof(float) +
+                   message.entity_transforms.size() * (4 + transform_size) +
+                   message.events.size() * (1 + 8 + 4 + transform_size));
+
+    write_header(buffer, MessageType::State);
+    BinaryWriter writer(buffer);
+    writer.write_int(static_cast<std::uint32_t>(message.tick));
+    writer.write_int(static_cast<std::uint8_t>(message.done));
+
+    writer.write_count(message.agent_transforms.size());
+    for (const auto &transform : message.agent_transforms)
+    {
+        writer.write_transform(transform);
+    }
+
+    writer.write_count(message.hps.size());
+    for (const auto &hp : message.hps)
+    {
+        writer.write_f32(hp);
+    }
+
+    writer.write_count(message.scores.size());
+    for (const auto &score : message.scores)
+    {
+        writer.write_f32(score);
+    }
+
+    writer.write_count(message.entity_transforms.size());
+    for (const auto &entity : message.entity_transforms)
+    {
+        writer.write_int(static_cast<std::uint32_t>(entity.first));
+        writer.write_transform(entity.second);
+    }
+
+    writer.write_count(message.events.size());
+    for (const auto &event : message.events)
+    {
+        if (event->type == EventTypes::EntityDestroyed)
+        {
+            const auto &entity_destroyed = static_cast<const EntityDestroyed &>(*event);
+            writer.write_int(static_cast<std::uint8_t>(EventTag::EntityDestroyed));
+            writer.write_f64(entity_destroyed.get_time());
+            writer.write_transform(entity_destroyed.get_transform());
+            writer.write_int(static_cast<std::uint32_t>(entity_destroyed.get_id()));
+        }
+        else if (event->type == EventTypes::EffectTriggered)
+        {
+            const auto &effect = static_cast<const EffectTriggered &>(*event);
+            writer.write_int(static_cast<std::uint8_t>(
+                static_cast<int>(EventTag::BodyHit) + static_cast<int>(effect.get_effect_type())));
+            writer.write_f64(effect.get_time());
+            writer.write_transform(effect.get_transform());
+        }
+        else
+        {
+            throw std::runtime_error("Tried to serialize unknown event type");
+        }
+    }
+
+    return buffer;
+}
+
+template <>
+ActionMessage BinaryCodec::decode<ActionMessage>(const std::string &message)
+{
+    check_header(message, MessageType::Action);
+    BinaryReader reader(message);
+
+    const auto tick = static_cast<int>(reader.read_int<std::uint32_t>());
+    std::vector<int> actions(reader.read_int<std::uint16_t>());
+    std::uint8_t byte = 0;
+    for (std::size_t i = 0; i < actions.size(); ++i)
+    {
+        if (i % 8 == 0)
+        {
+            byte = reader.read_int<std::uint8_t>();
+        }
+        actions[i] = (byte >> (i % 8)) & 1;
+    }
+
+    return ActionMessage(std::move(actions), tick);
+}
+
+template <>
+StateMessage BinaryCodec::decode<StateMessage>(const std::string &message)
+{
+    check_header(message, MessageType::State);
+    BinaryReader reader(message);
+
+    const auto tick = static_cast<int>(reader.read_int<std::uint32_t>());
+    const bool done = reader.read_int<std::uint8_t>() != 0;
+
+    std::vector<Transform> agent_transforms(reader.read_int<std::uint16_t>());
+    for (auto &transform : agent_transforms)
+    {
+        transform = reader.read_transform();
+    }
+
+    auto hps = reader.read_floats();
+    auto scores = reader.read_floats();
+
+    std::unordered_map<unsigned int, Transform> entity_transforms;
+    const auto num_entities = reader.read_int<std::uint16_t>();
+    entity_transforms.reserve(num_entities);
+    for (unsigned int i = 0; i < num_entities; ++i)
+    {
+        const auto id = reader.read_int<std::uint32_t>();
+        entity_transforms[id] = reader.read_transform();
+    }
+
+    std::vector<std::unique_ptr<IEvent>> events;
+    const auto num_events = reader.read_int<std::uint16_t>();
+    events.reserve(num_events);
+    for (unsigned int i = 0; i < num_events; ++i)
+    {
+        const auto tag = static_cast<EventTag>(reader.read_int<std::uint8_t>());
+        const double time = reader.read_f64();
+        const auto transform = reader.read_transform();
+        switch (tag)
+        {
+        case EventTag::EntityDestroyed:
+            events.push_back(std::make_unique<EntityDestroyed>(reader.read_int<std::uint32_t>(),
+                                                               time,
+                                                               transform));
+            break;
+        case EventTag::BodyHit:
+        case EventTag::BulletExplosion:
+        case EventTag::ThrusterParticles:
+            events.push_back(std::make_unique<EffectTriggered>(
+                static_cast<EffectTypes>(static_cast<int>(tag) -
+                                         static_cast<int>(EventTag::BodyHit)),
+                time,
+                transform));
+            break;
+        default:
+            throw std::runtime_error("Unknown event tag in binary message");
+        }
+    }
+
+    return StateMessage(std::move(agent_transforms),
+                        std::move(entity_transforms),
+                        std::move(events),
+                        std::move(hps),
+                        std::move(scores),
+                        done,
+                        tick);
+}
+
+MessageType BinaryCodec::get_message_type(const std::string &message)
+{
+    return static_cast<MessageType>(message[2]);
+}
+
+bool BinaryCodec::is_binary(const std::string &message)
+{
+    return message.size() >= header_size && static_cast<std::uint8_t>(message[0]) == magic;
+}
+
+namespace
+{
+StateMessage make_test_state(int num_bullets)
+{
+    std::unordered_map<unsigned int, Transform> entity_transforms;
+    for (int i = 0; i < num_bullets; ++i)
+    {
+        entity_transforms[static_cast<unsigned int>(i + 10)] = Transform(i * 0.5f, -i * 0.25f, 0.1f);
+    }
+    std::vector<std::unique_ptr<IEvent>> events;
+    events.push_back(std::make_unique<EntityDestroyed>(12, 3.5, Transform(1, 2, 3)));
+    events.push_back(std::make_unique<EffectTriggered>(EffectTypes::ThrusterParticles,
+                                                       3.25,
+                                                       Transform(-1, -2, 0.5f)));
+    return StateMessage({Transform(1.5f, 2.5f, 0.75f), Transform(-3, 4, -1)},
+                        std::move(entity_transforms),
+                        std::move(events),
+                        {7.f, 3.f},
+                        {1.f, 0.f},
+                        false,
+                        42);
+}
+}
+
+TEST_CASE("BinaryCodec")
+{
+    SUBCASE("Round trips an ActionMessage")
+    {
+        ActionMessage message({1, 0, 0, 1, 1, 0, 0, 0, 1, 1}, 1234);
+
+        auto encoded = BinaryCodec::encode(message);
+        auto decoded = BinaryCodec::decode<ActionMessage>(encoded);
+
+        DOCTEST_CHECK(decoded.actions == message.actions);
+        DOCTEST_CHECK(decoded.tick == 1234);
+        // Header, tick, count and two bytes of flags
+        DOCTEST_CHECK(encoded.size() == 3 + 4 + 2 + 2);
+    }
+
+    SUBCASE("Round trips a StateMessage")
+    {
+        auto message = make_test_state(3);
+
+        auto decoded = BinaryCodec::decode<StateMessage>(BinaryCodec::encode(message));
+
+        DOCTEST_CHECK(decoded.tick == 42);
+        DOCTEST_CHECK(decoded.done == false);
+        DOCTEST_CHECK(decoded.hps == message.hps);
+        DOCTEST_CHECK(decoded.scores == message.scores);
+        DOCTEST_CHECK(decoded.agent_transforms.size() == 2);
+        DOCTEST_CHECK(decoded.agent_transforms[1].get_position() ==
+                      message.agent_transforms[1].get_position());
+        DOCTEST_CHECK(decoded.agent_transforms[0].get_rotation() ==
+                      message.agent_transforms[0].get_rotation());
+        DOCTEST_CHECK(decoded.entity_transforms.size() == 3);
+        DOCTEST_CHECK(decoded.entity_transforms[11].get_position() ==
+                      message.entity_transforms[11].get_position());
+
+        DOCTEST_CHECK(decoded.events.size() == 2);
+        const auto &entity_destroyed = static_cast<const EntityDestroyed &>(*decoded.events[0]);
+        DOCTEST_CHECK(entity_destroyed.type == EventTypes::EntityDestroyed);
+        DOCTEST_CHECK(entity_destroyed.get_id() == 12);
+        DOCTEST_CHECK(entity_destroyed.get_time() == 3.5);
+        const auto &effect = static_cast<const EffectTriggered &>(*decoded.events[1]);
+        DOCTEST_CHECK(effect.type == EventTypes::EffectTriggered);
+        DOCTEST_CHECK(effect.get_effect_type() == EffectTypes::ThrusterParticles);
+        DOCTEST_CHECK(effect.get_transform().get_rotation() == 0.5f);
+    }
+
+    SUBCASE("Is distinguishable from msgpack messages")
+    {
+        ActionMessage message({1, 0}, 3);
+
+        DOCTEST_CHECK(BinaryCodec::is_binary(BinaryCodec::encode(message)));
+        DOCTEST_CHECK(!BinaryCodec::is_binary(MsgPackCodec::encode(message)));
+        DOCTEST_CHECK(BinaryCodec::get_message_type(BinaryCodec::encode(message)) ==
+                      MessageType::Action);
+    }
+
+    SUBCASE("Rejects other schema versions")
+    {
+        auto encoded = BinaryCodec::encode(ActionMessage({1, 0}, 3));
+        encoded[1] = static_cast<char>(BinaryCodec::schema_version + 1);
+
+        DOCTEST_CHECK_THROWS(BinaryCodec::decode<ActionMessage>(encoded));
+    }
+
+    SUBCASE("Rejects truncated messages")
+    {
+        auto encoded = BinaryCodec::encode(make_test_state(3));
+        encoded.resize(encoded.size() - 1);
+
+        DOCTEST_CHECK_THROWS(BinaryCodec::decode<StateMessage>(encoded));
+    }
+}
+
+// Run with --no-skip to compare against MsgPackCodec
+TEST_CASE("BinaryCodec benchmark" * doctest::skip())
+{
+    const int iterations = 100000;
+    auto state = make_test_state(20);
+
+    auto time = [&](const std::string &name, auto &&round_trip) {
+        std::size_t bytes = 0;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            bytes += round_trip();
+        }
+        const std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+        spdlog::info("{}: {:.3f}us per round trip, {} bytes",
+                     name, elapsed.count() / iterations, bytes / iterations);
+    };
+
+    time("msgpack StateMessage", [&] {
+        auto encoded = MsgPackCodec::encode(state);
+        MsgPackCodec::decode<StateMessage>(encoded);
+        return encoded.size();
+    });
+    time("binary StateMessage", [&] {
+        auto encoded = BinaryCodec::encode(state);
+        BinaryCodec::decode<StateMessage>(encoded);
+        return encoded.size();
+    });
+
+    ActionMessage action({1, 0, 1, 1}, 100);
+    time("msgpack ActionMessage", [&] {
+        auto encoded = MsgPackCodec::encode(action);
+        MsgPackCodec::decode<ActionMessage>(encoded);
+        return encoded.size();
+    });
+    time("binary ActionMessage", [&] {
+        auto encoded = BinaryCodec::encode(action);
+        BinaryCodec::decode<ActionMessage>(encoded);
+        return encoded.size();
+    });
+}
+}
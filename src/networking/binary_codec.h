@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "networking/messages.h"
+
+namespace ai
+{
+// Fixed-layout wire format for the messages sent every tick.
+//
+// Every message starts with a three byte header: a magic byte, the schema
+// version and the message type. The magic byte is 0xc1, which msgpack never
+// emits, so binary and msgpack messages can share a socket. All multi-byte
+// fields are little-endian.
+//
+// ActionMessage: u32 tick, u16 action count, actions bit-packed LSB first.
+// StateMessage: u32 tick, u8 done, then u16-counted arrays of agent
+// transforms (3 x f32), hps (f32), scores (f32), entities (u32 id +
+// transform) and events (u8 tag from the event table, f64 time, transform,
+// plus a u32 entity id for EntityDestroyed).
+class BinaryCodec
+{
+  public:
+    static constexpr std::uint8_t magic = 0xc1;
+    static constexpr std::uint8_t schema_version = 1;
+
+    static std::string encode(const ActionMessage &message);
+    static std::string encode(const StateMessage &message);
+
+    template <typename T>
+    static T decode(const std::string &message);
+
+    static MessageType get_message_type(const std::string &message);
+    static bool is_binary(const std::string &message);
+};
+
+template <>
+ActionMessage BinaryCodec::decode<ActionMessage>(const std::string &message);
+template <>
+StateMessage BinaryCodec::decode<StateMessage>(const std::string &message);
+}
@@ -1,44 +1,51 @@
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <Box2D/Box2D.h>
 #include <doctest.h>
+#include <entt/entt.hpp>
 #include <nlohmann/json.hpp>
 #include <torch/torch.h>
 
 #include "client_agent.h"
-#include "audio/audio_engine.h"
-#include "misc/module_factory.h"
+#include "environment/components/body.h"
+#include "environment/components/bullet.h"
+#include "environment/components/physics_body.h"
+#include "environment/ecs_env.h"
+#include "environment/serialization/serialize_body.h"
+#include "environment/systems/module_system.h"
+#include "environment/systems/modules/base_module_system.h"
+#include "environment/systems/modules/laser_sensor_module_system.h"
+#include "environment/systems/observation_system.h"
+#include "environment/utils/bullet_utils.h"
 #include "misc/random.h"
+#include "networking/game.h"
+#include "networking/messages.h"
 #include "training/agents/iagent.h"
 #include "training/agents/random_agent.h"
-#include "training/bodies/body.h"
-#include "training/bodies/test_body.h"
-#include "training/entities/bullet.h"
-#include "training/environments/ienvironment.h"
-#include "training/environments/koth_env.h"
 
 namespace ai
 {
 ClientAgent::ClientAgent(std::unique_ptr<IAgent> agent,
                          int agent_number,
-                         std::unique_ptr<IEnvironment> env)
+                         std::unique_ptr<EcsEnv> env)
     : agent(std::move(agent)),
       agent_number(agent_number),
       env(std::move(env)),
-      hidden_state(torch::zeros({this->agent->get_hidden_state_size()})) {}
+      hidden_state(torch::zeros({1, this->agent->get_hidden_state_size()})),
+      last_tick(-1) {}
 
-std::vector<int> ClientAgent::get_action(const EnvState &env_state)
+ClientAgent::~ClientAgent() {}
+
+std::vector<int> ClientAgent::get_action(const StateMessage &state)
 {
-    env->set_state(env_state);
-    auto observation = env->get_bodies()[agent_number]->get_observation();
+    set_state(state);
 
-    auto observation_tensor = torch::from_blob(observation.data(),
-                                               {static_cast<long>(observation.size())},
-                                               torch::kFloat);
-    auto act_result = agent->act(observation_tensor,
+    auto observation = observation_system(env->get_registry())[agent_number].unsqueeze(0);
+    auto act_result = agent->act(observation,
                                  hidden_state,
-                                 torch::ones({1}));
+                                 torch::ones({1, 1}));
     hidden_state = act_result.hidden_state;
     auto actions_tensor = act_result.action.to(torch::kInt);
     return std::vector<int>(actions_tensor.data_ptr<int>(),
@@ -49,36 +56,166 @@ void ClientAgent::set_bodies(const std::vector<nlohmann::json> &body_specs)
 {
     for (unsigned int i = 0; i < body_specs.size(); ++i)
     {
-        env->get_bodies()[i]->load_json(body_specs[i]);
+        env->set_body(i, body_specs[i]);
+    }
+    env->reset();
+    last_tick = -1;
+    last_transforms.clear();
+    bullets.clear();
+}
+
+void ClientAgent::set_bullets(const StateMessage &state)
+{
+    auto &registry = env->get_registry();
+
+    // Remove bullets that are gone on the server
+    for (auto iter = bullets.begin(); iter != bullets.end();)
+    {
+        if (state.entity_transforms.find(iter->first) == state.entity_transforms.end())
+        {
+            registry.destroy(iter->second);
+            iter = bullets.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    // Add new bullets and move existing ones
+    for (const auto &[id, transform] : state.entity_transforms)
+    {
+        auto iter = bullets.find(id);
+        if (iter == bullets.end())
+        {
+            iter = bullets.emplace(id, make_bullet(registry)).first;
+        }
+        const auto position = transform.get_position();
+        const auto rotation = transform.get_rotation();
+        registry.get<PhysicsBody>(iter->second).body->SetTransform({position.x, position.y},
+                                                                   rotation);
+        auto &bullet_transform = registry.get<Transform>(iter->second);
+        bullet_transform.set_position(position);
+        bullet_transform.set_rotation(rotation);
     }
 }
 
+void ClientAgent::set_state(const StateMessage &state)
+{
+    auto &registry = env->get_registry();
+    const auto &bodies = env->get_bodies();
+
+    // Velocities aren't sent over the network, so estimate them from the
+    // previous state to feed the base module's velocity sensors
+    const bool have_previous = last_tick >= 0 && state.tick > last_tick &&
+                               last_transforms.size() == state.agent_transforms.size();
+    const auto elapsed = static_cast<float>((state.tick - last_tick) *
+                                            frames_per_tick *
+                                            frame_length);
+
+    for (unsigned int i = 0; i < state.agent_transforms.size() && i < bodies.size(); ++i)
+    {
+        const auto &transform = state.agent_transforms[i];
+        const auto position = transform.get_position();
+        const auto rotation = transform.get_rotation();
+
+        auto *b2_body = registry.get<PhysicsBody>(bodies[i]).body;
+        b2_body->SetTransform({position.x, position.y}, rotation);
+        if (have_previous)
+        {
+            const auto velocity = (position - last_transforms[i].get_position()) / elapsed;
+            b2_body->SetLinearVelocity({velocity.x, velocity.y});
+            b2_body->SetAngularVelocity((rotation - last_transforms[i].get_rotation()) /
+                                        elapsed);
+        }
+        else
+        {
+            b2_body->SetLinearVelocity(b2Vec2_zero);
+            b2_body->SetAngularVelocity(0.f);
+        }
+
+        auto &body_transform = registry.get<Transform>(bodies[i]);
+        body_transform.set_position(position);
+        body_transform.set_rotation(rotation);
+
+        if (i < state.hps.size())
+        {
+            registry.get<EcsBody>(bodies[i]).hp = state.hps[i];
+        }
+    }
+
+    set_bullets(state);
+
+    module_system(registry);
+    base_module_system(registry);
+    laser_sensor_module_system(registry);
+
+    last_tick = state.tick;
+    last_transforms = state.agent_transforms;
+}
+
 TEST_CASE("ClientAgent")
 {
     Random rng(0);
-    MockAudioEngine audio_engine;
-    BulletFactory bullet_factory(audio_engine);
-    ModuleFactory module_factory(audio_engine, bullet_factory, rng);
-    TestBodyFactory body_factory(module_factory, rng);
-    KothEnvFactory env_factory(10, audio_engine, body_factory, bullet_factory);
-    auto env = env_factory.make();
-    auto agent = std::make_unique<RandomAgent>(env->get_bodies()[0]->to_json(),
-                                               rng,
-                                               "Random agent");
+    auto env = std::make_unique<EcsEnv>();
+    env->set_body(0, default_body());
+    env->set_body(1, default_body());
+    auto &registry = env->get_registry();
+    auto agent = std::make_unique<RandomAgent>(default_body(), rng, "Random agent");
 
     ClientAgent client_agent(std::move(agent), 1, std::move(env));
 
     SUBCASE("get_action() returns correctly sized action")
     {
-        EnvState env_state(std::vector<b2Transform>{b2Transform(b2Vec2(-5, -5), b2Rot(0)),
-                                                    b2Transform(b2Vec2(5, 5), b2Rot(1))},
-                           std::unordered_map<unsigned int, b2Transform>{},
+        StateMessage state({Transform(-5, -5, 0), Transform(5, 5, 1)},
+                           {},
+                           {},
                            {10, 10},
                            {0, 0},
+                           false,
                            0);
-        auto action = client_agent.get_action(env_state);
+        auto action = client_agent.get_action(state);
 
         DOCTEST_CHECK(action.size() == 4);
     }
+
+    SUBCASE("get_action() works across consecutive states")
+    {
+        for (int tick = 0; tick < 3; ++tick)
+        {
+            StateMessage state({Transform(-5, -5 + tick, 0), Transform(5, 5, 1)},
+                               {},
+                               {},
+                               {10, 10},
+                               {0, 0},
+                               false,
+                               tick);
+            auto action = client_agent.get_action(state);
+
+            DOCTEST_CHECK(action.size() == 4);
+        }
+    }
+
+    SUBCASE("Bullets are added, moved and removed to match the state")
+    {
+        StateMessage state({Transform(-5, -5, 0), Transform(5, 5, 1)},
+                           {{3, Transform(1, 2, 0)}, {7, Transform(3, 4, 0)}},
+                           {},
+                           {10, 10},
+                           {0, 0},
+                           false,
+                           0);
+        client_agent.get_action(state);
+
+        DOCTEST_CHECK(registry.size<EcsBullet>() == 2);
+
+        state.entity_transforms = {{7, Transform(5, 6, 0)}};
+        state.tick = 1;
+        client_agent.get_action(state);
+
+        DOCTEST_REQUIRE(registry.size<EcsBullet>() == 1);
+        const auto bullet = *registry.view<EcsBullet>().begin();
+        DOCTEST_CHECK(registry.get<Transform>(bullet).get_position() == glm::vec2{5.f, 6.f});
+    }
+}
 }
-}
\ No newline at end of file
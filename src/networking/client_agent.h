@@ -1,31 +1,45 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include <entt/entity/entity.hpp>
 #include <nlohmann/json.hpp>
 #include <torch/torch.h>
 
-#include "training/environments/ienvironment.h"
+#include "misc/transform.h"
 
 namespace ai
 {
+class EcsEnv;
 class IAgent;
+struct StateMessage;
 
 class ClientAgent
 {
   private:
     std::unique_ptr<IAgent> agent;
     int agent_number;
-    std::unique_ptr<IEnvironment> env;
+    std::unique_ptr<EcsEnv> env;
     torch::Tensor hidden_state;
+    int last_tick;
+    std::vector<Transform> last_transforms;
+    // The server's IDs for bullets, mapped to their entities in env
+    std::unordered_map<unsigned int, entt::entity> bullets;
+
+    void set_bullets(const StateMessage &state);
+    void set_state(const StateMessage &state);
 
   public:
     ClientAgent(std::unique_ptr<IAgent> agent,
                 int agent_number,
-                std::unique_ptr<IEnvironment> env);
+                std::unique_ptr<EcsEnv> env);
+    ~ClientAgent();
 
-    std::vector<int> get_action(const EnvState &env_state);
+    std::vector<int> get_action(const StateMessage &state);
     void set_bodies(const std::vector<nlohmann::json> &body_specs);
+
+    inline const IAgent &get_agent() const { return *agent; }
 };
-}
\ No newline at end of file
+}
@@ -1,44 +1,40 @@
-#include <chrono>
-#include <map>
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <vector>
 
-#include <Box2D/Box2D.h>
 #include <doctest.h>
+#include <entt/entt.hpp>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 #include <torch/torch.h>
 
 #include "game.h"
-#include "audio/audio_engine.h"
-#include "misc/module_factory.h"
-#include "misc/random.h"
-#include "training/entities/bullet.h"
-#include "training/entities/ientity.h"
-#include "training/environments/ienvironment.h"
-#include "training/environments/koth_env.h"
-#include "training/bodies/body.h"
-#include "training/bodies/test_body.h"
+#include "environment/components/activatable.h"
+#include "environment/components/body.h"
+#include "environment/components/bullet.h"
+#include "environment/components/modules/thruster_module.h"
+#include "environment/ecs_env.h"
+#include "environment/serialization/serialize_body.h"
+#include "misc/transform.h"
+#include "training/events/effect_triggered.h"
+#include "training/events/entity_destroyed.h"
 
 namespace ai
 {
-Game::Game(double tick_length,
-           BodyFactory &body_factory,
-           IEnvironmentFactory &env_factory,
-           Random &rng)
-    : body_factory(body_factory),
-      current_tick(0),
-      env_factory(env_factory),
+Game::Game(double tick_length, double game_length)
+    : current_tick(0),
+      game_length(game_length),
       last_tick_time(0),
-      rng(rng),
       tick_length(tick_length) {}
 
+Game::~Game() {}
+
 bool Game::add_body(nlohmann::json body_spec)
 {
     body_specs.push_back(body_spec);
 
-    if (static_cast<int>(body_specs.size()) == env_factory.get_num_bodies())
+    if (body_specs.size() == 2)
     {
         setup_env();
         return true;
@@ -46,6 +42,30 @@ bool Game::add_body(nlohmann::json body_spec)
     return false;
 }
 
+int Game::get_dropped_actions() const
+{
+    return action_store == nullptr ? 0 : action_store->get_dropped_actions();
+}
+
+int Game::get_late_actions() const
+{
+    return action_store == nullptr ? 0 : action_store->get_late_actions();
+}
+
+void Game::on_bullet_destroyed(entt::registry &registry, entt::entity entity)
+{
+    const auto *transform = registry.try_get<Transform>(entity);
+    const Transform bullet_transform = transform == nullptr ? Transform() : *transform;
+    const auto time = env->get_elapsed_time();
+
+    events.push_back(std::make_unique<EffectTriggered>(EffectTypes::BulletExplosion,
+                                                       time,
+                                                       bullet_transform));
+    events.push_back(std::make_unique<EntityDestroyed>(static_cast<unsigned int>(entity),
+                                                       time,
+                                                       bullet_transform));
+}
+
 bool Game::ready_to_tick(double current_time)
 {
     return current_time - last_tick_time >= tick_length && env != nullptr;
@@ -53,30 +73,29 @@ bool Game::ready_to_tick(double current_time)
 
 void Game::set_action(int tick, int player, const std::vector<int> &action)
 {
+    // Actions can arrive before every body has connected
+    if (action_store == nullptr)
+    {
+        return;
+    }
     action_store->add_action(tick, player, action);
 }
 
 void Game::setup_env()
 {
-    auto b2_world = std::make_unique<b2World>(b2Vec2{0, 0});
-    std::vector<std::unique_ptr<Body>> bodies;
-    std::vector<int> actions_per_player;
-    std::transform(body_specs.begin(), body_specs.end(),
-                   std::back_inserter(bodies),
-                   [&](const nlohmann::json &json) {
-                       auto body = body_factory.make(*b2_world, rng);
-                       body->load_json(json);
-                       actions_per_player.push_back(json["num_actions"]);
-                       return body;
-                   });
-
-    env = env_factory.make(std::make_unique<Random>(rng.next_int(0, 65535)),
-                           std::move(b2_world),
-                           std::move(bodies),
-                           RewardConfig());
+    env = std::make_unique<EcsEnv>(game_length);
     env->set_audibility(false);
+
+    std::vector<int> actions_per_player;
+    for (unsigned int i = 0; i < body_specs.size(); ++i)
+    {
+        env->set_body(i, body_specs[i]);
+        actions_per_player.push_back(body_specs[i]["num_actions"]);
+    }
     env->reset();
 
+    env->get_registry().on_destroy<EcsBullet>().connect<&Game::on_bullet_destroyed>(*this);
+
     action_store = std::make_unique<ActionStore>(actions_per_player);
 }
 
@@ -98,44 +117,51 @@ TickResult Game::tick(double current_time)
                                                {static_cast<long>(actions_vec.size())},
                                                torch::kInt);
                    });
-    for (int i = 0; i < 5; ++i)
+
+    // Same step/forward cadence as SingleRolloutGenerator, so the server
+    // simulates exactly what the agents were trained on
+    auto step_info = env->step(actions_tensors, frame_length);
+    auto &registry = env->get_registry();
+    registry.view<EcsThrusterModule, Activatable, Transform>().each(
+        [&](const auto &, const auto &activatable, const auto &transform) {
+            if (activatable.active)
+            {
+                events.push_back(std::make_unique<EffectTriggered>(EffectTypes::ThrusterParticles,
+                                                                   env->get_elapsed_time(),
+                                                                   transform));
+            }
+        });
+    for (int i = 0; i < frames_per_tick - 1; ++i)
     {
-        env->forward(1.f / 60.f);
-        env->clear_effects();
+        env->forward(frame_length);
     }
-    auto step_info = env->step(actions_tensors, 1.f / 60.f);
 
     ++current_tick;
 
     std::unordered_map<unsigned int, Transform> entity_transforms;
-    for (const auto &entity : env->get_entities())
-    {
-        auto b2_transform = entity.second->get_transform();
-        entity_transforms[entity.first] = {b2_transform.p.x,
-                                           b2_transform.p.y,
-                                           b2_transform.q.GetAngle()};
-    }
+    registry.view<EcsBullet, Transform>().each(
+        [&](auto entity, const auto &, const auto &transform) {
+            entity_transforms[static_cast<unsigned int>(entity)] = transform;
+        });
 
     std::vector<Transform> agent_transforms;
-    for (const auto &body : env->get_bodies())
-    {
-        auto b2_transform = body->get_rigid_body().body->GetTransform();
-        agent_transforms.push_back({b2_transform.p.x,
-                                    b2_transform.p.y,
-                                    b2_transform.q.GetAngle()});
-    }
-
     std::vector<float> hps;
-    for (const auto &body : env->get_bodies())
+    for (const auto &body_entity : env->get_bodies())
     {
-        hps.push_back(body->get_hp());
+        agent_transforms.push_back(registry.get<Transform>(body_entity));
+        hps.push_back(registry.get<EcsBody>(body_entity).hp);
     }
 
+    const auto scores = env->get_scores();
+
+    auto tick_events = std::move(events);
+    events.clear();
+
     return {std::move(agent_transforms),
             std::move(entity_transforms),
-            std::move(step_info.events),
+            std::move(tick_events),
             std::move(hps),
-            env->get_scores(),
+            {static_cast<float>(scores.first), static_cast<float>(scores.second)},
             step_info.done[0].item().toBool(),
             current_tick,
             step_info.victor};
@@ -143,40 +169,37 @@ TickResult Game::tick(double current_time)
 
 TEST_CASE("Game")
 {
-    Random rng(0);
-    MockAudioEngine audio_engine;
-    BulletFactory bullet_factory(audio_engine);
-    ModuleFactory module_factory(audio_engine, bullet_factory, rng);
-    TestBodyFactory body_factory(module_factory, rng);
-    KothEnvFactory env_factory(10, audio_engine, body_factory, bullet_factory);
-    Game game(0.1, body_factory, env_factory, rng);
+    Game game(0.1, 1);
 
     SUBCASE("add_body() returns true after enough bodies are added")
     {
-        TestBody test_body(module_factory, rng);
-        auto body_spec = test_body.to_json();
+        DOCTEST_CHECK(game.add_body(default_body()) == false);
+        DOCTEST_CHECK(game.add_body(default_body()) == true);
+    }
+
+    SUBCASE("set_action() ignores actions sent before the game starts")
+    {
+        game.add_body(default_body());
+        game.set_action(0, 0, {1, 1, 1, 1});
+        game.set_action(0, 5, {1, 1, 1, 1});
 
-        DOCTEST_CHECK(game.add_body(body_spec) == false);
-        DOCTEST_CHECK(game.add_body(body_spec) == true);
+        DOCTEST_CHECK(game.add_body(default_body()) == true);
     }
 
     SUBCASE("ready_to_tick()")
     {
-        TestBody test_body(module_factory, rng);
-        auto body_spec = test_body.to_json();
-
         SUBCASE("Returns false if bodies have not been added")
         {
             DOCTEST_CHECK(game.ready_to_tick(100) == false);
-            game.add_body(body_spec);
+            game.add_body(default_body());
             DOCTEST_CHECK(game.ready_to_tick(100) == false);
-            game.add_body(body_spec);
+            game.add_body(default_body());
         }
 
         SUBCASE("Returns false if called before tick is ready")
         {
-            game.add_body(body_spec);
-            game.add_body(body_spec);
+            game.add_body(default_body());
+            game.add_body(default_body());
 
             DOCTEST_CHECK(game.ready_to_tick(0) == false);
             DOCTEST_CHECK(game.ready_to_tick(0.05) == false);
@@ -185,8 +208,8 @@ TEST_CASE("Game")
 
         SUBCASE("Returns true if called after tick is ready")
         {
-            game.add_body(body_spec);
-            game.add_body(body_spec);
+            game.add_body(default_body());
+            game.add_body(default_body());
 
             DOCTEST_CHECK(game.ready_to_tick(0.1) == true);
             DOCTEST_CHECK(game.ready_to_tick(100) == true);
@@ -199,30 +222,44 @@ TEST_CASE("Game")
         {
             DOCTEST_CHECK_THROWS(game.tick(0));
 
-            TestBody test_body(module_factory, rng);
-            auto body_spec = test_body.to_json();
-            game.add_body(body_spec);
+            game.add_body(default_body());
 
             DOCTEST_CHECK_THROWS(game.tick(0));
         }
 
         SUBCASE("Returns a finished result within the maximum amount of time steps")
         {
-            TestBody test_body(module_factory, rng);
-            auto body_spec = test_body.to_json();
-
-            game.add_body(body_spec);
-            game.add_body(body_spec);
+            game.add_body(default_body());
+            game.add_body(default_body());
 
             bool finished = false;
-            for (int i = 0; i < 10; ++i)
+            for (int i = 0; i < 20; ++i)
             {
                 game.set_action(i, 0, {0, 0, 0, 0});
                 game.set_action(i, 1, {0, 0, 0, 0});
                 auto result = game.tick(0);
                 finished |= result.done;
             }
+
+            DOCTEST_CHECK(finished);
+        }
+
+        SUBCASE("Reports bullets in entity transforms")
+        {
+            game.add_body(default_body());
+            game.add_body(default_body());
+
+            bool saw_bullet = false;
+            for (int i = 0; i < 10; ++i)
+            {
+                game.set_action(i, 0, {1, 1, 1, 1});
+                game.set_action(i, 1, {1, 1, 1, 1});
+                auto result = game.tick(0);
+                saw_bullet |= !result.entity_transforms.empty();
+            }
+
+            DOCTEST_CHECK(saw_bullet);
         }
     }
 }
-}
\ No newline at end of file
+}
@@ -1,19 +1,25 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include <entt/fwd.hpp>
 #include <nlohmann/json.hpp>
 
 #include "third_party/di.hpp"
-#include "training/environments/ienvironment.h"
+#include "misc/transform.h"
 #include "networking/action_store.h"
 #include "networking/messages.h"
+#include "training/events/ievent.h"
 
 namespace ai
 {
-class BodyFactory;
-class Random;
+class EcsEnv;
+
+// Simulated time covered by one Game::tick()
+constexpr double frame_length = 1. / 60.;
+constexpr int frames_per_tick = 6;
 
 struct TickResult
 {
@@ -27,33 +33,35 @@ struct TickResult
     int victor;
 };
 
+static auto GameLength = [] {};
 static auto TickLength = [] {};
 
 class Game
 {
   private:
     std::unique_ptr<ActionStore> action_store;
-    BodyFactory &body_factory;
     std::vector<nlohmann::json> body_specs;
     int current_tick;
-    std::unique_ptr<IEnvironment> env;
-    IEnvironmentFactory &env_factory;
+    std::unique_ptr<EcsEnv> env;
+    std::vector<std::unique_ptr<IEvent>> events;
+    double game_length;
     double last_tick_time;
-    Random &rng;
     double tick_length;
 
+    void on_bullet_destroyed(entt::registry &registry, entt::entity entity);
     void setup_env();
 
   public:
     BOOST_DI_INJECT(Game,
                     (named = TickLength) double tick_length,
-                    BodyFactory &body_factory,
-                    IEnvironmentFactory &env_factory,
-                    Random &rng);
+                    (named = GameLength) double game_length);
+    ~Game();
 
     bool add_body(nlohmann::json body_spec);
+    int get_dropped_actions() const;
+    int get_late_actions() const;
     bool ready_to_tick(double current_time);
     void set_action(int tick, int player, const std::vector<int> &action);
     TickResult tick(double current_time);
 };
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <stdexcept>
 #include <string>
@@ -21,7 +22,9 @@ enum class MessageType
     ConnectConfirmation = 1,
     Action = 2,
     GameStart = 3,
-    State = 4
+    State = 4,
+    RolloutChunk = 5,
+    Policy = 6
 };
 
 struct Message
@@ -135,6 +138,49 @@ struct StateMessage : Message
     }
 };
 
+// Experience gathered by a rollout worker, with the version of the policy
+// that gathered it. The rollout's tensors are stored one after the other as
+// zlib compressed floats.
+struct RolloutChunkMessage : Message
+{
+    std::string worker_id;
+    unsigned long long policy_version;
+    int num_steps;
+    int num_processes;
+    std::vector<std::vector<std::int64_t>> shapes;
+    unsigned long long raw_size;
+    std::vector<char> data;
+
+    RolloutChunkMessage()
+    {
+        type = MessageType::RolloutChunk;
+    }
+
+    MSGPACK_DEFINE_ARRAY(MSGPACK_BASE(Message),
+                         worker_id,
+                         policy_version,
+                         num_steps,
+                         num_processes,
+                         shapes,
+                         raw_size,
+                         data)
+};
+
+// The learner's latest policy weights, zlib compressed the same way
+struct PolicyMessage : Message
+{
+    unsigned long long policy_version;
+    unsigned long long raw_size;
+    std::vector<char> weights;
+
+    PolicyMessage()
+    {
+        type = MessageType::Policy;
+    }
+
+    MSGPACK_DEFINE_ARRAY(MSGPACK_BASE(Message), policy_version, raw_size, weights)
+};
+
 inline MessageType get_message_type(const msgpack::object &object)
 {
     return static_cast<MessageType>(object.via.array.ptr[0].via.array.ptr[0].as<int>());
@@ -11,10 +11,10 @@
 #include <spdlog/spdlog.h>
 
 #include "server_app.h"
-#include "audio/audio_engine.h"
-#include "misc/module_factory.h"
+#include "environment/ecs_env.h"
+#include "environment/serialization/serialize_body.h"
 #include "misc/random.h"
-#include "misc/resource_manager.h"
+#include "networking/binary_codec.h"
 #include "networking/client_communicator.h"
 #include "networking/client_agent.h"
 #include "networking/game.h"
@@ -24,9 +24,6 @@
 #include "third_party/httplib.h"
 #include "third_party/zmq.hpp"
 #include "training/agents/random_agent.h"
-#include "training/bodies/test_body.h"
-#include "training/entities/bullet.h"
-#include "training/environments/koth_env.h"
 
 namespace di = boost::di;
 
@@ -43,15 +40,7 @@ void run_client(const std::string &id, const std::string &token)
     ClientCommunicator client_communicator(std::move(client_socket));
 
     Random rng(0);
-    MockAudioEngine audio_engine;
-    BulletFactory bullet_factory(audio_engine);
-    ModuleFactory module_factory(audio_engine, bullet_factory, rng);
-    TestBodyFactory body_factory(module_factory, rng);
-    KothEnvFactory env_factory(100, audio_engine, body_factory, bullet_factory);
-    auto env = env_factory.make();
-
-    auto body_spec = env->get_bodies()[0]->to_json();
-
+    auto body_spec = default_body();
     auto agent = std::make_unique<RandomAgent>(body_spec, rng, "Random agent");
 
     std::unique_ptr<ClientAgent> client_agent;
@@ -69,13 +58,28 @@ void run_client(const std::string &id, const std::string &token)
             continue;
         }
 
+        if (BinaryCodec::is_binary(raw_message))
+        {
+            auto message = BinaryCodec::decode<StateMessage>(raw_message);
+            finished = message.done;
+
+            auto action = client_agent->get_action(message);
+
+            ActionMessage action_message(action, message.tick);
+            auto encoded_action_message = BinaryCodec::encode(action_message);
+            client_communicator.send(encoded_action_message);
+            continue;
+        }
+
         auto message_object = MsgPackCodec::decode<msgpack::object_handle>(raw_message);
 
         auto type = get_message_type(message_object.get());
         if (type == MessageType::ConnectConfirmation)
         {
             auto message = message_object->as<ConnectConfirmationMessage>();
-            client_agent = std::make_unique<ClientAgent>(std::move(agent), message.player_number, std::move(env));
+            client_agent = std::make_unique<ClientAgent>(std::move(agent),
+                                                         message.player_number,
+                                                         std::make_unique<EcsEnv>());
         }
         else if (type == MessageType::GameStart)
         {
@@ -88,34 +92,14 @@ void run_client(const std::string &id, const std::string &token)
                            });
             client_agent->set_bodies(body_specs);
         }
-        else if (type == MessageType::State)
-        {
-            spdlog::debug("Received state message: {}", message_object.get());
-            auto message = message_object->as<StateMessage>();
-            finished = message.done;
-
-            auto action = client_agent->get_action(EnvState(message.agent_transforms,
-                                                            message.entity_transforms,
-                                                            message.hps,
-                                                            message.scores,
-                                                            message.tick));
-
-            ActionMessage action_message(action, message.tick);
-            auto encoded_action_message = MsgPackCodec::encode(action_message);
-            client_communicator.send(encoded_action_message);
-        }
     }
 }
 
 TEST_CASE("Network")
 {
     const auto injector = di::make_injector(
-        di::bind<int>.named(MaxSteps).to(100),
-        di::bind<double>.named(TickLength).to(0.001),
-        di::bind<IEnvironmentFactory>.to<KothEnvFactory>(),
-        di::bind<IAudioEngine>.to<AudioEngine>(),
-        di::bind<IModuleFactory>.to<ModuleFactory>(),
-        di::bind<IBulletFactory>.to<BulletFactory>());
+        di::bind<double>.named(GameLength).to(10.),
+        di::bind<double>.named(TickLength).to(0.001));
     auto app = injector.create<ServerApp>();
     char filepath[] = "./asd";
     char quiet[] = "--quiet";
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "simulated_client.h"
+#include "environment/ecs_env.h"
+#include "networking/binary_codec.h"
+#include "networking/client_agent.h"
+#include "networking/client_communicator.h"
+#include "networking/messages.h"
+#include "networking/msgpack_codec.h"
+#include "training/agents/iagent.h"
+
+namespace ai
+{
+SimulatedClient::SimulatedClient(std::unique_ptr<IAgent> agent,
+                                 std::unique_ptr<ClientCommunicator> client_communicator)
+    : agent(std::move(agent)),
+      client_communicator(std::move(client_communicator)),
+      finished(false),
+      last_action_tick(-1),
+      last_action_time(0) {}
+
+SimulatedClient::~SimulatedClient() {}
+
+void SimulatedClient::connect(double current_time)
+{
+    stats.start_time = current_time;
+    ConnectMessage connect_message(agent->get_body_spec().dump(), "");
+    send(MsgPackCodec::encode(connect_message));
+}
+
+void SimulatedClient::handle_message(const std::string &raw_message, double current_time)
+{
+    if (BinaryCodec::is_binary(raw_message))
+    {
+        if (BinaryCodec::get_message_type(raw_message) == MessageType::State)
+        {
+            handle_state(BinaryCodec::decode<StateMessage>(raw_message), current_time);
+        }
+        return;
+    }
+
+    auto message_object = MsgPackCodec::decode<msgpack::object_handle>(raw_message);
+    auto type = get_message_type(message_object.get());
+
+    if (type == MessageType::ConnectConfirmation)
+    {
+        auto message = message_object->as<ConnectConfirmationMessage>();
+        client_agent = std::make_unique<ClientAgent>(std::move(agent),
+                                                     message.player_number,
+                                                     std::make_unique<EcsEnv>());
+    }
+    else if (type == MessageType::GameStart)
+    {
+        auto message = message_object->as<GameStartMessage>();
+        std::vector<nlohmann::json> body_specs;
+        std::transform(message.body_specs.begin(), message.body_specs.end(),
+                       std::back_inserter(body_specs),
+                       [](const std::string &body_spec_string) {
+                           return nlohmann::json::parse(body_spec_string);
+                       });
+        client_agent->set_bodies(body_specs);
+    }
+}
+
+void SimulatedClient::handle_state(const StateMessage &message, double current_time)
+{
+    stats.last_tick = message.tick;
+
+    // The state for the tick after the one we acted on is the first
+    // point at which we know the server has consumed our action
+    if (last_action_tick >= 0 && message.tick > last_action_tick)
+    {
+        stats.round_trip_times.push_back(current_time - last_action_time);
+        stats.tick_lags.push_back(message.tick - last_action_tick - 1);
+    }
+
+    if (message.done)
+    {
+        finished = true;
+        stats.finish_time = current_time;
+        return;
+    }
+
+    auto action = client_agent->get_action(message);
+    ActionMessage action_message(action, message.tick);
+    send(BinaryCodec::encode(action_message));
+    last_action_tick = message.tick;
+    last_action_time = current_time;
+}
+
+void SimulatedClient::send(const std::string &message)
+{
+    stats.bytes_sent += message.size();
+    client_communicator->send(message);
+}
+
+bool SimulatedClient::update(double current_time)
+{
+    bool received = false;
+    while (!finished)
+    {
+        std::string raw_message = client_communicator->get();
+        if (raw_message.empty())
+        {
+            break;
+        }
+        received = true;
+        stats.bytes_received += raw_message.size();
+        handle_message(raw_message, current_time);
+    }
+
+    return received;
+}
+
+double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    const auto index = std::min(values.size() - 1,
+                                static_cast<std::size_t>(std::floor(fraction *
+                                                                    static_cast<double>(values.size()))));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return values[index];
+}
+
+TEST_CASE("percentile()")
+{
+    SUBCASE("Returns 0 for no values")
+    {
+        DOCTEST_CHECK(percentile({}, 0.5) == 0);
+    }
+
+    SUBCASE("Returns correct values")
+    {
+        std::vector<double> values{5, 1, 4, 2, 3};
+
+        DOCTEST_CHECK(percentile(values, 0) == 1);
+        DOCTEST_CHECK(percentile(values, 0.5) == 3);
+        DOCTEST_CHECK(percentile(values, 1) == 5);
+    }
+}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ai
+{
+class ClientAgent;
+class ClientCommunicator;
+class IAgent;
+struct StateMessage;
+
+struct ClientStats
+{
+    std::size_t bytes_received = 0;
+    std::size_t bytes_sent = 0;
+    double finish_time = 0;
+    int last_tick = 0;
+    std::vector<double> round_trip_times;
+    double start_time = 0;
+    std::vector<int> tick_lags;
+};
+
+// Headless multiplayer client used for load testing: plays a whole game
+// against a server through a ClientCommunicator and records timings
+class SimulatedClient
+{
+  private:
+    std::unique_ptr<IAgent> agent;
+    std::unique_ptr<ClientAgent> client_agent;
+    std::unique_ptr<ClientCommunicator> client_communicator;
+    bool finished;
+    int last_action_tick;
+    double last_action_time;
+    ClientStats stats;
+
+    void handle_message(const std::string &raw_message, double current_time);
+    void handle_state(const StateMessage &message, double current_time);
+    void send(const std::string &message);
+
+  public:
+    SimulatedClient(std::unique_ptr<IAgent> agent,
+                    std::unique_ptr<ClientCommunicator> client_communicator);
+    ~SimulatedClient();
+
+    void connect(double current_time);
+    bool update(double current_time);
+
+    inline const ClientStats &get_stats() const { return stats; }
+    inline bool is_finished() const { return finished; }
+};
+
+double percentile(std::vector<double> values, double fraction);
+}
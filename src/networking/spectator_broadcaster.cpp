@@ -0,0 +1,151 @@
+#include <memory>
+#include <string>
+
+#include <doctest.h>
+#include <spdlog/spdlog.h>
+
+#include "spectator_broadcaster.h"
+#include "networking/messages.h"
+#include "networking/msgpack_codec.h"
+#include "third_party/zmq.hpp"
+#include "third_party/zmq_addon.hpp"
+
+namespace ai
+{
+SpectatorBroadcaster::SpectatorBroadcaster(std::unique_ptr<zmq::socket_t> socket,
+                                           const std::string &topic)
+    : socket(std::move(socket)),
+      subscriber_count(0),
+      topic(topic)
+{
+    // Pass every subscription and unsubscription through, not just the first
+    // and last per topic, so each late joiner triggers a keyframe and the
+    // subscriber count stays right with several spectators
+    this->socket->setsockopt(ZMQ_XPUB_VERBOSER, 1);
+}
+
+void SpectatorBroadcaster::publish(const std::string &message)
+{
+    socket->send(zmq::message_t(topic.data(), topic.size()),
+                 zmq::send_flags::dontwait | zmq::send_flags::sndmore);
+    socket->send(zmq::message_t(message.data(), message.size()),
+                 zmq::send_flags::dontwait);
+}
+
+void SpectatorBroadcaster::publish_game_start(const std::string &encoded_game_start)
+{
+    game_start = encoded_game_start;
+    publish(game_start);
+}
+
+void SpectatorBroadcaster::publish_state(const std::string &encoded_state)
+{
+    latest_state = encoded_state;
+    publish(latest_state);
+}
+
+void SpectatorBroadcaster::update()
+{
+    bool send_keyframe = false;
+    while (true)
+    {
+        zmq::message_t message;
+        socket->recv(message, zmq::recv_flags::dontwait);
+        if (message.empty())
+        {
+            break;
+        }
+
+        // Subscription messages are a 1 (subscribe) or 0 (unsubscribe) byte
+        // followed by the topic
+        const auto *data = static_cast<const char *>(message.data());
+        if (data[0] == 1)
+        {
+            ++subscriber_count;
+            send_keyframe = true;
+            spdlog::debug("Spectator joined ({} watching)", subscriber_count);
+        }
+        else if (data[0] == 0 && subscriber_count > 0)
+        {
+            --subscriber_count;
+        }
+    }
+
+    // One keyframe covers every spectator that joined since the last update.
+    // Spectators already watching just see a repeated state.
+    if (send_keyframe && !game_start.empty())
+    {
+        publish(game_start);
+        if (!latest_state.empty())
+        {
+            publish(latest_state);
+        }
+    }
+}
+
+TEST_CASE("SpectatorBroadcaster")
+{
+    zmq::context_t context;
+
+    auto publisher_socket = std::make_unique<zmq::socket_t>(context, zmq::socket_type::xpub);
+    publisher_socket->bind("inproc://spectator_test");
+    SpectatorBroadcaster broadcaster(std::move(publisher_socket), "match");
+
+    zmq::socket_t spectator_socket(context, zmq::socket_type::sub);
+    spectator_socket.connect("inproc://spectator_test");
+    spectator_socket.setsockopt(ZMQ_SUBSCRIBE, "match", 5);
+
+    auto receive = [&] {
+        zmq::multipart_t message;
+        message.recv(spectator_socket, static_cast<int>(zmq::recv_flags::none));
+        return std::string(static_cast<char *>(message[1].data()), message[1].size());
+    };
+
+    SUBCASE("Late joiners receive a keyframe")
+    {
+        GameStartMessage game_start({"asd", "sdf"});
+        broadcaster.publish_game_start(MsgPackCodec::encode(game_start));
+        broadcaster.publish_state("state");
+
+        while (broadcaster.get_subscriber_count() == 0)
+        {
+            broadcaster.update();
+        }
+
+        auto keyframe = MsgPackCodec::decode<GameStartMessage>(receive());
+        DOCTEST_CHECK(keyframe.body_specs == game_start.body_specs);
+        DOCTEST_CHECK(receive() == "state");
+    }
+
+    SUBCASE("Subscribers receive published states")
+    {
+        while (broadcaster.get_subscriber_count() == 0)
+        {
+            broadcaster.update();
+        }
+
+        broadcaster.publish_state("state");
+
+        DOCTEST_CHECK(receive() == "state");
+    }
+
+    SUBCASE("Every spectator is counted, and uncounted when they leave")
+    {
+        zmq::socket_t other_spectator_socket(context, zmq::socket_type::sub);
+        other_spectator_socket.connect("inproc://spectator_test");
+        other_spectator_socket.setsockopt(ZMQ_SUBSCRIBE, "match", 5);
+        while (broadcaster.get_subscriber_count() < 2)
+        {
+            broadcaster.update();
+        }
+
+        other_spectator_socket.setsockopt(ZMQ_UNSUBSCRIBE, "match", 5);
+        while (broadcaster.get_subscriber_count() == 2)
+        {
+            broadcaster.update();
+        }
+
+        DOCTEST_CHECK(broadcaster.get_subscriber_count() == 1);
+    }
+}
+}
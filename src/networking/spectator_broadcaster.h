@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "third_party/zmq.hpp"
+#include "third_party/zmq_addon.hpp"
+
+namespace ai
+{
+// Publishes a match's encoded messages to any number of spectators over a
+// single XPUB socket, so fan-out costs the tick loop one send per message.
+// Spectators that subscribe mid-match are sent a keyframe (the game start
+// message and the latest state) to catch up from.
+class SpectatorBroadcaster
+{
+  private:
+    std::string game_start;
+    std::string latest_state;
+    std::unique_ptr<zmq::socket_t> socket;
+    int subscriber_count;
+    std::string topic;
+
+    void publish(const std::string &message);
+
+  public:
+    SpectatorBroadcaster(std::unique_ptr<zmq::socket_t> socket, const std::string &topic);
+
+    void publish_game_start(const std::string &encoded_game_start);
+    void publish_state(const std::string &encoded_state);
+    void update();
+
+    inline int get_subscriber_count() const { return subscriber_count; }
+};
+}
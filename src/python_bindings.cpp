@@ -1,10 +1,15 @@
+#include <chrono>
+#include <future>
 #include <string>
 
+#include <fmt/format.h>
 #include <nlohmann/json.hpp>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <spdlog/spdlog.h>
 
+#include "environment/vec_env.h"
 #include "misc/module_factory.h"
 #include "misc/random.h"
 #include "third_party/di.hpp"
@@ -13,6 +18,8 @@
 #include "training/environments/ienvironment.h"
 #include "training/environments/koth_env.h"
 #include "training/evaluators/elo_evaluator.h"
+#include "training/metric_ring.h"
+#include "training/population.h"
 #include "training/saver.h"
 #include "training/trainer.h"
 
@@ -20,16 +27,170 @@ namespace py = pybind11;
 namespace di = boost::di;
 
 using namespace ai;
+
+namespace
+{
+// Wraps a buffer owned by vec_env without copying it. The VecEnv is kept
+// alive for as long as the array is, and the contents change on every step.
+template <typename T>
+py::array_t<T> share_buffer(VecEnv &vec_env,
+                            const T *data,
+                            std::vector<py::ssize_t> shape)
+{
+    return py::array_t<T>(shape, data, py::cast(&vec_env));
+}
+
+// Futures for work running on a Trainer's worker thread. Waiting releases
+// the GIL so other Python threads keep running.
+template <typename T>
+void bind_future(py::module &m, const char *name)
+{
+    py::class_<std::shared_future<T>>(m, name)
+        .def("done", [](const std::shared_future<T> &future) {
+            return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        })
+        .def("result", [](const std::shared_future<T> &future, py::object timeout) {
+            const auto wait_all = timeout.is_none();
+            const auto seconds = wait_all ? 0. : timeout.cast<double>();
+            auto ready = true;
+            {
+                py::gil_scoped_release release;
+                if (wait_all)
+                {
+                    future.wait();
+                }
+                else
+                {
+                    ready = future.wait_for(std::chrono::duration<double>(seconds)) ==
+                            std::future_status::ready;
+                }
+            }
+            if (!ready)
+            {
+                throw py::value_error("Timed out waiting for result");
+            }
+            return future.get();
+        },
+             py::arg("timeout") = py::none());
+}
+
+py::tuple get_step_result(VecEnv &vec_env)
+{
+    const auto env_count = static_cast<py::ssize_t>(vec_env.get_env_count());
+    return py::make_tuple(
+        share_buffer(vec_env, vec_env.get_observations(),
+                     {env_count, 2, vec_env.get_observation_size()}),
+        share_buffer(vec_env, vec_env.get_rewards(), {env_count, 2}),
+        share_buffer(vec_env, vec_env.get_dones(), {env_count}),
+        share_buffer(vec_env, vec_env.get_victors(), {env_count}));
+}
+}
+
 PYBIND11_MODULE(artificial_insentience, m)
 {
     m.doc() = "AI: Artificial Insentience Python bindings";
 
+    py::class_<TrainingMetric>(m, "TrainingMetric")
+        .def_readonly("name", &TrainingMetric::name)
+        .def_readonly("value", &TrainingMetric::value)
+        .def_readonly("timestep", &TrainingMetric::timestep)
+        .def_readonly("batch_number", &TrainingMetric::batch_number)
+        .def("__repr__", [](const TrainingMetric &metric) {
+            return fmt::format("TrainingMetric({}={}, timestep={})",
+                               metric.name,
+                               metric.value,
+                               metric.timestep);
+        });
+
+    py::class_<MetricRing>(m, "MetricRing")
+        .def("poll", [](const MetricRing &metrics, unsigned long long cursor) {
+            unsigned long long dropped = 0;
+            auto records = metrics.poll(cursor, &dropped);
+            return py::make_tuple(std::move(records), cursor, dropped);
+        },
+             py::arg("cursor") = 0,
+             "Records from cursor on, returned as (records, next_cursor, dropped)")
+        .def_property_readonly("next_sequence", &MetricRing::get_next_sequence);
+
+    bind_future<double>(m, "EvaluationFuture");
+    bind_future<std::vector<TrainingMetric>>(m, "BatchFuture");
+
+    // The synchronous calls wait on the same worker thread as the async
+    // ones, so they never run while a queued batch is changing the policy
     py::class_<Trainer>(m, "Trainer")
-        .def("evaluate", &Trainer::evaluate)
+        .def("evaluate", [](Trainer &trainer) {
+            return trainer.evaluate_async().get();
+        },
+             py::call_guard<py::gil_scoped_release>())
+        .def("evaluate_async", [](Trainer &trainer) {
+            return trainer.evaluate_async().share();
+        },
+             "Queue an evaluation on the trainer's worker thread")
         .def("save_model", [](Trainer &trainer, std::string directory) {
-            return trainer.save_model(directory).string();
-        })
-        .def("step_batch", &Trainer::step_batch);
+            return trainer.save_model_async(directory).get().string();
+        },
+             py::call_guard<py::gil_scoped_release>())
+        .def("step_batch", [](Trainer &trainer) {
+            return trainer.step_batch_async().get();
+        },
+             py::call_guard<py::gil_scoped_release>())
+        .def("step_batch_async", [](Trainer &trainer) {
+            return trainer.step_batch_async().share();
+        },
+             "Queue a batch on the trainer's worker thread")
+        .def_property_readonly("metrics", &Trainer::get_metrics, py::return_value_policy::reference_internal)
+        .def_property_readonly("timestep", &Trainer::get_timestep);
+
+    py::class_<VecEnv>(m, "VecEnv",
+                       "A batch of games in which both bodies are controlled from Python.\n\n"
+                       "Arrays returned by reset() and step() share memory with the VecEnv "
+                       "and are overwritten by the next call. Finished games are reset "
+                       "automatically.")
+        .def(py::init([](const std::string &body_json,
+                         std::size_t num_envs,
+                         double game_length,
+                         unsigned int num_threads) {
+                 return std::make_unique<VecEnv>(num_envs,
+                                                 nlohmann::json::parse(body_json),
+                                                 game_length,
+                                                 num_threads);
+             }),
+             py::arg("body_json"),
+             py::arg("num_envs"),
+             py::arg("game_length") = 60.,
+             py::arg("num_threads") = 0)
+        .def("reset", [](VecEnv &vec_env) {
+            {
+                py::gil_scoped_release release;
+                vec_env.reset();
+            }
+            return get_step_result(vec_env);
+        },
+             "Reset every game, returning (observations, rewards, dones, victors)")
+        .def("step", [](VecEnv &vec_env,
+                        py::array_t<float, py::array::c_style | py::array::forcecast> actions) {
+            const auto env_count = static_cast<py::ssize_t>(vec_env.get_env_count());
+            if (actions.ndim() != 3 ||
+                actions.shape(0) != env_count ||
+                actions.shape(1) != 2 ||
+                actions.shape(2) != vec_env.get_action_size())
+            {
+                throw py::value_error(fmt::format("Expected actions of shape ({}, 2, {})",
+                                                  env_count,
+                                                  vec_env.get_action_size()));
+            }
+            {
+                py::gil_scoped_release release;
+                vec_env.step(actions.data());
+            }
+            return get_step_result(vec_env);
+        },
+             py::arg("actions"),
+             "Step every game with actions shaped (num_envs, 2, action_size), "
+             "returning (observations, rewards, dones, victors)")
+        .def_property_readonly("num_envs", &VecEnv::get_env_count)
+        .def_property_readonly("observation_size", &VecEnv::get_observation_size)
+        .def_property_readonly("action_size", &VecEnv::get_action_size);
 
     m.def("make_trainer", [](const std::string &program_json) {
         // Logging
@@ -49,4 +210,49 @@ PYBIND11_MODULE(artificial_insentience, m)
         return trainer_factory.make(program);
     },
           "Make a Trainer");
+
+    py::class_<Population>(m, "Population")
+        .def("add_members_to_opponent_pool", &Population::add_members_to_opponent_pool,
+             py::call_guard<py::gil_scoped_release>())
+        .def("evaluate", &Population::evaluate,
+             py::arg("games_per_member"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("exploit_and_explore", &Population::exploit_and_explore,
+             py::arg("quantile") = 0.25f,
+             py::call_guard<py::gil_scoped_release>())
+        .def("member", &Population::get_member, py::return_value_policy::reference_internal)
+        .def("step_batch", &Population::step_batch, py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("fitness", &Population::get_fitness)
+        .def("__len__", &Population::size);
+
+    m.def("make_population", [](const std::vector<std::string> &program_jsons,
+                                unsigned int num_threads) {
+        spdlog::set_level(spdlog::level::debug);
+        spdlog::set_pattern("%^[%T %7l] %v%$");
+
+        std::vector<TrainingProgram> programs;
+        for (const auto &program_json : program_jsons)
+        {
+            auto json = nlohmann::json::parse(program_json);
+            programs.emplace_back(json);
+        }
+
+        // Members hold on to the injector's singletons for as long as they
+        // live, so it has to outlast every population
+        static const auto injector = di::make_injector(
+            di::bind<IEnvironmentFactory>.to<KothEnvFactory>(),
+            di::bind<int>.named(MaxSteps).to(600),
+            di::bind<ISaver>.to<Saver>(),
+            di::bind<std::string>.named(CheckpointDirectory).to("checkpoints"));
+        auto &trainer_factory = injector.create<TrainerFactory &>();
+        auto &rng = injector.create<Random &>();
+
+        return std::make_unique<Population>(std::move(programs),
+                                            trainer_factory,
+                                            rng,
+                                            num_threads);
+    },
+          py::arg("programs"),
+          py::arg("num_threads") = 0,
+          "Make a Population training one member per program");
 }
\ No newline at end of file
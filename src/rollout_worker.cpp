@@ -0,0 +1,34 @@
+#include <chrono>
+#include <string>
+
+#include "rollout_worker_app.h"
+#include "audio/audio_engine.h"
+#include "misc/module_factory.h"
+#include "misc/random.h"
+#include "third_party/di.hpp"
+#include "training/checkpointer.h"
+#include "training/entities/bullet.h"
+#include "training/environments/ienvironment.h"
+#include "training/environments/koth_env.h"
+#include "training/saver.h"
+#include "training/trainer.h"
+
+using namespace ai;
+
+namespace di = boost::di;
+
+int main(int argc, char *argv[])
+{
+    const auto injector = di::make_injector(
+        di::bind<int>.named(MaxSteps).to(600),
+        // Workers must each play different games
+        di::bind<int>.named(RandomSeed).to(static_cast<int>(std::chrono::high_resolution_clock::now().time_since_epoch().count())),
+        di::bind<IEnvironmentFactory>.to<KothEnvFactory>(),
+        di::bind<ISaver>.to<Saver>(),
+        di::bind<std::string>.named(CheckpointDirectory).to("checkpoints"),
+        di::bind<IAudioEngine>.to<AudioEngine>(),
+        di::bind<IModuleFactory>.to<ModuleFactory>(),
+        di::bind<IBulletFactory>.to<BulletFactory>());
+    auto app = injector.create<RolloutWorkerApp>();
+    return app.run(argc, argv);
+}
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <torch/torch.h>
+
+#include "rollout_worker_app.h"
+#include "third_party/zmq.hpp"
+#include "training/distributed/rollout_worker.h"
+#include "training/training_program.h"
+
+namespace
+{
+volatile sig_atomic_t stop;
+
+void inthand(int /*signum*/)
+{
+    stop = 1;
+}
+}
+
+namespace ai
+{
+RolloutWorkerApp::RolloutWorkerApp(SingleRolloutGeneratorFactory &single_rollout_generator_factory,
+                                   TrainerFactory &trainer_factory)
+    : single_rollout_generator_factory(single_rollout_generator_factory),
+      trainer_factory(trainer_factory)
+{
+    // Logging
+    spdlog::set_level(spdlog::level::info);
+    spdlog::set_pattern("%^[%T %7l] %v%$");
+
+    signal(SIGINT, inthand);
+}
+
+int RolloutWorkerApp::run(int argc, char *argv[])
+{
+    argh::parser args(argv);
+    if (args[{"-t", "--test"}])
+    {
+        return run_tests(argc, argv, args);
+    }
+
+    std::string address;
+    args({"-a", "--address"}, "tcp://localhost") >> address;
+    int rollout_port;
+    args({"--rollout-port"}, 7300) >> rollout_port;
+    int policy_port;
+    args({"--policy-port"}, 7301) >> policy_port;
+    int env_count;
+    args({"-e", "--envs"}, 4) >> env_count;
+    std::string worker_id;
+    args({"--id"}, fmt::format("worker-{}", getpid())) >> worker_id;
+
+    std::ifstream file(args[1]);
+    auto json = nlohmann::json::parse(file);
+    TrainingProgram program(json);
+    torch::manual_seed(static_cast<std::uint64_t>(getpid()));
+    // Each worker runs as many environments as suit its machine, the
+    // learner waits for as many as the program asks for
+    program.hyper_parameters.num_env = env_count;
+
+    zmq::context_t zmq_context;
+    auto rollout_socket = std::make_unique<zmq::socket_t>(zmq_context, zmq::socket_type::push);
+    rollout_socket->setsockopt(ZMQ_LINGER, 0);
+    rollout_socket->connect(fmt::format("{}:{}", address, rollout_port));
+    auto policy_socket = std::make_unique<zmq::socket_t>(zmq_context, zmq::socket_type::sub);
+    policy_socket->setsockopt(ZMQ_LINGER, 0);
+    policy_socket->setsockopt(ZMQ_SUBSCRIBE, "", 0);
+    policy_socket->connect(fmt::format("{}:{}", address, policy_port));
+
+    RolloutWorker worker(worker_id,
+                         program,
+                         std::move(rollout_socket),
+                         std::move(policy_socket),
+                         trainer_factory,
+                         single_rollout_generator_factory);
+
+    spdlog::info("{} waiting for a policy from {}:{}", worker_id, address, policy_port);
+    while (!stop && !worker.receive_policy(std::chrono::milliseconds(500)))
+    {
+    }
+
+    while (!stop)
+    {
+        worker.receive_policy(std::chrono::milliseconds(0));
+        worker.send_rollout();
+        spdlog::info("{} sent batch {} from policy version {}",
+                     worker_id,
+                     worker.get_batches_sent(),
+                     worker.get_policy_version());
+    }
+    worker.stop();
+
+    return 0;
+}
+
+int RolloutWorkerApp::run_tests(int argc, char *argv[], const argh::parser &args)
+{
+    if (!args["--with-logs"])
+    {
+        spdlog::set_level(spdlog::level::off);
+    }
+    doctest::Context context;
+
+    context.setOption("order-by", "name");
+
+    context.applyCommandLine(argc, argv);
+
+    return context.run();
+}
+}
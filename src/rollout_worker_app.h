@@ -0,0 +1,24 @@
+#pragma once
+
+#include <argh.h>
+
+namespace ai
+{
+class SingleRolloutGeneratorFactory;
+class TrainerFactory;
+
+class RolloutWorkerApp
+{
+  private:
+    SingleRolloutGeneratorFactory &single_rollout_generator_factory;
+    TrainerFactory &trainer_factory;
+
+    int run_tests(int argc, char *argv[], const argh::parser &args);
+
+  public:
+    RolloutWorkerApp(SingleRolloutGeneratorFactory &single_rollout_generator_factory,
+                     TrainerFactory &trainer_factory);
+
+    int run(int argc, char *argv[]);
+};
+}
@@ -13,6 +13,7 @@
 #include <spdlog/spdlog.h>
 
 #include "multiplayer_screen.h"
+#include "environment/ecs_env.h"
 #include "graphics/backend/shader.h"
 #include "graphics/post_processing/post_proc_layer.h"
 #include "graphics/renderers/renderer.h"
@@ -23,6 +24,7 @@
 #include "misc/random.h"
 #include "misc/resource_manager.h"
 #include "misc/screen_manager.h"
+#include "networking/binary_codec.h"
 #include "networking/client_agent.h"
 #include "networking/client_communicator.h"
 #include "networking/messages.h"
@@ -246,23 +248,17 @@ void MultiplayerScreen::play(double delta_time)
             break;
         }
 
-        auto message_object = MsgPackCodec::decode<msgpack::object_handle>(raw_message);
-
-        auto type = get_message_type(message_object.get());
-        if (type != MessageType::State)
+        if (!BinaryCodec::is_binary(raw_message) ||
+            BinaryCodec::get_message_type(raw_message) != MessageType::State)
         {
             continue;
         }
-        auto message = message_object->as<StateMessage>();
+        auto message = BinaryCodec::decode<StateMessage>(raw_message);
 
-        auto action = client_agent->get_action(EnvState(message.agent_transforms,
-                                                        message.entity_transforms,
-                                                        message.hps,
-                                                        message.scores,
-                                                        message.tick));
+        auto action = client_agent->get_action(message);
 
         ActionMessage action_message(action, message.tick);
-        auto encoded_action_message = MsgPackCodec::encode(action_message);
+        auto encoded_action_message = BinaryCodec::encode(action_message);
         client_communicator->send(encoded_action_message);
 
         env->add_new_state(EnvState(message.agent_transforms,
@@ -353,7 +349,7 @@ void MultiplayerScreen::wait_for_start()
     ImGui::End();
 
     std::string raw_message = client_communicator->get();
-    if (raw_message.empty())
+    if (raw_message.empty() || BinaryCodec::is_binary(raw_message))
     {
         return;
     }
@@ -366,7 +362,9 @@ void MultiplayerScreen::wait_for_start()
         spdlog::info("Received connection confirmation");
         auto message = message_object->as<ConnectConfirmationMessage>();
         auto body_spec = env->get_bodies()[0]->to_json();
-        client_agent = std::make_unique<ClientAgent>(std::move(agent), message.player_number, env_factory.make());
+        client_agent = std::make_unique<ClientAgent>(std::move(agent),
+                                                     message.player_number,
+                                                     std::make_unique<EcsEnv>());
         player_number = message.player_number;
     }
     else if (type == MessageType::GameStart)
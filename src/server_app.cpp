@@ -3,6 +3,7 @@
 #include <memory>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include <thread>
 #include <signal.h>
 #include <stdlib.h>
@@ -14,10 +15,12 @@
 #include <spdlog/spdlog.h>
 
 #include "server_app.h"
+#include "misc/metrics.h"
+#include "misc/metrics_exporter.h"
+#include "networking/binary_codec.h"
 #include "networking/messages.h"
 #include "networking/msgpack_codec.h"
 #include "third_party/httplib.h"
-#include "training/environments/koth_env.h"
 
 namespace
 {
@@ -89,6 +92,25 @@ int ServerApp::run(int argc, char *argv[])
     socket->bind("tcp://*:" + std::to_string(port));
     server_communicator = std::make_unique<ServerCommunicator>(std::move(socket));
 
+    // Spectators subscribe to the match's tick stream on a separate port
+    int spectator_port;
+    args({"--spectator-port"}, 0) >> spectator_port;
+    if (spectator_port > 0)
+    {
+        std::string match_id;
+        args({"--match-id"}, "match") >> match_id;
+        spdlog::info("Publishing match {} to spectators on port: {}", match_id, spectator_port);
+
+        auto spectator_socket = std::make_unique<zmq::socket_t>(zmq_context,
+                                                                zmq::socket_type::xpub);
+        spectator_socket->bind("tcp://*:" + std::to_string(spectator_port));
+        spectator_broadcaster = std::make_unique<SpectatorBroadcaster>(std::move(spectator_socket),
+                                                                       match_id);
+    }
+
+    MetricsExporter metrics_exporter(get_metrics());
+    start_metrics_exporter(metrics_exporter, args);
+
     // Signal to Agones that we are ready and start the health check thread
     std::thread health_thread;
     bool use_agones = args[{"--agones"}];
@@ -136,6 +158,22 @@ int ServerApp::run(int argc, char *argv[])
             {
                 break;
             }
+            const auto player_number = std::find(players.begin(),
+                                                 players.end(),
+                                                 raw_message.id) -
+                                       players.begin();
+
+            // Actions arrive every tick, so they use the binary codec
+            if (BinaryCodec::is_binary(raw_message.message))
+            {
+                if (BinaryCodec::get_message_type(raw_message.message) == MessageType::Action)
+                {
+                    auto message = BinaryCodec::decode<ActionMessage>(raw_message.message);
+                    game->set_action(message.tick, player_number, message.actions);
+                }
+                continue;
+            }
+
             auto message_object = MsgPackCodec::decode<msgpack::object_handle>(
                 raw_message.message);
             auto type = get_message_type(message_object.get());
@@ -163,24 +201,28 @@ int ServerApp::run(int argc, char *argv[])
             else if (type == MessageType::Action)
             {
                 auto message = message_object->as<ActionMessage>();
-                game->set_action(message.tick,
-                                 std::find(players.begin(),
-                                           players.end(),
-                                           raw_message.id) -
-                                     players.begin(),
-                                 message.actions);
+                game->set_action(message.tick, player_number, message.actions);
             }
         }
 
+        if (spectator_broadcaster != nullptr)
+        {
+            spectator_broadcaster->update();
+        }
+
         // If game is about to start, notify the clients
         if (!game_started && game_start_message.body_specs.size() == 2)
         {
             spdlog::info("Starting game");
+            auto encoded_game_start_message = MsgPackCodec::encode(game_start_message);
             for (const auto &player : players)
             {
-                auto encoded_game_start_message = MsgPackCodec::encode(game_start_message);
                 server_communicator->send(player, encoded_game_start_message);
             }
+            if (spectator_broadcaster != nullptr)
+            {
+                spectator_broadcaster->publish_game_start(encoded_game_start_message);
+            }
             game_started = true;
             start_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
             start_time *= 1e-9;
@@ -194,6 +236,11 @@ int ServerApp::run(int argc, char *argv[])
             continue;
         }
 
+        static auto &tick_time = get_metrics().histogram("ai_server_tick_seconds",
+                                                         "Time taken to tick and broadcast");
+        static auto &ticks = get_metrics().counter("ai_server_ticks_total", "Ticks simulated");
+        ScopedTimer tick_timer(tick_time);
+        ticks.increment();
         auto tick_result = game->tick(time_stamp);
         if (tick_result.tick % 10 == 0)
         {
@@ -208,17 +255,23 @@ int ServerApp::run(int argc, char *argv[])
                            std::move(tick_result.scores),
                            tick_result.done,
                            tick_result.tick);
-        auto encoded_reply = MsgPackCodec::encode(reply);
-        auto obj = MsgPackCodec::decode<msgpack::object_handle>(encoded_reply);
+        auto encoded_reply = BinaryCodec::encode(reply);
         for (const auto &player : players)
         {
             server_communicator->send(player, encoded_reply);
         }
+        if (spectator_broadcaster != nullptr)
+        {
+            spectator_broadcaster->publish_state(encoded_reply);
+        }
 
         finished = tick_result.done;
         if (finished)
         {
             spdlog::info("Winner: {}", tick_result.victor);
+            spdlog::info("Late actions: {} - Dropped actions: {}",
+                         game->get_late_actions(),
+                         game->get_dropped_actions());
             if (use_agones)
             {
                 update_elos(tick_result.victor);
@@ -8,6 +8,7 @@
 
 #include "networking/game.h"
 #include "networking/server_communicator.h"
+#include "networking/spectator_broadcaster.h"
 #include "third_party/httplib.h"
 #include "third_party/zmq.hpp"
 #include "third_party/zmq_addon.hpp"
@@ -26,6 +27,7 @@ class ServerApp
     std::vector<std::string> player_usernames;
     std::vector<std::string> players;
     std::unique_ptr<ServerCommunicator> server_communicator;
+    std::unique_ptr<SpectatorBroadcaster> spectator_broadcaster;
 
     int run_tests(int argc, char *argv[], const argh::parser &args);
     void update_elos(int victor);
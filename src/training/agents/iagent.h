@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -32,6 +33,8 @@ class IAgent
     int get_action_size() const;
     const nlohmann::json &get_body_spec() const;
     virtual int get_hidden_state_size() const = 0;
+    // Roughly how many bytes the agent's weights take up
+    virtual std::size_t get_memory_usage() const { return 0; }
     int get_observation_size() const;
 
     inline std::string get_name() const { return name; }
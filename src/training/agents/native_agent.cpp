@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest.h>
+#include <cpprl/cpprl.h>
+#include <nlohmann/json.hpp>
+
+#include "native_agent.h"
+#include "audio/audio_engine.h"
+#include "misc/module_factory.h"
+#include "misc/random.h"
+#include "training/bodies/test_body.h"
+#include "training/entities/bullet.h"
+
+namespace ai
+{
+namespace
+{
+const float probability_epsilon = 1e-7f;
+
+bool ends_with(const std::string &string, const std::string &suffix)
+{
+    return string.size() >= suffix.size() &&
+           string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::vector<float> to_vector(const TensorView &tensor)
+{
+    return std::vector<float>(tensor.data, tensor.data + get_element_count(tensor.shape));
+}
+}
+
+MlpWeights extract_mlp_weights(cpprl::Policy &policy)
+{
+    torch::NoGradGuard no_grad;
+    if (policy->is_recurrent())
+    {
+        throw std::invalid_argument("Recurrent policies can't run natively");
+    }
+
+    std::vector<torch::Tensor> tensors;
+    std::vector<TensorView> views;
+    const auto add_tensor = [&](const std::string &name, const torch::Tensor &tensor) {
+        tensors.push_back(tensor.detach().to(torch::kCPU, torch::kFloat).contiguous());
+        views.push_back({name, tensors.back().sizes().vec(), tensors.back().data_ptr<float>()});
+    };
+    for (const auto &parameter : policy->named_parameters())
+    {
+        add_tensor(parameter.key(), parameter.value());
+    }
+    for (const auto &buffer : policy->named_buffers())
+    {
+        add_tensor(buffer.key(), buffer.value());
+    }
+    return extract_mlp_weights(views);
+}
+
+MlpWeights extract_mlp_weights(const std::vector<TensorView> &tensors)
+{
+    // Parameters are named like base.actor.0.weight, so sorting by name puts
+    // each Sequential's layers in order
+    std::vector<const TensorView *> actor;
+    std::vector<const TensorView *> critic;
+    std::vector<const TensorView *> value;
+    std::vector<const TensorView *> output;
+    MlpWeights weights;
+    for (const auto &tensor : tensors)
+    {
+        const auto &name = tensor.name;
+        // The observation normaliser's buffers
+        if (ends_with(name, ".mean"))
+        {
+            weights.observation_mean = to_vector(tensor);
+        }
+        else if (ends_with(name, ".variance"))
+        {
+            weights.observation_variance = to_vector(tensor);
+        }
+        else if (ends_with(name, ".count"))
+        {
+            continue;
+        }
+        else if (name.find("gru") != std::string::npos)
+        {
+            throw std::invalid_argument("Recurrent policies can't run natively");
+        }
+        else if (name.find("critic_linear") != std::string::npos)
+        {
+            value.push_back(&tensor);
+        }
+        else if (name.find("critic") != std::string::npos)
+        {
+            critic.push_back(&tensor);
+        }
+        else if (name.find("actor") != std::string::npos)
+        {
+            actor.push_back(&tensor);
+        }
+        else
+        {
+            output.push_back(&tensor);
+        }
+    }
+    for (auto *group : {&actor, &critic, &value, &output})
+    {
+        std::sort(group->begin(), group->end(),
+                  [](const auto *a, const auto *b) { return a->name < b->name; });
+    }
+    // Biases sort before weights within a layer
+    if (actor.size() != 4 || critic.size() != 4 || value.size() != 2 || output.size() != 2 ||
+        actor[1]->shape.size() != 2 || output[1]->shape.size() != 2)
+    {
+        throw std::invalid_argument("Only two layer MLP policies can run natively");
+    }
+
+    weights.observation_size = static_cast<int>(actor[1]->shape[1]);
+    weights.hidden_size = static_cast<int>(actor[1]->shape[0]);
+    weights.action_count = static_cast<int>(output[1]->shape[0]);
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        weights.actor_biases[i] = to_vector(*actor[i * 2]);
+        weights.actor_weights[i] = to_vector(*actor[i * 2 + 1]);
+        weights.critic_biases[i] = to_vector(*critic[i * 2]);
+        weights.critic_weights[i] = to_vector(*critic[i * 2 + 1]);
+    }
+    weights.value_biases = to_vector(*value[0]);
+    weights.value_weights = to_vector(*value[1]);
+    weights.action_biases = to_vector(*output[0]);
+    weights.action_weights = to_vector(*output[1]);
+
+    return weights;
+}
+
+NativeAgent::NativeAgent(cpprl::Policy policy,
+                         const nlohmann::json &body_spec,
+                         const std::string &name,
+                         WeightPrecision precision)
+    : IAgent(body_spec, name),
+      engine(std::make_shared<const MlpInferenceEngine>(extract_mlp_weights(policy),
+                                                        precision)) {}
+
+NativeAgent::NativeAgent(std::shared_ptr<const MlpInferenceEngine> engine,
+                         const nlohmann::json &body_spec,
+                         const std::string &name)
+    : IAgent(body_spec, name),
+      engine(std::move(engine)) {}
+
+ActResult NativeAgent::act(torch::Tensor observations,
+                           torch::Tensor hidden_states,
+                           torch::Tensor /*masks*/) const
+{
+    if (observations.dim() == 1)
+    {
+        observations = observations.unsqueeze(0);
+        hidden_states = hidden_states.unsqueeze(0);
+    }
+    observations = observations.to(torch::kCPU, torch::kFloat).contiguous();
+
+    const auto row_count = observations.size(0);
+    const auto observation_size = engine->get_observation_size();
+    const auto action_count = engine->get_action_count();
+    if (observations.size(1) != observation_size)
+    {
+        throw std::invalid_argument("Observations are the wrong size for this agent");
+    }
+
+    auto probabilities = torch::empty({row_count, action_count});
+    auto values = torch::empty({row_count, 1});
+    const auto *observation_data = observations.data_ptr<float>();
+    auto *probability_data = probabilities.data_ptr<float>();
+    auto *value_data = values.data_ptr<float>();
+    for (long row = 0; row < row_count; ++row)
+    {
+        engine->forward(observation_data + row * observation_size,
+                        probability_data + row * action_count,
+                        value_data + row);
+    }
+
+    const auto actions = torch::bernoulli(probabilities);
+    const auto clamped = probabilities.clamp(probability_epsilon, 1 - probability_epsilon);
+    const auto log_probs = (actions * clamped.log() + (1 - actions) * (1 - clamped).log())
+                               .sum(-1, true);
+
+    return {values, actions, log_probs, hidden_states};
+}
+
+std::unique_ptr<IAgent> NativeAgent::clone() const
+{
+    return std::make_unique<NativeAgent>(engine, body_spec, name);
+}
+
+TEST_CASE("NativeAgent")
+{
+    Random rng(0);
+    MockAudioEngine audio_engine;
+    BulletFactory bullet_factory(audio_engine);
+    ModuleFactory module_factory(audio_engine, bullet_factory, rng);
+    TestBody body(module_factory, rng);
+    const auto body_spec = body.to_json();
+    const int num_observations = body_spec["num_observations"];
+    const unsigned int num_actions = body_spec["num_actions"];
+
+    torch::manual_seed(0);
+    auto nn_base = std::make_shared<cpprl::MlpBase>(num_observations, false, 6);
+    auto policy = cpprl::Policy(cpprl::ActionSpace{"MultiBinary", {num_actions}}, nn_base, true);
+    policy->update_observation_normalizer(torch::randn({20, num_observations}) * 3 + 1);
+
+    const auto observations = torch::randn({3, num_observations});
+    const auto hidden_states = torch::zeros({3, 1});
+    const auto masks = torch::ones({3, 1});
+
+    SUBCASE("Values and log probabilities match libtorch")
+    {
+        NativeAgent agent(policy, body_spec, "Test");
+        const auto result = agent.act(observations, hidden_states, masks);
+        const auto expected = policy->evaluate_actions(observations,
+                                                       hidden_states,
+                                                       masks,
+                                                       result.action);
+
+        DOCTEST_CHECK(torch::allclose(result.value, expected[0], 1e-4, 1e-5));
+        DOCTEST_CHECK(torch::allclose(result.log_probs, expected[1], 1e-4, 1e-5));
+    }
+
+    SUBCASE("Reduced precision stays close to libtorch")
+    {
+        NativeAgent agent(policy, body_spec, "Test", WeightPrecision::Float16);
+        const auto result = agent.act(observations, hidden_states, masks);
+        const auto expected = policy->evaluate_actions(observations,
+                                                       hidden_states,
+                                                       masks,
+                                                       result.action);
+
+        DOCTEST_CHECK(torch::allclose(result.value, expected[0], 1e-2, 1e-2));
+    }
+
+    SUBCASE("Agents made from mapped parameters match libtorch")
+    {
+        std::vector<torch::Tensor> tensors;
+        std::vector<TensorView> views;
+        for (const auto &tensor : policy->named_parameters())
+        {
+            tensors.push_back(tensor.value().detach().contiguous());
+            views.push_back({tensor.key(), tensors.back().sizes().vec(),
+                             tensors.back().data_ptr<float>()});
+        }
+        for (const auto &tensor : policy->named_buffers())
+        {
+            tensors.push_back(tensor.value().detach().contiguous());
+            views.push_back({tensor.key(), tensors.back().sizes().vec(),
+                             tensors.back().data_ptr<float>()});
+        }
+        const auto path = std::filesystem::temp_directory_path() / "native_agent_test.params";
+        const auto layout = write_flat_parameters(path, views);
+        const FlatParameters parameters(path, layout);
+
+        NativeAgent agent(std::make_shared<const MlpInferenceEngine>(
+                              extract_mlp_weights(parameters.get_tensors())),
+                          body_spec,
+                          "Test");
+        const auto result = agent.act(observations, hidden_states, masks);
+        const auto expected = policy->evaluate_actions(observations,
+                                                       hidden_states,
+                                                       masks,
+                                                       result.action);
+
+        DOCTEST_CHECK(torch::allclose(result.value, expected[0], 1e-4, 1e-5));
+        DOCTEST_CHECK(torch::allclose(result.log_probs, expected[1], 1e-4, 1e-5));
+        std::filesystem::remove(path);
+    }
+
+    SUBCASE("Clones keep the weights they were made with")
+    {
+        NativeAgent agent(policy, body_spec, "Test");
+        const auto clone = agent.clone();
+        {
+            torch::NoGradGuard no_grad;
+            for (auto &parameter : policy->parameters())
+            {
+                parameter.zero_();
+            }
+        }
+
+        const auto result = clone->act(observations, hidden_states, masks);
+
+        DOCTEST_CHECK(result.value.abs().sum().item().toFloat() > 0);
+    }
+}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <cpprl/model/policy.h>
+#include <nlohmann/json_fwd.hpp>
+
+#include "iagent.h"
+#include "training/flat_parameters.h"
+#include "training/inference/mlp_engine.h"
+
+namespace ai
+{
+// Copies the weights of a non-recurrent MlpBase policy out of libtorch
+MlpWeights extract_mlp_weights(cpprl::Policy &policy);
+// Copies the weights of a non-recurrent MlpBase policy out of its named
+// parameters and buffers, such as those in a checkpoint's .params file
+MlpWeights extract_mlp_weights(const std::vector<TensorView> &tensors);
+
+// Runs a frozen copy of a policy with MlpInferenceEngine instead of libtorch.
+// Meant for opponents and evaluation, where the policy doesn't train and
+// there's one small observation at a time to act on.
+class NativeAgent : public IAgent
+{
+  private:
+    std::shared_ptr<const MlpInferenceEngine> engine;
+
+  public:
+    NativeAgent(cpprl::Policy policy,
+                const nlohmann::json &body_spec,
+                const std::string &name,
+                WeightPrecision precision = WeightPrecision::Float32);
+    NativeAgent(std::shared_ptr<const MlpInferenceEngine> engine,
+                const nlohmann::json &body_spec,
+                const std::string &name);
+
+    ActResult act(torch::Tensor observations,
+                  torch::Tensor hidden_states,
+                  torch::Tensor masks) const;
+    virtual std::unique_ptr<IAgent> clone() const;
+
+    inline int get_hidden_state_size() const { return 1; }
+    inline std::size_t get_memory_usage() const override { return engine->get_memory_usage(); }
+};
+}
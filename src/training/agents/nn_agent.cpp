@@ -36,6 +36,20 @@ std::unique_ptr<IAgent> NNAgent::clone() const
     return std::make_unique<NNAgent>(policy, body_spec, name);
 }
 
+std::size_t NNAgent::get_memory_usage() const
+{
+    std::size_t memory_usage = 0;
+    for (const auto &tensor : policy->parameters())
+    {
+        memory_usage += tensor.numel() * tensor.element_size();
+    }
+    for (const auto &tensor : policy->buffers())
+    {
+        memory_usage += tensor.numel() * tensor.element_size();
+    }
+    return memory_usage;
+}
+
 TEST_CASE("NNAgent")
 {
     auto nn_base = std::make_shared<cpprl::MlpBase>(5, true, 6);
@@ -0,0 +1,177 @@
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "training/checkpoint_index.h"
+
+namespace fs = std::filesystem;
+
+namespace ai
+{
+namespace
+{
+const std::string index_schema_version = "v1";
+}
+
+const std::string CheckpointIndex::filename = "index.json";
+
+CheckpointIndex::CheckpointIndex(const fs::path &directory)
+    : index_path(directory / filename),
+      last_size(0) {}
+
+bool CheckpointIndex::exists() const
+{
+    return fs::exists(index_path);
+}
+
+void CheckpointIndex::refresh(bool force)
+{
+    // Write times can be too coarse to tell two quick writes apart, so the
+    // size is checked too, and updates always read the index again
+    std::error_code error;
+    const auto write_time = fs::last_write_time(index_path, error);
+    const auto size = error ? 0 : fs::file_size(index_path, error);
+    if (error || (!force && write_time == last_write_time && size == last_size))
+    {
+        return;
+    }
+
+    std::ifstream file(index_path);
+    try
+    {
+        const auto json = nlohmann::json::parse(file);
+        entries = json["checkpoints"].get<std::map<std::string, nlohmann::json>>();
+    }
+    catch (const nlohmann::json::exception &exception)
+    {
+        // Everything in the index can be read from the checkpoints again
+        spdlog::warn("Ignoring unreadable checkpoint index {}: {}",
+                     index_path.string(),
+                     exception.what());
+        entries.clear();
+    }
+    last_size = size;
+    last_write_time = write_time;
+}
+
+void CheckpointIndex::write()
+{
+    const nlohmann::json json{{"schema", index_schema_version}, {"checkpoints", entries}};
+
+    auto temporary_path = index_path;
+    temporary_path += fmt::format(".{}.tmp", std::random_device()());
+    {
+        std::ofstream file(temporary_path);
+        file << json.dump();
+        if (!file)
+        {
+            throw std::runtime_error(fmt::format("Couldn't write {}", index_path.string()));
+        }
+    }
+    fs::rename(temporary_path, index_path);
+    last_size = fs::file_size(index_path);
+    last_write_time = fs::last_write_time(index_path);
+}
+
+std::optional<nlohmann::json> CheckpointIndex::get(const std::string &id)
+{
+    std::lock_guard lock(mutex);
+    refresh();
+    const auto iter = entries.find(id);
+    if (iter == entries.end())
+    {
+        return std::nullopt;
+    }
+    return iter->second;
+}
+
+std::vector<std::string> CheckpointIndex::get_ids()
+{
+    std::lock_guard lock(mutex);
+    refresh();
+    std::vector<std::string> ids;
+    for (const auto &entry : entries)
+    {
+        ids.push_back(entry.first);
+    }
+    return ids;
+}
+
+void CheckpointIndex::update(const std::map<std::string, nlohmann::json> &added,
+                             const std::vector<std::string> &removed)
+{
+    std::lock_guard lock(mutex);
+    refresh(true);
+    for (const auto &entry : added)
+    {
+        entries[entry.first] = entry.second;
+    }
+    for (const auto &id : removed)
+    {
+        entries.erase(id);
+    }
+    write();
+}
+
+TEST_CASE("CheckpointIndex")
+{
+    const auto directory = fs::temp_directory_path() / "checkpoint_index_test";
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    CheckpointIndex index(directory);
+
+    SUBCASE("Starts empty")
+    {
+        DOCTEST_CHECK(!index.exists());
+        DOCTEST_CHECK(index.get_ids().empty());
+        DOCTEST_CHECK(!index.get("abc").has_value());
+    }
+
+    SUBCASE("Entries can be added, replaced and removed")
+    {
+        index.update({{"abc", {{"data", 1}}}, {"def", {{"data", 2}}}});
+        index.update({{"abc", {{"data", 3}}}}, {"def"});
+
+        DOCTEST_CHECK(index.exists());
+        DOCTEST_CHECK(index.get_ids() == std::vector<std::string>{"abc"});
+        DOCTEST_CHECK(index.get("abc").value()["data"] == 3);
+    }
+
+    SUBCASE("Changes made through another index are seen and kept")
+    {
+        CheckpointIndex other_index(directory);
+        index.update({{"abc", {{"data", 1}}}});
+        other_index.update({{"def", {{"data", 2}}}});
+        index.update({{"ghi", {{"data", 3}}}});
+
+        DOCTEST_CHECK(other_index.get_ids() == std::vector<std::string>{"abc", "def", "ghi"});
+    }
+
+    SUBCASE("A corrupt index is treated as empty")
+    {
+        {
+            std::ofstream file(directory / CheckpointIndex::filename);
+            file << "{\"checkpoints\": {";
+        }
+
+        DOCTEST_CHECK(index.get_ids().empty());
+
+        index.update({{"abc", {{"data", 1}}}});
+
+        DOCTEST_CHECK(CheckpointIndex(directory).get("abc").has_value());
+    }
+
+    fs::remove_all(directory);
+}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace ai
+{
+// The metadata of every checkpoint in a directory, kept in one file so
+// listing or opening checkpoints doesn't mean parsing a file for each one.
+// Entries are keyed by checkpoint ID, the file name without an extension.
+//
+// Changes are written to a temporary file that's renamed over the index,
+// so readers never see it half written. The index is read again whenever
+// it changes on disk, and changes are merged into the latest copy on disk
+// rather than overwriting it. Thread-safe.
+class CheckpointIndex
+{
+  private:
+    std::map<std::string, nlohmann::json> entries;
+    std::filesystem::path index_path;
+    std::uintmax_t last_size;
+    std::filesystem::file_time_type last_write_time;
+    std::mutex mutex;
+
+    void refresh(bool force = false);
+    void write();
+
+  public:
+    static const std::string filename;
+
+    explicit CheckpointIndex(const std::filesystem::path &directory);
+
+    bool exists() const;
+    std::optional<nlohmann::json> get(const std::string &id);
+    std::vector<std::string> get_ids();
+    // Adds or replaces entries and removes others in one write
+    void update(const std::map<std::string, nlohmann::json> &added,
+                const std::vector<std::string> &removed = {});
+};
+}
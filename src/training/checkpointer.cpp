@@ -1,17 +1,29 @@
+#include <algorithm>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include <doctest.h>
 #include <cpprl/cpprl.h>
+#include <fmt/format.h>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
+#include <taskflow/taskflow.hpp>
+#include <torch/torch.h>
 
 #include "checkpointer.h"
 #include "third_party/date.h"
 #include "misc/random.h"
+#include "training/checkpoint_index.h"
+#include "training/flat_parameters.h"
 #include "training/mock_saver.h"
 
 namespace fs = std::filesystem;
@@ -24,6 +36,60 @@ static const char alphanum[] =
     "abcdefghijklmnopqrstuvwxyz";
 const std::string schema_version = "v1alpha1";
 
+namespace
+{
+CheckpointData parse_checkpoint_data(const nlohmann::json &json)
+{
+    std::chrono::system_clock::time_point time_stamp;
+    std::istringstream string_stream(json.at("timestamp").get<std::string>());
+    string_stream >> date::parse("%F-%H-%M-%S", time_stamp);
+    return {json.at("body_spec"),
+            json.at("data"),
+            json.at("previous_checkpoint").get<std::string>(),
+            json.at("recurrent"),
+            time_stamp};
+}
+
+// Writes a policy's parameters and buffers to a .params file, and returns
+// the entry describing it that goes in the checkpoint's metadata
+nlohmann::json save_flat_parameters(cpprl::Policy &policy, const fs::path &path)
+{
+    torch::NoGradGuard no_grad;
+    std::vector<torch::Tensor> tensors;
+    std::vector<TensorView> views;
+    const auto add_tensor = [&](const std::string &name, const torch::Tensor &tensor) {
+        tensors.push_back(tensor.detach().to(torch::kCPU, torch::kFloat).contiguous());
+        views.push_back({name, tensors.back().sizes().vec(), tensors.back().data_ptr<float>()});
+    };
+    for (const auto &parameter : policy->named_parameters())
+    {
+        add_tensor(parameter.key(), parameter.value());
+    }
+    for (const auto &buffer : policy->named_buffers())
+    {
+        add_tensor(buffer.key(), buffer.value());
+    }
+
+    nlohmann::json layout_json = nlohmann::json::array();
+    for (const auto &tensor : write_flat_parameters(path, views))
+    {
+        layout_json.push_back(
+            {{"name", tensor.name}, {"offset", tensor.offset}, {"shape", tensor.shape}});
+    }
+    return {{"file", path.filename().string()}, {"tensors", layout_json}};
+}
+
+void copy_tensor(const FlatParameters &parameters, const std::string &name, torch::Tensor tensor)
+{
+    const auto *view = parameters.find(name);
+    if (view == nullptr || tensor.sizes() != c10::IntArrayRef(view->shape))
+    {
+        throw std::runtime_error(fmt::format("Checkpoint has no {} of the right shape", name));
+    }
+    tensor.copy_(torch::from_blob(const_cast<float *>(view->data), view->shape, torch::kFloat));
+}
+}
+
 Checkpointer::Checkpointer(std::string checkpoint_directory,
                            Random &random,
                            ISaver &saver)
@@ -38,19 +104,113 @@ Checkpointer::Checkpointer(std::string checkpoint_directory,
     }
 }
 
+Checkpointer::~Checkpointer() {}
+
 std::vector<fs::path> Checkpointer::enumerate_checkpoints()
 {
-    std::vector<fs::path> paths;
+    std::vector<std::string> ids;
     for (const auto &file : fs::directory_iterator(checkpoint_directory))
     {
         if (file.path().extension() == ".meta")
         {
-            paths.push_back(file.path());
+            ids.push_back(file.path().stem().string());
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+
+    // Bring the index up to date with checkpoints copied in or deleted by
+    // hand, and those saved before there was an index
+    auto &index = get_index(checkpoint_directory);
+    const auto indexed_ids = index.get_ids();
+    std::vector<std::string> missing_ids;
+    std::set_difference(ids.begin(), ids.end(),
+                        indexed_ids.begin(), indexed_ids.end(),
+                        std::back_inserter(missing_ids));
+    std::vector<std::string> removed_ids;
+    std::set_difference(indexed_ids.begin(), indexed_ids.end(),
+                        ids.begin(), ids.end(),
+                        std::back_inserter(removed_ids));
+    if (!missing_ids.empty() || !removed_ids.empty())
+    {
+        spdlog::info("Indexing {} checkpoints in {}",
+                     missing_ids.size(),
+                     checkpoint_directory.string());
+        // Old checkpoints go through libtorch to get a .params file, which
+        // is slow enough to be worth doing in parallel
+        std::vector<std::optional<nlohmann::json>> entries(missing_ids.size());
+        tf::Executor executor;
+        tf::Taskflow task_flow;
+        for (std::size_t i = 0; i < missing_ids.size(); ++i)
+        {
+            task_flow.emplace([&, i] {
+                const auto path = checkpoint_directory / (missing_ids[i] + ".meta");
+                try
+                {
+                    entries[i] = index_checkpoint(path);
+                }
+                catch (const std::exception &exception)
+                {
+                    spdlog::warn("Couldn't index {}: {}", path.string(), exception.what());
+                }
+            });
+        }
+        executor.run(task_flow);
+        executor.wait_for_all();
+
+        std::map<std::string, nlohmann::json> added;
+        for (std::size_t i = 0; i < missing_ids.size(); ++i)
+        {
+            if (entries[i].has_value())
+            {
+                added.emplace(missing_ids[i], std::move(*entries[i]));
+            }
         }
+        index.update(added, removed_ids);
+    }
+
+    std::vector<fs::path> paths;
+    for (const auto &id : ids)
+    {
+        paths.push_back(checkpoint_directory / (id + ".meta"));
     }
     return paths;
 }
 
+std::optional<nlohmann::json> Checkpointer::find_entry(const fs::path &path)
+{
+    return get_index(path.parent_path()).get(path.stem().string());
+}
+
+CheckpointIndex &Checkpointer::get_index(fs::path directory)
+{
+    directory = fs::absolute(directory).lexically_normal();
+    if (!directory.has_filename())
+    {
+        directory = directory.parent_path();
+    }
+
+    std::lock_guard lock(indices_mutex);
+    auto &index = indices[directory];
+    if (index == nullptr)
+    {
+        index = std::make_unique<CheckpointIndex>(directory);
+    }
+    return *index;
+}
+
+nlohmann::json Checkpointer::index_checkpoint(const fs::path &path)
+{
+    auto json = saver.load_json(path);
+    if (!json.contains("parameters"))
+    {
+        auto policy = load(path).policy;
+        auto parameters_path = path;
+        parameters_path.replace_extension(".params");
+        json["parameters"] = save_flat_parameters(policy, parameters_path);
+    }
+    return json;
+}
+
 Checkpoint Checkpointer::load(fs::path path)
 {
     auto data = load_data(path);
@@ -61,24 +221,57 @@ Checkpoint Checkpointer::load(fs::path path)
                                             {data.body_spec["num_actions"]}},
                          nn_base,
                          true);
-    auto policy_path = path.replace_extension(".pth");
-    saver.load_policy(policy_path, policy);
+    if (const auto parameters = load_parameters(path))
+    {
+        torch::NoGradGuard no_grad;
+        for (const auto &parameter : policy->named_parameters())
+        {
+            copy_tensor(*parameters, parameter.key(), parameter.value());
+        }
+        for (const auto &buffer : policy->named_buffers())
+        {
+            copy_tensor(*parameters, buffer.key(), buffer.value());
+        }
+    }
+    else
+    {
+        auto policy_path = path.replace_extension(".pth");
+        saver.load_policy(policy_path, policy);
+    }
 
     return {data, policy};
 }
 
 CheckpointData Checkpointer::load_data(fs::path path)
 {
-    auto json = saver.load_json(path);
-    std::chrono::system_clock::time_point time_stamp;
-    std::istringstream string_stream(static_cast<std::string>(json["timestamp"]));
-    string_stream >> date::parse("%F-%H-%M-%S", time_stamp);
-    return {json["body_spec"],
-            json["data"],
-            json["previous_checkpoint"].get<std::string>(),
-            json["recurrent"],
-            time_stamp};
+    if (const auto entry = find_entry(path))
+    {
+        return parse_checkpoint_data(*entry);
+    }
+    return parse_checkpoint_data(saver.load_json(path));
+}
+
+std::shared_ptr<const FlatParameters> Checkpointer::load_parameters(const fs::path &path)
+{
+    const auto entry = find_entry(path);
+    if (!entry.has_value() || !entry->contains("parameters"))
+    {
+        return nullptr;
+    }
+
+    const auto &parameters = (*entry)["parameters"];
+    std::vector<FlatTensor> layout;
+    for (const auto &tensor : parameters["tensors"])
+    {
+        layout.push_back({tensor["name"].get<std::string>(),
+                          tensor["offset"].get<std::uint64_t>(),
+                          tensor["shape"].get<std::vector<std::int64_t>>()});
+    }
+    return std::make_shared<const FlatParameters>(
+        path.parent_path() / parameters["file"].get<std::string>(),
+        layout);
 }
+
 fs::path Checkpointer::save(cpprl::Policy &policy,
                             nlohmann::json &body_spec,
                             std::map<std::string, double> data,
@@ -117,22 +310,28 @@ fs::path Checkpointer::save(cpprl::Policy &policy,
     json["previous_checkpoint"] = previous_checkpoint.string();
     json["recurrent"] = policy->is_recurrent();
     json["timestamp"] = date::format("%F-%H-%M-%S", std::chrono::system_clock::now());
+    json["parameters"] = save_flat_parameters(policy, save_path.replace_extension(".params"));
     auto meta_path = save_path.replace_extension(".meta");
     saver.save(json, meta_path);
+    get_index(meta_path.parent_path()).update({{file_id, json}});
 
     return meta_path;
 }
 
 TEST_CASE("Checkpointer")
 {
+    // The .params files and the index are written for real, so they go
+    // somewhere that's cleaned up afterwards
+    const auto directory = fs::temp_directory_path() / "checkpointer_test";
+    fs::remove_all(directory);
     MockSaver saver;
     Random random(0);
-    Checkpointer checkpointer("/tmp/checkpoints/", random, saver);
+    Checkpointer checkpointer(directory.string(), random, saver);
 
     SUBCASE("save()")
     {
         auto nn_base = std::make_shared<cpprl::MlpBase>(5, false);
-        cpprl::Policy policy(cpprl::ActionSpace{"MultiBinary", {12}}, nn_base);
+        cpprl::Policy policy(cpprl::ActionSpace{"MultiBinary", {12}}, nn_base, true);
         // clang-format off
         nlohmann::json body_spec = {
             {"base_module", {
@@ -149,10 +348,10 @@ TEST_CASE("Checkpointer")
 
         SUBCASE("Saves files to the correct paths")
         {
-            auto path = saver.last_saved_path.string();
-            DOCTEST_INFO(path);
-            DOCTEST_CHECK_UNARY(path.substr(0, 17) == "/tmp/checkpoints/" ||
-                                path.substr(0, 19) == "C:/tmp/checkpoints/");
+            auto path = saver.last_saved_path;
+            DOCTEST_INFO(path.string());
+            DOCTEST_CHECK(path.parent_path() == directory);
+            DOCTEST_CHECK(path.extension() == ".meta");
         }
 
         SUBCASE("Saves correct Json")
@@ -166,6 +365,33 @@ TEST_CASE("Checkpointer")
             DOCTEST_CHECK(json["recurrent"] == false);
         }
 
+        SUBCASE("Saved checkpoints are indexed")
+        {
+            const auto meta_path = saver.last_saved_path;
+            saver.json_to_load = nullptr;
+            auto data = checkpointer.load_data(meta_path);
+
+            DOCTEST_CHECK(data.body_spec == body_spec);
+            DOCTEST_CHECK(data.data["asd"] == doctest::Approx(123));
+            DOCTEST_CHECK(data.previous_checkpoint == "/asd/sdf.meta");
+            DOCTEST_CHECK(checkpointer.load_parameters(meta_path) != nullptr);
+        }
+
+        SUBCASE("Loads policies from the flat parameter file")
+        {
+            // MockSaver doesn't load .pth files, so these only match if the
+            // parameters came from the .params file
+            const auto checkpoint = checkpointer.load(saver.last_saved_path);
+            const auto saved_parameters = policy->parameters();
+            const auto loaded_parameters = checkpoint.policy->parameters();
+
+            DOCTEST_REQUIRE(saved_parameters.size() == loaded_parameters.size());
+            for (std::size_t i = 0; i < saved_parameters.size(); ++i)
+            {
+                DOCTEST_CHECK(torch::equal(saved_parameters[i], loaded_parameters[i]));
+            }
+        }
+
         SUBCASE("Saves accurate timestamps")
         {
             auto json = saver.last_saved_json;
@@ -208,5 +434,7 @@ TEST_CASE("Checkpointer")
         DOCTEST_CHECK(data.previous_checkpoint == "/asd/sdf.meta");
         DOCTEST_CHECK(data.recurrent == false);
     }
+
+    fs::remove_all(directory);
 }
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 #include <chrono>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -17,6 +21,8 @@ class Policy;
 
 namespace ai
 {
+class CheckpointIndex;
+class FlatParameters;
 class Random;
 
 struct CheckpointData
@@ -36,22 +42,41 @@ struct Checkpoint
 
 static auto CheckpointDirectory = [] {};
 
+// Saves and loads policies along with their metadata.
+//
+// Each checkpoint is a .meta JSON file, a .pth file for libtorch and a
+// .params file holding the same parameters as flat float32 arrays that can
+// be mapped into memory. Each directory's metadata is also kept in a
+// CheckpointIndex, along with where each parameter is in the .params file,
+// so most loads don't open the .meta file at all. Checkpoints saved before
+// there was an index are added to it the first time the directory is
+// enumerated. Thread-safe.
 class Checkpointer
 {
   private:
     std::filesystem::path checkpoint_directory;
+    std::map<std::filesystem::path, std::unique_ptr<CheckpointIndex>> indices;
+    std::mutex indices_mutex;
     Random &random;
     ISaver &saver;
 
+    std::optional<nlohmann::json> find_entry(const std::filesystem::path &path);
+    CheckpointIndex &get_index(std::filesystem::path directory);
+    nlohmann::json index_checkpoint(const std::filesystem::path &path);
+
   public:
     BOOST_DI_INJECT(Checkpointer,
                     (named = CheckpointDirectory) std::string checkpoint_directory,
                     Random &random,
                     ISaver &saver);
+    ~Checkpointer();
 
     std::vector<std::filesystem::path> enumerate_checkpoints();
     Checkpoint load(std::filesystem::path path);
     CheckpointData load_data(std::filesystem::path path);
+    // The checkpoint's parameters mapped straight from its .params file, or
+    // nullptr if it doesn't have one
+    std::shared_ptr<const FlatParameters> load_parameters(const std::filesystem::path &path);
     std::filesystem::path save(cpprl::Policy &policy,
                                nlohmann::json &body_spec,
                                std::map<std::string, double> data,
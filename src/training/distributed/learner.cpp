@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cpprl/cpprl.h>
+#include <doctest.h>
+#include <spdlog/spdlog.h>
+
+#include "training/distributed/learner.h"
+#include "networking/messages.h"
+#include "networking/msgpack_codec.h"
+#include "training/distributed/rollout_codec.h"
+#include "training/trainer.h"
+
+namespace ai
+{
+namespace
+{
+// Workers that connect late miss earlier broadcasts, so the policy is sent
+// again whenever it's been this long
+const auto republish_interval = std::chrono::seconds(1);
+}
+
+PolicyLagTracker::PolicyLagTracker(unsigned long long max_lag)
+    : accepted(0),
+      dropped(0),
+      max_lag(max_lag),
+      max_seen_lag(0),
+      total_lag(0) {}
+
+bool PolicyLagTracker::accept(unsigned long long rollout_version,
+                              unsigned long long current_version)
+{
+    const auto lag = current_version > rollout_version ? current_version - rollout_version : 0;
+    if (lag > max_lag)
+    {
+        ++dropped;
+        return false;
+    }
+    ++accepted;
+    total_lag += lag;
+    max_seen_lag = std::max(max_seen_lag, lag);
+    return true;
+}
+
+std::vector<TrainingMetric> PolicyLagTracker::take_metrics(unsigned long long timestep,
+                                                           unsigned int batch_number)
+{
+    const auto mean_lag = accepted == 0 ? 0.f
+                                        : static_cast<float>(total_lag) /
+                                              static_cast<float>(accepted);
+    std::vector<TrainingMetric> metrics{
+        {"Mean Policy Lag", mean_lag, timestep, batch_number},
+        {"Max Policy Lag", static_cast<float>(max_seen_lag), timestep, batch_number},
+        {"Dropped Rollouts", static_cast<float>(dropped), timestep, batch_number}};
+    accepted = 0;
+    dropped = 0;
+    max_seen_lag = 0;
+    total_lag = 0;
+    return metrics;
+}
+
+Learner::Learner(Trainer &trainer,
+                 std::unique_ptr<zmq::socket_t> rollout_socket,
+                 std::unique_ptr<zmq::socket_t> policy_socket,
+                 unsigned long long max_policy_lag)
+    : lag_tracker(max_policy_lag),
+      num_processes_needed(trainer.get_training_program().hyper_parameters.num_env),
+      pending_processes(0),
+      policy_socket(std::move(policy_socket)),
+      policy_version(0),
+      rollout_socket(std::move(rollout_socket)),
+      trainer(trainer)
+{
+    publish_policy();
+}
+
+void Learner::publish_policy()
+{
+    const auto message = MsgPackCodec::encode(
+        encode_policy(trainer.get_agent().get_policy(), policy_version));
+    policy_socket->send(zmq::message_t(message.data(), message.size()), zmq::send_flags::dontwait);
+    last_publish_time = std::chrono::steady_clock::now();
+}
+
+std::vector<TrainingMetric> Learner::update(std::chrono::milliseconds timeout)
+{
+    zmq::pollitem_t poll_items[] = {{static_cast<void *>(*rollout_socket), 0, ZMQ_POLLIN, 0}};
+    zmq::poll(poll_items, 1, timeout);
+
+    zmq::message_t raw_message;
+    while (rollout_socket->recv(raw_message, zmq::recv_flags::dontwait))
+    {
+        auto message = MsgPackCodec::decode<RolloutChunkMessage>(
+            std::string(static_cast<char *>(raw_message.data()), raw_message.size()));
+        if (!lag_tracker.accept(message.policy_version, policy_version))
+        {
+            spdlog::debug("Dropping rollout from {}: policy version {} is too old",
+                          message.worker_id,
+                          message.policy_version);
+            continue;
+        }
+        pending_rollouts.push_back(decode_rollout(message));
+        pending_processes += message.num_processes;
+    }
+
+    if (pending_processes < num_processes_needed)
+    {
+        if (std::chrono::steady_clock::now() - last_publish_time > republish_interval)
+        {
+            publish_policy();
+        }
+        return {};
+    }
+
+    std::vector<cpprl::RolloutStorage *> rollout_ptrs;
+    for (auto &rollout : pending_rollouts)
+    {
+        rollout_ptrs.push_back(&rollout);
+    }
+    cpprl::RolloutStorage rollout(rollout_ptrs, torch::kCPU);
+    pending_rollouts.clear();
+    pending_processes = 0;
+
+    auto metrics = trainer.learn_from(rollout);
+    ++policy_version;
+    publish_policy();
+
+    auto lag_metrics = lag_tracker.take_metrics(trainer.get_timestep(), trainer.get_batch_number());
+    metrics.insert(metrics.end(), lag_metrics.begin(), lag_metrics.end());
+    return metrics;
+}
+
+TEST_CASE("PolicyLagTracker")
+{
+    PolicyLagTracker tracker(2);
+
+    SUBCASE("Rollouts within the maximum lag are accepted")
+    {
+        DOCTEST_CHECK(tracker.accept(5, 5));
+        DOCTEST_CHECK(tracker.accept(3, 5));
+    }
+
+    SUBCASE("Rollouts beyond the maximum lag are dropped")
+    {
+        DOCTEST_CHECK(!tracker.accept(2, 5));
+    }
+
+    SUBCASE("Metrics summarise lag since they were last taken")
+    {
+        tracker.accept(5, 5);
+        tracker.accept(3, 5);
+        tracker.accept(0, 5);
+        const auto metrics = tracker.take_metrics(100, 1);
+
+        DOCTEST_REQUIRE(metrics.size() == 3);
+        DOCTEST_CHECK(metrics[0].value == doctest::Approx(1.f));
+        DOCTEST_CHECK(metrics[1].value == doctest::Approx(2.f));
+        DOCTEST_CHECK(metrics[2].value == doctest::Approx(1.f));
+
+        const auto next_metrics = tracker.take_metrics(200, 2);
+
+        DOCTEST_CHECK(next_metrics[2].value == doctest::Approx(0.f));
+    }
+}
+}
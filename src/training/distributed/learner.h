@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cpprl/storage.h>
+
+#include "third_party/zmq.hpp"
+#include "training/metric_ring.h"
+
+namespace ai
+{
+class Trainer;
+
+// Tracks how far behind the learner's policy each rollout was gathered.
+//
+// Rollouts from an older policy are off-policy for the current one. PPO's
+// clipped ratio against the stored log probabilities absorbs a little of
+// that drift, but rollouts more than max_lag versions old are dropped.
+class PolicyLagTracker
+{
+  private:
+    unsigned long long accepted;
+    unsigned long long dropped;
+    unsigned long long max_lag;
+    unsigned long long max_seen_lag;
+    unsigned long long total_lag;
+
+  public:
+    explicit PolicyLagTracker(unsigned long long max_lag);
+
+    bool accept(unsigned long long rollout_version, unsigned long long current_version);
+    // Lag statistics since the last call
+    std::vector<TrainingMetric> take_metrics(unsigned long long timestep,
+                                             unsigned int batch_number);
+};
+
+// The learning half of distributed training.
+//
+// Rollout workers push compressed rollouts to rollout_socket (a PULL socket).
+// Once there are as many environments' worth as the program asks for, the
+// trainer learns from them and the new weights are published on
+// policy_socket (a PUB socket) for the workers to pick up.
+class Learner
+{
+  private:
+    std::chrono::steady_clock::time_point last_publish_time;
+    PolicyLagTracker lag_tracker;
+    int num_processes_needed;
+    std::vector<cpprl::RolloutStorage> pending_rollouts;
+    int pending_processes;
+    std::unique_ptr<zmq::socket_t> policy_socket;
+    unsigned long long policy_version;
+    std::unique_ptr<zmq::socket_t> rollout_socket;
+    Trainer &trainer;
+
+    void publish_policy();
+
+  public:
+    Learner(Trainer &trainer,
+            std::unique_ptr<zmq::socket_t> rollout_socket,
+            std::unique_ptr<zmq::socket_t> policy_socket,
+            unsigned long long max_policy_lag);
+
+    // Waits up to timeout for rollouts, learning from them if there are
+    // enough. Returns the batch's metrics, or nothing if it didn't learn.
+    std::vector<TrainingMetric> update(std::chrono::milliseconds timeout);
+
+    inline unsigned long long get_policy_version() const { return policy_version; }
+};
+}
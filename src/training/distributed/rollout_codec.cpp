@@ -0,0 +1,259 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cpprl/cpprl.h>
+#include <doctest.h>
+#include <fmt/format.h>
+#include <torch/torch.h>
+#include <zlib.h>
+
+#include "training/distributed/rollout_codec.h"
+#include "networking/messages.h"
+
+namespace ai
+{
+namespace
+{
+std::vector<torch::Tensor> get_rollout_tensors(const cpprl::RolloutStorage &rollout)
+{
+    return {rollout.get_observations(),
+            rollout.get_hidden_states(),
+            rollout.get_rewards(),
+            rollout.get_value_predictions(),
+            rollout.get_action_log_probs(),
+            rollout.get_actions(),
+            rollout.get_masks()};
+}
+
+std::vector<torch::Tensor> get_policy_tensors(cpprl::Policy &policy)
+{
+    auto tensors = policy->parameters();
+    const auto buffers = policy->buffers();
+    tensors.insert(tensors.end(), buffers.begin(), buffers.end());
+    return tensors;
+}
+}
+
+std::vector<char> compress(const std::vector<char> &data)
+{
+    auto compressed_size = compressBound(static_cast<uLong>(data.size()));
+    std::vector<char> compressed(compressed_size);
+    // Rollouts are sent every batch, so speed matters more than size
+    const auto result = compress2(reinterpret_cast<Bytef *>(compressed.data()),
+                                  &compressed_size,
+                                  reinterpret_cast<const Bytef *>(data.data()),
+                                  static_cast<uLong>(data.size()),
+                                  Z_BEST_SPEED);
+    if (result != Z_OK)
+    {
+        throw std::runtime_error(fmt::format("Compression failed: {}", result));
+    }
+    compressed.resize(compressed_size);
+    return compressed;
+}
+
+std::vector<char> decompress(const std::vector<char> &data, std::size_t raw_size)
+{
+    std::vector<char> decompressed(raw_size);
+    auto decompressed_size = static_cast<uLongf>(raw_size);
+    const auto result = uncompress(reinterpret_cast<Bytef *>(decompressed.data()),
+                                   &decompressed_size,
+                                   reinterpret_cast<const Bytef *>(data.data()),
+                                   static_cast<uLong>(data.size()));
+    if (result != Z_OK || decompressed_size != raw_size)
+    {
+        throw std::runtime_error(fmt::format("Decompression failed: {}", result));
+    }
+    return decompressed;
+}
+
+std::vector<char> pack_tensors(const std::vector<torch::Tensor> &tensors)
+{
+    std::size_t size = 0;
+    for (const auto &tensor : tensors)
+    {
+        size += static_cast<std::size_t>(tensor.numel()) * sizeof(float);
+    }
+
+    std::vector<char> data(size);
+    std::size_t offset = 0;
+    for (const auto &tensor : tensors)
+    {
+        const auto contiguous = tensor.to(torch::kFloat).contiguous();
+        const auto tensor_size = static_cast<std::size_t>(contiguous.numel()) * sizeof(float);
+        std::memcpy(data.data() + offset, contiguous.data_ptr<float>(), tensor_size);
+        offset += tensor_size;
+    }
+    return data;
+}
+
+void unpack_tensors(const std::vector<char> &data, const std::vector<torch::Tensor> &destinations)
+{
+    torch::NoGradGuard no_grad;
+    std::size_t offset = 0;
+    for (const auto &destination : destinations)
+    {
+        const auto tensor_size = static_cast<std::size_t>(destination.numel()) * sizeof(float);
+        if (offset + tensor_size > data.size())
+        {
+            throw std::runtime_error("Not enough data to fill tensors");
+        }
+        auto source = torch::from_blob(const_cast<char *>(data.data() + offset),
+                                       destination.sizes(),
+                                       torch::kFloat);
+        destination.copy_(source);
+        offset += tensor_size;
+    }
+    if (offset != data.size())
+    {
+        throw std::runtime_error("Too much data for tensors");
+    }
+}
+
+RolloutChunkMessage encode_rollout(const cpprl::RolloutStorage &rollout,
+                                   const std::string &worker_id,
+                                   unsigned long long policy_version)
+{
+    const auto tensors = get_rollout_tensors(rollout);
+    const auto data = pack_tensors(tensors);
+
+    RolloutChunkMessage message;
+    message.worker_id = worker_id;
+    message.policy_version = policy_version;
+    message.num_steps = static_cast<int>(rollout.get_rewards().size(0));
+    message.num_processes = static_cast<int>(rollout.get_rewards().size(1));
+    for (const auto &tensor : tensors)
+    {
+        message.shapes.push_back(tensor.sizes().vec());
+    }
+    message.raw_size = data.size();
+    message.data = compress(data);
+    return message;
+}
+
+cpprl::RolloutStorage decode_rollout(const RolloutChunkMessage &message)
+{
+    if (message.shapes.size() != 7)
+    {
+        throw std::runtime_error(fmt::format("Expected 7 rollout tensors, got {}",
+                                             message.shapes.size()));
+    }
+
+    std::vector<torch::Tensor> tensors;
+    for (const auto &shape : message.shapes)
+    {
+        tensors.push_back(torch::empty(shape));
+    }
+    unpack_tensors(decompress(message.data, message.raw_size), tensors);
+
+    const auto observation_size = tensors[0].size(2);
+    const auto hidden_state_size = tensors[1].size(2);
+    const auto action_count = tensors[5].size(2);
+    cpprl::RolloutStorage rollout(message.num_steps,
+                                  message.num_processes,
+                                  {observation_size},
+                                  cpprl::ActionSpace{"MultiBinary", {action_count}},
+                                  hidden_state_size,
+                                  torch::kCPU);
+    rollout.set_observations(tensors[0]);
+    rollout.set_hidden_states(tensors[1]);
+    rollout.set_rewards(tensors[2]);
+    rollout.set_value_predictions(tensors[3]);
+    rollout.set_action_log_probs(tensors[4]);
+    rollout.set_actions(tensors[5]);
+    rollout.set_masks(tensors[6]);
+    return rollout;
+}
+
+PolicyMessage encode_policy(cpprl::Policy &policy, unsigned long long policy_version)
+{
+    const auto data = pack_tensors(get_policy_tensors(policy));
+
+    PolicyMessage message;
+    message.policy_version = policy_version;
+    message.raw_size = data.size();
+    message.weights = compress(data);
+    return message;
+}
+
+void decode_policy(const PolicyMessage &message, cpprl::Policy &policy)
+{
+    unpack_tensors(decompress(message.weights, message.raw_size), get_policy_tensors(policy));
+}
+
+TEST_CASE("Rollout codec")
+{
+    SUBCASE("Compressed data decompresses to the original")
+    {
+        std::vector<char> data(1000);
+        for (std::size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<char>(i % 7);
+        }
+        const auto compressed = compress(data);
+
+        DOCTEST_CHECK(compressed.size() < data.size());
+        DOCTEST_CHECK(decompress(compressed, data.size()) == data);
+    }
+
+    SUBCASE("Packed tensors unpack to the same values")
+    {
+        const auto a = torch::rand({2, 3});
+        const auto b = torch::rand({4});
+        const auto data = pack_tensors({a, b});
+        auto a_out = torch::zeros({2, 3});
+        auto b_out = torch::zeros({4});
+        unpack_tensors(data, {a_out, b_out});
+
+        DOCTEST_CHECK(data.size() == 10 * sizeof(float));
+        DOCTEST_CHECK(torch::equal(a, a_out));
+        DOCTEST_CHECK(torch::equal(b, b_out));
+    }
+
+    SUBCASE("Unpacking into the wrong shapes throws")
+    {
+        const auto data = pack_tensors({torch::rand({4})});
+
+        DOCTEST_CHECK_THROWS(unpack_tensors(data, {torch::zeros({3})}));
+        DOCTEST_CHECK_THROWS(unpack_tensors(data, {torch::zeros({5})}));
+    }
+
+    SUBCASE("Rollouts survive a round trip")
+    {
+        cpprl::RolloutStorage rollout(5,
+                                      2,
+                                      {3},
+                                      cpprl::ActionSpace{"MultiBinary", {4}},
+                                      0,
+                                      torch::kCPU);
+        rollout.set_rewards(torch::rand({5, 2, 1}));
+        rollout.set_actions(torch::rand({5, 2, 4}).round());
+        const auto decoded = decode_rollout(encode_rollout(rollout, "worker", 3));
+
+        DOCTEST_CHECK(torch::equal(decoded.get_rewards(), rollout.get_rewards()));
+        DOCTEST_CHECK(torch::equal(decoded.get_actions(), rollout.get_actions()));
+        DOCTEST_CHECK(decoded.get_observations().sizes() == rollout.get_observations().sizes());
+    }
+
+    SUBCASE("Policies survive a round trip")
+    {
+        auto make_policy = [] {
+            return cpprl::Policy(cpprl::ActionSpace{"MultiBinary", {4}},
+                                 std::make_shared<cpprl::MlpBase>(3, false, 8),
+                                 true);
+        };
+        auto source = make_policy();
+        auto destination = make_policy();
+        decode_policy(encode_policy(source, 1), destination);
+
+        const auto source_parameters = source->parameters();
+        const auto destination_parameters = destination->parameters();
+        for (std::size_t i = 0; i < source_parameters.size(); ++i)
+        {
+            DOCTEST_CHECK(torch::equal(source_parameters[i], destination_parameters[i]));
+        }
+    }
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <cpprl/model/policy.h>
+#include <torch/torch.h>
+
+#include "networking/messages.h"
+
+namespace cpprl
+{
+class RolloutStorage;
+}
+
+namespace ai
+{
+std::vector<char> compress(const std::vector<char> &data);
+std::vector<char> decompress(const std::vector<char> &data, std::size_t raw_size);
+
+// Float tensors laid end to end as raw bytes
+std::vector<char> pack_tensors(const std::vector<torch::Tensor> &tensors);
+// Fills destinations, which must add up to the packed size, in order
+void unpack_tensors(const std::vector<char> &data, const std::vector<torch::Tensor> &destinations);
+
+RolloutChunkMessage encode_rollout(const cpprl::RolloutStorage &rollout,
+                                   const std::string &worker_id,
+                                   unsigned long long policy_version);
+cpprl::RolloutStorage decode_rollout(const RolloutChunkMessage &message);
+
+// Policies are sent as their parameters and buffers, so both ends must
+// already have a policy of the same shape
+PolicyMessage encode_policy(cpprl::Policy &policy, unsigned long long policy_version);
+void decode_policy(const PolicyMessage &message, cpprl::Policy &policy);
+}
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cpprl/cpprl.h>
+#include <spdlog/spdlog.h>
+
+#include "training/distributed/rollout_worker.h"
+#include "environment/ecs_env.h"
+#include "networking/messages.h"
+#include "networking/msgpack_codec.h"
+#include "training/agents/nn_agent.h"
+#include "training/distributed/rollout_codec.h"
+#include "training/opponent_pool.h"
+#include "training/rollout_generators/multi_rollout_generator.h"
+#include "training/rollout_generators/single_rollout_generator.h"
+#include "training/trainer.h"
+#include "training/training_program.h"
+
+namespace ai
+{
+RolloutWorker::RolloutWorker(const std::string &worker_id,
+                             TrainingProgram &program,
+                             std::unique_ptr<zmq::socket_t> rollout_socket,
+                             std::unique_ptr<zmq::socket_t> policy_socket,
+                             TrainerFactory &trainer_factory,
+                             SingleRolloutGeneratorFactory &single_rollout_generator_factory)
+    : agent(std::make_unique<NNAgent>(make_policy(program.body), program.body, "Agent")),
+      batches_sent(0),
+      opponent_pool(trainer_factory.make_opponent_pool({program})),
+      policy_socket(std::move(policy_socket)),
+      policy_version(0),
+      received_policy(false),
+      rollout_socket(std::move(rollout_socket)),
+      worker_id(worker_id)
+{
+    std::vector<std::unique_ptr<ISingleRolloutGenerator>> sub_generators;
+    for (int i = 0; i < program.hyper_parameters.num_env; ++i)
+    {
+        sub_generators.push_back(single_rollout_generator_factory.make(
+            *agent,
+            std::make_unique<EcsEnv>(),
+            *opponent_pool));
+    }
+    rollout_generator = std::make_unique<MultiRolloutGenerator>(
+        program.hyper_parameters.batch_size,
+        std::move(sub_generators));
+    rollout_generator->set_fast();
+}
+
+RolloutWorker::~RolloutWorker() {}
+
+bool RolloutWorker::receive_policy(std::chrono::milliseconds timeout)
+{
+    if (!received_policy)
+    {
+        zmq::pollitem_t poll_items[] = {{static_cast<void *>(*policy_socket), 0, ZMQ_POLLIN, 0}};
+        zmq::poll(poll_items, 1, timeout);
+    }
+
+    // Only the newest policy matters, so skip any that have been superseded
+    zmq::message_t raw_message;
+    std::string latest;
+    while (policy_socket->recv(raw_message, zmq::recv_flags::dontwait))
+    {
+        latest.assign(static_cast<char *>(raw_message.data()), raw_message.size());
+    }
+    if (latest.empty())
+    {
+        return received_policy;
+    }
+
+    const auto message = MsgPackCodec::decode<PolicyMessage>(latest);
+    if (!received_policy || message.policy_version != policy_version)
+    {
+        decode_policy(message, agent->get_policy());
+        policy_version = message.policy_version;
+        received_policy = true;
+        spdlog::debug("{} playing with policy version {}", worker_id, policy_version);
+    }
+    return true;
+}
+
+void RolloutWorker::send_rollout()
+{
+    auto rollout = rollout_generator->generate();
+    const auto message = MsgPackCodec::encode(encode_rollout(rollout, worker_id, policy_version));
+    rollout_socket->send(zmq::message_t(message.data(), message.size()), zmq::send_flags::none);
+    ++batches_sent;
+}
+
+void RolloutWorker::stop()
+{
+    rollout_generator->stop();
+}
+}
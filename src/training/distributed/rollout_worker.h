@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "third_party/zmq.hpp"
+
+namespace ai
+{
+class MultiRolloutGenerator;
+class NNAgent;
+class OpponentPool;
+class SingleRolloutGeneratorFactory;
+class TrainerFactory;
+struct TrainingProgram;
+
+// The collecting half of distributed training.
+//
+// Plays the program's games with the latest policy received on
+// policy_socket (a SUB socket), and pushes each batch of experience to the
+// learner through rollout_socket (a PUSH socket), tagged with the version
+// of the policy that gathered it.
+class RolloutWorker
+{
+  private:
+    std::unique_ptr<NNAgent> agent;
+    unsigned long long batches_sent;
+    std::unique_ptr<OpponentPool> opponent_pool;
+    std::unique_ptr<zmq::socket_t> policy_socket;
+    unsigned long long policy_version;
+    bool received_policy;
+    std::unique_ptr<MultiRolloutGenerator> rollout_generator;
+    std::unique_ptr<zmq::socket_t> rollout_socket;
+    std::string worker_id;
+
+  public:
+    RolloutWorker(const std::string &worker_id,
+                  TrainingProgram &program,
+                  std::unique_ptr<zmq::socket_t> rollout_socket,
+                  std::unique_ptr<zmq::socket_t> policy_socket,
+                  TrainerFactory &trainer_factory,
+                  SingleRolloutGeneratorFactory &single_rollout_generator_factory);
+    ~RolloutWorker();
+
+    // Takes the newest policy the learner has published, waiting up to
+    // timeout for one to arrive. Returns whether there is a policy to play
+    // with.
+    bool receive_policy(std::chrono::milliseconds timeout);
+    // Gathers one batch of experience and sends it to the learner
+    void send_rollout();
+    void stop();
+
+    inline unsigned long long get_batches_sent() const { return batches_sent; }
+    inline unsigned long long get_policy_version() const { return policy_version; }
+};
+}
@@ -1,9 +1,9 @@
 #include <Box2D/Box2D.h>
 #include <glm/glm.hpp>
-#include <glm/gtc/random.hpp>
 
 #include "bullet_explosion.h"
 #include "audio/audio_engine.h"
+#include "graphics/particle_spawner.h"
 #include "graphics/render_data.h"
 #include "graphics/renderers/renderer.h"
 
@@ -20,23 +20,18 @@ void BulletExplosion::trigger(Renderer &renderer, IAudioEngine *audio_engine)
         audio_engine->play("hit_wall");
     }
     const int particle_count = 100;
-    const float step_subdivision = 1.f / particle_count / 10.f;
     glm::vec4 end_color = particle_color;
     end_color.a = 0;
-    std::vector<Particle> particles;
-    for (int i = 0; i < particle_count; ++i)
-    {
-        Particle particle{
-            glm::vec2(position.x, position.y),
-            glm::diskRand(4.f),
-            -i * step_subdivision,
-            0.75f,
-            0.03f,
-            particle_color,
-            end_color};
-        particles.push_back(particle);
-    }
-    renderer.draw(particles);
+    const ParticleSettings settings{0.75f,
+                                    0.03f,
+                                    particle_color,
+                                    end_color,
+                                    1.f / particle_count / 10.f};
+    renderer.get_particle_spawner().spawn_burst(renderer.allocate_particles(particle_count),
+                                                particle_count,
+                                                {position.x, position.y},
+                                                4.f,
+                                                settings);
 
     renderer.apply_explosive_force({position.x, position.y}, 2, 0.1f);
 }
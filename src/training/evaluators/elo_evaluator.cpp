@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <cmath>
 #include <map>
+#include <memory>
+#include <numeric>
 #include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <doctest.h>
@@ -15,10 +21,18 @@
 #include "training/agents/iagent.h"
 #include "training/agents/nn_agent.h"
 #include "training/agents/random_agent.h"
+#include "training/opponent_pool.h"
 
 namespace ai
 {
-const double elo_constant = 16;
+namespace
+{
+// What the agent being evaluated is recorded as
+const std::string current_agent_id = ":current:";
+// The share of each evaluation's games played by the agent being evaluated
+const double current_agent_share = 0.75;
+const int max_pairing_attempts = 8;
+}
 
 double expected_win_chance(double a_rating, double b_rating)
 {
@@ -55,100 +69,136 @@ std::tuple<double, double> calculate_elos(double a_rating,
     return {new_a_rating, new_b_rating};
 }
 
-EloEvaluator::EloEvaluator(Random &rng, double game_length)
-    : Evaluator(game_length), rng(rng) {}
+EloEvaluator::EloEvaluator(Random &rng, double game_length, unsigned int games_per_pair)
+    : Evaluator(game_length),
+      executor(std::make_unique<tf::Executor>()),
+      games_per_pair(games_per_pair),
+      rng(rng) {}
 
-double EloEvaluator::evaluate(IAgent &agent,
-                              const std::vector<IAgent *> &new_opponents,
+EloEvaluator::~EloEvaluator() {}
+
+double EloEvaluator::evaluate(const IAgent &agent,
+                              OpponentPool &opponents,
                               unsigned int number_of_trials)
 {
-    if (main_agent == nullptr)
-    {
-        // Initialize main agent
-        main_agent = agent.clone();
-        elos[main_agent.get()] = 0;
-    }
-    else
-    {
-        // Update main agent
-        auto new_main_agent_temp = agent.clone();
-        elos[new_main_agent_temp.get()] = elos[main_agent.get()];
-        elos.erase(main_agent.get());
-        main_agent = std::move(new_main_agent_temp);
-    }
+    // The agent has changed since it was last evaluated
+    results.remove(current_agent_id);
 
-    // Add new opponents to opponent pool
-    for (const auto &opponent : new_opponents)
+    const auto opponent_count = static_cast<int>(opponents.size());
+    std::vector<std::string> ids;
+    for (int i = 0; i < opponent_count; ++i)
     {
-        opponents.push_back(opponent->clone());
-        elos[opponents.back().get()] = 0;
+        ids.push_back(opponents.get_id(i));
     }
 
+    // An index of -1 is the agent being evaluated
     struct Evaluation
     {
-        IAgent *agent_1;
-        IAgent *agent_2;
+        int agent_1;
+        int agent_2;
         EvaluationResult result = EvaluationResult::Draw;
     };
     std::vector<Evaluation> evaluations;
+    const auto add_evaluation = [&](int player_1, int player_2) {
+        if (rng.next_bool(0.5))
+        {
+            std::swap(player_1, player_2);
+        }
+        evaluations.push_back({player_1, player_2});
+    };
 
     // Select players
-    for (unsigned int i = 0; i < number_of_trials; ++i)
+    const auto current_agent_games =
+        opponent_count < 2 ? number_of_trials
+                           : static_cast<unsigned int>(
+                                 std::ceil(number_of_trials * current_agent_share));
+    for (unsigned int i = 0; i < current_agent_games && opponent_count > 0; ++i)
     {
-        // Select randomly from opponent pool
-        // TODO: Make it impossible for an agent to play against itself
-        IAgent *agent_1 = opponents[rng.next_int(0, opponents.size())].get();
-        IAgent *agent_2 = opponents[rng.next_int(0, opponents.size())].get();
+        add_evaluation(-1, rng.next_int(0, opponent_count));
+    }
 
-        // 1 in 10 chance to play against the main agent
-        if (rng.next_float(0, 1) < 0.1)
+    // The rest go to the opponents with the fewest games, each against a
+    // partner it hasn't played enough yet
+    std::vector<int> by_games_played(static_cast<std::size_t>(opponent_count));
+    std::iota(by_games_played.begin(), by_games_played.end(), 0);
+    std::stable_sort(by_games_played.begin(), by_games_played.end(), [&](int a, int b) {
+        return results.get_games_played(ids[a]) < results.get_games_played(ids[b]);
+    });
+    std::map<std::pair<int, int>, unsigned int> scheduled;
+    for (unsigned int i = current_agent_games; i < number_of_trials; ++i)
+    {
+        const auto player = by_games_played[(i - current_agent_games) % opponent_count];
+        for (int attempt = 0; attempt < max_pairing_attempts; ++attempt)
         {
-            if (rng.next_float(0, 1) < 0.5)
+            const auto partner = rng.next_int(0, opponent_count);
+            if (partner == player)
             {
-                agent_1 = main_agent.get();
+                continue;
             }
-            else
+            auto &pending = scheduled[std::minmax(player, partner)];
+            if (results.get(ids[player], ids[partner]).get_total() + pending < games_per_pair)
             {
-                agent_2 = main_agent.get();
+                ++pending;
+                add_evaluation(player, partner);
+                break;
             }
         }
-
-        evaluations.push_back({agent_1, agent_2});
     }
 
-    // Create evaluation tasks
-    tf::Executor executor;
+    // Create evaluation tasks. Opponents are only fetched as they play, so
+    // the pool can keep to its memory limit.
     tf::Taskflow task_flow;
 
     for (auto &evaluation : evaluations)
     {
         task_flow.emplace([&] {
-            auto result = Evaluator::evaluate(*evaluation.agent_1, *evaluation.agent_2);
-            evaluation.result = result;
+            std::shared_ptr<const IAgent> agent_1;
+            std::shared_ptr<const IAgent> agent_2;
+            if (evaluation.agent_1 >= 0)
+            {
+                agent_1 = opponents.get(evaluation.agent_1);
+            }
+            if (evaluation.agent_2 >= 0)
+            {
+                agent_2 = opponents.get(evaluation.agent_2);
+            }
+            evaluation.result = Evaluator::evaluate(agent_1 == nullptr ? agent : *agent_1,
+                                                    agent_2 == nullptr ? agent : *agent_2);
         });
     }
 
     // Run evaluation tasks
-    executor.run(task_flow);
-    executor.wait_for_all();
+    executor->run(task_flow);
+    executor->wait_for_all();
 
     // Calculate Elos
+    const auto get_id = [&](int index) -> const std::string & {
+        return index < 0 ? current_agent_id : ids[index];
+    };
     for (const auto &evaluation : evaluations)
     {
-        std::tie(elos[evaluation.agent_1],
-                 elos[evaluation.agent_2]) = calculate_elos(elos[evaluation.agent_1],
-                                                            elos[evaluation.agent_2],
-                                                            elo_constant,
-                                                            evaluation.result);
+        results.add(get_id(evaluation.agent_1), get_id(evaluation.agent_2), evaluation.result);
+    }
+    ratings = fit_bradley_terry(results, ids.empty() ? current_agent_id : ids[0]);
+    double elo = 0;
+    const auto current_agent_rating = ratings.find(current_agent_id);
+    if (current_agent_rating != ratings.end())
+    {
+        elo = current_agent_rating->second;
+        ratings.erase(current_agent_rating);
     }
 
-    spdlog::debug("{}: {}", main_agent->get_name(), elos[main_agent.get()]);
-    for (const auto &opponent : opponents)
+    spdlog::debug("{}: {}", agent.get_name(), elo);
+    for (const auto &[id, rating] : ratings)
     {
-        spdlog::debug("{}: {}", opponent->get_name(), elos[opponent.get()]);
+        spdlog::debug("{}: {}", id, rating);
     }
+    spdlog::debug("Played {} games, {} between opponents",
+                  evaluations.size(),
+                  evaluations.size() - std::min<std::size_t>(current_agent_games,
+                                                             evaluations.size()));
 
-    return elos[main_agent.get()];
+    return elo;
 }
 
 TEST_CASE("EloEvaluator")
@@ -180,17 +230,37 @@ TEST_CASE("EloEvaluator")
         RandomAgent agent_3(default_body(), rng, "Agent 3");
         RandomAgent agent_4(default_body(), rng, "Agent 4");
 
-        std::vector<IAgent *> new_opponents;
+        OpponentPool opponents;
 
-        new_opponents.push_back(&agent_2);
-        evaluator.evaluate(agent_1, new_opponents, 2);
-        new_opponents[0] = &agent_3;
-        evaluator.evaluate(agent_1, new_opponents, 2);
-        new_opponents[0] = &agent_4;
-        auto elo = evaluator.evaluate(agent_1, new_opponents, 2);
+        opponents.add(agent_2.clone(), "2");
+        evaluator.evaluate(agent_1, opponents, 2);
+        opponents.add(agent_3.clone(), "3");
+        evaluator.evaluate(agent_1, opponents, 2);
+        opponents.add(agent_4.clone(), "4");
+        auto elo = evaluator.evaluate(agent_1, opponents, 2);
 
         DOCTEST_CHECK(elo < 40);
         DOCTEST_CHECK(elo > -40);
     }
+
+    SUBCASE("Opponents stop playing each other once they've played enough")
+    {
+        Random rng(0);
+        EloEvaluator evaluator(rng, 0.2, 1);
+
+        RandomAgent agent(default_body(), rng, "Agent");
+        OpponentPool opponents;
+        opponents.add(std::make_unique<RandomAgent>(default_body(), rng, "Opponent 1"), "1");
+        opponents.add(std::make_unique<RandomAgent>(default_body(), rng, "Opponent 2"), "2");
+
+        evaluator.evaluate(agent, opponents, 8);
+        evaluator.evaluate(agent, opponents, 8);
+        const auto &results = evaluator.get_results();
+
+        DOCTEST_CHECK(results.get("1", "2").get_total() == 1);
+        // Only the latest evaluation's games against the agent are kept
+        DOCTEST_CHECK(results.get_games_played("1") + results.get_games_played("2") == 8);
+        DOCTEST_CHECK(evaluator.get_ratings().size() == 2);
+    }
 }
 }
\ No newline at end of file
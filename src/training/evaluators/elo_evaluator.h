@@ -1,33 +1,55 @@
 #pragma once
 
 #include <memory>
-#include <vector>
-#include <map>
-
-#include <cpprl/model/policy.h>
-#include <nlohmann/json_fwd.hpp>
+#include <string>
+#include <unordered_map>
 
 #include "training/agents/iagent.h"
-#include "training/agents/nn_agent.h"
 #include "training/evaluators/evaluator.h"
+#include "training/evaluators/result_matrix.h"
+
+namespace tf
+{
+class Executor;
+}
 
 namespace ai
 {
+class OpponentPool;
 class Random;
 
+// Rates an agent against a league of frozen opponents.
+//
+// Results between opponents can't change, so they're kept from one
+// evaluation to the next, and only pairs that have played fewer than
+// games_per_pair games are played again. Most games go to the agent being
+// evaluated, whose earlier results are thrown away each time as its
+// weights have changed since. Ratings are fitted to every result at once.
 class EloEvaluator : protected Evaluator
 {
   private:
-    std::map<const IAgent *, double> elos;
-    std::unique_ptr<IAgent> main_agent;
-    std::vector<std::unique_ptr<IAgent>> opponents;
+    // Kept between evaluations, along with each thread's environment
+    std::unique_ptr<tf::Executor> executor;
+    unsigned int games_per_pair;
+    ResultMatrix results;
+    std::unordered_map<std::string, double> ratings;
     Random &rng;
 
   public:
-    EloEvaluator(Random &rng, double game_length = 60.f);
+    EloEvaluator(Random &rng, double game_length = 60.f, unsigned int games_per_pair = 4);
+    ~EloEvaluator();
 
-    double evaluate(IAgent &agent,
-                    const std::vector<IAgent *> &new_opponents,
+    // Plays number_of_trials games, and returns agent's Elo relative to the
+    // first opponent in the pool
+    double evaluate(const IAgent &agent,
+                    OpponentPool &opponents,
                     unsigned int number_of_trials);
+
+    // Every rated opponent's Elo by ID, as of the last evaluate()
+    inline const std::unordered_map<std::string, double> &get_ratings() const
+    {
+        return ratings;
+    }
+    inline const ResultMatrix &get_results() const { return results; }
 };
-}
\ No newline at end of file
+}
@@ -10,6 +10,7 @@
 #include "audio/audio_engine.h"
 #include "environment/ecs_env.h"
 #include "environment/serialization/serialize_body.h"
+#include "misc/metrics.h"
 #include "misc/random.h"
 #include "training/agents/iagent.h"
 #include "training/agents/random_agent.h"
@@ -20,9 +21,22 @@ Evaluator::Evaluator(double game_length) : game_length(game_length) {}
 
 EvaluationResult Evaluator::evaluate(const IAgent &agent_1, const IAgent &agent_2)
 {
-    // Initialize environment
-    EcsEnv environment(game_length);
-    environment.set_audibility(false);
+    AI_METRICS_TIMER("ai_evaluation_game_seconds", "Time taken to play one evaluation game");
+    static auto &games_played = get_metrics().counter("ai_evaluation_games_total",
+                                                      "Evaluation games played");
+    games_played.increment();
+
+    // Initialize environment. Each thread keeps one, since setting up a new
+    // one for every game takes longer than many games do.
+    thread_local std::unique_ptr<EcsEnv> thread_environment;
+    thread_local double thread_game_length = 0;
+    if (thread_environment == nullptr || thread_game_length != game_length)
+    {
+        thread_environment = std::make_unique<EcsEnv>(game_length);
+        thread_environment->set_audibility(false);
+        thread_game_length = game_length;
+    }
+    auto &environment = *thread_environment;
     environment.set_body(0, agent_1.get_body_spec());
     environment.set_body(1, agent_2.get_body_spec());
 
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <doctest.h>
+
+#include "training/evaluators/result_matrix.h"
+
+namespace ai
+{
+namespace
+{
+const double convergence_threshold = 1e-9;
+const double elo_scale = 400. / std::log(10.);
+
+MatchupRecord flip(const MatchupRecord &record)
+{
+    return {record.losses, record.draws, record.wins};
+}
+}
+
+void ResultMatrix::add(const std::string &player_1,
+                       const std::string &player_2,
+                       EvaluationResult result)
+{
+    const bool swapped = player_2 < player_1;
+    auto &record = swapped ? records[{player_2, player_1}] : records[{player_1, player_2}];
+    if (result == EvaluationResult::Draw)
+    {
+        ++record.draws;
+    }
+    else if ((result == EvaluationResult::Agent1) != swapped)
+    {
+        ++record.wins;
+    }
+    else
+    {
+        ++record.losses;
+    }
+    ++games_played[player_1];
+    ++games_played[player_2];
+}
+
+MatchupRecord ResultMatrix::get(const std::string &player_1, const std::string &player_2) const
+{
+    const bool swapped = player_2 < player_1;
+    const auto iter = swapped ? records.find({player_2, player_1})
+                              : records.find({player_1, player_2});
+    if (iter == records.end())
+    {
+        return {};
+    }
+    return swapped ? flip(iter->second) : iter->second;
+}
+
+unsigned int ResultMatrix::get_games_played(const std::string &player) const
+{
+    const auto iter = games_played.find(player);
+    return iter == games_played.end() ? 0 : iter->second;
+}
+
+void ResultMatrix::remove(const std::string &player)
+{
+    for (auto iter = records.begin(); iter != records.end();)
+    {
+        const auto &[player_1, player_2] = iter->first;
+        if (player_1 == player || player_2 == player)
+        {
+            const auto &other = player_1 == player ? player_2 : player_1;
+            games_played[other] -= iter->second.get_total();
+            iter = records.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    games_played.erase(player);
+}
+
+std::unordered_map<std::string, double> fit_bradley_terry(const ResultMatrix &matrix,
+                                                          const std::string &anchor,
+                                                          unsigned int max_iterations)
+{
+    struct Matchup
+    {
+        std::size_t player_1;
+        std::size_t player_2;
+        double games;
+    };
+
+    std::unordered_map<std::string, std::size_t> indices;
+    std::vector<const std::string *> ids;
+    // Starts with the draw against the imaginary player
+    std::vector<double> scores;
+    std::vector<Matchup> matchups;
+    const auto get_index = [&](const std::string &id) {
+        const auto [iter, inserted] = indices.emplace(id, ids.size());
+        if (inserted)
+        {
+            ids.push_back(&iter->first);
+            scores.push_back(0.5);
+        }
+        return iter->second;
+    };
+    for (const auto &[players, record] : matrix.get_records())
+    {
+        const auto player_1 = get_index(players.first);
+        const auto player_2 = get_index(players.second);
+        scores[player_1] += record.wins + 0.5 * record.draws;
+        scores[player_2] += record.losses + 0.5 * record.draws;
+        matchups.push_back({player_1, player_2, static_cast<double>(record.get_total())});
+    }
+
+    std::vector<double> strengths(ids.size(), 1.);
+    std::vector<double> denominators(ids.size());
+    for (unsigned int iteration = 0; iteration < max_iterations; ++iteration)
+    {
+        for (std::size_t i = 0; i < strengths.size(); ++i)
+        {
+            denominators[i] = 1. / (strengths[i] + 1.);
+        }
+        for (const auto &matchup : matchups)
+        {
+            const auto share = matchup.games /
+                               (strengths[matchup.player_1] + strengths[matchup.player_2]);
+            denominators[matchup.player_1] += share;
+            denominators[matchup.player_2] += share;
+        }
+
+        double largest_change = 0;
+        for (std::size_t i = 0; i < strengths.size(); ++i)
+        {
+            const auto new_strength = scores[i] / denominators[i];
+            largest_change = std::max(largest_change,
+                                      std::abs(std::log(new_strength / strengths[i])));
+            strengths[i] = new_strength;
+        }
+        if (largest_change < convergence_threshold)
+        {
+            break;
+        }
+    }
+
+    const auto anchor_iter = indices.find(anchor);
+    const double anchor_strength = anchor_iter == indices.end() ? 1.
+                                                                : strengths[anchor_iter->second];
+    std::unordered_map<std::string, double> ratings;
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+        ratings[*ids[i]] = elo_scale * std::log(strengths[i] / anchor_strength);
+    }
+    return ratings;
+}
+
+TEST_CASE("ResultMatrix")
+{
+    ResultMatrix matrix;
+
+    SUBCASE("Results are stored from both sides")
+    {
+        matrix.add("b", "a", EvaluationResult::Agent1);
+        matrix.add("a", "b", EvaluationResult::Draw);
+        matrix.add("a", "b", EvaluationResult::Agent1);
+
+        const auto record = matrix.get("a", "b");
+        DOCTEST_CHECK(record.wins == 1);
+        DOCTEST_CHECK(record.draws == 1);
+        DOCTEST_CHECK(record.losses == 1);
+        DOCTEST_CHECK(matrix.get("b", "a").wins == 1);
+        DOCTEST_CHECK(matrix.get_games_played("a") == 3);
+        DOCTEST_CHECK(matrix.get("a", "c").get_total() == 0);
+    }
+
+    SUBCASE("Removing a player forgets its games")
+    {
+        matrix.add("a", "b", EvaluationResult::Agent1);
+        matrix.add("a", "c", EvaluationResult::Agent2);
+        matrix.remove("a");
+
+        DOCTEST_CHECK(matrix.get("a", "b").get_total() == 0);
+        DOCTEST_CHECK(matrix.get_games_played("b") == 0);
+        DOCTEST_CHECK(matrix.get_records().empty());
+    }
+
+    SUBCASE("Stronger players are rated higher")
+    {
+        for (int i = 0; i < 30; ++i)
+        {
+            matrix.add("strong", "medium", i % 3 == 0 ? EvaluationResult::Agent2
+                                                      : EvaluationResult::Agent1);
+            matrix.add("medium", "weak", i % 3 == 0 ? EvaluationResult::Agent2
+                                                    : EvaluationResult::Agent1);
+        }
+        const auto ratings = fit_bradley_terry(matrix, "weak");
+
+        DOCTEST_CHECK(ratings.at("weak") == doctest::Approx(0.));
+        DOCTEST_CHECK(ratings.at("medium") > 0);
+        DOCTEST_CHECK(ratings.at("strong") > ratings.at("medium"));
+        // Winning two in three is worth about 120 Elo. The prior pulls it in a little.
+        DOCTEST_CHECK(ratings.at("strong") - ratings.at("medium") ==
+                      doctest::Approx(120.).epsilon(0.1));
+    }
+
+    SUBCASE("Evenly matched players are rated the same")
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            matrix.add("a", "b", i % 2 == 0 ? EvaluationResult::Agent1 : EvaluationResult::Agent2);
+            matrix.add("b", "c", EvaluationResult::Draw);
+        }
+        const auto ratings = fit_bradley_terry(matrix, "a");
+
+        DOCTEST_CHECK(ratings.at("b") == doctest::Approx(0.).epsilon(1e-6));
+        DOCTEST_CHECK(ratings.at("c") == doctest::Approx(0.).epsilon(1e-6));
+    }
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "training/evaluators/evaluator.h"
+
+namespace ai
+{
+struct MatchupRecord
+{
+    unsigned int wins = 0;
+    unsigned int draws = 0;
+    unsigned int losses = 0;
+
+    inline unsigned int get_total() const { return wins + draws + losses; }
+};
+
+// Win/draw/loss counts for every pair of players that have played, by
+// player ID
+class ResultMatrix
+{
+  private:
+    std::unordered_map<std::string, unsigned int> games_played;
+    // Keyed with the lesser ID first, and counted from its side
+    std::map<std::pair<std::string, std::string>, MatchupRecord> records;
+
+  public:
+    // result is from player_1's side, as Agent1 meaning player_1 won
+    void add(const std::string &player_1,
+             const std::string &player_2,
+             EvaluationResult result);
+    // From player_1's side
+    MatchupRecord get(const std::string &player_1, const std::string &player_2) const;
+    unsigned int get_games_played(const std::string &player) const;
+    // Forgets every result involving player
+    void remove(const std::string &player);
+
+    inline const std::map<std::pair<std::string, std::string>, MatchupRecord> &
+    get_records() const { return records; }
+};
+
+// Fits Bradley-Terry strengths to every player's results by minorization-
+// maximization, counting a draw as half a win each. Each player also gets
+// one draw against an imaginary player of strength 1, which keeps players
+// who have only won or only lost finite. Returned as Elo ratings, relative
+// to anchor if it has played, or else to the imaginary player.
+std::unordered_map<std::string, double> fit_bradley_terry(const ResultMatrix &matrix,
+                                                          const std::string &anchor,
+                                                          unsigned int max_iterations = 500);
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest.h>
+#include <fmt/format.h>
+
+#include "training/flat_parameters.h"
+
+namespace fs = std::filesystem;
+
+namespace ai
+{
+namespace
+{
+// Cache line alignment, which is also enough for aligned vector loads
+const std::uint64_t alignment = 64;
+const std::array<char, 8> magic = {'A', 'I', 'P', 'A', 'R', 'A', 'M', 'S'};
+const std::uint32_t format_version = 1;
+
+// Files are written and read in the machine's own byte order, which is
+// little endian on everything we train on
+struct Header
+{
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t tensor_count;
+    std::uint64_t data_size;
+};
+
+std::uint64_t align(std::uint64_t offset)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+}
+
+std::int64_t get_element_count(const std::vector<std::int64_t> &shape)
+{
+    return std::accumulate(shape.begin(), shape.end(), std::int64_t{1},
+                           [](std::int64_t count, std::int64_t size) { return count * size; });
+}
+
+std::vector<FlatTensor> write_flat_parameters(const fs::path &path,
+                                              const std::vector<TensorView> &tensors)
+{
+    std::vector<FlatTensor> layout;
+    auto offset = align(sizeof(Header));
+    for (const auto &tensor : tensors)
+    {
+        layout.push_back({tensor.name, offset, tensor.shape});
+        offset = align(offset + get_element_count(tensor.shape) * sizeof(float));
+    }
+    const Header header{magic,
+                        format_version,
+                        static_cast<std::uint32_t>(tensors.size()),
+                        offset - align(sizeof(Header))};
+
+    auto temporary_path = path;
+    temporary_path += fmt::format(".{}.tmp", std::random_device()());
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error(fmt::format("Couldn't write {}", path.string()));
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const std::array<char, alignment> padding{};
+        std::uint64_t position = sizeof(header);
+        for (std::size_t i = 0; i < tensors.size(); ++i)
+        {
+            file.write(padding.data(), static_cast<std::streamsize>(layout[i].offset - position));
+            const auto size = get_element_count(tensors[i].shape) * sizeof(float);
+            file.write(reinterpret_cast<const char *>(tensors[i].data),
+                       static_cast<std::streamsize>(size));
+            position = layout[i].offset + size;
+        }
+        file.write(padding.data(), static_cast<std::streamsize>(offset - position));
+        if (!file)
+        {
+            throw std::runtime_error(fmt::format("Couldn't write {}", path.string()));
+        }
+    }
+    fs::rename(temporary_path, path);
+
+    return layout;
+}
+
+FlatParameters::FlatParameters(const fs::path &path, const std::vector<FlatTensor> &layout)
+    : file(path)
+{
+    Header header;
+    if (file.get_size() < sizeof(header))
+    {
+        throw std::runtime_error(fmt::format("{} is too short to be a parameter file",
+                                             path.string()));
+    }
+    std::memcpy(&header, file.get_data(), sizeof(header));
+    if (header.magic != magic || header.version != format_version)
+    {
+        throw std::runtime_error(fmt::format("{} isn't a parameter file", path.string()));
+    }
+
+    for (const auto &tensor : layout)
+    {
+        const auto size = get_element_count(tensor.shape) * sizeof(float);
+        if (tensor.offset % alignof(float) != 0 || tensor.offset > file.get_size() ||
+            size > file.get_size() - tensor.offset)
+        {
+            throw std::runtime_error(fmt::format("{} doesn't fit in {}",
+                                                 tensor.name,
+                                                 path.string()));
+        }
+        tensors.push_back({tensor.name,
+                           tensor.shape,
+                           reinterpret_cast<const float *>(file.get_data() + tensor.offset)});
+    }
+}
+
+const TensorView *FlatParameters::find(const std::string &name) const
+{
+    auto iter = std::find_if(tensors.begin(), tensors.end(),
+                             [&](const TensorView &tensor) { return tensor.name == name; });
+    return iter == tensors.end() ? nullptr : &*iter;
+}
+
+TEST_CASE("Flat parameters")
+{
+    const auto path = fs::temp_directory_path() / "flat_parameters_test.params";
+    const std::vector<float> weights{1, 2, 3, 4, 5, 6};
+    const std::vector<float> bias{-1, -2, -3};
+    const std::vector<TensorView> tensors{{"layer.weight", {3, 2}, weights.data()},
+                                          {"layer.bias", {3}, bias.data()}};
+    const auto layout = write_flat_parameters(path, tensors);
+
+    SUBCASE("Every tensor is aligned")
+    {
+        DOCTEST_REQUIRE(layout.size() == 2);
+        DOCTEST_CHECK(layout[0].offset % 64 == 0);
+        DOCTEST_CHECK(layout[1].offset % 64 == 0);
+        DOCTEST_CHECK(layout[1].offset > layout[0].offset);
+        DOCTEST_CHECK(fs::file_size(path) % 64 == 0);
+    }
+
+    SUBCASE("Tensors read back the same as they were written")
+    {
+        FlatParameters parameters(path, layout);
+        const auto *weight_view = parameters.find("layer.weight");
+        const auto *bias_view = parameters.find("layer.bias");
+
+        DOCTEST_REQUIRE(weight_view != nullptr);
+        DOCTEST_REQUIRE(bias_view != nullptr);
+        DOCTEST_CHECK(weight_view->shape == std::vector<std::int64_t>{3, 2});
+        DOCTEST_CHECK(std::equal(weights.begin(), weights.end(), weight_view->data));
+        DOCTEST_CHECK(std::equal(bias.begin(), bias.end(), bias_view->data));
+        DOCTEST_CHECK(parameters.find("layer.missing") == nullptr);
+    }
+
+    SUBCASE("A layout that runs past the end of the file is rejected")
+    {
+        auto bad_layout = layout;
+        bad_layout[1].shape = {1000};
+
+        DOCTEST_CHECK_THROWS_AS(FlatParameters(path, bad_layout), std::runtime_error);
+    }
+
+    SUBCASE("Other files are rejected")
+    {
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << std::string(128, 'x');
+        }
+
+        DOCTEST_CHECK_THROWS_AS(FlatParameters(path, layout), std::runtime_error);
+    }
+
+    fs::remove(path);
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "misc/mapped_file.h"
+
+namespace ai
+{
+// Where a float32 tensor lives in a flat parameter file. Offsets are in
+// bytes from the start of the file.
+struct FlatTensor
+{
+    std::string name;
+    std::uint64_t offset;
+    std::vector<std::int64_t> shape;
+};
+
+// A float32 tensor owned by something else, such as a policy or a mapped file
+struct TensorView
+{
+    std::string name;
+    std::vector<std::int64_t> shape;
+    const float *data;
+};
+
+std::int64_t get_element_count(const std::vector<std::int64_t> &shape);
+
+// Writes tensors end to end after a short header, each aligned so it can be
+// read in place once the file is mapped, and returns where each one went.
+// The layout isn't stored in the file itself, it's kept with the
+// checkpoint's metadata. The file is written under a temporary name and
+// renamed, so it's never seen half written.
+std::vector<FlatTensor> write_flat_parameters(const std::filesystem::path &path,
+                                              const std::vector<TensorView> &tensors);
+
+// A flat parameter file mapped into memory. Nothing is copied, so opening
+// one costs the same however big the policy is, and only the pages that are
+// read come off the disk.
+class FlatParameters
+{
+  private:
+    MappedFile file;
+    std::vector<TensorView> tensors;
+
+  public:
+    // Throws std::runtime_error if the file isn't a parameter file or the
+    // layout doesn't fit inside it
+    FlatParameters(const std::filesystem::path &path, const std::vector<FlatTensor> &layout);
+
+    // nullptr if there's no tensor by that name
+    const TensorView *find(const std::string &name) const;
+    inline const std::vector<TensorView> &get_tensors() const { return tensors; }
+};
+}
@@ -0,0 +1,546 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AI_MLP_ENGINE_AVX2
+// Only the kernels are built for AVX2, so the rest of the program still runs
+// on CPUs without it
+#define AI_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#endif
+
+#include <doctest.h>
+
+#include "training/inference/mlp_engine.h"
+
+namespace ai
+{
+namespace
+{
+// Matches cpprl's observation normalisation
+const float normalisation_epsilon = 1e-8f;
+const float observation_clip = 10.f;
+
+int pad_to_eight(int count)
+{
+    return (count + 7) / 8 * 8;
+}
+
+void gemv_f32(const float *weights, const float *bias, const float *input, float *output,
+              int rows, int columns, int padded_columns)
+{
+    for (int row = 0; row < rows; ++row)
+    {
+        const float *row_weights = weights + static_cast<std::size_t>(row) * padded_columns;
+        float sum = 0;
+        for (int column = 0; column < columns; ++column)
+        {
+            sum += row_weights[column] * input[column];
+        }
+        output[row] = sum + bias[row];
+    }
+}
+
+void gemv_f16(const std::uint16_t *weights, const float *bias, const float *input, float *output,
+              int rows, int columns, int padded_columns)
+{
+    for (int row = 0; row < rows; ++row)
+    {
+        const std::uint16_t *row_weights = weights + static_cast<std::size_t>(row) * padded_columns;
+        float sum = 0;
+        for (int column = 0; column < columns; ++column)
+        {
+            sum += half_to_float(row_weights[column]) * input[column];
+        }
+        output[row] = sum + bias[row];
+    }
+}
+
+void gemv_i8(const std::int8_t *weights, const float *scales, const float *bias,
+             const float *input, float *output, int rows, int columns, int padded_columns)
+{
+    for (int row = 0; row < rows; ++row)
+    {
+        const std::int8_t *row_weights = weights + static_cast<std::size_t>(row) * padded_columns;
+        float sum = 0;
+        for (int column = 0; column < columns; ++column)
+        {
+            sum += static_cast<float>(row_weights[column]) * input[column];
+        }
+        output[row] = sum * scales[row] + bias[row];
+    }
+}
+
+#ifdef AI_MLP_ENGINE_AVX2
+bool has_avx2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2") &&
+                                  __builtin_cpu_supports("fma") &&
+                                  __builtin_cpu_supports("f16c");
+    return supported;
+}
+
+AI_TARGET_AVX2 inline float horizontal_sum(__m256 values)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+AI_TARGET_AVX2 inline __m256 load_weights(const float *weights)
+{
+    return _mm256_load_ps(weights);
+}
+
+AI_TARGET_AVX2 inline __m256 load_weights(const std::uint16_t *weights)
+{
+    return _mm256_cvtph_ps(_mm_load_si128(reinterpret_cast<const __m128i *>(weights)));
+}
+
+AI_TARGET_AVX2 inline __m256 load_weights(const std::int8_t *weights)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(weights))));
+}
+
+// Four rows at a time, so each load of the input is used four times
+template <typename Weight>
+AI_TARGET_AVX2 void gemv_avx2(const Weight *weights, const float *scales, const float *bias,
+                              const float *input, float *output, int rows, int padded_columns)
+{
+    const auto stride = static_cast<std::size_t>(padded_columns);
+    int row = 0;
+    for (; row + 4 <= rows; row += 4)
+    {
+        const Weight *row_weights = weights + row * stride;
+        __m256 sums[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                          _mm256_setzero_ps(), _mm256_setzero_ps()};
+        for (int column = 0; column < padded_columns; column += 8)
+        {
+            const __m256 input_8 = _mm256_loadu_ps(input + column);
+            for (int i = 0; i < 4; ++i)
+            {
+                sums[i] = _mm256_fmadd_ps(load_weights(row_weights + i * stride + column),
+                                          input_8,
+                                          sums[i]);
+            }
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            const float scale = scales == nullptr ? 1.f : scales[row + i];
+            output[row + i] = horizontal_sum(sums[i]) * scale + bias[row + i];
+        }
+    }
+    for (; row < rows; ++row)
+    {
+        const Weight *row_weights = weights + row * stride;
+        __m256 sum = _mm256_setzero_ps();
+        for (int column = 0; column < padded_columns; column += 8)
+        {
+            sum = _mm256_fmadd_ps(load_weights(row_weights + column),
+                                  _mm256_loadu_ps(input + column),
+                                  sum);
+        }
+        const float scale = scales == nullptr ? 1.f : scales[row];
+        output[row] = horizontal_sum(sum) * scale + bias[row];
+    }
+}
+#endif
+
+// Scratch space for forward(), kept per thread so engines can be shared
+float *get_scratch(int index, int size)
+{
+    thread_local AlignedArray<float> buffers[3];
+    auto &buffer = buffers[index];
+    if (buffer.size() < static_cast<std::size_t>(size))
+    {
+        buffer = AlignedArray<float>(static_cast<std::size_t>(size));
+    }
+    return buffer.get();
+}
+
+// Applies tanh to the layer's outputs and zeroes the padding after them,
+// ready to be the next layer's input
+void activate(float *values, int count, int padded_count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        values[i] = std::tanh(values[i]);
+    }
+    std::fill(values + count, values + padded_count, 0.f);
+}
+}
+
+std::uint16_t float_to_half(float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+    std::uint32_t mantissa = bits & 0x007fffffu;
+    const int exponent = static_cast<int>((bits >> 23) & 0xffu);
+
+    if (exponent == 0xff)
+    {
+        // Infinity or NaN
+        return static_cast<std::uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+    }
+    const int half_exponent = exponent - 127 + 15;
+    if (half_exponent >= 0x1f)
+    {
+        return static_cast<std::uint16_t>(sign | 0x7c00u);
+    }
+    if (half_exponent <= 0)
+    {
+        if (half_exponent < -10)
+        {
+            return sign;
+        }
+        // Subnormal, rounded to nearest even
+        mantissa |= 0x00800000u;
+        const int shift = 14 - half_exponent;
+        auto half_mantissa = mantissa >> shift;
+        const auto remainder = mantissa & ((1u << shift) - 1);
+        const auto halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u)))
+        {
+            ++half_mantissa;
+        }
+        return static_cast<std::uint16_t>(sign | half_mantissa);
+    }
+
+    // Rounding up can carry into the exponent, which is still correct
+    auto half = static_cast<std::uint32_t>(half_exponent << 10) | (mantissa >> 13);
+    const auto remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+    {
+        ++half;
+    }
+    return static_cast<std::uint16_t>(sign | half);
+}
+
+float half_to_float(std::uint16_t value)
+{
+    const std::uint32_t sign = (value & 0x8000u) << 16;
+    std::uint32_t exponent = (value >> 10) & 0x1fu;
+    std::uint32_t mantissa = value & 0x3ffu;
+
+    std::uint32_t bits;
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400u) == 0)
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+    }
+    else if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+DenseLayer::DenseLayer(int input_size,
+                       int output_size,
+                       const float *weights,
+                       const float *bias,
+                       WeightPrecision precision)
+    : bias(static_cast<std::size_t>(output_size)),
+      input_size(input_size),
+      output_size(output_size),
+      padded_input_size(pad_to_eight(input_size)),
+      precision(precision)
+{
+    std::copy(bias, bias + output_size, this->bias.get());
+
+    const auto weight_count = static_cast<std::size_t>(output_size) * padded_input_size;
+    if (precision == WeightPrecision::Float32)
+    {
+        weights_f32 = AlignedArray<float>(weight_count);
+    }
+    else if (precision == WeightPrecision::Float16)
+    {
+        weights_f16 = AlignedArray<std::uint16_t>(weight_count);
+    }
+    else
+    {
+        weights_i8 = AlignedArray<std::int8_t>(weight_count);
+        scales.resize(static_cast<std::size_t>(output_size));
+    }
+
+    for (int row = 0; row < output_size; ++row)
+    {
+        const float *source = weights + static_cast<std::size_t>(row) * input_size;
+        const auto offset = static_cast<std::size_t>(row) * padded_input_size;
+        if (precision == WeightPrecision::Float32)
+        {
+            std::copy(source, source + input_size, weights_f32.get() + offset);
+        }
+        else if (precision == WeightPrecision::Float16)
+        {
+            std::transform(source, source + input_size, weights_f16.get() + offset, float_to_half);
+        }
+        else
+        {
+            // Symmetric, so zero stays exactly zero
+            float max_weight = 0;
+            for (int column = 0; column < input_size; ++column)
+            {
+                max_weight = std::max(max_weight, std::abs(source[column]));
+            }
+            const float scale = max_weight / 127.f;
+            scales[static_cast<std::size_t>(row)] = scale;
+            for (int column = 0; column < input_size; ++column)
+            {
+                const float quantized = scale == 0 ? 0 : std::round(source[column] / scale);
+                weights_i8[offset + static_cast<std::size_t>(column)] =
+                    static_cast<std::int8_t>(std::clamp(quantized, -127.f, 127.f));
+            }
+        }
+    }
+}
+
+void DenseLayer::forward(const float *input, float *output) const
+{
+#ifdef AI_MLP_ENGINE_AVX2
+    if (has_avx2())
+    {
+        if (precision == WeightPrecision::Float32)
+        {
+            gemv_avx2(weights_f32.get(), nullptr, bias.get(), input, output,
+                      output_size, padded_input_size);
+        }
+        else if (precision == WeightPrecision::Float16)
+        {
+            gemv_avx2(weights_f16.get(), nullptr, bias.get(), input, output,
+                      output_size, padded_input_size);
+        }
+        else
+        {
+            gemv_avx2(weights_i8.get(), scales.data(), bias.get(), input, output,
+                      output_size, padded_input_size);
+        }
+        return;
+    }
+#endif
+    if (precision == WeightPrecision::Float32)
+    {
+        gemv_f32(weights_f32.get(), bias.get(), input, output,
+                 output_size, input_size, padded_input_size);
+    }
+    else if (precision == WeightPrecision::Float16)
+    {
+        gemv_f16(weights_f16.get(), bias.get(), input, output,
+                 output_size, input_size, padded_input_size);
+    }
+    else
+    {
+        gemv_i8(weights_i8.get(), scales.data(), bias.get(), input, output,
+                output_size, input_size, padded_input_size);
+    }
+}
+
+std::size_t DenseLayer::get_memory_usage() const
+{
+    return bias.size() * sizeof(float) +
+           scales.size() * sizeof(float) +
+           weights_f16.size() * sizeof(std::uint16_t) +
+           weights_f32.size() * sizeof(float) +
+           weights_i8.size() * sizeof(std::int8_t);
+}
+
+MlpInferenceEngine::MlpInferenceEngine(const MlpWeights &weights, WeightPrecision precision)
+{
+    const auto check_size = [](const std::vector<float> &values, int size, const char *name) {
+        if (values.size() != static_cast<std::size_t>(size))
+        {
+            throw std::invalid_argument(std::string("Wrong number of values for ") + name);
+        }
+    };
+    const int observations = weights.observation_size;
+    const int hidden = weights.hidden_size;
+    const int actions = weights.action_count;
+    for (int i = 0; i < 2; ++i)
+    {
+        const int inputs = i == 0 ? observations : hidden;
+        check_size(weights.actor_weights[i], inputs * hidden, "actor weights");
+        check_size(weights.actor_biases[i], hidden, "actor biases");
+        check_size(weights.critic_weights[i], inputs * hidden, "critic weights");
+        check_size(weights.critic_biases[i], hidden, "critic biases");
+        actor_layers[i] = DenseLayer(inputs, hidden, weights.actor_weights[i].data(),
+                                     weights.actor_biases[i].data(), precision);
+        critic_layers[i] = DenseLayer(inputs, hidden, weights.critic_weights[i].data(),
+                                      weights.critic_biases[i].data(), precision);
+    }
+    check_size(weights.value_weights, hidden, "value weights");
+    check_size(weights.value_biases, 1, "value biases");
+    check_size(weights.action_weights, hidden * actions, "action weights");
+    check_size(weights.action_biases, actions, "action biases");
+    // The output layers are tiny and decide the actions, so they stay exact
+    value_layer = DenseLayer(hidden, 1, weights.value_weights.data(),
+                             weights.value_biases.data(), WeightPrecision::Float32);
+    action_layer = DenseLayer(hidden, actions, weights.action_weights.data(),
+                              weights.action_biases.data(), WeightPrecision::Float32);
+
+    if (!weights.observation_mean.empty())
+    {
+        check_size(weights.observation_mean, observations, "observation mean");
+        check_size(weights.observation_variance, observations, "observation variance");
+        observation_offset = weights.observation_mean;
+        for (const auto variance : weights.observation_variance)
+        {
+            observation_scale.push_back(1.f / std::sqrt(variance + normalisation_epsilon));
+        }
+    }
+}
+
+void MlpInferenceEngine::forward(const float *observation,
+                                 float *action_probabilities,
+                                 float *value) const
+{
+    const int observation_size = actor_layers[0].get_input_size();
+    const int padded_observation_size = actor_layers[0].get_padded_input_size();
+    const int hidden_size = actor_layers[0].get_output_size();
+    const int padded_hidden_size = actor_layers[1].get_padded_input_size();
+
+    float *input = get_scratch(0, padded_observation_size);
+    float *hidden_1 = get_scratch(1, padded_hidden_size);
+    float *hidden_2 = get_scratch(2, padded_hidden_size);
+
+    if (observation_offset.empty())
+    {
+        std::copy(observation, observation + observation_size, input);
+    }
+    else
+    {
+        for (int i = 0; i < observation_size; ++i)
+        {
+            input[i] = std::clamp((observation[i] - observation_offset[i]) * observation_scale[i],
+                                  -observation_clip,
+                                  observation_clip);
+        }
+    }
+    std::fill(input + observation_size, input + padded_observation_size, 0.f);
+
+    actor_layers[0].forward(input, hidden_1);
+    activate(hidden_1, hidden_size, padded_hidden_size);
+    actor_layers[1].forward(hidden_1, hidden_2);
+    activate(hidden_2, hidden_size, padded_hidden_size);
+    action_layer.forward(hidden_2, action_probabilities);
+    for (int i = 0; i < action_layer.get_output_size(); ++i)
+    {
+        action_probabilities[i] = 1.f / (1.f + std::exp(-action_probabilities[i]));
+    }
+
+    if (value != nullptr)
+    {
+        critic_layers[0].forward(input, hidden_1);
+        activate(hidden_1, hidden_size, padded_hidden_size);
+        critic_layers[1].forward(hidden_1, hidden_2);
+        activate(hidden_2, hidden_size, padded_hidden_size);
+        value_layer.forward(hidden_2, value);
+    }
+}
+
+std::size_t MlpInferenceEngine::get_memory_usage() const
+{
+    std::size_t memory_usage = action_layer.get_memory_usage() + value_layer.get_memory_usage();
+    for (int i = 0; i < 2; ++i)
+    {
+        memory_usage += actor_layers[i].get_memory_usage() + critic_layers[i].get_memory_usage();
+    }
+    return memory_usage + (observation_offset.size() + observation_scale.size()) * sizeof(float);
+}
+
+TEST_CASE("MlpInferenceEngine")
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    auto random_values = [&](int count) {
+        std::vector<float> values(static_cast<std::size_t>(count));
+        for (auto &value : values)
+        {
+            value = distribution(rng);
+        }
+        return values;
+    };
+
+    SUBCASE("Half precision round trips")
+    {
+        for (const float value : {0.f, 1.f, -2.5f, 0.333251953125f, 65504.f, 6.103515625e-05f})
+        {
+            DOCTEST_CHECK(half_to_float(float_to_half(value)) == value);
+        }
+        DOCTEST_CHECK(half_to_float(float_to_half(1e6f)) == INFINITY);
+        // The smallest subnormal
+        DOCTEST_CHECK(half_to_float(float_to_half(5.960464477539063e-08f)) ==
+                      doctest::Approx(5.960464477539063e-08f));
+    }
+
+    SUBCASE("Dense layers match a plain matrix-vector product")
+    {
+        // Odd sizes exercise the padding and the leftover rows
+        const int inputs = 13;
+        const int outputs = 7;
+        const auto weights = random_values(inputs * outputs);
+        const auto bias = random_values(outputs);
+        auto input = random_values(16);
+        std::fill(input.begin() + inputs, input.end(), 0.f);
+
+        std::vector<float> expected(outputs);
+        for (int row = 0; row < outputs; ++row)
+        {
+            expected[row] = bias[row];
+            for (int column = 0; column < inputs; ++column)
+            {
+                expected[row] += weights[row * inputs + column] * input[column];
+            }
+        }
+
+        for (const auto &[precision, tolerance] : {std::pair{WeightPrecision::Float32, 1e-5},
+                                                  std::pair{WeightPrecision::Float16, 5e-3},
+                                                  std::pair{WeightPrecision::Int8, 5e-2}})
+        {
+            DenseLayer layer(inputs, outputs, weights.data(), bias.data(), precision);
+            std::vector<float> output(outputs);
+            layer.forward(input.data(), output.data());
+            for (int row = 0; row < outputs; ++row)
+            {
+                DOCTEST_CHECK(output[row] == doctest::Approx(expected[row]).epsilon(tolerance));
+            }
+        }
+    }
+
+    SUBCASE("Mismatched weights are rejected")
+    {
+        MlpWeights weights;
+        weights.observation_size = 3;
+        weights.hidden_size = 4;
+        weights.action_count = 2;
+
+        DOCTEST_CHECK_THROWS_AS(MlpInferenceEngine{weights}, std::invalid_argument);
+    }
+}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace ai
+{
+enum class WeightPrecision
+{
+    Float32,
+    // Half the memory, converted back to floats as they're used
+    Float16,
+    // A quarter of the memory, with one scale per output
+    Int8
+};
+
+std::uint16_t float_to_half(float value);
+float half_to_float(std::uint16_t value);
+
+// A fixed size array aligned for 256 bit loads
+template <typename T>
+class AlignedArray
+{
+  private:
+    struct Delete
+    {
+        void operator()(T *pointer) const
+        {
+            ::operator delete(pointer, std::align_val_t{alignment});
+        }
+    };
+
+    std::unique_ptr<T[], Delete> data;
+    std::size_t count;
+
+  public:
+    static constexpr std::size_t alignment = 32;
+
+    AlignedArray() : count(0) {}
+    explicit AlignedArray(std::size_t count)
+        : data(static_cast<T *>(::operator new(count * sizeof(T),
+                                               std::align_val_t{alignment}))),
+          count(count)
+    {
+        std::fill(data.get(), data.get() + count, T{});
+    }
+
+    inline T *get() { return data.get(); }
+    inline const T *get() const { return data.get(); }
+    inline std::size_t size() const { return count; }
+    inline T &operator[](std::size_t index) { return data[index]; }
+    inline const T &operator[](std::size_t index) const { return data[index]; }
+};
+
+// A fully connected layer computing weights * input + bias.
+//
+// Rows of weights are padded to a multiple of eight so the kernels never
+// need a scalar tail, and inputs must be padded to match with zeros.
+class DenseLayer
+{
+  private:
+    AlignedArray<float> bias;
+    int input_size;
+    int output_size;
+    int padded_input_size;
+    WeightPrecision precision;
+    std::vector<float> scales;
+    AlignedArray<std::uint16_t> weights_f16;
+    AlignedArray<float> weights_f32;
+    AlignedArray<std::int8_t> weights_i8;
+
+  public:
+    DenseLayer() : input_size(0), output_size(0), padded_input_size(0),
+                   precision(WeightPrecision::Float32) {}
+    // weights is row-major, output_size rows of input_size
+    DenseLayer(int input_size,
+               int output_size,
+               const float *weights,
+               const float *bias,
+               WeightPrecision precision);
+
+    void forward(const float *input, float *output) const;
+
+    inline int get_input_size() const { return input_size; }
+    std::size_t get_memory_usage() const;
+    inline int get_output_size() const { return output_size; }
+    inline int get_padded_input_size() const { return padded_input_size; }
+};
+
+// Everything needed to run a cpprl MlpBase policy with a Bernoulli output,
+// without libtorch
+struct MlpWeights
+{
+    int observation_size = 0;
+    int hidden_size = 0;
+    int action_count = 0;
+
+    // Left empty if observations aren't normalised
+    std::vector<float> observation_mean;
+    std::vector<float> observation_variance;
+
+    std::vector<float> actor_weights[2];
+    std::vector<float> actor_biases[2];
+    std::vector<float> critic_weights[2];
+    std::vector<float> critic_biases[2];
+    std::vector<float> value_weights;
+    std::vector<float> value_biases;
+    std::vector<float> action_weights;
+    std::vector<float> action_biases;
+};
+
+// Runs the actor and critic of a small, fixed shape MLP policy for one
+// observation at a time, on the CPU's vector units where it has them.
+// forward() can be called from several threads at once.
+class MlpInferenceEngine
+{
+  private:
+    DenseLayer action_layer;
+    DenseLayer actor_layers[2];
+    DenseLayer critic_layers[2];
+    std::vector<float> observation_offset;
+    std::vector<float> observation_scale;
+    DenseLayer value_layer;
+
+  public:
+    explicit MlpInferenceEngine(const MlpWeights &weights,
+                                WeightPrecision precision = WeightPrecision::Float32);
+
+    // Writes the probability of each action being taken, and the value of
+    // the observation if value isn't null
+    void forward(const float *observation, float *action_probabilities, float *value) const;
+
+    inline int get_action_count() const { return action_layer.get_output_size(); }
+    inline int get_hidden_size() const { return actor_layers[0].get_output_size(); }
+    std::size_t get_memory_usage() const;
+    inline int get_observation_size() const { return actor_layers[0].get_input_size(); }
+};
+}
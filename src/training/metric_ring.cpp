@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <doctest.h>
+
+#include "training/metric_ring.h"
+
+namespace ai
+{
+MetricRing::MetricRing(std::size_t capacity)
+    : capacity(capacity),
+      next_sequence(0)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("A MetricRing needs room for at least one record");
+    }
+    records.reserve(capacity);
+}
+
+unsigned long long MetricRing::get_next_sequence() const
+{
+    std::lock_guard lock(mutex);
+    return next_sequence;
+}
+
+std::vector<TrainingMetric> MetricRing::poll(unsigned long long &cursor,
+                                             unsigned long long *dropped) const
+{
+    std::lock_guard lock(mutex);
+
+    const auto oldest = next_sequence - records.size();
+    const auto first = std::clamp(cursor, oldest, next_sequence);
+    if (dropped != nullptr)
+    {
+        *dropped = cursor < oldest ? oldest - cursor : 0;
+    }
+
+    std::vector<TrainingMetric> result;
+    result.reserve(next_sequence - first);
+    for (auto sequence = first; sequence < next_sequence; ++sequence)
+    {
+        result.push_back(records[sequence % capacity]);
+    }
+    cursor = next_sequence;
+
+    return result;
+}
+
+void MetricRing::push(TrainingMetric record)
+{
+    std::lock_guard lock(mutex);
+    if (records.size() < capacity)
+    {
+        records.push_back(std::move(record));
+    }
+    else
+    {
+        records[next_sequence % capacity] = std::move(record);
+    }
+    ++next_sequence;
+}
+
+void MetricRing::push(const std::vector<TrainingMetric> &new_records)
+{
+    for (const auto &record : new_records)
+    {
+        push(record);
+    }
+}
+
+TEST_CASE("MetricRing")
+{
+    MetricRing ring(4);
+    unsigned long long cursor = 0;
+
+    SUBCASE("Polling returns records in the order they were pushed")
+    {
+        ring.push({"Loss", 1.f, 10, 1});
+        ring.push({"FPS", 2.f, 10, 1});
+        const auto records = ring.poll(cursor);
+
+        DOCTEST_REQUIRE(records.size() == 2);
+        DOCTEST_CHECK(records[0].name == "Loss");
+        DOCTEST_CHECK(records[1].value == doctest::Approx(2.f));
+        DOCTEST_CHECK(cursor == 2);
+    }
+
+    SUBCASE("Polling again only returns new records")
+    {
+        ring.push({"Loss", 1.f, 10, 1});
+        ring.poll(cursor);
+        ring.push({"Loss", 0.5f, 20, 2});
+        const auto records = ring.poll(cursor);
+
+        DOCTEST_REQUIRE(records.size() == 1);
+        DOCTEST_CHECK(records[0].batch_number == 2);
+    }
+
+    SUBCASE("Overwritten records are reported as dropped")
+    {
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            ring.push({"Loss", static_cast<float>(i), i, i});
+        }
+        unsigned long long dropped = 0;
+        const auto records = ring.poll(cursor, &dropped);
+
+        DOCTEST_REQUIRE(records.size() == 4);
+        DOCTEST_CHECK(records[0].value == doctest::Approx(2.f));
+        DOCTEST_CHECK(records[3].value == doctest::Approx(5.f));
+        DOCTEST_CHECK(dropped == 2);
+    }
+
+    SUBCASE("Readers follow the ring independently")
+    {
+        unsigned long long other_cursor = 0;
+        ring.push({"Loss", 1.f, 10, 1});
+        ring.poll(cursor);
+
+        DOCTEST_CHECK(ring.poll(other_cursor).size() == 1);
+    }
+}
+}
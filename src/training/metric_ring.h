@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ai
+{
+struct TrainingMetric
+{
+    std::string name;
+    float value;
+    unsigned long long timestep;
+    unsigned int batch_number;
+};
+
+// A fixed size ring of the most recent training metrics, safe to poll from
+// one thread while the trainer writes from another.
+//
+// Every record gets a sequence number. Readers keep a cursor, the sequence
+// number of the next record they want, so any number of readers can follow
+// the ring independently. Records overwritten before a reader got to them
+// are counted as dropped.
+class MetricRing
+{
+  private:
+    std::size_t capacity;
+    mutable std::mutex mutex;
+    unsigned long long next_sequence;
+    std::vector<TrainingMetric> records;
+
+  public:
+    explicit MetricRing(std::size_t capacity = 4096);
+
+    // Records from cursor on, after which cursor points past the newest one
+    std::vector<TrainingMetric> poll(unsigned long long &cursor,
+                                     unsigned long long *dropped = nullptr) const;
+    void push(TrainingMetric record);
+    void push(const std::vector<TrainingMetric> &new_records);
+
+    unsigned long long get_next_sequence() const;
+};
+}
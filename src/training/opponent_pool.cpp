@@ -0,0 +1,234 @@
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <doctest.h>
+#include <spdlog/spdlog.h>
+
+#include "training/opponent_pool.h"
+#include "environment/serialization/serialize_body.h"
+#include "misc/random.h"
+#include "training/agents/iagent.h"
+#include "training/agents/random_agent.h"
+
+namespace ai
+{
+OpponentPool::OpponentPool(Loader loader, std::size_t max_memory)
+    : evictions(0),
+      loader(std::move(loader)),
+      loads(0),
+      max_memory(max_memory),
+      memory_usage(0),
+      use_count(0) {}
+
+OpponentPool::~OpponentPool() {}
+
+bool OpponentPool::add(std::unique_ptr<IAgent> agent, const std::string &id)
+{
+    const auto name = agent->get_name();
+    const auto agent_memory = agent->get_memory_usage();
+    return add_entry({std::move(agent), id, 0, agent_memory, name, ""});
+}
+
+bool OpponentPool::add_checkpoint(const std::string &path)
+{
+    if (!loader)
+    {
+        throw std::logic_error("Can't add checkpoints to an opponent pool without a loader");
+    }
+    return add_entry({nullptr, path, 0, 0, path, path});
+}
+
+bool OpponentPool::add_checkpoint(const std::string &path, std::unique_ptr<IAgent> agent)
+{
+    const auto name = agent->get_name();
+    const auto agent_memory = agent->get_memory_usage();
+    return add_entry({std::move(agent), path, 0, agent_memory, name, loader ? path : ""});
+}
+
+bool OpponentPool::add_entry(Entry entry)
+{
+    std::lock_guard lock(mutex);
+    if (!indices.emplace(entry.id, entries.size()).second)
+    {
+        return false;
+    }
+    entry.last_used = use_count++;
+    memory_usage += entry.agent == nullptr ? 0 : entry.memory_usage;
+    entries.push_back(std::move(entry));
+    evict(entries.size() - 1);
+    return true;
+}
+
+void OpponentPool::evict(std::size_t keep)
+{
+    while (max_memory != 0 && memory_usage > max_memory)
+    {
+        auto oldest = entries.size();
+        auto oldest_use = std::numeric_limits<unsigned long long>::max();
+        for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+            const auto &entry = entries[i];
+            if (i != keep && entry.agent != nullptr && !entry.path.empty() &&
+                entry.last_used < oldest_use)
+            {
+                oldest = i;
+                oldest_use = entry.last_used;
+            }
+        }
+        if (oldest == entries.size())
+        {
+            return;
+        }
+        entries[oldest].agent.reset();
+        memory_usage -= entries[oldest].memory_usage;
+        ++evictions;
+    }
+}
+
+std::shared_ptr<const IAgent> OpponentPool::get(std::size_t index)
+{
+    std::string name;
+    std::string path;
+    {
+        std::lock_guard lock(mutex);
+        auto &entry = entries.at(index);
+        entry.last_used = use_count++;
+        if (entry.agent != nullptr)
+        {
+            return entry.agent;
+        }
+        name = entry.name;
+        path = entry.path;
+    }
+
+    // Loading takes a while, so other games carry on meanwhile. If two
+    // threads load the same checkpoint, the second copy is thrown away.
+    spdlog::debug("Loading opponent {}", path);
+    auto agent = loader(path);
+    agent->set_name(name);
+    const auto agent_memory = agent->get_memory_usage();
+
+    std::lock_guard lock(mutex);
+    auto &entry = entries[index];
+    if (entry.agent == nullptr)
+    {
+        entry.agent = std::move(agent);
+        entry.memory_usage = agent_memory;
+        memory_usage += agent_memory;
+        ++loads;
+        evict(index);
+    }
+    return entry.agent;
+}
+
+std::string OpponentPool::get_id(std::size_t index) const
+{
+    std::lock_guard lock(mutex);
+    return entries.at(index).id;
+}
+
+OpponentPoolStats OpponentPool::get_stats() const
+{
+    std::lock_guard lock(mutex);
+    std::size_t resident = 0;
+    for (const auto &entry : entries)
+    {
+        resident += entry.agent == nullptr ? 0 : 1;
+    }
+    return {evictions, loads, memory_usage, resident, entries.size()};
+}
+
+std::size_t OpponentPool::size() const
+{
+    std::lock_guard lock(mutex);
+    return entries.size();
+}
+
+namespace
+{
+class SizedAgent : public RandomAgent
+{
+  public:
+    SizedAgent(Random &rng, const std::string &name) : RandomAgent(default_body(), rng, name) {}
+
+    std::size_t get_memory_usage() const override { return 100; }
+};
+}
+
+TEST_CASE("OpponentPool")
+{
+    Random rng(0);
+    int load_count = 0;
+    OpponentPool pool(
+        [&](const std::string &path) {
+            ++load_count;
+            return std::make_unique<SizedAgent>(rng, path);
+        },
+        300);
+
+    SUBCASE("Each ID is only added once")
+    {
+        DOCTEST_CHECK(pool.add(std::make_unique<SizedAgent>(rng, "Agent"), "agent"));
+        DOCTEST_CHECK(!pool.add(std::make_unique<SizedAgent>(rng, "Agent"), "agent"));
+        DOCTEST_CHECK(pool.add_checkpoint("a.pt"));
+        DOCTEST_CHECK(!pool.add_checkpoint("a.pt"));
+
+        DOCTEST_CHECK(pool.size() == 2);
+    }
+
+    SUBCASE("Checkpoints are only loaded when they're played")
+    {
+        pool.add_checkpoint("a.pt");
+
+        DOCTEST_CHECK(load_count == 0);
+
+        const auto agent = pool.get(0);
+        pool.get(0);
+
+        DOCTEST_CHECK(load_count == 1);
+        DOCTEST_CHECK(agent->get_name() == "a.pt");
+    }
+
+    SUBCASE("The least recently played checkpoints are dropped to stay under the limit")
+    {
+        pool.add(std::make_unique<SizedAgent>(rng, "Pinned"), "pinned");
+        pool.add_checkpoint("a.pt");
+        pool.add_checkpoint("b.pt");
+        const auto a = pool.get(1);
+        pool.get(2);
+
+        DOCTEST_CHECK(pool.get_stats().memory_usage == 300);
+
+        pool.add_checkpoint("c.pt");
+        pool.get(3);
+        const auto stats = pool.get_stats();
+
+        DOCTEST_CHECK(stats.memory_usage == 300);
+        DOCTEST_CHECK(stats.evictions == 1);
+        DOCTEST_CHECK(stats.resident == 3);
+        // Still usable by whoever was playing it
+        DOCTEST_CHECK(a->get_name() == "a.pt");
+
+        pool.get(1);
+
+        DOCTEST_CHECK(load_count == 4);
+    }
+
+    SUBCASE("Saved snapshots start loaded, but can be dropped")
+    {
+        pool.add_checkpoint("a.pt", std::make_unique<SizedAgent>(rng, "Snapshot"));
+        pool.add_checkpoint("b.pt", std::make_unique<SizedAgent>(rng, "Snapshot 2"));
+        pool.add_checkpoint("c.pt", std::make_unique<SizedAgent>(rng, "Snapshot 3"));
+        pool.add_checkpoint("d.pt", std::make_unique<SizedAgent>(rng, "Snapshot 4"));
+
+        DOCTEST_CHECK(load_count == 0);
+        DOCTEST_CHECK(pool.get_stats().resident == 3);
+        DOCTEST_CHECK(pool.get(0)->get_name() == "Snapshot");
+        DOCTEST_CHECK(load_count == 1);
+    }
+}
+}
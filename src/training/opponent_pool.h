@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ai
+{
+class IAgent;
+
+struct OpponentPoolStats
+{
+    std::size_t evictions;
+    std::size_t loads;
+    std::size_t memory_usage;
+    std::size_t resident;
+    std::size_t size;
+};
+
+// Every opponent agents train and are evaluated against, each stored once
+// and shared by training and evaluation.
+//
+// Opponents are identified by a unique ID, normally their checkpoint path.
+// Those with a checkpoint are only loaded when first played, and once the
+// pool's loaded agents use more than max_memory bytes, the least recently
+// played are dropped until they are needed again. Agents still being
+// played keep their own reference, so dropping one never pulls it out from
+// under a game. All methods are thread-safe, and indices never change.
+class OpponentPool
+{
+  public:
+    using Loader = std::function<std::unique_ptr<IAgent>(const std::string &path)>;
+
+  private:
+    struct Entry
+    {
+        std::shared_ptr<const IAgent> agent;
+        std::string id;
+        unsigned long long last_used;
+        std::size_t memory_usage;
+        std::string name;
+        // Empty if the agent can't be loaded again, so it's never dropped
+        std::string path;
+    };
+
+    std::vector<Entry> entries;
+    std::size_t evictions;
+    std::unordered_map<std::string, std::size_t> indices;
+    Loader loader;
+    std::size_t loads;
+    std::size_t max_memory;
+    std::size_t memory_usage;
+    mutable std::mutex mutex;
+    unsigned long long use_count;
+
+    bool add_entry(Entry entry);
+    void evict(std::size_t keep);
+
+  public:
+    // A max_memory of 0 never drops anything
+    explicit OpponentPool(Loader loader = nullptr, std::size_t max_memory = 0);
+    ~OpponentPool();
+
+    // Adds an agent that stays in memory. Returns false, and leaves the pool
+    // as it was, if the ID is already taken.
+    bool add(std::unique_ptr<IAgent> agent, const std::string &id);
+    // Adds a checkpoint to be loaded when it's first played
+    bool add_checkpoint(const std::string &path);
+    // Adds an agent that was saved to path, so it can be dropped and loaded
+    // again later
+    bool add_checkpoint(const std::string &path, std::unique_ptr<IAgent> agent);
+    std::shared_ptr<const IAgent> get(std::size_t index);
+    std::string get_id(std::size_t index) const;
+    OpponentPoolStats get_stats() const;
+    std::size_t size() const;
+};
+}
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "training/population.h"
+#include "misc/random.h"
+#include "misc/thread_pool.h"
+#include "training/agents/iagent.h"
+#include "training/agents/native_agent.h"
+#include "training/agents/nn_agent.h"
+#include "training/opponent_pool.h"
+#include "training/trainer.h"
+
+namespace ai
+{
+namespace
+{
+const float perturb_factor = 1.2f;
+}
+
+std::vector<std::pair<std::size_t, std::size_t>> select_exploit_pairs(
+    const std::vector<double> &fitness,
+    float quantile)
+{
+    std::vector<std::size_t> ranking(fitness.size());
+    std::iota(ranking.begin(), ranking.end(), 0);
+    std::stable_sort(ranking.begin(), ranking.end(),
+                     [&](std::size_t a, std::size_t b) { return fitness[a] > fitness[b]; });
+
+    // Never so many that the best and worst groups overlap
+    const auto group_size = std::min(
+        static_cast<std::size_t>(std::ceil(fitness.size() * quantile)),
+        fitness.size() / 2);
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    for (std::size_t i = 0; i < group_size; ++i)
+    {
+        pairs.push_back({ranking[ranking.size() - 1 - i], ranking[i]});
+    }
+    return pairs;
+}
+
+HyperParameters perturb_hyper_parameters(const HyperParameters &hyper_parameters, Random &rng)
+{
+    auto perturb = [&rng](float value) {
+        return rng.next_bool(0.5) ? value * perturb_factor : value / perturb_factor;
+    };
+
+    auto result = hyper_parameters;
+    result.learning_rate = perturb(result.learning_rate);
+    result.entropy_coef = perturb(result.entropy_coef);
+    result.actor_loss_coef = perturb(result.actor_loss_coef);
+    result.value_loss_coef = perturb(result.value_loss_coef);
+    result.clip_param = std::min(perturb(result.clip_param), 0.5f);
+    // Perturb the horizon rather than the discount itself, so it stays below 1
+    result.discount_factor = 1.f - std::min(perturb(1.f - result.discount_factor), 0.5f);
+    return result;
+}
+
+Population::Population(std::vector<TrainingProgram> programs,
+                       TrainerFactory &trainer_factory,
+                       Random &rng,
+                       unsigned int thread_count)
+    : executor(std::make_unique<ThreadPool>(
+          thread_count == 0 ? std::max(1u, std::thread::hardware_concurrency()) : thread_count)),
+      generation(0),
+      rng(rng)
+{
+    if (programs.empty())
+    {
+        throw std::invalid_argument("A population needs at least one member");
+    }
+    for (const auto &program : programs)
+    {
+        if (program.body != programs[0].body)
+        {
+            throw std::invalid_argument("Every member of a population must use the same body");
+        }
+    }
+
+    opponent_pool = trainer_factory.make_opponent_pool(programs);
+    // Each member gets its own seed so they don't all start with the same
+    // weights
+    for (std::size_t i = 0; i < programs.size(); ++i)
+    {
+        members.push_back(trainer_factory.make(programs[i], opponent_pool, *executor, i));
+    }
+    fitness.resize(members.size(), 0);
+}
+
+Population::~Population()
+{
+    // Members queue work on the executor, so they have to go first
+    members.clear();
+    executor.reset();
+}
+
+void Population::add_members_to_opponent_pool()
+{
+    for (std::size_t i = 0; i < members.size(); ++i)
+    {
+        // Saved first so the pool can drop it from memory and load it again
+        auto &member = *members[i];
+        const auto checkpoint_path = member.save_model();
+        opponent_pool->add_checkpoint(
+            checkpoint_path.string(),
+            std::make_unique<NativeAgent>(member.get_agent().get_policy(),
+                                          member.get_training_program().body,
+                                          fmt::format("Member {} generation {}", i, generation)));
+    }
+}
+
+const std::vector<double> &Population::evaluate(unsigned int games_per_member)
+{
+    struct Game
+    {
+        std::size_t member;
+        // Past the end of the pool are the members
+        std::size_t opponent;
+        bool member_first;
+        std::future<EvaluationResult> result;
+    };
+
+    // Members can be drawn as opponents too, so they're compared directly
+    // rather than only through the pool
+    std::vector<std::unique_ptr<IAgent>> member_agents;
+    for (auto &member : members)
+    {
+        member_agents.push_back(member->get_agent().clone());
+    }
+    const auto pool_size = opponent_pool->size();
+    const auto opponent_count = static_cast<int>(pool_size + member_agents.size());
+
+    std::vector<Game> games;
+    for (std::size_t member = 0; member < members.size(); ++member)
+    {
+        for (unsigned int i = 0; i < games_per_member; ++i)
+        {
+            const auto opponent = static_cast<std::size_t>(rng.next_int(0, opponent_count));
+            games.push_back({member, opponent, rng.next_bool(0.5), {}});
+        }
+    }
+    for (auto &game : games)
+    {
+        const auto &agent = *member_agents[game.member];
+        game.result = executor->enqueue([this, &agent, &game, &member_agents, pool_size] {
+            // Held until the game ends, even if the pool drops it meanwhile
+            std::shared_ptr<const IAgent> pool_opponent;
+            if (game.opponent < pool_size)
+            {
+                pool_opponent = opponent_pool->get(game.opponent);
+            }
+            const auto &opponent = pool_opponent == nullptr
+                                       ? *member_agents[game.opponent - pool_size]
+                                       : *pool_opponent;
+            return game.member_first ? evaluator.evaluate(agent, opponent)
+                                     : evaluator.evaluate(opponent, agent);
+        });
+    }
+
+    std::vector<double> scores(members.size(), 0);
+    for (auto &game : games)
+    {
+        const auto result = game.result.get();
+        if (result == EvaluationResult::Draw)
+        {
+            scores[game.member] += 0.5;
+        }
+        else if ((result == EvaluationResult::Agent1) == game.member_first)
+        {
+            scores[game.member] += 1;
+        }
+    }
+    for (std::size_t i = 0; i < members.size(); ++i)
+    {
+        fitness[i] = games_per_member == 0 ? 0 : scores[i] / games_per_member;
+        spdlog::info("Member {} fitness: {:.2f}", i, fitness[i]);
+    }
+
+    return fitness;
+}
+
+std::size_t Population::get_opponent_count() const
+{
+    return opponent_pool->size();
+}
+
+void Population::exploit_and_explore(float quantile)
+{
+    for (const auto &[loser, winner] : select_exploit_pairs(fitness, quantile))
+    {
+        spdlog::info("Member {} takes the weights of member {}", loser, winner);
+        members[loser]->copy_weights(*members[winner]);
+        members[loser]->set_hyper_parameters(perturb_hyper_parameters(
+            members[winner]->get_training_program().hyper_parameters,
+            rng));
+        fitness[loser] = fitness[winner];
+    }
+    ++generation;
+}
+
+std::vector<std::vector<TrainingMetric>> Population::step_batch()
+{
+    std::vector<std::future<std::vector<TrainingMetric>>> futures;
+    for (auto &member : members)
+    {
+        futures.push_back(member->step_batch_async());
+    }
+
+    std::vector<std::vector<TrainingMetric>> metrics;
+    for (auto &future : futures)
+    {
+        metrics.push_back(future.get());
+    }
+    return metrics;
+}
+
+TEST_CASE("Population")
+{
+    SUBCASE("The worst members are paired with the best")
+    {
+        const auto pairs = select_exploit_pairs({0.5, 0.1, 0.9, 0.3, 0.7, 0.2, 0.8, 0.4}, 0.25f);
+
+        DOCTEST_REQUIRE(pairs.size() == 2);
+        DOCTEST_CHECK(pairs[0] == std::pair<std::size_t, std::size_t>{1, 2});
+        DOCTEST_CHECK(pairs[1] == std::pair<std::size_t, std::size_t>{5, 6});
+    }
+
+    SUBCASE("A member is never both replaced and copied")
+    {
+        const auto pairs = select_exploit_pairs({0.5, 0.1, 0.9}, 0.9f);
+
+        DOCTEST_REQUIRE(pairs.size() == 1);
+        DOCTEST_CHECK(pairs[0] == std::pair<std::size_t, std::size_t>{1, 2});
+    }
+
+    SUBCASE("Perturbed hyper-parameters stay in range")
+    {
+        Random rng(0);
+        HyperParameters hyper_parameters;
+        hyper_parameters.discount_factor = 0.99f;
+        for (int i = 0; i < 20; ++i)
+        {
+            hyper_parameters = perturb_hyper_parameters(hyper_parameters, rng);
+
+            DOCTEST_CHECK(hyper_parameters.discount_factor < 1.f);
+            DOCTEST_CHECK(hyper_parameters.clip_param <= 0.5f);
+            DOCTEST_CHECK(hyper_parameters.learning_rate > 0.f);
+        }
+    }
+
+    SUBCASE("Unchanging hyper-parameters are kept")
+    {
+        Random rng(0);
+        HyperParameters hyper_parameters;
+        hyper_parameters.batch_size = 256;
+        hyper_parameters.num_env = 4;
+        const auto perturbed = perturb_hyper_parameters(hyper_parameters, rng);
+
+        DOCTEST_CHECK(perturbed.batch_size == 256);
+        DOCTEST_CHECK(perturbed.num_env == 4);
+        DOCTEST_CHECK(perturbed.algorithm == hyper_parameters.algorithm);
+    }
+}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "training/evaluators/evaluator.h"
+#include "training/metric_ring.h"
+#include "training/training_program.h"
+
+class ThreadPool;
+
+namespace ai
+{
+class OpponentPool;
+class Random;
+class Trainer;
+class TrainerFactory;
+
+// Pairs each of the worst performers with one of the best, as
+// (member to replace, member to copy). quantile is the share of the
+// population in each group.
+std::vector<std::pair<std::size_t, std::size_t>> select_exploit_pairs(
+    const std::vector<double> &fitness,
+    float quantile);
+// Scales each continuous hyper-parameter up or down by 20%
+HyperParameters perturb_hyper_parameters(const HyperParameters &hyper_parameters, Random &rng);
+
+// Population based training within one process.
+//
+// Every member trains with its own hyper-parameters, but their environments
+// all run on one executor sized to the machine, and they play against one
+// opponent pool, in which each checkpoint is only loaded once. Members that
+// fall behind take a copy of a better member's weights and a perturbed copy
+// of its hyper-parameters.
+class Population
+{
+  private:
+    Evaluator evaluator;
+    std::unique_ptr<ThreadPool> executor;
+    std::vector<double> fitness;
+    unsigned int generation;
+    std::vector<std::unique_ptr<Trainer>> members;
+    std::shared_ptr<OpponentPool> opponent_pool;
+    Random &rng;
+
+  public:
+    // thread_count of 0 uses one thread per core
+    Population(std::vector<TrainingProgram> programs,
+               TrainerFactory &trainer_factory,
+               Random &rng,
+               unsigned int thread_count = 0);
+    ~Population();
+
+    // Saves every member and adds a frozen copy of each to the shared
+    // opponent pool
+    void add_members_to_opponent_pool();
+    // Plays each member against the opponent pool and the other members,
+    // scoring a win as 1 and a draw as 0.5
+    const std::vector<double> &evaluate(unsigned int games_per_member);
+    // Replaces the worst members with perturbed copies of the best, using the
+    // fitness from the last evaluate()
+    void exploit_and_explore(float quantile = 0.25f);
+    // Trains every member for one batch, in parallel
+    std::vector<std::vector<TrainingMetric>> step_batch();
+
+    inline const std::vector<double> &get_fitness() const { return fitness; }
+    inline Trainer &get_member(std::size_t index) { return *members[index]; }
+    std::size_t get_opponent_count() const;
+    inline std::size_t size() const { return members.size(); }
+};
+}
@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <doctest.h>
+
+#include "training/returns.h"
+
+namespace ai
+{
+namespace
+{
+// Blocks are whole cache lines wide, so threads never write to the same line
+const std::size_t block_alignment = 16;
+// Below this, starting threads costs more than it saves
+const std::size_t min_elements_per_block = 1 << 16;
+
+struct Moments
+{
+    double count;
+    double mean;
+    double m2;
+};
+
+Moments merge(const Moments &a, const Moments &b)
+{
+    const auto count = a.count + b.count;
+    if (count == 0)
+    {
+        return a;
+    }
+    const auto delta = b.mean - a.mean;
+    return {count,
+            a.mean + delta * b.count / count,
+            a.m2 + b.m2 + delta * delta * a.count * b.count / count};
+}
+
+using Block = std::pair<std::size_t, std::size_t>;
+
+std::vector<Block> make_blocks(std::size_t steps, std::size_t columns)
+{
+    const auto hardware_threads = static_cast<std::size_t>(std::thread::hardware_concurrency());
+    const auto block_count = std::max<std::size_t>(
+        1,
+        std::min({hardware_threads,
+                  columns / block_alignment,
+                  (steps + 1) * columns / min_elements_per_block}));
+    const auto columns_per_block = (columns + block_count - 1) / block_count;
+    const auto block_width =
+        (columns_per_block + block_alignment - 1) / block_alignment * block_alignment;
+
+    std::vector<Block> blocks;
+    for (std::size_t begin = 0; begin < columns; begin += block_width)
+    {
+        blocks.emplace_back(begin, std::min(begin + block_width, columns));
+    }
+    return blocks;
+}
+
+// Calls function with the index of every block, running the first on this
+// thread
+template <typename Function>
+void for_each_block(const std::vector<Block> &blocks, Function function)
+{
+    std::vector<std::future<void>> futures;
+    for (std::size_t i = 1; i < blocks.size(); ++i)
+    {
+        futures.push_back(std::async(std::launch::async, function, i));
+    }
+    function(0);
+    for (auto &future : futures)
+    {
+        future.get();
+    }
+}
+
+// Discounted returns, bootstrapped from the last row of values, written to
+// returns. Returns their moments, each column's kept separately with
+// Welford's algorithm as it goes so the inner loop vectorizes.
+Moments sweep_returns(const float *rewards,
+                      const float *values,
+                      const float *masks,
+                      float *returns,
+                      std::size_t steps,
+                      std::size_t columns,
+                      Block block,
+                      float discount_factor)
+{
+    const auto [begin, end] = block;
+    std::vector<double> means(values + steps * columns + begin, values + steps * columns + end);
+    std::vector<double> m2s(end - begin, 0.);
+    std::copy(values + steps * columns + begin,
+              values + steps * columns + end,
+              returns + steps * columns + begin);
+
+    for (auto step = steps; step-- > 0;)
+    {
+        const auto count = static_cast<double>(steps - step + 1);
+        const auto *reward_row = rewards + step * columns;
+        const auto *next_mask_row = masks + (step + 1) * columns;
+        const auto *next_return_row = returns + (step + 1) * columns;
+        auto *return_row = returns + step * columns;
+        for (auto column = begin; column < end; ++column)
+        {
+            const auto value = next_return_row[column] * discount_factor * next_mask_row[column] +
+                               reward_row[column];
+            return_row[column] = value;
+            auto &mean = means[column - begin];
+            const double delta = value - mean;
+            mean += delta / count;
+            m2s[column - begin] += delta * (value - mean);
+        }
+    }
+
+    Moments moments{0, 0, 0};
+    for (std::size_t i = 0; i < means.size(); ++i)
+    {
+        moments = merge(moments, {static_cast<double>(steps + 1), means[i], m2s[i]});
+    }
+    return moments;
+}
+
+void sweep_gae(float *rewards,
+               const float *values,
+               const float *masks,
+               float *returns,
+               std::size_t steps,
+               std::size_t columns,
+               Block block,
+               float reward_divisor,
+               float discount_factor,
+               float gae_lambda,
+               float reward_clip)
+{
+    const auto [begin, end] = block;
+    std::vector<float> gaes(end - begin, 0.f);
+    std::copy(values + steps * columns + begin,
+              values + steps * columns + end,
+              returns + steps * columns + begin);
+
+    for (auto step = steps; step-- > 0;)
+    {
+        auto *reward_row = rewards + step * columns;
+        const auto *value_row = values + step * columns;
+        const auto *next_value_row = values + (step + 1) * columns;
+        const auto *next_mask_row = masks + (step + 1) * columns;
+        auto *return_row = returns + step * columns;
+        // Kept apart from the loop below, which otherwise writes to too many
+        // arrays that might overlap for the compiler to vectorize it
+        for (auto column = begin; column < end; ++column)
+        {
+            reward_row[column] = std::min(std::max(reward_row[column] / reward_divisor,
+                                                   -reward_clip),
+                                          reward_clip);
+        }
+        for (auto column = begin; column < end; ++column)
+        {
+            const auto delta = reward_row[column] +
+                               discount_factor * next_value_row[column] * next_mask_row[column] -
+                               value_row[column];
+            auto &gae = gaes[column - begin];
+            gae = delta + discount_factor * gae_lambda * next_mask_row[column] * gae;
+            return_row[column] = gae + value_row[column];
+        }
+    }
+}
+}
+
+void RunningMoments::update(double batch_count, double batch_mean, double batch_variance)
+{
+    const auto merged = merge({count, mean, variance * count},
+                              {batch_count, batch_mean, batch_variance * batch_count});
+    count = merged.count;
+    mean = merged.mean;
+    variance = merged.m2 / merged.count;
+}
+
+void compute_normalized_gae(float *rewards,
+                            const float *values,
+                            const float *masks,
+                            float *returns,
+                            std::size_t steps,
+                            std::size_t columns,
+                            RunningMoments &moments,
+                            float discount_factor,
+                            float gae_lambda,
+                            float reward_clip)
+{
+    if (columns == 0)
+    {
+        return;
+    }
+    const auto blocks = make_blocks(steps, columns);
+
+    std::vector<Moments> block_moments(blocks.size());
+    for_each_block(blocks, [&](std::size_t i) {
+        block_moments[i] = sweep_returns(rewards,
+                                         values,
+                                         masks,
+                                         returns,
+                                         steps,
+                                         columns,
+                                         blocks[i],
+                                         discount_factor);
+    });
+    Moments batch{0, 0, 0};
+    for (const auto &block_moment : block_moments)
+    {
+        batch = merge(batch, block_moment);
+    }
+    moments.update(batch.count, batch.mean, batch.m2 / batch.count);
+
+    const auto reward_divisor = static_cast<float>(std::sqrt(moments.variance) + 1e-8);
+    for_each_block(blocks, [&](std::size_t i) {
+        sweep_gae(rewards,
+                  values,
+                  masks,
+                  returns,
+                  steps,
+                  columns,
+                  blocks[i],
+                  reward_divisor,
+                  discount_factor,
+                  gae_lambda,
+                  reward_clip);
+    });
+}
+
+TEST_CASE("compute_normalized_gae()")
+{
+    const float discount_factor = 0.9f;
+    const float gae_lambda = 0.95f;
+
+    // The separate passes Trainer::learn() used to make
+    const auto reference = [&](std::vector<float> &rewards,
+                               const std::vector<float> &values,
+                               const std::vector<float> &masks,
+                               std::size_t steps,
+                               std::size_t columns,
+                               RunningMoments &moments) {
+        std::vector<float> raw_returns(values.size());
+        std::vector<float> returns(values.size());
+        for (std::size_t column = 0; column < columns; ++column)
+        {
+            raw_returns[steps * columns + column] = values[steps * columns + column];
+            returns[steps * columns + column] = values[steps * columns + column];
+            for (auto step = steps; step-- > 0;)
+            {
+                const auto i = step * columns + column;
+                raw_returns[i] = raw_returns[i + columns] * discount_factor * masks[i + columns] +
+                                 rewards[i];
+            }
+        }
+        double mean = 0;
+        for (const auto value : raw_returns)
+        {
+            mean += value;
+        }
+        mean /= static_cast<double>(raw_returns.size());
+        double variance = 0;
+        for (const auto value : raw_returns)
+        {
+            variance += (value - mean) * (value - mean);
+        }
+        variance /= static_cast<double>(raw_returns.size());
+        moments.update(static_cast<double>(raw_returns.size()), mean, variance);
+
+        const auto divisor = static_cast<float>(std::sqrt(moments.variance) + 1e-8);
+        for (auto &reward : rewards)
+        {
+            reward = std::clamp(reward / divisor, -10.f, 10.f);
+        }
+        for (std::size_t column = 0; column < columns; ++column)
+        {
+            float gae = 0;
+            for (auto step = steps; step-- > 0;)
+            {
+                const auto i = step * columns + column;
+                const auto delta = rewards[i] +
+                                   discount_factor * values[i + columns] * masks[i + columns] -
+                                   values[i];
+                gae = delta + discount_factor * gae_lambda * masks[i + columns] * gae;
+                returns[i] = gae + values[i];
+            }
+        }
+        return returns;
+    };
+
+    const auto check_matches_reference = [&](std::size_t steps, std::size_t columns) {
+        std::mt19937 rng(0);
+        std::normal_distribution<float> normal(0.f, 3.f);
+        std::bernoulli_distribution done(0.05);
+        std::vector<float> rewards(steps * columns);
+        std::vector<float> values((steps + 1) * columns);
+        std::vector<float> masks((steps + 1) * columns);
+        std::generate(rewards.begin(), rewards.end(), [&] { return normal(rng); });
+        std::generate(values.begin(), values.end(), [&] { return normal(rng); });
+        std::generate(masks.begin(), masks.end(), [&] { return done(rng) ? 0.f : 1.f; });
+
+        RunningMoments expected_moments;
+        auto expected_rewards = rewards;
+        const auto expected_returns = reference(expected_rewards,
+                                                values,
+                                                masks,
+                                                steps,
+                                                columns,
+                                                expected_moments);
+
+        RunningMoments moments;
+        std::vector<float> returns(values.size());
+        compute_normalized_gae(rewards.data(),
+                               values.data(),
+                               masks.data(),
+                               returns.data(),
+                               steps,
+                               columns,
+                               moments,
+                               discount_factor,
+                               gae_lambda,
+                               10.f);
+
+        DOCTEST_CHECK(moments.count == doctest::Approx(expected_moments.count));
+        DOCTEST_CHECK(moments.mean == doctest::Approx(expected_moments.mean));
+        DOCTEST_CHECK(moments.variance == doctest::Approx(expected_moments.variance));
+        bool rewards_match = true;
+        for (std::size_t i = 0; i < rewards.size(); ++i)
+        {
+            rewards_match &= rewards[i] == doctest::Approx(expected_rewards[i]).epsilon(1e-4);
+        }
+        bool returns_match = true;
+        for (std::size_t i = 0; i < returns.size(); ++i)
+        {
+            returns_match &= returns[i] == doctest::Approx(expected_returns[i]).epsilon(1e-4);
+        }
+        DOCTEST_CHECK(rewards_match);
+        DOCTEST_CHECK(returns_match);
+    };
+
+    SUBCASE("Matches separate passes")
+    {
+        check_matches_reference(50, 3);
+    }
+
+    SUBCASE("Matches separate passes when split across threads")
+    {
+        check_matches_reference(4096, 67);
+    }
+
+    SUBCASE("Rewards are clamped")
+    {
+        std::vector<float> rewards{1000.f, 0.f};
+        const std::vector<float> values{0.f, 0.f, 0.f};
+        const std::vector<float> masks{1.f, 1.f, 1.f};
+        std::vector<float> returns(3);
+        RunningMoments moments;
+        moments.count = 1e6;
+
+        compute_normalized_gae(rewards.data(),
+                               values.data(),
+                               masks.data(),
+                               returns.data(),
+                               2,
+                               1,
+                               moments,
+                               discount_factor,
+                               gae_lambda,
+                               10.f);
+
+        DOCTEST_CHECK(rewards[0] == doctest::Approx(10.f));
+        DOCTEST_CHECK(returns[0] == doctest::Approx(10.f));
+    }
+}
+
+TEST_CASE("RunningMoments")
+{
+    SUBCASE("Batches combine into the moments of all their values")
+    {
+        RunningMoments moments;
+        moments.count = 0;
+        // 0 and 2, then 4, 5 and 6
+        moments.update(2, 1, 1);
+        moments.update(3, 5, 2. / 3.);
+
+        DOCTEST_CHECK(moments.count == doctest::Approx(5));
+        DOCTEST_CHECK(moments.mean == doctest::Approx(17. / 5.));
+        DOCTEST_CHECK(moments.variance == doctest::Approx(4.64));
+    }
+}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ai
+{
+// A running mean and variance, updated a batch at a time. Starts out the
+// same as cpprl::RunningMeanStd.
+struct RunningMoments
+{
+    double count = 1e-4;
+    double mean = 0;
+    double variance = 1;
+
+    // Folds in a batch's mean and population variance
+    void update(double batch_count, double batch_mean, double batch_variance);
+};
+
+// Scales rewards by the running standard deviation of discounted returns,
+// then computes GAE returns from the scaled rewards. The same as calling
+// RolloutStorage::compute_returns() without GAE, updating a
+// cpprl::RunningMeanStd with the returns, dividing the rewards by its
+// standard deviation and clamping them to reward_clip, then calling
+// compute_returns() with GAE.
+//
+// Everything is laid out step by step, with one column per environment.
+// rewards is steps x columns, and is overwritten with the scaled rewards.
+// values, masks and returns are (steps + 1) x columns, and values' last row
+// is the value of the step after the rollout.
+//
+// It takes two backward sweeps, one for the raw returns and their moments
+// and one for GAE, because no reward can be scaled until every return is
+// known. Each sweep works along whole rows, and large rollouts are split
+// into blocks of environments that are swept on separate threads.
+void compute_normalized_gae(float *rewards,
+                            const float *values,
+                            const float *masks,
+                            float *returns,
+                            std::size_t steps,
+                            std::size_t columns,
+                            RunningMoments &moments,
+                            float discount_factor,
+                            float gae_lambda,
+                            float reward_clip);
+}
@@ -10,14 +10,18 @@
 
 #include "multi_rollout_generator.h"
 #include "graphics/renderers/renderer.h"
+#include "misc/metrics.h"
+#include "misc/thread_pool.h"
 #include "training/rollout_generators/single_rollout_generator.h"
 
 namespace ai
 {
 MultiRolloutGenerator::MultiRolloutGenerator(
     unsigned long num_steps,
-    std::vector<std::unique_ptr<ISingleRolloutGenerator>> &&sub_generators)
+    std::vector<std::unique_ptr<ISingleRolloutGenerator>> &&sub_generators,
+    ThreadPool *executor)
     : batch_number(0),
+      executor(executor),
       num_steps(num_steps),
       sub_generators(std::move(sub_generators)),
       timestep(0)
@@ -47,10 +51,20 @@ cpprl::RolloutStorage MultiRolloutGenerator::generate()
     std::vector<std::future<RolloutStorageFuture>> storage_futures;
     for (auto &sub_generator : sub_generators)
     {
-        storage_futures.emplace_back(std::async(std::launch::async, [&] {
+        auto generate = [&] {
             return RolloutStorageFuture{
                 std::make_unique<cpprl::RolloutStorage>(sub_generator->generate(num_steps))};
-        }));
+        };
+        // Generators sharing an executor take turns on its threads instead
+        // of each starting one per environment
+        if (executor != nullptr)
+        {
+            storage_futures.push_back(executor->enqueue(generate));
+        }
+        else
+        {
+            storage_futures.emplace_back(std::async(std::launch::async, generate));
+        }
     }
 
     std::vector<cpprl::RolloutStorage> storages;
@@ -60,6 +74,8 @@ cpprl::RolloutStorage MultiRolloutGenerator::generate()
                        return *storage_future.get().storage;
                    });
 
+    AI_METRICS_TIMER("ai_rollout_storage_assembly_seconds",
+                     "Time spent merging per-environment rollouts into one batch");
     std::vector<cpprl::RolloutStorage *> storage_ptrs;
     std::transform(storages.begin(), storages.end(), std::back_inserter(storage_ptrs),
                    [](cpprl::RolloutStorage &storage) { return &storage; });
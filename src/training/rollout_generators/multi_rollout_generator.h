@@ -7,6 +7,8 @@
 
 #include "training/rollout_generators/single_rollout_generator.h"
 
+class ThreadPool;
+
 namespace ai
 {
 class Renderer;
@@ -15,14 +17,18 @@ class MultiRolloutGenerator
 {
   private:
     unsigned long batch_number;
+    ThreadPool *executor;
     unsigned long num_steps;
     std::vector<std::unique_ptr<ISingleRolloutGenerator>> sub_generators;
     std::atomic<unsigned long long> timestep;
 
   public:
     MultiRolloutGenerator(unsigned long num_steps,
-                          std::vector<std::unique_ptr<ISingleRolloutGenerator>> &&sub_generators);
+                          std::vector<std::unique_ptr<ISingleRolloutGenerator>> &&sub_generators,
+                          ThreadPool *executor = nullptr);
 
+    // Counts experience gathered somewhere else, e.g. by remote workers
+    inline void add_timesteps(unsigned long long count) { timestep += count; }
     void draw(Renderer &renderer, bool lightweight = false);
     cpprl::RolloutStorage generate();
     void set_fast();
@@ -11,17 +11,19 @@
 #include "environment/iecs_env.h"
 #include "environment/serialization/serialize_body.h"
 #include "graphics/colors.h"
+#include "misc/metrics.h"
 #include "misc/module_factory.h"
 #include "misc/random.h"
 #include "training/agents/iagent.h"
 #include "training/agents/random_agent.h"
+#include "training/opponent_pool.h"
 
 namespace ai
 {
 SingleRolloutGenerator::SingleRolloutGenerator(
     const IAgent &agent,
     std::unique_ptr<IEcsEnv> environment,
-    const std::vector<std::unique_ptr<IAgent>> &opponent_pool,
+    OpponentPool &opponent_pool,
     IAudioEngine &audio_engine,
     Random &rng,
     std::atomic<unsigned long long> *timestep)
@@ -41,7 +43,7 @@ SingleRolloutGenerator::SingleRolloutGenerator(
 {
     std::lock_guard lock_guard(mutex);
     const auto opponent_index = rng.next_int(0, opponent_pool.size());
-    opponent = opponent_pool[opponent_index].get();
+    opponent = opponent_pool.get(opponent_index);
     opponent_hidden_state = torch::zeros({opponent->get_hidden_state_size(), 1}),
     opponent_last_observation = torch::zeros({1, opponent->get_observation_size()});
 
@@ -83,6 +85,13 @@ void SingleRolloutGenerator::fast_forward(unsigned int steps)
 
 cpprl::RolloutStorage SingleRolloutGenerator::generate(unsigned long length)
 {
+    static auto &inference_time = get_metrics().histogram(
+        "ai_rollout_inference_seconds", "Time spent choosing actions for both players per step");
+    static auto &simulation_time = get_metrics().histogram(
+        "ai_rollout_simulation_seconds", "Time spent in each environment step or forward");
+    static auto &environment_steps = get_metrics().counter(
+        "ai_rollout_steps_total", "Environment steps taken by rollout generators");
+
     cpprl::RolloutStorage storage(
         length,
         1,
@@ -102,6 +111,7 @@ cpprl::RolloutStorage SingleRolloutGenerator::generate(unsigned long length)
         // Get action from agent
         ActResult act_result, opponent_act_result;
         {
+            ScopedTimer timer(inference_time);
             torch::NoGradGuard no_grad;
             act_result = agent.act(storage.get_observations()[step],
                                    storage.get_hidden_states()[step],
@@ -121,6 +131,7 @@ cpprl::RolloutStorage SingleRolloutGenerator::generate(unsigned long length)
 
         EcsStepInfo step_info;
         {
+            ScopedTimer timer(simulation_time);
             std::lock_guard lock_guard(mutex);
             auto &player_actions = act_result.action;
             auto &opponent_actions = opponent_act_result.action;
@@ -142,6 +153,7 @@ cpprl::RolloutStorage SingleRolloutGenerator::generate(unsigned long length)
         for (int mini_step = 0; mini_step < 5; ++mini_step)
         {
             {
+                ScopedTimer timer(simulation_time);
                 std::lock_guard lock_guard(mutex);
                 environment->forward(1.f / 60.f);
             }
@@ -163,7 +175,7 @@ cpprl::RolloutStorage SingleRolloutGenerator::generate(unsigned long length)
             reset_recently = true;
             score = 0;
             int selected_opponent = rng.next_int(0, opponent_pool.size());
-            opponent = opponent_pool[selected_opponent].get();
+            opponent = opponent_pool.get(selected_opponent);
             opponent_hidden_state = torch::zeros({opponent->get_hidden_state_size(), 1});
             start_position = rng.next_bool(0.5);
             auto opponent_json = opponent->get_body_spec();
@@ -194,6 +206,7 @@ cpprl::RolloutStorage SingleRolloutGenerator::generate(unsigned long length)
                        act_result.value,
                        rewards,
                        1 - dones);
+        environment_steps.increment();
         if (timestep)
         {
             (*timestep)++;
@@ -223,7 +236,7 @@ void SingleRolloutGenerator::stop()
 std::unique_ptr<ISingleRolloutGenerator> SingleRolloutGeneratorFactory::make(
     const IAgent &agent,
     std::unique_ptr<IEcsEnv> environment,
-    const std::vector<std::unique_ptr<IAgent>> &opponent_pool,
+    OpponentPool &opponent_pool,
     std::atomic<unsigned long long> *timestep)
 {
     return std::make_unique<SingleRolloutGenerator>(agent,
@@ -256,9 +269,9 @@ TEST_CASE("SingleRolloutGenerator")
                             torch::zeros({2, 1}),
                             torch::zeros({2, 1}),
                             -1});
-    std::vector<std::unique_ptr<IAgent>> opponent_pool;
-    opponent_pool.emplace_back(std::make_unique<RandomAgent>(default_body(), rng, "Opponent 1"));
-    opponent_pool.emplace_back(std::make_unique<RandomAgent>(default_body(), rng, "Opponent 2"));
+    OpponentPool opponent_pool;
+    opponent_pool.add(std::make_unique<RandomAgent>(default_body(), rng, "Opponent 1"), "1");
+    opponent_pool.add(std::make_unique<RandomAgent>(default_body(), rng, "Opponent 2"), "2");
     SingleRolloutGenerator generator(agent,
                                      std::move(environment),
                                      opponent_pool,
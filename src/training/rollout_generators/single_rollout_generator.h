@@ -18,6 +18,7 @@ class RolloutStorage;
 namespace ai
 {
 class IAudioEngine;
+class OpponentPool;
 class Random;
 class Renderer;
 
@@ -50,11 +51,11 @@ class SingleRolloutGenerator : public ISingleRolloutGenerator
     torch::Tensor hidden_state;
     torch::Tensor last_observation;
     mutable std::mutex mutex;
-    const IAgent *opponent;
+    std::shared_ptr<const IAgent> opponent;
     torch::Tensor opponent_hidden_state;
     torch::Tensor opponent_last_observation;
     torch::Tensor opponent_mask;
-    const std::vector<std::unique_ptr<IAgent>> &opponent_pool;
+    OpponentPool &opponent_pool;
     std::atomic<bool> reset_recently;
     Random &rng;
     std::atomic<float> score;
@@ -66,7 +67,7 @@ class SingleRolloutGenerator : public ISingleRolloutGenerator
   public:
     SingleRolloutGenerator(const IAgent &agent,
                            std::unique_ptr<IEcsEnv> environment,
-                           const std::vector<std::unique_ptr<IAgent>> &opponent_pool,
+                           OpponentPool &opponent_pool,
                            IAudioEngine &audio_engine,
                            Random &rng,
                            std::atomic<unsigned long long> *timestep = nullptr);
@@ -124,7 +125,7 @@ class SingleRolloutGeneratorFactory
     std::unique_ptr<ISingleRolloutGenerator> make(
         const IAgent &agent,
         std::unique_ptr<IEcsEnv> environment,
-        const std::vector<std::unique_ptr<IAgent>> &opponent_pool,
+        OpponentPool &opponent_pool,
         std::atomic<unsigned long long> *timestep = nullptr);
 };
 }
\ No newline at end of file
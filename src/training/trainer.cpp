@@ -15,17 +15,23 @@
 #include "environment/iecs_env.h"
 #include "environment/ecs_env.h"
 #include "graphics/colors.h"
+#include "misc/metrics.h"
 #include "misc/random.h"
 #include "misc/resource_manager.h"
+#include "misc/thread_pool.h"
 #include "misc/utils/range.h"
 #include "training/agents/iagent.h"
+#include "training/agents/native_agent.h"
 #include "training/agents/nn_agent.h"
 #include "training/agents/random_agent.h"
 #include "training/bodies/body.h"
 #include "training/bodies/test_body.h"
 #include "training/checkpointer.h"
+#include "training/flat_parameters.h"
 #include "training/environments/ienvironment.h"
 #include "training/evaluators/elo_evaluator.h"
+#include "training/opponent_pool.h"
+#include "training/returns.h"
 #include "training/score_processor.h"
 #include "training/training_program.h"
 #include "third_party/date.h"
@@ -38,13 +44,63 @@ namespace ai
 {
 const bool recurrent = false;
 
+namespace
+{
+std::unique_ptr<cpprl::Algorithm> make_algorithm(cpprl::Policy &policy,
+                                                 const HyperParameters &hyper_parameters)
+{
+    if (hyper_parameters.algorithm == Algorithm::A2C)
+    {
+        return std::make_unique<cpprl::A2C>(policy,
+                                            hyper_parameters.actor_loss_coef,
+                                            hyper_parameters.value_loss_coef,
+                                            hyper_parameters.entropy_coef,
+                                            hyper_parameters.learning_rate);
+    }
+    else if (hyper_parameters.algorithm == Algorithm::PPO)
+    {
+        return std::make_unique<cpprl::PPO>(policy,
+                                            hyper_parameters.clip_param,
+                                            hyper_parameters.num_epoch,
+                                            hyper_parameters.num_minibatch,
+                                            hyper_parameters.actor_loss_coef,
+                                            hyper_parameters.value_loss_coef,
+                                            hyper_parameters.entropy_coef,
+                                            hyper_parameters.learning_rate);
+    }
+    throw std::runtime_error("Algorithm not supported");
+}
+
+void copy_tensors(const std::vector<torch::Tensor> &source,
+                  const std::vector<torch::Tensor> &destination)
+{
+    if (source.size() != destination.size())
+    {
+        throw std::runtime_error("Can't copy weights between different network shapes");
+    }
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        destination[i].copy_(source[i]);
+    }
+}
+}
+
+cpprl::Policy make_policy(const nlohmann::json &body_spec)
+{
+    const unsigned int num_observations = body_spec["num_observations"];
+    const unsigned int num_actions = body_spec["num_actions"];
+    auto nn_base = std::make_shared<cpprl::MlpBase>(num_observations, recurrent);
+    return cpprl::Policy(cpprl::ActionSpace{"MultiBinary", {num_actions}}, nn_base, true);
+}
+
 Trainer::Trainer(std::unique_ptr<NNAgent> agent,
                  std::unique_ptr<cpprl::Algorithm> algorithm,
-                 std::unique_ptr<std::vector<std::unique_ptr<IAgent>>> opponent_pool,
+                 std::shared_ptr<OpponentPool> opponent_pool,
                  TrainingProgram program,
                  std::unique_ptr<MultiRolloutGenerator> rollout_generator,
                  Checkpointer &checkpointer,
-                 EloEvaluator &evaluator)
+                 EloEvaluator &evaluator,
+                 bool shares_opponent_pool)
     : agent(std::move(agent)),
       algorithm(std::move(algorithm)),
       checkpointer(checkpointer),
@@ -52,14 +108,31 @@ Trainer::Trainer(std::unique_ptr<NNAgent> agent,
       evaluator(evaluator),
       last_save_time(std::chrono::high_resolution_clock::now()),
       last_update_time(std::chrono::high_resolution_clock::now()),
-      new_opponents(1 + program.opponent_pool.size()),
       opponent_pool(std::move(opponent_pool)),
       previous_checkpoint(program.checkpoint),
       program(program),
       reset_recently(true),
-      returns_rms(1),
+      returns_rms(),
       rollout_generator(std::move(rollout_generator)),
-      skip_update(false) {}
+      shares_opponent_pool(shares_opponent_pool),
+      skip_update(false),
+      worker(std::make_unique<ThreadPool>(1)) {}
+
+Trainer::~Trainer()
+{
+    // Finish any queued work before the members it uses go away
+    worker.reset();
+}
+
+void Trainer::copy_weights(const Trainer &other)
+{
+    torch::NoGradGuard no_grad;
+    const auto &other_policy = other.agent->get_policy();
+    auto &policy = agent->get_policy();
+    copy_tensors(other_policy->parameters(), policy->parameters());
+    copy_tensors(other_policy->buffers(), policy->buffers());
+    returns_rms = other.returns_rms;
+}
 
 void Trainer::draw(Renderer &renderer, bool lightweight)
 {
@@ -69,16 +142,24 @@ void Trainer::draw(Renderer &renderer, bool lightweight)
 double Trainer::evaluate()
 {
     spdlog::debug("Evaluating agent");
-    std::vector<IAgent *> new_opponents_vec;
-    for (unsigned int i = opponent_pool->size() - new_opponents; i < opponent_pool->size(); ++i)
-    {
-        new_opponents_vec.push_back((*opponent_pool)[i].get());
-    }
-    new_opponents = 0;
-    return evaluator.evaluate(*agent, new_opponents_vec, 80);
+    // Evaluation only runs inference, which is quicker without libtorch
+    NativeAgent evaluated_agent(agent->get_policy(), program.body, agent->get_name());
+    const auto elo = evaluator.evaluate(evaluated_agent, *opponent_pool, 80);
+    static auto &elo_gauge = get_metrics().gauge("ai_trainer_elo", "Most recently evaluated Elo");
+    elo_gauge.set(elo);
+    metrics.push({"Elo",
+                  static_cast<float>(elo),
+                  rollout_generator->get_timestep(),
+                  rollout_generator->get_batch_number()});
+    return elo;
 }
 
-std::vector<std::pair<std::string, float>> Trainer::step_batch()
+std::future<double> Trainer::evaluate_async()
+{
+    return worker->enqueue([this] { return evaluate(); });
+}
+
+std::vector<TrainingMetric> Trainer::step_batch()
 {
     auto rollout = rollout_generator->generate();
     if (skip_update)
@@ -86,12 +167,28 @@ std::vector<std::pair<std::string, float>> Trainer::step_batch()
         return {};
     }
     auto update_data = learn(rollout);
+    metrics.push(update_data);
+    return update_data;
+}
+
+std::future<std::vector<TrainingMetric>> Trainer::step_batch_async()
+{
+    return worker->enqueue([this] { return step_batch(); });
+}
+
+std::vector<TrainingMetric> Trainer::learn_from(cpprl::RolloutStorage &rollout)
+{
+    rollout_generator->add_timesteps(
+        static_cast<unsigned long long>(rollout.get_rewards().size(0) * rollout.get_rewards().size(1)));
+    auto update_data = learn(rollout);
+    metrics.push(update_data);
     return update_data;
 }
 
 std::filesystem::path Trainer::save_model(std::filesystem::path directory)
 {
     spdlog::debug("Saving model");
+    AI_METRICS_TIMER("ai_checkpoint_save_seconds", "Time spent saving checkpoints");
     previous_checkpoint = checkpointer.save(agent->get_policy(),
                                             program.body,
                                             {},
@@ -102,7 +199,12 @@ std::filesystem::path Trainer::save_model(std::filesystem::path directory)
     return previous_checkpoint;
 }
 
-std::vector<std::pair<std::string, float>> Trainer::learn(cpprl::RolloutStorage &rollout)
+std::future<std::filesystem::path> Trainer::save_model_async(std::filesystem::path directory)
+{
+    return worker->enqueue([this, directory] { return save_model(directory); });
+}
+
+std::vector<TrainingMetric> Trainer::learn(cpprl::RolloutStorage &rollout)
 {
     auto update_start_time = std::chrono::high_resolution_clock::now();
 
@@ -115,24 +217,37 @@ std::vector<std::pair<std::string, float>> Trainer::learn(cpprl::RolloutStorage
                                             rollout.get_masks()[-1])
                          .detach();
     }
-    // Divide rewards by return variance
-    rollout.compute_returns(next_value,
-                            false,
-                            program.hyper_parameters.discount_factor,
-                            0.95f);
-    returns_rms->update(rollout.get_returns());
-    rollout.set_rewards(torch::clamp(
-        rollout.get_rewards() / (returns_rms->get_variance().sqrt() + 1e-8),
-        -10,
-        10));
-
-    // Calculate the returns for real this time
-    rollout.compute_returns(next_value,
-                            true,
-                            program.hyper_parameters.discount_factor,
-                            0.95f);
-
-    auto update_data = algorithm->update(rollout);
+    {
+        AI_METRICS_TIMER("ai_trainer_returns_seconds", "Time spent computing returns per update");
+        // Divide rewards by return variance, then calculate GAE returns from
+        // them, on plain arrays rather than a tensor op per step
+        auto value_predictions = rollout.get_value_predictions();
+        value_predictions[-1] = next_value;
+        auto rewards = rollout.get_rewards().to(torch::kCPU, torch::kFloat).contiguous();
+        const auto values = value_predictions.to(torch::kCPU, torch::kFloat).contiguous();
+        const auto masks = rollout.get_masks().to(torch::kCPU, torch::kFloat).contiguous();
+        auto returns = torch::empty_like(values);
+        const auto steps = rewards.size(0);
+        compute_normalized_gae(rewards.data_ptr<float>(),
+                               values.data_ptr<float>(),
+                               masks.data_ptr<float>(),
+                               returns.data_ptr<float>(),
+                               static_cast<std::size_t>(steps),
+                               static_cast<std::size_t>(rewards.numel() / steps),
+                               returns_rms,
+                               program.hyper_parameters.discount_factor,
+                               0.95f,
+                               10.f);
+        rollout.set_rewards(rewards);
+        auto rollout_returns = rollout.get_returns();
+        rollout_returns.copy_(returns);
+    }
+
+    std::vector<cpprl::UpdateDatum> update_data;
+    {
+        AI_METRICS_TIMER("ai_trainer_optimizer_seconds", "Time spent in the optimizer per update");
+        update_data = algorithm->update(rollout);
+    }
     rollout.after_update();
 
     spdlog::info("---");
@@ -147,31 +262,76 @@ std::vector<std::pair<std::string, float>> Trainer::learn(cpprl::RolloutStorage
     auto now = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> update_duration = now - update_start_time;
     spdlog::info("Update took {:.2f}s", update_duration.count());
+    const auto opponent_stats = opponent_pool->get_stats();
+    const auto opponent_memory = static_cast<float>(opponent_stats.memory_usage) / (1024 * 1024);
+    spdlog::info("Opponents: {} of {} loaded, using {:.1f}MB",
+                 opponent_stats.resident,
+                 opponent_stats.size,
+                 opponent_memory);
 
     last_update_time = now;
 
+    static auto &steps_per_second = get_metrics().gauge(
+        "ai_trainer_steps_per_second", "Environment steps per second over the last batch");
+    static auto &total_steps = get_metrics().gauge("ai_trainer_steps",
+                                                   "Environment steps trained on so far");
+    static auto &opponent_memory_gauge = get_metrics().gauge(
+        "ai_opponent_pool_memory_bytes", "Memory used by loaded opponents");
+    static auto &opponents_loaded = get_metrics().gauge("ai_opponent_pool_loaded",
+                                                        "Opponents currently in memory");
+    steps_per_second.set(fps);
+    total_steps.set(static_cast<double>(rollout_generator->get_timestep()));
+    opponent_memory_gauge.set(static_cast<double>(opponent_stats.memory_usage));
+    opponents_loaded.set(static_cast<double>(opponent_stats.resident));
+
     if (now - last_save_time > std::chrono::minutes(program.minutes_per_checkpoint))
     {
         auto checkpoint_path = save_model();
-        opponent_pool->push_back(std::make_unique<NNAgent>(
-            agent->get_policy(),
-            program.body,
-            date::format("%F-%H-%M", std::chrono::system_clock::now())));
-        new_opponents++;
+        if (!shares_opponent_pool)
+        {
+            // A frozen copy, rather than one that keeps training with the agent
+            opponent_pool->add_checkpoint(
+                checkpoint_path.string(),
+                std::make_unique<NativeAgent>(
+                    agent->get_policy(),
+                    program.body,
+                    date::format("%F-%H-%M", std::chrono::system_clock::now())));
+        }
         last_save_time = now;
     }
 
-    std::vector<std::pair<std::string, float>> update_pairs;
+    const auto timestep = rollout_generator->get_timestep();
+    const auto batch_number = rollout_generator->get_batch_number();
+    std::vector<TrainingMetric> update_metrics;
     std::transform(update_data.begin(), update_data.end(),
-                   std::back_inserter(update_pairs),
-                   [](const cpprl::UpdateDatum &datum) {
-                       return std::pair<std::string, float>{datum.name, datum.value};
+                   std::back_inserter(update_metrics),
+                   [&](const cpprl::UpdateDatum &datum) {
+                       return TrainingMetric{datum.name, datum.value, timestep, batch_number};
                    });
-    update_pairs.push_back({"FPS", fps});
-    update_pairs.push_back({"Total Frames", rollout_generator->get_timestep()});
-    update_pairs.push_back({"Update Duration", update_duration.count()});
+    update_metrics.push_back({"FPS", static_cast<float>(fps), timestep, batch_number});
+    update_metrics.push_back({"Total Frames", static_cast<float>(timestep), timestep, batch_number});
+    update_metrics.push_back({"Update Duration",
+                              static_cast<float>(update_duration.count()),
+                              timestep,
+                              batch_number});
+    update_metrics.push_back({"Opponent Memory (MB)", opponent_memory, timestep, batch_number});
+    update_metrics.push_back({"Loaded Opponents",
+                              static_cast<float>(opponent_stats.resident),
+                              timestep,
+                              batch_number});
 
-    return update_pairs;
+    return update_metrics;
+}
+
+void Trainer::set_hyper_parameters(const HyperParameters &hyper_parameters)
+{
+    const auto batch_size = program.hyper_parameters.batch_size;
+    const auto num_env = program.hyper_parameters.num_env;
+    program.hyper_parameters = hyper_parameters;
+    program.hyper_parameters.batch_size = batch_size;
+    program.hyper_parameters.num_env = num_env;
+
+    algorithm = make_algorithm(agent->get_policy(), program.hyper_parameters);
 }
 
 bool Trainer::should_clear_particles()
@@ -192,19 +352,26 @@ void Trainer::stop()
 
 std::unique_ptr<Trainer> TrainerFactory::make(TrainingProgram &program) const
 {
-    torch::manual_seed(0);
+    return make(program, make_opponent_pool({program}), nullptr, false, 0);
+}
 
-    const unsigned int num_observations = program.body["num_observations"];
-    const unsigned int num_actions = program.body["num_actions"];
+std::unique_ptr<Trainer> TrainerFactory::make(
+    TrainingProgram &program,
+    std::shared_ptr<OpponentPool> opponent_pool,
+    ThreadPool &executor,
+    std::uint64_t seed) const
+{
+    return make(program, std::move(opponent_pool), &executor, true, seed);
+}
 
-    // Initialize opponent pool
-    auto opponent_pool = std::make_unique<std::vector<std::unique_ptr<IAgent>>>();
-    opponent_pool->push_back(std::make_unique<RandomAgent>(program.body, rng, "Random Agent"));
-    for (const auto &checkpoint_path : program.opponent_pool)
-    {
-        auto policy = checkpointer.load(checkpoint_path).policy;
-        opponent_pool->push_back(std::make_unique<NNAgent>(policy, program.body, checkpoint_path));
-    }
+std::unique_ptr<Trainer> TrainerFactory::make(
+    TrainingProgram &program,
+    std::shared_ptr<OpponentPool> opponent_pool,
+    ThreadPool *executor,
+    bool shares_opponent_pool,
+    std::uint64_t seed) const
+{
+    torch::manual_seed(seed);
 
     // Initialize environments
     std::vector<std::unique_ptr<IEcsEnv>> environments;
@@ -217,8 +384,7 @@ std::unique_ptr<Trainer> TrainerFactory::make(TrainingProgram &program) const
     if (program.checkpoint.empty())
     {
         spdlog::debug("Making new agent");
-        auto nn_base = std::make_shared<cpprl::MlpBase>(num_observations, recurrent);
-        policy = cpprl::Policy(cpprl::ActionSpace{"MultiBinary", {num_actions}}, nn_base, true);
+        policy = make_policy(program.body);
     }
     else
     {
@@ -240,32 +406,10 @@ std::unique_ptr<Trainer> TrainerFactory::make(TrainingProgram &program) const
 
     auto rollout_generator = std::make_unique<MultiRolloutGenerator>(
         program.hyper_parameters.batch_size,
-        std::move(sub_generators));
+        std::move(sub_generators),
+        executor);
 
-    std::unique_ptr<cpprl::Algorithm> algorithm;
-    if (program.hyper_parameters.algorithm == Algorithm::A2C)
-    {
-        algorithm = std::make_unique<cpprl::A2C>(agent->get_policy(),
-                                                 program.hyper_parameters.actor_loss_coef,
-                                                 program.hyper_parameters.value_loss_coef,
-                                                 program.hyper_parameters.entropy_coef,
-                                                 program.hyper_parameters.learning_rate);
-    }
-    else if (program.hyper_parameters.algorithm == Algorithm::PPO)
-    {
-        algorithm = std::make_unique<cpprl::PPO>(agent->get_policy(),
-                                                 program.hyper_parameters.clip_param,
-                                                 program.hyper_parameters.num_epoch,
-                                                 program.hyper_parameters.num_minibatch,
-                                                 program.hyper_parameters.actor_loss_coef,
-                                                 program.hyper_parameters.value_loss_coef,
-                                                 program.hyper_parameters.entropy_coef,
-                                                 program.hyper_parameters.learning_rate);
-    }
-    else
-    {
-        throw std::runtime_error("Algorithm not supported");
-    }
+    auto algorithm = make_algorithm(agent->get_policy(), program.hyper_parameters);
 
     return std::make_unique<Trainer>(std::move(agent),
                                      std::move(algorithm),
@@ -273,6 +417,65 @@ std::unique_ptr<Trainer> TrainerFactory::make(TrainingProgram &program) const
                                      program,
                                      std::move(rollout_generator),
                                      checkpointer,
+                                     evaluator,
+                                     shares_opponent_pool);
+}
+
+std::unique_ptr<Trainer> TrainerFactory::make_learner(TrainingProgram &program) const
+{
+    torch::manual_seed(0);
+
+    auto policy = program.checkpoint.empty() ? make_policy(program.body)
+                                             : checkpointer.load(program.checkpoint).policy;
+    auto agent = std::make_unique<NNAgent>(policy, program.body, "Agent");
+    auto algorithm = make_algorithm(agent->get_policy(), program.hyper_parameters);
+    auto rollout_generator = std::make_unique<MultiRolloutGenerator>(
+        program.hyper_parameters.batch_size,
+        std::vector<std::unique_ptr<ISingleRolloutGenerator>>{});
+
+    return std::make_unique<Trainer>(std::move(agent),
+                                     std::move(algorithm),
+                                     make_opponent_pool({program}),
+                                     program,
+                                     std::move(rollout_generator),
+                                     checkpointer,
                                      evaluator);
 }
+
+std::unique_ptr<OpponentPool> TrainerFactory::make_opponent_pool(
+    const std::vector<TrainingProgram> &programs,
+    std::size_t max_memory) const
+{
+    if (programs.empty())
+    {
+        throw std::invalid_argument("An opponent pool needs at least one program");
+    }
+
+    const auto body = programs[0].body;
+    auto opponent_pool = std::make_unique<OpponentPool>(
+        [&checkpointer = checkpointer, body](const std::string &path) {
+            // Checkpoints with a .params file are mapped straight into the
+            // inference engine, without building a libtorch policy
+            if (const auto parameters = checkpointer.load_parameters(path))
+            {
+                return std::make_unique<NativeAgent>(
+                    std::make_shared<const MlpInferenceEngine>(
+                        extract_mlp_weights(parameters->get_tensors())),
+                    body,
+                    path);
+            }
+            return std::make_unique<NativeAgent>(checkpointer.load(path).policy, body, path);
+        },
+        max_memory);
+    opponent_pool->add(std::make_unique<RandomAgent>(body, rng, "Random Agent"), "random");
+    for (const auto &program : programs)
+    {
+        for (const auto &checkpoint_path : program.opponent_pool)
+        {
+            opponent_pool->add_checkpoint(checkpoint_path);
+        }
+    }
+
+    return opponent_pool;
+}
 }
\ No newline at end of file
@@ -2,14 +2,15 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <future>
 #include <mutex>
 #include <string>
 #include <tuple>
 #include <vector>
 
 #include <cpprl/algorithms/algorithm.h>
-#include <cpprl/running_mean_std.h>
 #include <cpprl/storage.h>
 #include <torch/torch.h>
 
@@ -17,18 +18,26 @@
 #include "third_party/di.hpp"
 #include "training/agents/iagent.h"
 #include "training/agents/nn_agent.h"
+#include "training/metric_ring.h"
+#include "training/returns.h"
 #include "training/rollout_generators/multi_rollout_generator.h"
 #include "training/training_program.h"
 
+class ThreadPool;
+
 namespace ai
 {
 class BodyFactory;
 class Checkpointer;
 class EloEvaluator;
 class IEnvironmentFactory;
+class OpponentPool;
 class Random;
 class SingleRolloutGeneratorFactory;
 
+// A new, untrained policy for body_spec
+cpprl::Policy make_policy(const nlohmann::json &body_spec);
+
 class Trainer
 {
   private:
@@ -39,34 +48,53 @@ class Trainer
     EloEvaluator &evaluator;
     std::chrono::time_point<std::chrono::high_resolution_clock> last_save_time;
     std::chrono::time_point<std::chrono::high_resolution_clock> last_update_time;
-    int new_opponents;
-    std::unique_ptr<std::vector<std::unique_ptr<IAgent>>> opponent_pool;
+    MetricRing metrics;
+    std::shared_ptr<OpponentPool> opponent_pool;
     std::filesystem::path previous_checkpoint;
     TrainingProgram program;
     bool reset_recently;
-    cpprl::RunningMeanStd returns_rms;
+    RunningMoments returns_rms;
     std::unique_ptr<MultiRolloutGenerator> rollout_generator;
+    // A shared pool is filled by its owner, rather than by every trainer
+    // playing against it
+    bool shares_opponent_pool;
     std::atomic<bool> skip_update;
+    // Runs the async calls one at a time, in the order they were made
+    std::unique_ptr<ThreadPool> worker;
 
-    std::vector<std::pair<std::string, float>> learn(cpprl::RolloutStorage &rollout);
+    std::vector<TrainingMetric> learn(cpprl::RolloutStorage &rollout);
 
   public:
     Trainer(std::unique_ptr<NNAgent> agent,
             std::unique_ptr<cpprl::Algorithm> algorithm,
-            std::unique_ptr<std::vector<std::unique_ptr<IAgent>>> opponent_pool,
+            std::shared_ptr<OpponentPool> opponent_pool,
             TrainingProgram program,
             std::unique_ptr<MultiRolloutGenerator> rollout_generator,
             Checkpointer &checkpointer,
-            EloEvaluator &evaluator);
+            EloEvaluator &evaluator,
+            bool shares_opponent_pool = false);
+    ~Trainer();
 
+    // Takes the other trainer's policy weights and return statistics
+    void copy_weights(const Trainer &other);
     void draw(Renderer &renderer, bool lightweight = false);
     double evaluate();
+    std::future<double> evaluate_async();
+    // Learns from experience gathered elsewhere rather than by this trainer
+    std::vector<TrainingMetric> learn_from(cpprl::RolloutStorage &rollout);
     std::filesystem::path save_model(std::filesystem::path directory = {});
-    std::vector<std::pair<std::string, float>> step_batch();
+    std::future<std::filesystem::path> save_model_async(std::filesystem::path directory = {});
+    // The batch size and number of environments can't be changed, and are
+    // kept as they are
+    void set_hyper_parameters(const HyperParameters &hyper_parameters);
+    std::vector<TrainingMetric> step_batch();
+    std::future<std::vector<TrainingMetric>> step_batch_async();
     bool should_clear_particles();
     void stop();
 
+    inline NNAgent &get_agent() { return *agent; }
     inline unsigned int get_batch_number() const { return rollout_generator->get_batch_number(); }
+    inline const MetricRing &get_metrics() const { return metrics; }
     inline std::string get_current_opponent() const
     {
         return rollout_generator->get_current_opponent(0);
@@ -89,6 +117,12 @@ class TrainerFactory
     Random &rng;
     SingleRolloutGeneratorFactory &single_rollout_generator_factory;
 
+    std::unique_ptr<Trainer> make(TrainingProgram &program,
+                                  std::shared_ptr<OpponentPool> opponent_pool,
+                                  ThreadPool *executor,
+                                  bool shares_opponent_pool,
+                                  std::uint64_t seed) const;
+
   public:
     TrainerFactory(Checkpointer &checkpointer,
                    EloEvaluator &evaluator,
@@ -100,5 +134,23 @@ class TrainerFactory
           single_rollout_generator_factory(single_rollout_generator_factory) {}
 
     std::unique_ptr<Trainer> make(TrainingProgram &program) const;
+    // Makes a trainer that plays against a pool shared with other trainers
+    // and runs its environments on executor, which must outlive it. New
+    // policies are initialized from seed, so trainers given different seeds
+    // start out different.
+    std::unique_ptr<Trainer> make(TrainingProgram &program,
+                                  std::shared_ptr<OpponentPool> opponent_pool,
+                                  ThreadPool &executor,
+                                  std::uint64_t seed) const;
+    // Makes a trainer without environments of its own, which only learns
+    // from rollouts passed to learn_from()
+    std::unique_ptr<Trainer> make_learner(TrainingProgram &program) const;
+    // A random agent followed by the programs' opponents, each loaded when
+    // first played. Checkpoints are dropped from memory, least recently
+    // played first, once they take up more than max_memory bytes.
+    std::unique_ptr<OpponentPool> make_opponent_pool(
+        const std::vector<TrainingProgram> &programs,
+        std::size_t max_memory = 512 * 1024 * 1024) const;
 };
+
 }
\ No newline at end of file
@@ -96,17 +96,19 @@ std::string PartSelectorWindow::update(const std::string &selected_part,
         for (unsigned int i = 0; i < parts.size(); ++i)
         {
             ImGui::BeginGroup();
-            const auto &texture = module_texture_store.get(parts[i]);
+            const auto &region = module_texture_store.get(parts[i]);
+            const auto uv_min = region.get_uv_min();
+            const auto uv_max = region.get_uv_max();
             bool active = false;
             if (parts[i] == selected_part)
             {
                 ImGui::PushStyleColor(ImGuiCol_Button, cl_base00);
                 active = true;
             }
-            if (ImGui::ImageButton(ImTextureID(texture.get_id()),
+            if (ImGui::ImageButton(ImTextureID(region.page->get_id()),
                                    ImVec2(image_size, image_size),
-                                   {1, 1},
-                                   {0, 0}))
+                                   {uv_max.x, uv_max.y},
+                                   {uv_min.x, uv_min.y}))
             {
                 new_selected_part = parts[i];
             }
@@ -218,14 +218,16 @@ bool UnlockPartsWindow::update(bool &show)
             for (unsigned int i = 0; i < parts.size(); ++i)
             {
                 ImGui::BeginGroup();
-                const auto &texture = module_texture_store.get(parts[i].name);
+                const auto &region = module_texture_store.get(parts[i].name);
+                const auto uv_min = region.get_uv_min();
+                const auto uv_max = region.get_uv_max();
                 const auto tint = parts[i].owned ? glm::vec4{1, 1, 1, 1}
                                                  : glm::vec4{0.5f, 0.5f, 0.5f, 1};
                 ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, {13, 3});
-                if (ImGui::ImageButton(ImTextureID(texture.get_id()),
+                if (ImGui::ImageButton(ImTextureID(region.page->get_id()),
                                        ImVec2(image_size, image_size),
-                                       {1, 1},
-                                       {0, 0},
+                                       {uv_max.x, uv_max.y},
+                                       {uv_min.x, uv_min.y},
                                        -1,
                                        {0, 0, 0, 0},
                                        tint))
@@ -302,11 +304,13 @@ bool UnlockPartsWindow::update(bool &show)
 
         const float image_size = resolution.x * 0.1f;
         ImGui::SameLine(ImGui::GetContentRegionAvail().x - image_size);
-        const auto &texture = module_texture_store.get(selected_part->name);
-        ImGui::Image(ImTextureID(texture.get_id()),
+        const auto &region = module_texture_store.get(selected_part->name);
+        const auto uv_min = region.get_uv_min();
+        const auto uv_max = region.get_uv_max();
+        ImGui::Image(ImTextureID(region.page->get_id()),
                      {image_size, image_size},
-                     {1, 1},
-                     {0, 0});
+                     {uv_max.x, uv_max.y},
+                     {uv_min.x, uv_min.y});
 
         ImGui::TextWrapped("%s", module_info(selected_part->name).description.c_str());
     }
@@ -0,0 +1,30 @@
+#include <chrono>
+#include <string>
+
+#include "video_export_app.h"
+#include "audio/audio_engine.h"
+#include "graphics/renderers/particle_renderer.h"
+#include "graphics/renderers/renderer.h"
+#include "misc/random.h"
+#include "misc/resource_manager.h"
+#include "third_party/di.hpp"
+#include "training/checkpointer.h"
+#include "training/saver.h"
+
+using namespace ai;
+
+namespace di = boost::di;
+
+int main(int argc, char *argv[])
+{
+    const auto injector = di::make_injector(
+        di::bind<int>.named(RandomSeed).to(static_cast<int>(std::chrono::high_resolution_clock::now().time_since_epoch().count())),
+        di::bind<int>.named(ResolutionX).to(1280),
+        di::bind<int>.named(ResolutionY).to(720),
+        di::bind<std::string>.named(AssetsPath).to("assets/"),
+        di::bind<int>.named(MaxParticles).to(100000),
+        di::bind<ISaver>.to<Saver>(),
+        di::bind<std::string>.named(CheckpointDirectory).to("checkpoints"));
+    auto app = injector.create<VideoExportApp>();
+    return app.run(argc, argv);
+}
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <signal.h>
+
+#include <doctest.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <torch/torch.h>
+
+#include "video_export_app.h"
+#include "audio/audio_engine.h"
+#include "environment/ecs_env.h"
+#include "environment/serialization/serialize_body.h"
+#include "graphics/backend/shader.h"
+#include "graphics/frame_recorder.h"
+#include "graphics/headless_context.h"
+#include "graphics/post_processing/bloom_layer.h"
+#include "graphics/post_processing/distortion_layer.h"
+#include "graphics/post_processing/post_proc_layer.h"
+#include "graphics/renderers/renderer.h"
+#include "misc/profiler.h"
+#include "misc/random.h"
+#include "misc/resource_manager.h"
+#include "training/agents/iagent.h"
+#include "training/agents/nn_agent.h"
+#include "training/agents/random_agent.h"
+#include "training/checkpointer.h"
+
+namespace
+{
+volatile sig_atomic_t stop;
+
+void inthand(int /*signum*/)
+{
+    stop = 1;
+}
+
+double now()
+{
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(time).count();
+}
+
+const double frame_length = 1. / 60.;
+const int frames_per_action = 6;
+}
+
+namespace ai
+{
+static std::string match_output_path(const std::string &output, int match, int matches)
+{
+    if (matches == 1)
+    {
+        return output;
+    }
+
+    const std::filesystem::path path(output);
+    return (path.parent_path() /
+            fmt::format("{}_{}{}", path.stem().string(), match, path.extension().string()))
+        .string();
+}
+
+VideoExportApp::VideoExportApp(AudioEngine &audio_engine,
+                               Checkpointer &checkpointer,
+                               HeadlessContext &headless_context,
+                               Random &rng,
+                               Renderer &renderer,
+                               ResourceManager &resource_manager)
+    : audio_engine(audio_engine),
+      checkpointer(checkpointer),
+      headless_context(headless_context),
+      renderer(renderer),
+      resource_manager(resource_manager),
+      rng(rng)
+{
+    // Logging
+    spdlog::set_level(spdlog::level::info);
+    spdlog::set_pattern("%^[%T %7l] %v%$");
+
+    signal(SIGINT, inthand);
+}
+
+int VideoExportApp::run(int argc, char *argv[])
+{
+    argh::parser args(argv);
+    if (args[{"-t", "--test"}])
+    {
+        return run_tests(argc, argv, args);
+    }
+
+    std::string checkpoint_path;
+    args({"-c", "--checkpoint"}, "") >> checkpoint_path;
+    std::string opponent_path;
+    args({"--opponent"}, checkpoint_path) >> opponent_path;
+    std::string output;
+    args({"-o", "--output"}, "match.mp4") >> output;
+    int matches;
+    args({"-m", "--matches"}, 1) >> matches;
+    double game_length;
+    args({"-l", "--length"}, 60.) >> game_length;
+    int width;
+    args({"--width"}, renderer.get_width()) >> width;
+    int height;
+    args({"--height"}, renderer.get_height()) >> height;
+    // Frames are piped to the encoder's standard input as raw RGBA
+    std::string encoder;
+    args({"--encoder"},
+         "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgba -s {width}x{height} -r {fps} "
+         "-i - -c:v libx264 -preset veryfast -pix_fmt yuv420p \"{output}\"") >>
+        encoder;
+    const bool raw = args["--raw"];
+    std::string profile_path;
+    if (args({"--profile"}) >> profile_path)
+    {
+        get_profiler().set_enabled(true);
+    }
+
+    headless_context.init(4, 3);
+    renderer.init();
+    renderer.resize(width, height);
+    audio_engine.init(AudioDriver::Null);
+
+    resource_manager.load_shader("bloom", "shaders/highpass.vert", "shaders/highpass.frag");
+    resource_manager.load_shader("blur", "shaders/blur.vert", "shaders/blur.frag");
+    resource_manager.load_shader("combine", "shaders/blur.vert", "shaders/combine.frag");
+    resource_manager.load_shader("crt", "shaders/texture.vert", "shaders/crt.frag");
+    resource_manager.load_shader("texture", "shaders/texture.vert", "shaders/texture.frag");
+    resource_manager.load_shader("distortion",
+                                 "shaders/distortion.vert",
+                                 "shaders/distortion.frag");
+    resource_manager.load_texture("bullet", "images/bullet.png");
+    resource_manager.load_texture("pixel", "images/pixel.png");
+    resource_manager.load_texture("target", "images/target.png");
+    resource_manager.load_font("roboto-16", "fonts/Roboto-Regular.ttf", 16);
+    BloomLayer bloom_post_proc_layer(resource_manager, width, height);
+    PostProcLayer crt_post_proc_layer(*resource_manager.shader_store.get("crt"), width, height);
+    DistortionLayer distortion_layer(resource_manager, width, height);
+
+    auto load_agent = [&](const std::string &path, const std::string &name) -> std::unique_ptr<IAgent> {
+        if (path.empty())
+        {
+            return std::make_unique<RandomAgent>(default_body(), rng, name);
+        }
+        auto checkpoint = checkpointer.load(path);
+        return std::make_unique<NNAgent>(checkpoint.policy, checkpoint.data.body_spec, name);
+    };
+    const auto agent_1 = load_agent(checkpoint_path, "Player 1");
+    const auto agent_2 = load_agent(opponent_path, "Player 2");
+
+    for (int match = 0; match < matches && !stop; ++match)
+    {
+        const auto path = match_output_path(output, match, matches);
+        std::unique_ptr<IFrameSink> sink;
+        if (raw)
+        {
+            sink = std::make_unique<FileFrameSink>(path);
+        }
+        else
+        {
+            sink = std::make_unique<PipeFrameSink>(fmt::format(encoder,
+                                                               fmt::arg("width", width),
+                                                               fmt::arg("height", height),
+                                                               fmt::arg("fps", 60),
+                                                               fmt::arg("output", path)));
+        }
+        FrameRecorder recorder(width, height, *sink);
+
+        EcsEnv environment(game_length);
+        environment.set_audibility(false);
+        environment.set_body(0, agent_1->get_body_spec());
+        environment.set_body(1, agent_2->get_body_spec());
+        auto step_info = environment.reset();
+        auto observation_1 = step_info.observations[0];
+        auto observation_2 = step_info.observations[1];
+        auto hidden_state_1 = torch::zeros({1, agent_1->get_hidden_state_size()});
+        auto hidden_state_2 = torch::zeros({1, agent_2->get_hidden_state_size()});
+        const auto masks = torch::ones({1, 1});
+
+        const double start_time = now();
+        double time = 0;
+        bool done = false;
+        for (int frame = 0; !done && !stop; ++frame)
+        {
+            // Agents act at the same rate as in training, with the physics
+            // run forward every frame in between
+            if (frame % frames_per_action == 0)
+            {
+                torch::NoGradGuard no_grad;
+                const auto act_result_1 = agent_1->act(observation_1, hidden_state_1, masks);
+                const auto act_result_2 = agent_2->act(observation_2, hidden_state_2, masks);
+                hidden_state_1 = act_result_1.hidden_state;
+                hidden_state_2 = act_result_2.hidden_state;
+                step_info = environment.step({act_result_1.action, act_result_2.action},
+                                             frame_length);
+                observation_1 = step_info.observations[0];
+                observation_2 = step_info.observations[1];
+                done = step_info.done[0].item().toBool();
+            }
+            else
+            {
+                environment.forward(frame_length);
+            }
+
+            renderer.begin();
+            renderer.set_distortion_layer(distortion_layer);
+            environment.draw(renderer, audio_engine);
+            renderer.push_post_proc_layer(crt_post_proc_layer);
+            renderer.push_post_proc_layer(bloom_post_proc_layer);
+            resource_manager.shader_store.get("crt")->set_uniform_2f("u_resolution",
+                                                                    {width, height});
+            recorder.record(*renderer.render_to_buffer(time));
+            get_profiler().end_frame();
+            time += frame_length;
+        }
+        recorder.flush();
+
+        const double duration = std::max(now() - start_time, 1e-9);
+        const auto frames = recorder.get_frames_written();
+        spdlog::info("Match {}: {} frames to {} in {:.1f}s ({:.1f}x real time)",
+                     match,
+                     frames,
+                     path,
+                     duration,
+                     static_cast<double>(frames) * frame_length / duration);
+    }
+
+    if (!profile_path.empty())
+    {
+        get_profiler().write_chrome_trace(profile_path);
+    }
+
+    resource_manager.unload_all();
+
+    return 0;
+}
+
+int VideoExportApp::run_tests(int argc, char *argv[], const argh::parser &args)
+{
+    if (!args["--with-logs"])
+    {
+        spdlog::set_level(spdlog::level::off);
+    }
+    doctest::Context context;
+
+    context.setOption("order-by", "name");
+
+    context.applyCommandLine(argc, argv);
+
+    return context.run();
+}
+
+TEST_CASE("match_output_path()")
+{
+    SUBCASE("A single match is written to the output path as is")
+    {
+        DOCTEST_CHECK(match_output_path("clips/match.mp4", 0, 1) == "clips/match.mp4");
+    }
+
+    SUBCASE("Multiple matches are numbered")
+    {
+        DOCTEST_CHECK(match_output_path("clips/match.mp4", 2, 3) == "clips/match_2.mp4");
+    }
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <argh.h>
+
+namespace ai
+{
+class AudioEngine;
+class Checkpointer;
+class HeadlessContext;
+class Random;
+class Renderer;
+class ResourceManager;
+
+class VideoExportApp
+{
+  private:
+    AudioEngine &audio_engine;
+    Checkpointer &checkpointer;
+    HeadlessContext &headless_context;
+    Renderer &renderer;
+    ResourceManager &resource_manager;
+    Random &rng;
+
+    int run_tests(int argc, char *argv[], const argh::parser &args);
+
+  public:
+    VideoExportApp(AudioEngine &audio_engine,
+                   Checkpointer &checkpointer,
+                   HeadlessContext &headless_context,
+                   Random &rng,
+                   Renderer &renderer,
+                   ResourceManager &resource_manager);
+
+    int run(int argc, char *argv[]);
+};
+}